@@ -28,11 +28,27 @@ typedef struct __align__(16)
   unsigned int  functionSize;      /**< The size of the lookup table */
 
   //opague memory back for the transfer function
-  cudaArray* alphaTransferArray1D;
-  cudaArray* galphaTransferArray1D;
-  cudaArray* colorRTransferArray1D;
-  cudaArray* colorGTransferArray1D;
-  cudaArray* colorBTransferArray1D;
+  cudaArray* colourOpacityTransferArray1D;  /**< Colour and opacity packed as RGBA, so a sample needs a single fetch */
+  cudaArray* galphaTransferArray1D;         /**< Gradient opacity, only fetched for shaded samples */
+  cudaTextureObject_t colourOpacityTexture; /**< Texture object the ray caster reads the colour and opacity through */
+  cudaTextureObject_t galphaTexture;        /**< Texture object the ray caster reads the gradient opacity through */
+  int        useGradientOpacity;            /**< Whether the gradient opacity is applied, the ray caster otherwise launching a variant without it */
+
+  // pre-integrated colour and opacity of ray segments, indexed by the intensities at both ends
+  cudaArray*    preIntegrationTransferArray2D;  /**< Colour and opacity of a segment a minimum spacing long */
+  cudaTextureObject_t preIntegrationTexture;    /**< Texture object the ray caster reads the pre-integrated table through */
+  unsigned int  preIntegrationSize;             /**< The number of front (and back) intensities in the pre-integrated table */
+  int           usePreIntegration;              /**< Whether the ray caster composites segments from the pre-integrated table rather than point samples */
+
+  // range maximum query over the opacity, used to find the bricks of the volume which are transparent throughout
+  float*        opacityRangeMax;    /**< Device copy of the sparse table, level k holding the maximum opacity of the 2^k entries from each entry on */
+  unsigned int  opacityRangeLevels; /**< The number of levels of the sparse table */
+  unsigned int  opacityVersion;     /**< Changed every time the tables are baked, so the ray caster knows when to reclassify the bricks */
+
+  // filled in by the ray caster for the kernels, null when the bricks are not (validly) classified
+  const unsigned char* brickOccupancy; /**< Whether each brick of the volume holds any sample with a non-zero opacity */
+  int3          brickGridSize;      /**< The number of bricks along each axis */
+  int           usePreClassified;   /**< Whether the volume classified with these tables is sampled instead of the intensities */
 
 } cuda1DTransferFunctionInformation;
 
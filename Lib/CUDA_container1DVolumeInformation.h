@@ -0,0 +1,50 @@
+/** @file CUDA_container1DVolumeInformation.h
+*
+*  @brief File for the structure holding the device copy of the volume sampled by a 1D ray caster, along with its mip pyramid and bricks
+*
+*  @note This is primarily an internal file used by the vtkCUDA1DVolumeMapper and CUDA_renderAlgo to keep the volume of each mapper apart
+*
+*/
+
+#ifndef __CUDA_container1DVolumeInformation_h
+#define __CUDA_container1DVolumeInformation_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+#include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
+
+//the number of transfer functions whose brick occupancy is kept, so switching between them needs no reclassification
+#define CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS 4
+
+/** @brief A structure held by each mapper that owns the device arrays of its volume and the texture objects reading them, which the CUDA_renderAlgo functions fill in and hand to the kernels sampling them
+*
+*/
+typedef struct __align__(16)
+{
+  //the full resolution volume, holding halves when the volume has to be kept small
+  cudaArray*    sourceDataArray;  /**< The full resolution volume, level 0 of the mip pyramid */
+  size_t        sourceVoxelSize;  /**< Size in bytes of a voxel of the full resolution volume */
+  cudaTextureObject_t sourceTexture; /**< Texture object fetching the voxels of the full resolution volume without interpolation */
+
+  //coarser levels of the mip pyramid (level 0 is the source data array itself)
+  cudaArray*    pyramidArray[CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS];   /**< Average intensities of each coarser level */
+  float2*       pyramidMinMax[CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS];  /**< Min/max intensities of each coarser level */
+  cudaTextureObject_t levelTexture[CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS]; /**< Texture objects interpolating each level, the full resolution volume included */
+  int           currentLevel;     /**< The level the ray caster samples */
+
+  //intensity range of each brick of the full resolution volume, and whether each is visible under the last few transfer functions
+  float2*       brickMinMax;      /**< Intensity range of each brick, null when the bricks were not built */
+  unsigned char* brickOccupancy;  /**< CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS sets of whether each brick is visible */
+  int3          brickGridSize;    /**< The number of bricks along each axis */
+  unsigned int  brickVersion[CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS]; /**< Version of the tables each set of occupancies was classified with (0 being none) */
+  unsigned int  brickLastUse[CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS]; /**< When each set of occupancies was last rendered with, the oldest being reclassified first */
+  unsigned int  brickUseCounter;  /**< Counts the renders using the occupancies */
+
+  //the full resolution volume classified by a stable transfer function, as colour multiplied by opacity
+  cudaArray*    classifiedArray;   /**< The RGBA volume, null when pre-classification is off or did not fit */
+  cudaTextureObject_t classifiedTexture; /**< Texture object interpolating the RGBA volume as normalized floats */
+  unsigned int  classifiedVersion; /**< Version of the tables the volume was classified with, or last tried to be (0 being none) */
+
+} cuda1DVolumeInformation;
+
+#endif
@@ -0,0 +1,36 @@
+/** @file CUDA_container2DTransferFunctionInformation.h
+*
+*  @brief File for the transfer function information holding structure used for volume ray casting with 2D TFs
+*
+*  @note This is primarily an internal file used by the vtkCUDA2DTransferFunctionInformationHandler and CUDA_renderAlgo to store and communicate constants
+*
+*/
+
+#ifndef __CUDA_container2DTransferFunctionInformation_h
+#define __CUDA_container2DTransferFunctionInformation_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+
+/** @brief A stucture located on the CUDA hardware that holds all the information required about the 2D (intensity by gradient magnitude) transfer function
+*
+*/
+typedef struct __align__(16)
+{
+  // The scale and shift to transform intensity and gradient magnitude to indices in the transfer function
+  float      intensityLow;         /**< Intensity of the first column of the table */
+  float      intensityMultiplier;  /**< Scale factor to normalize intensities to between 0 and 1 */
+  float      gradientLow;          /**< Gradient magnitude of the first row of the table */
+  float      gradientMultiplier;   /**< Scale factor to normalize gradient magnitudes to between 0 and 1 */
+  unsigned int  intensitySize;     /**< The number of columns (intensities) of the lookup table */
+  unsigned int  gradientSize;      /**< The number of rows (gradient magnitudes) of the lookup table */
+
+  //opague memory back for the transfer function
+  cudaArray* colourOpacityTransferArray2D;  /**< Colour and opacity packed as RGBA, indexed by intensity then gradient magnitude */
+  cudaArray* maxOpacityTransferArray1D;     /**< The highest opacity of each column, so samples transparent at any gradient skip the gradient */
+  cudaTextureObject_t colourOpacityTexture; /**< Texture object the ray caster reads the colour and opacity through */
+  cudaTextureObject_t maxOpacityTexture;    /**< Texture object the ray caster reads the column maxima through */
+
+} cuda2DTransferFunctionInformation;
+
+#endif
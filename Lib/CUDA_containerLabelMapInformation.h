@@ -0,0 +1,34 @@
+/** @file CUDA_containerLabelMapInformation.h
+*
+*  @brief File for the label information holding structure used for volume ray casting of label maps
+*
+*  @note This is primarily an internal file used by the vtkCUDALabelMapInformationHandler and CUDA_renderAlgo to store and communicate constants
+*
+*/
+
+#ifndef __CUDA_containerLabelMapInformation_h
+#define __CUDA_containerLabelMapInformation_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+
+/** @brief A stucture located on the CUDA hardware that holds all the information required about the colour, opacity and visibility of each label
+*
+*/
+typedef struct __align__(16)
+{
+  unsigned int  numberOfLabels;      /**< The number of entries of the colour table, higher labels being transparent */
+  unsigned int  visibilityVersion;   /**< Identifies the uploaded visibility, changing with every upload of the bitmask (0 being none) */
+
+  //opague memory back for the labels
+  cudaArray* colourOpacityArray;            /**< Colour and opacity of each label packed as RGBA */
+  cudaTextureObject_t colourOpacityTexture; /**< Texture object the ray caster fetches the colour and opacity of a label through, without interpolation */
+  unsigned int* visibility;                 /**< One bit per label (32 labels per word), set for the visible labels of non-zero opacity */
+
+  //bricks holding a visible label, filled in by the ray caster and null when it cannot jump over empty space
+  unsigned char* brickOccupancy;  /**< Whether each brick of the volume holds a visible label */
+  int3  brickGridSize;            /**< The number of bricks along each axis */
+
+} cudaLabelMapInformation;
+
+#endif
@@ -0,0 +1,46 @@
+/** @file CUDA_containerMultiChannelInformation.h
+*
+*  @brief File for the channel information holding structure used for volume ray casting of several co-registered channels at once
+*
+*  @note This is primarily an internal file used by the vtkCUDAMultiChannelVolumeMapper and CUDA_renderAlgo to store and communicate constants
+*
+*/
+
+#ifndef __CUDA_containerMultiChannelInformation_h
+#define __CUDA_containerMultiChannelInformation_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+
+//the most channels a single ray march samples
+#define CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS 4
+
+//ways the classified channels of a sample are blended
+#define CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_ADD     0 /**< Opacities combine as layered samples, colours are averaged by opacity */
+#define CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_MAXIMUM 1 /**< The most opaque channel alone is taken */
+
+/** @brief A stucture located on the CUDA hardware that holds all the information required about the channels and their transfer functions
+*
+*/
+typedef struct __align__(16)
+{
+  int        numberOfChannels;  /**< The number of channels sampled, channel 0 being the input of the 1D ray caster */
+  int        blendMode;         /**< How the channels of a sample are blended */
+
+  // the transfer function of each channel, as baked by its handler
+  float      weight[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];              /**< Scale applied to the opacity of each channel */
+  float      intensityLow[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];        /**< Intensity of the first entry of each channel's table */
+  float      intensityMultiplier[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS]; /**< Scale factor to normalize each channel's intensities to between 0 and 1 */
+  float      gradientLow[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];         /**< Gradient magnitude of the first entry of each channel's gradient opacity table */
+  float      gradientMultiplier[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];  /**< Scale factor to normalize each channel's gradient magnitudes to between 0 and 1 */
+  cudaTextureObject_t colourOpacityTexture[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS]; /**< Texture objects reading each channel's colour and opacity */
+  cudaTextureObject_t galphaTexture[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];        /**< Texture objects reading each channel's gradient opacity */
+
+  // filled in by the ray caster
+  cudaTextureObject_t volumeTexture[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS]; /**< Texture objects reading the volume of each channel, the first at the level rendered */
+  const unsigned char* brickOccupancy; /**< Whether each brick of the volume is visible in any channel, null when the bricks are not (validly) classified */
+  int3       brickGridSize;      /**< The number of bricks along each axis */
+
+} cudaMultiChannelInformation;
+
+#endif
@@ -0,0 +1,33 @@
+/** @file CUDA_containerMultiChannelVolumeInformation.h
+*
+*  @brief File for the structure holding the device copies of the channels past the first sampled by a multi-channel ray caster, along with their bricks
+*
+*  @note This is primarily an internal file used by the vtkCUDAMultiChannelVolumeMapper and CUDA_renderAlgo to keep the channels of each mapper apart
+*
+*/
+
+#ifndef __CUDA_containerMultiChannelVolumeInformation_h
+#define __CUDA_containerMultiChannelVolumeInformation_h
+
+// CUDA Volume Rendering includes
+#include "vector_types.h"
+#include "CUDA_containerMultiChannelInformation.h"
+
+/** @brief A structure held by each mapper that owns the device arrays of its channels past the first, the first being held in its 1D volume information
+*
+*/
+typedef struct __align__(16)
+{
+  //the volumes of the channels past the first, and the intensity range of each of their bricks
+  cudaArray*          channelArray[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];   /**< The full resolution volume of each channel, null for the first */
+  cudaTextureObject_t channelTexture[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS]; /**< Texture objects reading the volume of each channel */
+  float2*             channelMinMax[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];  /**< Intensity range of each brick of each channel, null when they were not built */
+
+  //whether each brick is visible in any channel, and what it was classified with
+  unsigned char*      brickOccupancy;  /**< Whether each brick is visible in any channel */
+  int                 brickChannels;   /**< The number of channels the bricks were classified with (0 being none) */
+  unsigned int        brickVersion[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS]; /**< Version of the tables of each channel the bricks were classified with */
+
+} cudaMultiChannelVolumeInformation;
+
+#endif
@@ -23,14 +23,6 @@ typedef struct
   uint2       resolution;        /**< The resolution of the texture/image that will be textured to the screen */
   uchar4*     deviceOutputImage; /**< The texture/image that will be textured to the screen on device memory */
 
-  float*      rayStartX;         /**< The ray starting location buffer (x component) */
-  float*      rayStartY;         /**< The ray starting location buffer (y component) */
-  float*      rayStartZ;         /**< The ray starting location buffer (z component) */
-  float*      rayIncX;           /**< The ray increment amount buffer (x component) */
-  float*      rayIncY;           /**< The ray increment amount buffer (y component) */
-  float*      rayIncZ;           /**< The ray increment amount buffer (z component) */
-  float*      numSteps;          /**< The number of sample points on the ray */
-
 } cudaOutputImageInformation;
 
 #endif
@@ -31,6 +31,10 @@ typedef struct __align__(16)
   float gradShadeScale;      /**< Multiplicative constant for flat-like shading of the volume */
   float gradShadeShift;      /**< Additive constant for the flat-like shading of the volume */
 
+  //the depth of the opaque geometry the rays stop at
+  cudaArray* ZBufferArray;             /**< The z buffer of the renderer on the device */
+  cudaTextureObject_t ZBufferTexture;  /**< Texture object the rays read the z buffer through */
+
 } cudaRendererInformation;
 
 #endif
@@ -26,6 +26,12 @@ typedef struct __align__(16)
   float3     SpacingReciprocal; /**< The reciprocal of the spacing between pixels in the volume in the X, Y and Z directions */
   float3     Spacing;
   float      MinSpacing;
+  float      OpacitySpacing;    /**< The minimum spacing of the input before any downsampling or level of detail, which the opacities are defined over */
+
+  // Sampling along the rays
+  int        VoxelSpaceSampling; /**< Whether the ray steps are sized in voxels along the ray direction rather than by the minimum spacing */
+  float      SampleDistance;     /**< The length of a ray step, in voxels or minimum spacings */
+  int        CorrectOpacity;     /**< Whether a ray step may cover another distance than the opacity spacing, so the opacities have to be corrected to it */
 
   // Shading of the volume
   float      Ambient;
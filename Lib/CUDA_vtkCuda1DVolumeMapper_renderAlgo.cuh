@@ -10,24 +10,69 @@
 #include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
 #include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
 #include <cuda.h>
+#include <string.h>
 
-//execution parameters and general information
-__constant__ cuda1DTransferFunctionInformation  CUDA_vtkCUDA1DVolumeMapper_trfInfo;
+//the transfer function is handed to the kernels as a parameter, its tables being read through texture objects owned by
+//the mapper's transfer function handler, and the volume, its mip pyramid, its bricks and its classified volume are arrays owned by the mapper
+//and read through texture objects of its own (see cuda1DVolumeInformation), so no two mappers share any of them on the device
+cudaChannelFormatDesc colourOpacityChannelDesc = cudaCreateChannelDesc<float4>();
 
-//transfer function as read-only textures
-texture<float, 1, cudaReadModeElementType> alpha_texture_1D;
-texture<float, 1, cudaReadModeElementType> galpha_texture_1D;
-texture<float, 1, cudaReadModeElementType> colorR_texture_1D;
-texture<float, 1, cudaReadModeElementType> colorG_texture_1D;
-texture<float, 1, cudaReadModeElementType> colorB_texture_1D;
+//creates a texture object reading a table with linear interpolation between its entries and normalized, clamped coordinates
+cudaTextureObject_t CUDA_vtkCUDA1DVolumeMapper_createTableTexture(cudaArray* tableArray){
+  cudaResourceDesc resourceDesc;
+  memset(&resourceDesc, 0, sizeof(resourceDesc));
+  resourceDesc.resType = cudaResourceTypeArray;
+  resourceDesc.res.array.array = tableArray;
 
-//3D input data (read-only texture with corresponding opague device memory back)
-texture<float, 3, cudaReadModeElementType> CUDA_vtkCUDA1DVolumeMapper_input_texture;
-cudaArray* CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[1];
+  cudaTextureDesc textureDesc;
+  memset(&textureDesc, 0, sizeof(textureDesc));
+  textureDesc.normalizedCoords = 1;
+  textureDesc.filterMode = cudaFilterModeLinear;
+  textureDesc.addressMode[0] = cudaAddressModeClamp;
+  textureDesc.addressMode[1] = cudaAddressModeClamp;
+  textureDesc.readMode = cudaReadModeElementType;
 
-__device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStart,
+  cudaTextureObject_t tableTexture = 0;
+  cudaCreateTextureObject(&tableTexture, &resourceDesc, &textureDesc, 0);
+  return tableTexture;
+}
+
+//the texture object interpolating the level of a volume the ray caster samples, falling back on the full resolution volume
+cudaTextureObject_t CUDA_vtkCUDA1DVolumeMapper_renderAlgo_inputTexture(const cuda1DVolumeInformation& volumeData){
+  const int level = volumeData.currentLevel;
+  return (level > 0 && volumeData.levelTexture[level]) ? volumeData.levelTexture[level] : volumeData.levelTexture[0];
+}
+
+//number of steps taking the ray out of the brick it is in if that brick is transparent throughout, 0 if it is not
+__device__ int CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_EmptyBrickSteps(const float3& rayStart, const float3& rayInc,
+                  const unsigned char* brickOccupancy, const int3& brickGrid) {
+
+  const float brickSize = (float) CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE;
+  int3 brick;
+  brick.x = __float2int_rd(rayStart.x / brickSize);
+  brick.y = __float2int_rd(rayStart.y / brickSize);
+  brick.z = __float2int_rd(rayStart.z / brickSize);
+  if( brick.x < 0 || brick.y < 0 || brick.z < 0 || brick.x >= brickGrid.x || brick.y >= brickGrid.y || brick.z >= brickGrid.z ) return 0;
+  if( brickOccupancy[brick.x + brickGrid.x * (brick.y + brickGrid.y * brick.z)] ) return 0;
+
+  //distance (in steps) to the face the ray leaves the brick through
+  const float exitX = (rayInc.x > 0.0f) ? ((brick.x + 1) * brickSize - rayStart.x) / rayInc.x :
+                      (rayInc.x < 0.0f) ? (brick.x * brickSize - rayStart.x) / rayInc.x : 1.0e+38f;
+  const float exitY = (rayInc.y > 0.0f) ? ((brick.y + 1) * brickSize - rayStart.y) / rayInc.y :
+                      (rayInc.y < 0.0f) ? (brick.y * brickSize - rayStart.y) / rayInc.y : 1.0e+38f;
+  const float exitZ = (rayInc.z > 0.0f) ? ((brick.z + 1) * brickSize - rayStart.z) / rayInc.z :
+                      (rayInc.z < 0.0f) ? (brick.z * brickSize - rayStart.z) / rayInc.z : 1.0e+38f;
+  return max( 1, __float2int_ru( fminf( exitX, fminf( exitY, exitZ ) ) ) );
+}
+
+//the shading and gradient opacity are template parameters, so a variant without them takes no gradient at all
+template< bool Shade, bool GradientOpacity >
+__device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(const cudaVolumeInformation& volInfo,
+                  const cudaTextureObject_t inputTexture,
+                  float3& rayStart,
                   const float& numSteps,
                   const float3& rayInc,
+                  const cuda1DTransferFunctionInformation& trfInfo,
                   float4& outputVal) {
 
   //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
@@ -38,15 +83,17 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
     
   //fetch the required information about the size and range of the transfer function from memory to registers
   __syncthreads();
-  const float functRangeLow = CUDA_vtkCUDA1DVolumeMapper_trfInfo.intensityLow;
-  const float functRangeMulti = CUDA_vtkCUDA1DVolumeMapper_trfInfo.intensityMultiplier;
-  const float gradRangeLow = CUDA_vtkCUDA1DVolumeMapper_trfInfo.gradientLow;
-  const float gradRangeMulti = CUDA_vtkCUDA1DVolumeMapper_trfInfo.gradientMultiplier;
+  const float functRangeLow = trfInfo.intensityLow;
+  const float functRangeMulti = trfInfo.intensityMultiplier;
+  const float gradRangeLow = trfInfo.gradientLow;
+  const float gradRangeMulti = trfInfo.gradientMultiplier;
   const float3 space = volInfo.SpacingReciprocal;
   const float3 incSpace = volInfo.Spacing;
   const float ambient = volInfo.Ambient;
   const float diffuse = volInfo.Diffuse;
   const float2 spec = volInfo.Specular;
+  const unsigned char* brickOccupancy = trfInfo.brickOccupancy;
+  const int3 brickGrid = trfInfo.brickGridSize;
   __syncthreads();
 
   //apply a randomized offset to the ray
@@ -56,9 +103,8 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
   rayStart.x += retDepth*rayInc.x;
   rayStart.y += retDepth*rayInc.y;
   rayStart.z += retDepth*rayInc.z;
-  float rayLength = sqrtf(rayInc.x*rayInc.x*incSpace.x*incSpace.x +
-              rayInc.y*rayInc.y*incSpace.y*incSpace.y +
-              rayInc.z*rayInc.z*incSpace.z*incSpace.z);
+  float rayLength;
+  const float opacityExponent = CUDAkernel_OpacityExponent(volInfo, rayInc, rayLength);
   //allocate flags
   char2 step;
   step.x = 0;
@@ -68,11 +114,11 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
   while( maxSteps > 0 ){
 
     // fetching the intensity index into the transfer function
-    const float tempIndex = functRangeMulti * (tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+    const float tempIndex = functRangeMulti * (tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
   
-    //fetching the opacity value of the sampling point (apply transfer function in stages to minimize work)
-    // as well as the colour multiplier (with photorealistic shading)
-    float alpha = tex1D(alpha_texture_1D, tempIndex);
+    //fetching the colour and opacity of the sampling point at once (the gradient opacity being applied in a second stage to minimize work)
+    const float4 colourOpacity = tex1D<float4>(trfInfo.colourOpacityTexture, tempIndex);
+    float alpha = colourOpacity.w;
 
     //filter out objects with too low opacity (deemed unimportant, and this saves time and reduces cloudiness)
     if(alpha > 0.0f){
@@ -89,29 +135,36 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
 
       if(!step.x){
 
-        float3 gradient;
-        gradient.x = ( tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x+0.5f, rayStart.y, rayStart.z)
-               - tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
-        gradient.y = ( tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y+0.5f, rayStart.z)
-               - tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
-        gradient.z = ( tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y, rayStart.z+0.5f)
-               - tex3D(CUDA_vtkCUDA1DVolumeMapper_input_texture, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
-        float gradMag = sqrtf(dot(gradient, gradient));
-        alpha *= isfinite(gradRangeMulti) ? tex1D(galpha_texture_1D, gradRangeMulti*(gradMag-gradRangeLow)) : 1.0f;
-        float phongLambert = saturate( abs ( gradient.x*rayInc.x*incSpace.x + 
-                           gradient.y*rayInc.y*incSpace.y +
-                           gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) );
-        float shadeD = ambient + diffuse * phongLambert;
-        float shadeS = spec.x * pow(phongLambert, spec.y);
+        float shadeD = ambient;
+        float shadeS = 0.0f;
+        if(Shade || GradientOpacity){
+          float3 gradient;
+          gradient.x = ( tex3D<float>(inputTexture, rayStart.x+0.5f, rayStart.y, rayStart.z)
+                 - tex3D<float>(inputTexture, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
+          gradient.y = ( tex3D<float>(inputTexture, rayStart.x, rayStart.y+0.5f, rayStart.z)
+                 - tex3D<float>(inputTexture, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
+          gradient.z = ( tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z+0.5f)
+                 - tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
+          float gradMag = sqrtf(dot(gradient, gradient));
+          if(GradientOpacity) alpha *= tex1D<float>(trfInfo.galphaTexture, gradRangeMulti*(gradMag-gradRangeLow));
+          if(Shade){
+            float phongLambert = saturate( abs ( gradient.x*rayInc.x*incSpace.x + 
+                               gradient.y*rayInc.y*incSpace.y +
+                               gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) );
+            shadeD += diffuse * phongLambert;
+            shadeS = spec.x * pow(phongLambert, spec.y);
+          }
+        }
 
         //accumulate the opacity for this sample point
+        if(opacityExponent > 0.0f) alpha = 1.0f - __powf(1.0f - alpha, opacityExponent);
         float multiplier = outputVal.w * alpha;
         outputVal.w *= (1.0f - alpha);
 
         //accumulate the colour information from this sample point
-        outputVal.x += multiplier * saturate(shadeD * tex1D(colorR_texture_1D, tempIndex) + shadeS);
-        outputVal.y += multiplier * saturate(shadeD * tex1D(colorG_texture_1D, tempIndex) + shadeS);
-        outputVal.z += multiplier * saturate(shadeD * tex1D(colorB_texture_1D, tempIndex) + shadeS);
+        outputVal.x += multiplier * saturate(shadeD * colourOpacity.x + shadeS);
+        outputVal.y += multiplier * saturate(shadeD * colourOpacity.y + shadeS);
+        outputVal.z += multiplier * saturate(shadeD * colourOpacity.z + shadeS);
       }
       
       //determine whether or not we've hit an opacity where further sampling becomes neglible
@@ -122,6 +175,18 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
 
     }else{
 
+      //jump straight out of a brick which is transparent throughout
+      const int emptySteps = brickOccupancy ? CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_EmptyBrickSteps(rayStart, rayInc, brickOccupancy, brickGrid) : 0;
+      if(emptySteps){
+        rayStart.x += emptySteps * rayInc.x;
+        rayStart.y += emptySteps * rayInc.y;
+        rayStart.z += emptySteps * rayInc.z;
+        maxSteps -= emptySteps;
+        step.x = 0;
+        step.y = 0;
+        continue;
+      }
+
       //if we aren't backstepping, we can skip a sample
       if(!step.x){
         rayStart.x += rayInc.x;
@@ -150,7 +215,420 @@ __device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(float3& rayStar
 
 }
 
-__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite( ) {
+template< bool Shade, bool GradientOpacity >
+__device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1DPreIntegrated(const cudaVolumeInformation& volInfo,
+                  const cudaTextureObject_t inputTexture,
+                  float3& rayStart,
+                  const float& numSteps,
+                  const float3& rayInc,
+                  const cuda1DTransferFunctionInformation& trfInfo,
+                  float4& outputVal) {
+
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  outputVal.x = 0.0f; //R
+  outputVal.y = 0.0f; //G
+  outputVal.z = 0.0f; //B
+  outputVal.w = 1.0f; //A
+
+  //fetch the required information about the size and range of the transfer function from memory to registers
+  __syncthreads();
+  const float functRangeLow = trfInfo.intensityLow;
+  const float functRangeMulti = trfInfo.intensityMultiplier;
+  const float gradRangeLow = trfInfo.gradientLow;
+  const float gradRangeMulti = trfInfo.gradientMultiplier;
+  const float3 space = volInfo.SpacingReciprocal;
+  const float3 incSpace = volInfo.Spacing;
+  const float ambient = volInfo.Ambient;
+  const float diffuse = volInfo.Diffuse;
+  const float2 spec = volInfo.Specular;
+  const float opacitySpacing = volInfo.OpacitySpacing;
+  const unsigned char* brickOccupancy = trfInfo.brickOccupancy;
+  const int3 brickGrid = trfInfo.brickGridSize;
+  __syncthreads();
+
+  //apply a randomized offset to the ray
+  float retDepth = dRandomRayOffsets[threadIdx.x + BLOCK_DIM2D * threadIdx.y];
+  __syncthreads();
+  int maxSteps = __float2int_rd(numSteps - retDepth) ;
+  rayStart.x += retDepth*rayInc.x;
+  rayStart.y += retDepth*rayInc.y;
+  rayStart.z += retDepth*rayInc.z;
+  float rayLength = sqrtf(rayInc.x*rayInc.x*incSpace.x*incSpace.x +
+              rayInc.y*rayInc.y*incSpace.y*incSpace.y +
+              rayInc.z*rayInc.z*incSpace.z*incSpace.z);
+
+  //the table holds segments as long as the input's minimum spacing, so the opacity is always corrected to the length of a step
+  //by an exponent of this caster's own, rather than only when CUDAkernel_OpacityExponent finds a step of another length
+  const float opacityExponent = rayLength / opacitySpacing;
+
+  //the front of the first segment is the start of the ray, each segment's back being the next one's front
+  float frontIndex = functRangeMulti * (tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+
+  while( maxSteps > 0 ){
+
+    //move to the back of the segment and fetch its integrated colour and opacity
+    rayStart.x += rayInc.x;
+    rayStart.y += rayInc.y;
+    rayStart.z += rayInc.z;
+    maxSteps--;
+    const float backIndex = functRangeMulti * (tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+    const float4 colourOpacity = tex2D<float4>(trfInfo.preIntegrationTexture, frontIndex, backIndex);
+    frontIndex = backIndex;
+    float alpha = colourOpacity.w;
+
+    //segments which are transparent over their whole length need no shading
+    if(alpha > 0.0f){
+
+      //shade the segment using the gradient at its back
+      float shadeD = ambient;
+      float shadeS = 0.0f;
+      if(Shade || GradientOpacity){
+        float3 gradient;
+        gradient.x = ( tex3D<float>(inputTexture, rayStart.x+0.5f, rayStart.y, rayStart.z)
+               - tex3D<float>(inputTexture, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
+        gradient.y = ( tex3D<float>(inputTexture, rayStart.x, rayStart.y+0.5f, rayStart.z)
+               - tex3D<float>(inputTexture, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
+        gradient.z = ( tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z+0.5f)
+               - tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
+        float gradMag = sqrtf(dot(gradient, gradient));
+        if(GradientOpacity) alpha *= tex1D<float>(trfInfo.galphaTexture, gradRangeMulti*(gradMag-gradRangeLow));
+        if(Shade){
+          float phongLambert = saturate( abs ( gradient.x*rayInc.x*incSpace.x + 
+                             gradient.y*rayInc.y*incSpace.y +
+                             gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) );
+          shadeD += diffuse * phongLambert;
+          shadeS = spec.x * pow(phongLambert, spec.y);
+        }
+      }
+
+      //accumulate the opacity for this segment
+      alpha = 1.0f - __powf(1.0f - alpha, opacityExponent);
+      float multiplier = outputVal.w * alpha;
+      outputVal.w *= (1.0f - alpha);
+
+      //accumulate the colour information from this segment
+      outputVal.x += multiplier * saturate(shadeD * colourOpacity.x + shadeS);
+      outputVal.y += multiplier * saturate(shadeD * colourOpacity.y + shadeS);
+      outputVal.z += multiplier * saturate(shadeD * colourOpacity.z + shadeS);
+
+      //determine whether or not we've hit an opacity where further sampling becomes neglible
+      if(outputVal.w < 0.015625f){
+        outputVal.w = 0.0f;
+        break;
+      }
+
+    }else{
+
+      //jump straight out of a brick which is transparent throughout, starting a new segment where the ray lands
+      const int emptySteps = brickOccupancy ? CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_EmptyBrickSteps(rayStart, rayInc, brickOccupancy, brickGrid) : 0;
+      if(emptySteps){
+        rayStart.x += emptySteps * rayInc.x;
+        rayStart.y += emptySteps * rayInc.y;
+        rayStart.z += emptySteps * rayInc.z;
+        maxSteps -= emptySteps;
+        frontIndex = functRangeMulti * (tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+      }
+
+    }
+
+  }//while
+
+  //adjust the opacity output to reflect the collected opacity, and not the remaining opacity
+  outputVal.w = 1.0f - outputVal.w;
+  outputVal.x = saturate( outputVal.x );
+  outputVal.y = saturate( outputVal.y );
+  outputVal.z = saturate( outputVal.z );
+
+}
+
+//the gradient opacity is part of the classified volume, so only the shading is a template parameter
+template< bool Shade >
+__device__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1DPreClassified(const cudaVolumeInformation& volInfo,
+                  const cudaTextureObject_t inputTexture,
+                  const cudaTextureObject_t classifiedTexture,
+                  float3& rayStart,
+                  const float& numSteps,
+                  const float3& rayInc,
+                  const cuda1DTransferFunctionInformation& trfInfo,
+                  float4& outputVal) {
+
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  outputVal.x = 0.0f; //R
+  outputVal.y = 0.0f; //G
+  outputVal.z = 0.0f; //B
+  outputVal.w = 1.0f; //A
+
+  //fetch the required information about the volume from memory to registers
+  __syncthreads();
+  const float3 space = volInfo.SpacingReciprocal;
+  const float3 incSpace = volInfo.Spacing;
+  const float ambient = volInfo.Ambient;
+  const float diffuse = volInfo.Diffuse;
+  const float2 spec = volInfo.Specular;
+  const unsigned char* brickOccupancy = trfInfo.brickOccupancy;
+  const int3 brickGrid = trfInfo.brickGridSize;
+  __syncthreads();
+
+  //apply a randomized offset to the ray
+  float retDepth = dRandomRayOffsets[threadIdx.x + BLOCK_DIM2D * threadIdx.y];
+  __syncthreads();
+  int maxSteps = __float2int_rd(numSteps - retDepth) ;
+  rayStart.x += retDepth*rayInc.x;
+  rayStart.y += retDepth*rayInc.y;
+  rayStart.z += retDepth*rayInc.z;
+  float rayLength;
+  const float opacityExponent = CUDAkernel_OpacityExponent(volInfo, rayInc, rayLength);
+
+  while( maxSteps > 0 ){
+
+    //the classified volume holds the colour multiplied by the opacity, so transparent neighbours do not bleed into the sample
+    const float4 classified = tex3D<float4>(classifiedTexture, rayStart.x, rayStart.y, rayStart.z);
+    float alpha = classified.w;
+
+    if(alpha > 0.0f){
+
+      //only shading still needs the gradient
+      float shadeD = ambient;
+      float shadeS = 0.0f;
+      if(Shade){
+        float3 gradient;
+        gradient.x = ( tex3D<float>(inputTexture, rayStart.x+0.5f, rayStart.y, rayStart.z)
+               - tex3D<float>(inputTexture, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
+        gradient.y = ( tex3D<float>(inputTexture, rayStart.x, rayStart.y+0.5f, rayStart.z)
+               - tex3D<float>(inputTexture, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
+        gradient.z = ( tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z+0.5f)
+               - tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
+        float gradMag = sqrtf(dot(gradient, gradient));
+        float phongLambert = saturate( abs ( gradient.x*rayInc.x*incSpace.x + 
+                           gradient.y*rayInc.y*incSpace.y +
+                           gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) );
+        shadeD += diffuse * phongLambert;
+        shadeS = spec.x * pow(phongLambert, spec.y);
+      }
+
+      //accumulate the opacity for this sample point
+      const float colourScale = 1.0f / alpha;
+      if(opacityExponent > 0.0f) alpha = 1.0f - __powf(1.0f - alpha, opacityExponent);
+      float multiplier = outputVal.w * alpha;
+      outputVal.w *= (1.0f - alpha);
+
+      //accumulate the colour information from this sample point
+      outputVal.x += multiplier * saturate(shadeD * classified.x * colourScale + shadeS);
+      outputVal.y += multiplier * saturate(shadeD * classified.y * colourScale + shadeS);
+      outputVal.z += multiplier * saturate(shadeD * classified.z * colourScale + shadeS);
+
+      //determine whether or not we've hit an opacity where further sampling becomes neglible
+      if(outputVal.w < 0.015625f){
+        outputVal.w = 0.0f;
+        break;
+      }
+
+    }else{
+
+      //jump straight out of a brick which is transparent throughout
+      const int emptySteps = brickOccupancy ? CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_EmptyBrickSteps(rayStart, rayInc, brickOccupancy, brickGrid) : 0;
+      if(emptySteps){
+        rayStart.x += emptySteps * rayInc.x;
+        rayStart.y += emptySteps * rayInc.y;
+        rayStart.z += emptySteps * rayInc.z;
+        maxSteps -= emptySteps;
+        continue;
+      }
+
+    }
+
+    //move to the next sample
+    rayStart.x += rayInc.x;
+    rayStart.y += rayInc.y;
+    rayStart.z += rayInc.z;
+    maxSteps--;
+
+  }//while
+
+  //adjust the opacity output to reflect the collected opacity, and not the remaining opacity
+  outputVal.w = 1.0f - outputVal.w;
+  outputVal.x = saturate( outputVal.x );
+  outputVal.y = saturate( outputVal.y );
+  outputVal.z = saturate( outputVal.z );
+
+}
+
+//classify a slab of slices of the full resolution volume (the z index is folded into the y index of the grid)
+__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_PreClassify( uchar4* classifiedOut, const cudaTextureObject_t inputTexture, const int3 volumeSize,
+                                                                    const int firstSlice, const int blocksY, const float3 space,
+                                                                    const cuda1DTransferFunctionInformation trfInfo ) {
+
+  int3 index;
+  index.x = blockDim.x * blockIdx.x + threadIdx.x;
+  index.y = blockDim.y * (blockIdx.y % blocksY) + threadIdx.y;
+  index.z = blockIdx.y / blocksY;
+  if( index.x >= volumeSize.x || index.y >= volumeSize.y ) return;
+
+  //sample the voxel where the ray caster samples it
+  const float3 voxel = make_float3( index.x + 0.5f, index.y + 0.5f, firstSlice + index.z + 0.5f );
+  const float tempIndex = trfInfo.intensityMultiplier *
+                          (tex3D<float>(inputTexture, voxel.x, voxel.y, voxel.z) - trfInfo.intensityLow);
+  const float4 colourOpacity = tex1D<float4>(trfInfo.colourOpacityTexture, tempIndex);
+  float alpha = colourOpacity.w;
+  const float gradRangeMulti = trfInfo.gradientMultiplier;
+  if(alpha > 0.0f && trfInfo.useGradientOpacity && isfinite(gradRangeMulti)){
+    float3 gradient;
+    gradient.x = ( tex3D<float>(inputTexture, voxel.x+0.5f, voxel.y, voxel.z)
+           - tex3D<float>(inputTexture, voxel.x-0.5f, voxel.y, voxel.z) ) * space.x;
+    gradient.y = ( tex3D<float>(inputTexture, voxel.x, voxel.y+0.5f, voxel.z)
+           - tex3D<float>(inputTexture, voxel.x, voxel.y-0.5f, voxel.z) ) * space.y;
+    gradient.z = ( tex3D<float>(inputTexture, voxel.x, voxel.y, voxel.z+0.5f)
+           - tex3D<float>(inputTexture, voxel.x, voxel.y, voxel.z-0.5f) ) * space.z;
+    float gradMag = sqrtf(dot(gradient, gradient));
+    alpha *= tex1D<float>(trfInfo.galphaTexture, gradRangeMulti*(gradMag-trfInfo.gradientLow));
+  }
+  alpha = saturate(alpha);
+
+  uchar4 classified;
+  classified.x = __float2int_rn( 255.0f * saturate(colourOpacity.x) * alpha );
+  classified.y = __float2int_rn( 255.0f * saturate(colourOpacity.y) * alpha );
+  classified.z = __float2int_rn( 255.0f * saturate(colourOpacity.z) * alpha );
+  classified.w = __float2int_rn( 255.0f * alpha );
+  classifiedOut[index.x + volumeSize.x*(index.y + volumeSize.y*index.z)] = classified;
+}
+
+//find the intensity range of each brick, including the voxels one past its faces (the z index is folded into the y index of the grid)
+__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_BrickMinMax( float2* minMaxOut, const cudaTextureObject_t sourceTexture, const int3 volumeSize,
+                                                                   const int3 gridSize, const int blocksY ) {
+
+  int3 brick;
+  brick.x = blockDim.x * blockIdx.x + threadIdx.x;
+  brick.y = blockDim.y * (blockIdx.y % blocksY) + threadIdx.y;
+  brick.z = blockIdx.y / blocksY;
+  if( brick.x >= gridSize.x || brick.y >= gridSize.y ) return;
+
+  const int3 first = make_int3( max( brick.x * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1, 0 ),
+                                max( brick.y * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1, 0 ),
+                                max( brick.z * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1, 0 ) );
+  const int3 last = make_int3( min( (brick.x + 1) * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE, volumeSize.x - 1 ),
+                               min( (brick.y + 1) * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE, volumeSize.y - 1 ),
+                               min( (brick.z + 1) * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE, volumeSize.z - 1 ) );
+  float2 minMax = make_float2( 1.0e+38f, -1.0e+38f );
+  for( int z = first.z; z <= last.z; z++ )
+    for( int y = first.y; y <= last.y; y++ )
+      for( int x = first.x; x <= last.x; x++ ){
+        const float value = tex3D<float>(sourceTexture, x+0.5f, y+0.5f, z+0.5f);
+        minMax.x = fminf( minMax.x, value );
+        minMax.y = fmaxf( minMax.y, value );
+      }
+
+  minMaxOut[brick.x + gridSize.x*(brick.y + gridSize.y*brick.z)] = minMax;
+}
+
+//gradient magnitude at a voxel as the ray caster computes it, its taps half a voxel either side averaging the voxel with each neighbour
+__device__ float CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_VoxelGradient( const cudaTextureObject_t sourceTexture,
+                                                                      const float x, const float y, const float z, const float3 space ) {
+  float3 gradient;
+  gradient.x = 0.5f * ( tex3D<float>(sourceTexture, x+1.0f, y, z)
+                      - tex3D<float>(sourceTexture, x-1.0f, y, z) ) * space.x;
+  gradient.y = 0.5f * ( tex3D<float>(sourceTexture, x, y+1.0f, z)
+                      - tex3D<float>(sourceTexture, x, y-1.0f, z) ) * space.y;
+  gradient.z = 0.5f * ( tex3D<float>(sourceTexture, x, y, z+1.0f)
+                      - tex3D<float>(sourceTexture, x, y, z-1.0f) ) * space.z;
+  return sqrtf(dot(gradient, gradient));
+}
+
+//find the range of the gradient magnitudes, each thread walking a column of voxels and each block merging its columns before
+//merging with the others (the bits of non-negative floats ordering as the floats do)
+__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_GradientRange( unsigned int* rangeOut, const cudaTextureObject_t sourceTexture,
+                                                                     const int3 volumeSize, const float3 space ) {
+
+  __shared__ float columnMin[256];
+  __shared__ float columnMax[256];
+  const int x = blockDim.x * blockIdx.x + threadIdx.x;
+  const int y = blockDim.y * blockIdx.y + threadIdx.y;
+  const int thread = threadIdx.x + blockDim.x * threadIdx.y;
+
+  float minimum = 1.0e+38f;
+  float maximum = 0.0f;
+  if( x < volumeSize.x && y < volumeSize.y ){
+    for( int z = 0; z < volumeSize.z; z++ ){
+      const float gradMag = CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_VoxelGradient( sourceTexture, x+0.5f, y+0.5f, z+0.5f, space );
+      minimum = fminf( minimum, gradMag );
+      maximum = fmaxf( maximum, gradMag );
+    }
+  }
+  columnMin[thread] = minimum;
+  columnMax[thread] = maximum;
+  __syncthreads();
+
+  for( int stride = 128; stride > 0; stride >>= 1 ){
+    if( thread < stride ){
+      columnMin[thread] = fminf( columnMin[thread], columnMin[thread + stride] );
+      columnMax[thread] = fmaxf( columnMax[thread], columnMax[thread + stride] );
+    }
+    __syncthreads();
+  }
+  if( thread == 0 ){
+    atomicMin( rangeOut, __float_as_uint(columnMin[0]) );
+    atomicMax( rangeOut + 1, __float_as_uint(columnMax[0]) );
+  }
+}
+
+//count the gradient magnitudes into bins evenly spanning their range, each block counting its columns in shared memory first
+__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_GradientHistogram( unsigned int* histogramOut, const cudaTextureObject_t sourceTexture,
+                                                                         const int3 volumeSize, const float3 space,
+                                                                         const float low, const float scale ) {
+
+  __shared__ unsigned int blockHistogram[CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS];
+  const int x = blockDim.x * blockIdx.x + threadIdx.x;
+  const int y = blockDim.y * blockIdx.y + threadIdx.y;
+  const int thread = threadIdx.x + blockDim.x * threadIdx.y;
+  for( int bin = thread; bin < CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS; bin += blockDim.x * blockDim.y )
+    blockHistogram[bin] = 0;
+  __syncthreads();
+
+  if( x < volumeSize.x && y < volumeSize.y ){
+    for( int z = 0; z < volumeSize.z; z++ ){
+      const float gradMag = CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_VoxelGradient( sourceTexture, x+0.5f, y+0.5f, z+0.5f, space );
+      const int bin = min( max( __float2int_rd( (gradMag - low) * scale ), 0 ), CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS - 1 );
+      atomicAdd( &(blockHistogram[bin]), 1u );
+    }
+  }
+  __syncthreads();
+
+  for( int bin = thread; bin < CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS; bin += blockDim.x * blockDim.y )
+    if( blockHistogram[bin] ) atomicAdd( histogramOut + bin, blockHistogram[bin] );
+}
+
+//whether the opacity is non-zero anywhere over the entries of the table an intensity range interpolates between
+__device__ bool CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_RangeVisible( const float2 range, const float* rangeMax, const int functionSize,
+                                                                   const float low, const float multiplier, const int margin ) {
+
+  //the texture reads the entries either side of a normalized index
+  const float first = multiplier * (range.x - low) * functionSize - 0.5f;
+  const float last = multiplier * (range.y - low) * functionSize - 0.5f;
+  if( !isfinite(first) || !isfinite(last) ) return true;
+  const int firstEntry = min( max( __float2int_rd( fminf(first, last) ) - margin, 0 ), functionSize - 1 );
+  const int lastEntry = min( max( __float2int_rd( fmaxf(first, last) ) + 1 + margin, 0 ), functionSize - 1 );
+
+  //two overlapping power of two ranges of the sparse table cover the entries
+  const int level = 31 - __clz( lastEntry - firstEntry + 1 );
+  const float maxOpacity = fmaxf( rangeMax[level * functionSize + firstEntry],
+                                  rangeMax[level * functionSize + lastEntry - (1 << level) + 1] );
+  return (maxOpacity > 0.0f);
+}
+
+//classify each brick as visible if the table is not transparent throughout its intensity range
+__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_ClassifyBricks( unsigned char* occupancy, const float2* minMax, const int numBricks,
+                                                                      const float* rangeMax, const int functionSize,
+                                                                      const float low, const float multiplier, const int margin ) {
+
+  const int brick = blockDim.x * blockIdx.x + threadIdx.x;
+  if( brick >= numBricks ) return;
+  occupancy[brick] = CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_RangeVisible( minMax[brick], rangeMax, functionSize, low, multiplier, margin ) ? 1 : 0;
+}
+
+template< bool Shade, bool GradientOpacity, bool Clipping, bool Perspective >
+__global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite( const cudaVolumeInformation volInfo, const cudaRendererInformation renInfo,
+                                                                 const cudaOutputImageInformation outInfo, const cudaTextureObject_t inputTexture,
+                                                                 const cudaTextureObject_t classifiedTexture,
+                                                                 const cuda1DTransferFunctionInformation trfInfo ) {
   
   //index in the output image (2D)
   int2 index;
@@ -165,25 +643,16 @@ __global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite( ) {
   float numSteps; //maximum number of samples along this ray
   float4 outputVal; //rgba value of this ray (calculated in castRays, used in WriteData)
 
-  //load in the rays
-  __syncthreads();
-  rayStart.x = outInfo.rayStartX[outindex];
-  __syncthreads();
-  rayStart.y = outInfo.rayStartY[outindex];
-  __syncthreads();
-  rayStart.z = outInfo.rayStartZ[outindex];
-  __syncthreads();
-  rayInc.x = outInfo.rayIncX[outindex];
-  __syncthreads();
-  rayInc.y = outInfo.rayIncY[outindex];
-  __syncthreads();
-  rayInc.z = outInfo.rayIncZ[outindex];
-  __syncthreads();
-  numSteps = outInfo.numSteps[outindex];
-  __syncthreads();
+  //form the ray in registers rather than reading it back from global memory
+  CUDAkernel_FormRay<Clipping, Perspective>(volInfo, renInfo, outInfo, index, rayStart, rayInc, numSteps);
 
-  // trace along the ray (composite)
-  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D(rayStart, numSteps, rayInc, outputVal);
+  // trace along the ray (composite), through the classified volume when there is one and by segments when the transfer function is pre-integrated
+  if(trfInfo.usePreClassified)
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1DPreClassified<Shade>(volInfo, inputTexture, classifiedTexture, rayStart, numSteps, rayInc, trfInfo, outputVal);
+  else if(trfInfo.usePreIntegration)
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1DPreIntegrated<Shade, GradientOpacity>(volInfo, inputTexture, rayStart, numSteps, rayInc, trfInfo, outputVal);
+  else
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_CastRays1D<Shade, GradientOpacity>(volInfo, inputTexture, rayStart, numSteps, rayInc, trfInfo, outputVal);
 
   //convert output to uchar, adjusting it to be valued from [0,256) rather than [0,1]
   uchar4 temp;
@@ -198,42 +667,69 @@ __global__ void CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite( ) {
 
 }
 
+//launch the variant of the composite kernel forming its rays with only the clipping and projection code the renderer needs
+template< bool Shade, bool GradientOpacity >
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_composite(const cudaVolumeInformation& volumeInfo, const cudaRendererInformation& rendererInfo,
+                                                     const cudaOutputImageInformation& outputInfo, const cudaTextureObject_t inputTexture,
+                                                     const cudaTextureObject_t classifiedTexture, const cuda1DTransferFunctionInformation& trfInfo,
+                                                     const dim3& grid, const dim3& threads, cudaStream_t* stream){
+  const bool clipping = CUDA_vtkCUDAVolumeMapper_renderAlgo_useClipping(rendererInfo);
+  const bool perspective = CUDA_vtkCUDAVolumeMapper_renderAlgo_usePerspective(rendererInfo);
+  if(clipping && perspective)
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite<Shade, GradientOpacity, true, true> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, inputTexture, classifiedTexture, trfInfo);
+  else if(clipping)
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite<Shade, GradientOpacity, true, false> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, inputTexture, classifiedTexture, trfInfo);
+  else if(perspective)
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite<Shade, GradientOpacity, false, true> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, inputTexture, classifiedTexture, trfInfo);
+  else
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite<Shade, GradientOpacity, false, false> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, inputTexture, classifiedTexture, trfInfo);
+}
+
 //pre: the resolution of the image has been processed such that it's x and y size are both multiples of 16 (enforced automatically) and y > 256 (enforced automatically)
 //post: the OutputImage pointer will hold the ray casted information
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(const cudaOutputImageInformation& outputInfo,
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(cuda1DVolumeInformation& volumeData,
+               const cudaOutputImageInformation& outputInfo,
                const cudaRendererInformation& rendererInfo,
                const cudaVolumeInformation& volumeInfo,
                const cuda1DTransferFunctionInformation& transInfo,
                cudaStream_t* stream)
 {
 
-  // setup execution parameters - staggered to improve parallelism
-  cudaMemcpyToSymbolAsync(volInfo, &volumeInfo, sizeof(cudaVolumeInformation) );
-  cudaMemcpyToSymbolAsync(renInfo, &rendererInfo, sizeof(cudaRendererInformation));
-  cudaMemcpyToSymbolAsync(outInfo, &outputInfo, sizeof(cudaOutputImageInformation));
-  cudaMemcpyToSymbolAsync(CUDA_vtkCUDA1DVolumeMapper_trfInfo, &transInfo, sizeof(cuda1DTransferFunctionInformation));
-  
-  //map the texture for the transfer function
-  alpha_texture_1D.normalized = true;
-  alpha_texture_1D.filterMode = cudaFilterModeLinear;
-  alpha_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(alpha_texture_1D, transInfo.alphaTransferArray1D);
-  galpha_texture_1D.normalized = true;
-  galpha_texture_1D.filterMode = cudaFilterModeLinear;
-  galpha_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(galpha_texture_1D, transInfo.galphaTransferArray1D);
-  colorR_texture_1D.normalized = true;
-  colorR_texture_1D.filterMode = cudaFilterModeLinear;
-  colorR_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(colorR_texture_1D, transInfo.colorRTransferArray1D);
-  colorG_texture_1D.normalized = true;
-  colorG_texture_1D.filterMode = cudaFilterModeLinear;
-  colorG_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(colorG_texture_1D, transInfo.colorGTransferArray1D);
-  colorB_texture_1D.normalized = true;
-  colorB_texture_1D.filterMode = cudaFilterModeLinear;
-  colorB_texture_1D.addressMode[0] = cudaAddressModeClamp;
-  cudaBindTextureToArray(colorB_texture_1D, transInfo.colorBTransferArray1D);
+  //classify the bricks for tables not seen lately (a transfer function switched back to finding its occupancy still there),
+  //only jumping over them at full resolution where the bricks line up with the samples
+  cuda1DTransferFunctionInformation renderTransInfo = transInfo;
+  renderTransInfo.brickOccupancy = 0;
+  if( volumeData.brickMinMax && transInfo.opacityRangeMax && volumeData.currentLevel == 0 ){
+    const int numBricks = volumeData.brickGridSize.x * volumeData.brickGridSize.y * volumeData.brickGridSize.z;
+    int slot = 0;
+    for( int i = 0; i < CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS; i++ ){
+      if( volumeData.brickVersion[i] == transInfo.opacityVersion ){
+        slot = i;
+        break;
+      }
+      if( volumeData.brickLastUse[i] < volumeData.brickLastUse[slot] ) slot = i;
+    }
+    unsigned char* occupancy = volumeData.brickOccupancy + slot * numBricks;
+    if( volumeData.brickVersion[slot] != transInfo.opacityVersion ){
+
+      //the pre-integrated table blends entries a few table entries further than the point samples do
+      const int margin = transInfo.usePreIntegration ? (transInfo.functionSize + transInfo.preIntegrationSize - 2) / (transInfo.preIntegrationSize - 1) + 1 : 0;
+      CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_ClassifyBricks <<< (numBricks + 255) / 256, 256, 0, *stream >>>(occupancy, volumeData.brickMinMax, numBricks, transInfo.opacityRangeMax, transInfo.functionSize, transInfo.intensityLow, transInfo.intensityMultiplier, margin);
+      volumeData.brickVersion[slot] = transInfo.opacityVersion;
+    }
+    volumeData.brickLastUse[slot] = ++volumeData.brickUseCounter;
+    renderTransInfo.brickOccupancy = occupancy;
+    renderTransInfo.brickGridSize = volumeData.brickGridSize;
+  }
+
+  //sample the classified volume only while it was classified with these very tables
+  renderTransInfo.usePreClassified = volumeData.classifiedArray && !transInfo.usePreIntegration &&
+                                     volumeData.classifiedVersion == transInfo.opacityVersion &&
+                                     volumeData.currentLevel == 0 && volumeData.classifiedTexture;
+
+  //sample this mapper's volume at the level it is rendering
+  const cudaTextureObject_t inputTexture = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_inputTexture(volumeData);
+  if(!inputTexture) return false;
 
   //create the necessary execution amount parameters from the block sizes and calculate th volume rendering integral
   int blockX = outputInfo.resolution.x / BLOCK_DIM2D ;
@@ -241,131 +737,483 @@ bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(const cudaOutputImageInforma
 
   dim3 grid(blockX, blockY, 1);
   dim3 threads(BLOCK_DIM2D, BLOCK_DIM2D, 1);
-  CUDAkernel_renderAlgo_formRays <<< grid, threads, 0, *stream >>>();
-  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_Composite <<< grid, threads, 0, *stream >>>();
 
+  //composite through the variant holding only the shading and gradient opacity code the volume property needs,
+  //the gradient opacity being left out when it is disabled or the gradient range of the table is empty
+  const bool shade = volumeInfo.Diffuse != 0.0f || volumeInfo.Specular.x != 0.0f;
+  const bool gradientOpacity = transInfo.useGradientOpacity && transInfo.gradientMultiplier < 1.0e+38f;
+  if(shade && gradientOpacity)
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_composite<true, true>(volumeInfo, rendererInfo, outputInfo, inputTexture, volumeData.classifiedTexture, renderTransInfo, grid, threads, stream);
+  else if(shade)
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_composite<true, false>(volumeInfo, rendererInfo, outputInfo, inputTexture, volumeData.classifiedTexture, renderTransInfo, grid, threads, stream);
+  else if(gradientOpacity)
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_composite<false, true>(volumeInfo, rendererInfo, outputInfo, inputTexture, volumeData.classifiedTexture, renderTransInfo, grid, threads, stream);
+  else
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_composite<false, false>(volumeInfo, rendererInfo, outputInfo, inputTexture, volumeData.classifiedTexture, renderTransInfo, grid, threads, stream);
+
+  return (cudaGetLastError() == 0);
+}
+
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearPyramid(cuda1DVolumeInformation& volumeData){
+  for( int level = 1; level < CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS; level++ ){
+    if(volumeData.levelTexture[level])
+      cudaDestroyTextureObject(volumeData.levelTexture[level]);
+    if(volumeData.pyramidArray[level])
+      cudaFreeArray(volumeData.pyramidArray[level]);
+    if(volumeData.pyramidMinMax[level])
+      cudaFree(volumeData.pyramidMinMax[level]);
+    volumeData.levelTexture[level] = 0;
+    volumeData.pyramidArray[level] = 0;
+    volumeData.pyramidMinMax[level] = 0;
+  }
+  volumeData.currentLevel = 0;
+}
+
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearPreClassification(cuda1DVolumeInformation& volumeData, cudaStream_t* stream){
+  if(volumeData.classifiedTexture)
+    cudaDestroyTextureObject(volumeData.classifiedTexture);
+  volumeData.classifiedTexture = 0;
+  if(volumeData.classifiedArray)
+    cudaFreeArray(volumeData.classifiedArray);
+  volumeData.classifiedArray = 0;
+  volumeData.classifiedVersion = 0;
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_preClassify(cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo,
+                                                       const cuda1DTransferFunctionInformation& transInfo, const size_t availableBytes,
+                                                       cudaStream_t* stream){
+
+  //the classification is only of use at full resolution with point sampled tables
+  if( !volumeData.levelTexture[0] || volumeData.currentLevel != 0 ||
+      transInfo.usePreIntegration || transInfo.opacityVersion == 0 ) return false;
+  if( volumeData.classifiedVersion == transInfo.opacityVersion ) return volumeData.classifiedArray != 0;
+  volumeData.classifiedVersion = transInfo.opacityVersion;
+
+  //allocate the classified volume once, doing without it if it does not fit in the memory left to the mapper
+  const int3 volumeSize = volumeInfo.VolumeSize;
+  const int slabSlices = 16;
+  uchar4* slab = 0;
+  cudaChannelFormatDesc classifiedDesc = cudaCreateChannelDesc<uchar4>();
+  const size_t classifiedBytes = sizeof(uchar4) * (size_t) volumeSize.x * (size_t) volumeSize.y * (size_t) (volumeSize.z + slabSlices);
+  if( !volumeData.classifiedArray && classifiedBytes > availableBytes ) return false;
+  if( !volumeData.classifiedArray &&
+      cudaMalloc3DArray( &volumeData.classifiedArray, &classifiedDesc,
+                         make_cudaExtent(volumeSize.x, volumeSize.y, volumeSize.z) ) != cudaSuccess ){
+    volumeData.classifiedArray = 0;
+    cudaGetLastError();
+    return false;
+  }
+  if( !volumeData.classifiedTexture ){
+    cudaResourceDesc resourceDesc;
+    memset(&resourceDesc, 0, sizeof(resourceDesc));
+    resourceDesc.resType = cudaResourceTypeArray;
+    resourceDesc.res.array.array = volumeData.classifiedArray;
+
+    cudaTextureDesc textureDesc;
+    memset(&textureDesc, 0, sizeof(textureDesc));
+    textureDesc.normalizedCoords = 0;
+    textureDesc.filterMode = cudaFilterModeLinear;
+    textureDesc.addressMode[0] = cudaAddressModeClamp;
+    textureDesc.addressMode[1] = cudaAddressModeClamp;
+    textureDesc.addressMode[2] = cudaAddressModeClamp;
+    textureDesc.readMode = cudaReadModeNormalizedFloat;
+    cudaCreateTextureObject(&(volumeData.classifiedTexture), &resourceDesc, &textureDesc, 0);
+  }
+  if( cudaMalloc( (void**) &slab, sizeof(uchar4) * volumeSize.x * volumeSize.y * slabSlices ) != cudaSuccess ){
+    cudaGetLastError();
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearPreClassification(volumeData, stream);
+    volumeData.classifiedVersion = transInfo.opacityVersion;
+    return false;
+  }
+
+  //classify a slab at a time with the same tables and volume as the ray caster, so the volume never needs a second linear copy
+  int blocksX = (volumeSize.x + 7) / 8;
+  int blocksY = (volumeSize.y + 7) / 8;
+  for( int firstSlice = 0; firstSlice < volumeSize.z; firstSlice += slabSlices ){
+    const int numSlices = (volumeSize.z - firstSlice < slabSlices) ? volumeSize.z - firstSlice : slabSlices;
+    dim3 grid(blocksX, blocksY * numSlices, 1);
+    dim3 threads(8, 8, 1);
+    CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_PreClassify <<< grid, threads, 0, *stream >>>(slab, volumeData.levelTexture[0], volumeSize, firstSlice, blocksY,
+                                                                                        volumeInfo.SpacingReciprocal, transInfo);
+
+    cudaMemcpy3DParms copyParams = {0};
+    copyParams.srcPtr   = make_cudaPitchedPtr( (void*) slab, volumeSize.x*sizeof(uchar4), volumeSize.x, volumeSize.y);
+    copyParams.dstArray = volumeData.classifiedArray;
+    copyParams.dstPos   = make_cudaPos(0, 0, firstSlice);
+    copyParams.extent   = make_cudaExtent(volumeSize.x, volumeSize.y, numSlices);
+    copyParams.kind     = cudaMemcpyDeviceToDevice;
+    cudaMemcpy3DAsync(&copyParams, *stream);
+  }
+  cudaStreamSynchronize(*stream);
+  cudaFree(slab);
+
+  return (cudaGetLastError() == 0);
+}
+
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearBricks(cuda1DVolumeInformation& volumeData){
+  if(volumeData.brickMinMax)
+    cudaFree(volumeData.brickMinMax);
+  if(volumeData.brickOccupancy)
+    cudaFree(volumeData.brickOccupancy);
+  volumeData.brickMinMax = 0;
+  volumeData.brickOccupancy = 0;
+  for( int i = 0; i < CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS; i++ ){
+    volumeData.brickVersion[i] = 0;
+    volumeData.brickLastUse[i] = 0;
+  }
+}
+
+//allocate the bricks of the full resolution volume, doing without them if the device is running short on memory
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateBricks(cuda1DVolumeInformation& volumeData, const int3& volumeSize){
+
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearBricks(volumeData);
+  if(!volumeData.sourceDataArray) return false;
+
+  int3 gridSize;
+  gridSize.x = (volumeSize.x + CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1) / CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE;
+  gridSize.y = (volumeSize.y + CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1) / CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE;
+  gridSize.z = (volumeSize.z + CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1) / CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE;
+  const size_t numBricks = (size_t) gridSize.x * (size_t) gridSize.y * (size_t) gridSize.z;
+  if( cudaMalloc( (void**) &volumeData.brickMinMax, sizeof(float2)*numBricks ) != cudaSuccess ||
+      cudaMalloc( (void**) &volumeData.brickOccupancy, sizeof(unsigned char)*numBricks*CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS ) != cudaSuccess ){
+    cudaGetLastError();
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearBricks(volumeData);
+    return false;
+  }
+  volumeData.brickGridSize = gridSize;
+  return true;
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_buildBricks(cuda1DVolumeInformation& volumeData, const int3& volumeSize, cudaStream_t* stream){
+
+  if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateBricks(volumeData, volumeSize) ) return false;
+  const int3 gridSize = volumeData.brickGridSize;
+
+  //read the full resolution volume through point sampling
+  int blocksX = (gridSize.x + 7) / 8;
+  int blocksY = (gridSize.y + 7) / 8;
+  dim3 grid(blocksX, blocksY * gridSize.z, 1);
+  dim3 threads(8, 8, 1);
+  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_BrickMinMax <<< grid, threads, 0, *stream >>>(volumeData.brickMinMax, volumeData.sourceTexture, volumeSize, gridSize, blocksY);
+
+  return (cudaGetLastError() == 0);
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_gradientStatistics(const cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo,
+                                                              float range[2], unsigned int* histogram, cudaStream_t* stream){
+
+  if(!volumeData.sourceTexture) return false;
+  unsigned int* statistics = 0;
+  if( cudaMalloc( (void**) &statistics, sizeof(unsigned int) * (2 + CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS) ) != cudaSuccess ){
+    cudaGetLastError();
+    return false;
+  }
+
+  //the range starts out empty, from the bits of the largest float down to those of zero
+  unsigned int rangeBits[2] = { 0x7f7fffffu, 0u };
+  cudaMemcpyAsync( statistics, rangeBits, sizeof(rangeBits), cudaMemcpyHostToDevice, *stream );
+  cudaMemsetAsync( statistics + 2, 0, sizeof(unsigned int) * CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS, *stream );
+
+  //read the full resolution volume through point sampling, the histogram needing the range, so it is read back in between the two passes
+  const int3 volumeSize = volumeInfo.VolumeSize;
+  dim3 grid((volumeSize.x + 15) / 16, (volumeSize.y + 15) / 16, 1);
+  dim3 threads(16, 16, 1);
+  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_GradientRange <<< grid, threads, 0, *stream >>>(statistics, volumeData.sourceTexture, volumeSize, volumeInfo.SpacingReciprocal);
+  cudaMemcpyAsync( rangeBits, statistics, sizeof(rangeBits), cudaMemcpyDeviceToHost, *stream );
+  cudaStreamSynchronize(*stream);
+  memcpy( range, rangeBits, sizeof(rangeBits) );
+  range[0] = (range[0] < range[1]) ? range[0] : range[1];
+
+  const float scale = (range[1] > range[0]) ? CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS / (range[1] - range[0]) : 0.0f;
+  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_GradientHistogram <<< grid, threads, 0, *stream >>>(statistics + 2, volumeData.sourceTexture, volumeSize, volumeInfo.SpacingReciprocal, range[0], scale);
+  cudaMemcpyAsync( histogram, statistics + 2, sizeof(unsigned int) * CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS, cudaMemcpyDeviceToHost, *stream );
+  cudaStreamSynchronize(*stream);
+  cudaFree(statistics);
+
+  return (cudaGetLastError() == 0);
+}
+
+int CUDA_vtkCUDA1DVolumeMapper_renderAlgo_buildPyramid(cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo,
+                                                      const int maxLevels, cudaStream_t* stream){
+
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearPyramid(volumeData);
+  if(!volumeData.sourceDataArray) return 0;
+
+  //keep halving until the volume gets too small to be worth sampling or the device runs out of room
+  int numLevels = 1;
+  int3 levelSize = volumeInfo.VolumeSize;
+  cudaArray* finerArray = volumeData.sourceDataArray;
+  const float2* finerMinMax = 0;
+  while( numLevels < maxLevels && numLevels < CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS &&
+         levelSize.x >= 16 && levelSize.y >= 16 && levelSize.z >= 16 ){
+    int3 coarserSize;
+    if( !CUDA_vtkCUDAVolumeMapper_renderAlgo_buildPyramidLevel(finerArray, levelSize, finerMinMax,
+                                                               &(volumeData.pyramidArray[numLevels]),
+                                                               &(volumeData.pyramidMinMax[numLevels]),
+                                                               coarserSize, stream) )
+      break;
+    volumeData.levelTexture[numLevels] = CUDA_vtkCUDAVolumeMapper_createVolumeTexture(volumeData.pyramidArray[numLevels], cudaFilterModeLinear);
+    finerArray = volumeData.pyramidArray[numLevels];
+    finerMinMax = volumeData.pyramidMinMax[numLevels];
+    levelSize = coarserSize;
+    numLevels++;
+  }
+
+  return numLevels;
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_getLevelSlab(const cuda1DVolumeInformation& volumeData, const int level, const int3& levelSize,
+                                                        const int firstSlice, const int numSlices, float* average, float2* minMax,
+                                                        cudaStream_t* stream){
+
+  cudaArray* levelArray = (level > 0) ? volumeData.pyramidArray[level] : volumeData.sourceDataArray;
+  if( !levelArray ) return false;
+  if( level == 0 && volumeData.sourceVoxelSize != sizeof(float) ) return false;
+
+  //copy the slices out of the array
+  cudaMemcpy3DParms copyParams = {0};
+  copyParams.srcArray = levelArray;
+  copyParams.srcPos   = make_cudaPos(0, 0, firstSlice);
+  copyParams.dstPtr   = make_cudaPitchedPtr( (void*) average, levelSize.x*sizeof(float), levelSize.x, levelSize.y);
+  copyParams.extent   = make_cudaExtent(levelSize.x, levelSize.y, numSlices);
+  copyParams.kind     = cudaMemcpyDeviceToHost;
+  cudaMemcpy3DAsync(&copyParams, *stream);
+
+  //the min/max of the coarser levels is kept in linear memory
+  if( level > 0 && minMax ){
+    size_t sliceVoxels = (size_t) levelSize.x * (size_t) levelSize.y;
+    cudaMemcpyAsync( minMax, volumeData.pyramidMinMax[level] + sliceVoxels*firstSlice,
+                     sizeof(float2)*sliceVoxels*numSlices, cudaMemcpyDeviceToHost, *stream );
+  }
+  cudaStreamSynchronize(*stream);
+  return (cudaGetLastError() == 0);
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadLevel(cuda1DVolumeInformation& volumeData, const int level, const int3& levelSize,
+                                                     const float* average, const float2* minMax, cudaStream_t* stream){
+
+  if( level < 1 || level >= CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS ) return false;
+
+  //allocate the level, bailing out quietly if the device is running short on memory
+  size_t numVoxels = (size_t) levelSize.x * (size_t) levelSize.y * (size_t) levelSize.z;
+  cudaExtent volumeSize = make_cudaExtent(levelSize.x, levelSize.y, levelSize.z);
+  if( cudaMalloc( (void**) &(volumeData.pyramidMinMax[level]), sizeof(float2)*numVoxels ) != cudaSuccess ||
+      cudaMalloc3DArray( &(volumeData.pyramidArray[level]), &channelDesc, volumeSize ) != cudaSuccess ){
+    if( volumeData.pyramidMinMax[level] ) cudaFree( volumeData.pyramidMinMax[level] );
+    volumeData.pyramidMinMax[level] = 0;
+    volumeData.pyramidArray[level] = 0;
+    cudaGetLastError();
+    return false;
+  }
+
+  cudaMemcpy3DParms copyParams = {0};
+  copyParams.srcPtr   = make_cudaPitchedPtr( (void*) average, levelSize.x*sizeof(float), levelSize.x, levelSize.y);
+  copyParams.dstArray = volumeData.pyramidArray[level];
+  copyParams.extent   = volumeSize;
+  copyParams.kind     = cudaMemcpyHostToDevice;
+  cudaMemcpy3DAsync(&copyParams, *stream);
+  cudaMemcpyAsync( volumeData.pyramidMinMax[level], minMax, sizeof(float2)*numVoxels, cudaMemcpyHostToDevice, *stream );
+  volumeData.levelTexture[level] = CUDA_vtkCUDAVolumeMapper_createVolumeTexture(volumeData.pyramidArray[level], cudaFilterModeLinear);
+  cudaStreamSynchronize(*stream);
   return (cudaGetLastError() == 0);
 }
 
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(const int frame, cudaStream_t* stream){
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeLevel(cuda1DVolumeInformation& volumeData, const int level, cudaStream_t* stream){
+
+  //fall back on the full resolution volume if the level was never built
+  cudaArray* levelArray = (level > 0 && level < CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS) ? volumeData.pyramidArray[level] : 0;
+  if( !levelArray ) return CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(volumeData, 0, stream);
+  volumeData.currentLevel = level;
+
+  return (cudaGetLastError() == 0);
+}
 
-  // set the texture to the correct image
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.normalized = false;          // access with unnormalized texture coordinates
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.filterMode = cudaFilterModeLinear;    // linear interpolation
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.addressMode[0] = cudaAddressModeClamp;  // wrap texture coordinates
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.addressMode[1] = cudaAddressModeClamp;
-  CUDA_vtkCUDA1DVolumeMapper_input_texture.addressMode[2] = cudaAddressModeClamp;
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(cuda1DVolumeInformation& volumeData, const int frame, cudaStream_t* stream){
 
-  // bind array to 3D texture
-  cudaBindTextureToArray(CUDA_vtkCUDA1DVolumeMapper_input_texture,
-              CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0], channelDesc);
+  //sample the full resolution volume
+  volumeData.currentLevel = 0;
 
   return (cudaGetLastError() == 0);
 
 }
 
-//pre: the transfer functions are all of type float and are all of size FunctionSize
-//post: the alpha, colorR, G and B 1D textures will map to each transfer function
+//pre: the colour and opacity table holds transInfo.functionSize RGBA entries and the gradient opacity table as many floats
+//post: the packed colour and opacity texture object and the gradient opacity texture object will read the tables
 bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(cuda1DTransferFunctionInformation& transInfo,
-                  float* redTF, float* greenTF, float* blueTF, float* alphaTF, float* galphaTF,
+                  float4* colourOpacityTF, float* galphaTF,
                   cudaStream_t* stream){
 
-  //retrieve the size of the transer functions
-  size_t size = sizeof(float) * transInfo.functionSize;
-    
-  //define the texture mapping for the alpha component after copying information from host to device array
-  if(transInfo.alphaTransferArray1D)
-    cudaFreeArray(transInfo.alphaTransferArray1D);
-  cudaMallocArray( &(transInfo.alphaTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.alphaTransferArray1D, 0, 0, alphaTF, size, cudaMemcpyHostToDevice, *stream);
-  if(transInfo.galphaTransferArray1D)
-    cudaFreeArray(transInfo.galphaTransferArray1D);
-  cudaMallocArray( &(transInfo.galphaTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.galphaTransferArray1D, 0, 0, galphaTF, size, cudaMemcpyHostToDevice, *stream);
-    
-  //define the texture mapping for the red component after copying information from host to device array
-  if(transInfo.colorRTransferArray1D)
-    cudaFreeArray(transInfo.colorRTransferArray1D);
-  cudaMallocArray( &(transInfo.colorRTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.colorRTransferArray1D, 0, 0, redTF, size, cudaMemcpyHostToDevice, *stream);
-  
-  //define the texture mapping for the green component after copying information from host to device array
-  if(transInfo.colorGTransferArray1D)
-    cudaFreeArray(transInfo.colorGTransferArray1D);
-  cudaMallocArray( &(transInfo.colorGTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.colorGTransferArray1D, 0, 0, greenTF, size, cudaMemcpyHostToDevice, *stream);
-  
-  //define the texture mapping for the blue component after copying information from host to device array
-  if(transInfo.colorBTransferArray1D)
-    cudaFreeArray(transInfo.colorBTransferArray1D);
-  cudaMallocArray( &(transInfo.colorBTransferArray1D), &channelDesc, transInfo.functionSize, 1);
-  cudaMemcpyToArrayAsync(transInfo.colorBTransferArray1D, 0, 0, blueTF, size, cudaMemcpyHostToDevice, *stream);
+  //the arrays stay allocated across edits, each edit rewriting them in place in stream order
+  if(!transInfo.colourOpacityTransferArray1D)
+    cudaMallocArray( &(transInfo.colourOpacityTransferArray1D), &colourOpacityChannelDesc, transInfo.functionSize, 1);
+  if(!transInfo.galphaTransferArray1D)
+    cudaMallocArray( &(transInfo.galphaTransferArray1D), &channelDesc, transInfo.functionSize, 1);
+  if(!transInfo.colourOpacityTexture)
+    transInfo.colourOpacityTexture = CUDA_vtkCUDA1DVolumeMapper_createTableTexture(transInfo.colourOpacityTransferArray1D);
+  if(!transInfo.galphaTexture)
+    transInfo.galphaTexture = CUDA_vtkCUDA1DVolumeMapper_createTableTexture(transInfo.galphaTransferArray1D);
+
+  //copy the colour and opacity, then the gradient opacity
+  cudaMemcpyToArrayAsync(transInfo.colourOpacityTransferArray1D, 0, 0, colourOpacityTF, sizeof(float4) * transInfo.functionSize,
+                         cudaMemcpyHostToDevice, *stream);
+  cudaMemcpyToArrayAsync(transInfo.galphaTransferArray1D, 0, 0, galphaTF, sizeof(float) * transInfo.functionSize,
+                         cudaMemcpyHostToDevice, *stream);
+
+  return (cudaGetLastError() == 0);
+
+}
+
+//pre: the table holds transInfo.preIntegrationSize squared RGBA entries, the back intensity varying fastest
+//post: the pre-integration texture object will read the table
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPreIntegrationTexture(cuda1DTransferFunctionInformation& transInfo,
+                  const float4* preIntegrationTF, cudaStream_t* stream){
+
+  //like the 1D tables, the array is only allocated once and rewritten in place
+  if(!transInfo.preIntegrationTransferArray2D)
+    cudaMallocArray( &(transInfo.preIntegrationTransferArray2D), &colourOpacityChannelDesc,
+                     transInfo.preIntegrationSize, transInfo.preIntegrationSize);
+  if(!transInfo.preIntegrationTexture)
+    transInfo.preIntegrationTexture = CUDA_vtkCUDA1DVolumeMapper_createTableTexture(transInfo.preIntegrationTransferArray2D);
+  cudaMemcpyToArrayAsync(transInfo.preIntegrationTransferArray2D, 0, 0, preIntegrationTF,
+                         sizeof(float4) * transInfo.preIntegrationSize * transInfo.preIntegrationSize,
+                         cudaMemcpyHostToDevice, *stream);
 
   return (cudaGetLastError() == 0);
+}
+
+//pre: the table holds transInfo.opacityRangeLevels levels of transInfo.functionSize floats
+//post: the bricks will be classified with the table on the next render
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadOpacityRange(cuda1DTransferFunctionInformation& transInfo,
+                  const float* opacityRangeMax, cudaStream_t* stream){
 
+  const size_t tableSize = sizeof(float) * transInfo.opacityRangeLevels * transInfo.functionSize;
+  if(!transInfo.opacityRangeMax)
+    cudaMalloc( (void**) &(transInfo.opacityRangeMax), tableSize );
+  cudaMemcpyAsync( transInfo.opacityRangeMax, opacityRangeMax, tableSize, cudaMemcpyHostToDevice, *stream );
+
+  return (cudaGetLastError() == 0);
 }
 
 bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures(cuda1DTransferFunctionInformation& transInfo, cudaStream_t* stream){
 
-  if(transInfo.colorRTransferArray1D)
-    cudaFreeArray(transInfo.colorRTransferArray1D);
-  transInfo.colorRTransferArray1D = 0;
-  if(transInfo.colorGTransferArray1D)
-    cudaFreeArray(transInfo.colorGTransferArray1D);
-  transInfo.colorGTransferArray1D = 0;
-  if(transInfo.colorBTransferArray1D)
-    cudaFreeArray(transInfo.colorBTransferArray1D);
-  transInfo.colorBTransferArray1D = 0;
-  if(transInfo.alphaTransferArray1D)
-    cudaFreeArray(transInfo.alphaTransferArray1D);
-  transInfo.alphaTransferArray1D = 0;
+  //the texture objects go before the arrays they read
+  if(transInfo.colourOpacityTexture)
+    cudaDestroyTextureObject(transInfo.colourOpacityTexture);
+  transInfo.colourOpacityTexture = 0;
+  if(transInfo.galphaTexture)
+    cudaDestroyTextureObject(transInfo.galphaTexture);
+  transInfo.galphaTexture = 0;
+  if(transInfo.preIntegrationTexture)
+    cudaDestroyTextureObject(transInfo.preIntegrationTexture);
+  transInfo.preIntegrationTexture = 0;
+  if(transInfo.colourOpacityTransferArray1D)
+    cudaFreeArray(transInfo.colourOpacityTransferArray1D);
+  transInfo.colourOpacityTransferArray1D = 0;
   if(transInfo.galphaTransferArray1D)
     cudaFreeArray(transInfo.galphaTransferArray1D);
   transInfo.galphaTransferArray1D = 0;
+  if(transInfo.preIntegrationTransferArray2D)
+    cudaFreeArray(transInfo.preIntegrationTransferArray2D);
+  transInfo.preIntegrationTransferArray2D = 0;
+  if(transInfo.opacityRangeMax)
+    cudaFree(transInfo.opacityRangeMax);
+  transInfo.opacityRangeMax = 0;
 
   return (cudaGetLastError() == 0);
 }
 
 //pre:  the data has been preprocessed by the volumeInformationHandler such that it is float data
 //    the index is between 0 and 100
-//post: the input_texture will map to the source data in voxel coordinate space
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(const float* data, const cudaVolumeInformation& volumeInfo,
-                             cudaStream_t* stream){
+//post: the level 0 and source texture objects will read the source data in voxel coordinate space
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateImage(cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo,
+                                                         const bool halfPrecision, cudaStream_t* stream){
 
   // if the array is already populated with information, free it to prevent leaking
-  if(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0]){
-    cudaFreeArray(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0]);
-  }
-  
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(volumeData, stream);
+
   //define the size of the data, retrieved from the volume information
   cudaExtent volumeSize;
   volumeSize.width = volumeInfo.VolumeSize.x;
   volumeSize.height = volumeInfo.VolumeSize.y;
   volumeSize.depth = volumeInfo.VolumeSize.z;
-  
-  // create 3D array to store the image data in
-  cudaMalloc3DArray(&(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0]), &channelDesc, volumeSize);
 
-  // copy data to 3D array
+  // create 3D array to store the image data in, halves being read back as floats by the texture
+  cudaChannelFormatDesc sourceDesc = halfPrecision ? cudaCreateChannelDescHalf() : channelDesc;
+  volumeData.sourceVoxelSize = halfPrecision ? sizeof(unsigned short) : sizeof(float);
+  if( cudaMalloc3DArray(&(volumeData.sourceDataArray), &sourceDesc, volumeSize) != cudaSuccess ){
+    volumeData.sourceDataArray = 0;
+    return false;
+  }
+  volumeData.levelTexture[0] = CUDA_vtkCUDAVolumeMapper_createVolumeTexture(volumeData.sourceDataArray, cudaFilterModeLinear);
+  volumeData.sourceTexture = CUDA_vtkCUDAVolumeMapper_createVolumeTexture(volumeData.sourceDataArray, cudaFilterModePoint);
+  return (cudaGetLastError() == 0);
+
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageSlab(cuda1DVolumeInformation& volumeData, const void* slab, const int firstSlice, const int numSlices,
+                             const cudaVolumeInformation& volumeInfo, cudaStream_t* stream){
+
+  //the classified volume no longer matches the intensities
+  volumeData.classifiedVersion = 0;
+
+  // copy the slices into their place in the 3D array
   cudaMemcpy3DParms copyParams = {0};
-  copyParams.srcPtr   = make_cudaPitchedPtr( (void*) data, volumeSize.width*sizeof(float),
-                        volumeSize.width, volumeSize.height);
-  copyParams.dstArray = CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0];
-  copyParams.extent   = volumeSize;
+  copyParams.srcPtr   = make_cudaPitchedPtr( (void*) slab, volumeInfo.VolumeSize.x*volumeData.sourceVoxelSize,
+                        volumeInfo.VolumeSize.x, volumeInfo.VolumeSize.y);
+  copyParams.dstArray = volumeData.sourceDataArray;
+  copyParams.dstPos   = make_cudaPos(0, 0, firstSlice);
+  copyParams.extent   = make_cudaExtent(volumeInfo.VolumeSize.x, volumeInfo.VolumeSize.y, numSlices);
   copyParams.kind     = cudaMemcpyHostToDevice;
-  cudaMemcpy3D(&copyParams);
+  cudaMemcpy3DAsync(&copyParams, *stream);
+  return (cudaGetLastError() == 0);
 
-  return true;
+}
+
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(cuda1DVolumeInformation& volumeData, const float* data, const cudaVolumeInformation& volumeInfo,
+                             cudaStream_t* stream){
+
+  if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateImage(volumeData, volumeInfo, false, stream) ) return false;
+  if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageSlab(volumeData, data, 0, volumeInfo.VolumeSize.z, volumeInfo, stream) ) return false;
+  cudaStreamSynchronize(*stream);
+  return (cudaGetLastError() == 0);
 
 }
 
-void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(cudaStream_t* stream){
-  CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0] = 0;
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(cuda1DVolumeInformation& volumeData, cudaStream_t* stream){
+  volumeData.sourceDataArray = 0;
+  volumeData.sourceVoxelSize = sizeof(float);
+  volumeData.sourceTexture = 0;
+  volumeData.currentLevel = 0;
+  for( int level = 0; level < CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS; level++ ){
+    volumeData.pyramidArray[level] = 0;
+    volumeData.pyramidMinMax[level] = 0;
+    volumeData.levelTexture[level] = 0;
+  }
+  volumeData.brickMinMax = 0;
+  volumeData.brickOccupancy = 0;
+  for( int i = 0; i < CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS; i++ ){
+    volumeData.brickVersion[i] = 0;
+    volumeData.brickLastUse[i] = 0;
+  }
+  volumeData.brickGridSize = make_int3(0, 0, 0);
+  volumeData.brickUseCounter = 0;
+  volumeData.classifiedArray = 0;
+  volumeData.classifiedTexture = 0;
+  volumeData.classifiedVersion = 0;
 }
 
-void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(cudaStream_t* stream){
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(cuda1DVolumeInformation& volumeData, cudaStream_t* stream){
   // if the array is already populated with information, free it to prevent leaking
-  if(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0])
-    cudaFreeArray(CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0]);
-  CUDA_vtkCUDA1DVolumeMapper_sourceDataArray[0] = 0;
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearPyramid(volumeData);
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearBricks(volumeData);
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearPreClassification(volumeData, stream);
+  if(volumeData.levelTexture[0])
+    cudaDestroyTextureObject(volumeData.levelTexture[0]);
+  if(volumeData.sourceTexture)
+    cudaDestroyTextureObject(volumeData.sourceTexture);
+  if(volumeData.sourceDataArray)
+    cudaFreeArray(volumeData.sourceDataArray);
+  volumeData.levelTexture[0] = 0;
+  volumeData.sourceTexture = 0;
+  volumeData.sourceDataArray = 0;
 }
\ No newline at end of file
@@ -14,12 +14,17 @@
 
 // CUDA Volume Rendering includes
 #include "CUDA_container1DTransferFunctionInformation.h"
+#include "CUDA_container1DVolumeInformation.h"
 #include "CUDA_containerOutputImageInformation.h"
 #include "CUDA_containerRendererInformation.h"
 #include "CUDA_containerVolumeInformation.h"
 
+#define CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE 8 /**< Size in voxels of the bricks which the ray caster jumps over when they are transparent throughout */
+#define CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS 256 /**< Number of bins of the histogram of the gradient magnitudes of the volume */
+
 /** @brief Compute the image of the volume taking into account occluding isosurfaces returning it in a image buffer
 *
+*  @param volumeData Structure holding the device arrays of the mapper's volume, whose current level is sampled through its texture object for the render
 *  @param outputInfo Structure containing information for the rendering process describing the output image and how it is handled
 *  @param renderInfo Structure containing information for the rendering process taken primarily from the renderer, such as camera/shading properties
 *  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
@@ -28,7 +33,8 @@
 *  @pre CUDA-OpenGL interoperability is functional (ie. Only 1 OpenGL context which corresponds solely to the singular renderer/window)
 *
 */
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(const cudaOutputImageInformation& outputInfo,
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(cuda1DVolumeInformation& volumeData,
+                                                    const cudaOutputImageInformation& outputInfo,
                                                     const cudaRendererInformation& rendererInfo,
                                                     const cudaVolumeInformation& volumeInfo,
                                                     const cuda1DTransferFunctionInformation& transInfo,
@@ -41,33 +47,142 @@ bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(const cudaOutputImageInforma
 *  @pre frame is less than the total number of frames and is non-negative
 *
 */
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(const int frame, cudaStream_t* stream);
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(cuda1DVolumeInformation& volumeData, const int frame, cudaStream_t* stream);
+
+/** @brief Builds the min/max/average mip pyramid of the current frame on the device
+*
+*  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
+*  @param maxLevels The maximum number of levels wanted, including the full resolution volume
+*
+*  @return The number of levels actually built, which may be fewer if the volume is small or the device is short on memory
+*
+*/
+int CUDA_vtkCUDA1DVolumeMapper_renderAlgo_buildPyramid(cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo, const int maxLevels, cudaStream_t* stream);
+
+/** @brief Builds the intensity range of each brick of the full resolution volume, from which the bricks transparent under a transfer function are found
+*
+*  @param volumeSize The size of the full resolution volume
+*
+*  @note The range of a brick includes the voxels one past its faces, which interpolated samples and gradients within it read
+*  @note A live volume should not build the bricks as its slices keep changing, the ray caster then never jumping over bricks
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_buildBricks(cuda1DVolumeInformation& volumeData, const int3& volumeSize, cudaStream_t* stream);
+
+/** @brief Gathers the range and histogram of the gradient magnitudes of the full resolution volume, computed as the ray caster computes them, in two passes on the device
+*
+*  @param volumeInfo Structure describing the full resolution volume
+*  @param range Returns the smallest and largest gradient magnitudes, in intensity per unit of distance
+*  @param histogram Returns the number of voxels in each of CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS bins evenly spanning the range
+*
+*  @note This waits for the passes to finish, as the histogram needs the range
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_gradientStatistics(const cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo,
+                                                              float range[2], unsigned int* histogram, cudaStream_t* stream);
+
+/** @brief Classifies the full resolution volume with the transfer function into an RGBA volume which the ray caster samples directly
+*
+*  @param volumeInfo Structure describing the full resolution volume
+*  @param volumeData Structure holding the device arrays of the mapper's volume, which receives the RGBA volume and the version it was classified with
+*  @param transInfo Structure holding the transfer function to classify with, its version identifying the classification
+*  @param availableBytes The device memory the RGBA volume and the slab it is classified through may take if it is not allocated yet
+*
+*  @return Whether the volume is classified with the transfer function, which it cannot be away from the full resolution level,
+*          with pre-integration or when the RGBA volume does not fit (in which case it is not retried for the same version)
+*
+*  @note The colour is stored multiplied by the opacity (including the gradient opacity), so interpolating it does not bleed the colour of transparent voxels
+*  @note Any slab loaded afterwards invalidates the classification
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_preClassify(cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo,
+                                                       const cuda1DTransferFunctionInformation& transInfo, const size_t availableBytes,
+                                                       cudaStream_t* stream);
+
+/** @brief Releases the RGBA volume, returning the ray caster to classifying each sample
+*
+*/
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearPreClassification(cuda1DVolumeInformation& volumeData, cudaStream_t* stream);
+
+/** @brief Changes the level of the mip pyramid being sampled by the ray caster
+*
+*  @param level The level (0 being full resolution) to sample
+*
+*  @pre level is less than the number of levels returned by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_buildPyramid
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeLevel(cuda1DVolumeInformation& volumeData, const int level, cudaStream_t* stream);
+
+/** @brief Copies slices of a level of the mip pyramid back to the host, so they can be stored in the volume cache
+*
+*  @param level The level (0 being full resolution) to copy
+*  @param levelSize The size of the level
+*  @param firstSlice The first slice to copy
+*  @param numSlices The number of slices to copy
+*  @param average Host buffer receiving the (averaged) values of the slices
+*  @param minMax Host buffer receiving the min/max of the slices, which is only filled for the coarser levels
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_getLevelSlab(const cuda1DVolumeInformation& volumeData, const int level, const int3& levelSize,
+                                                        const int firstSlice, const int numSlices, float* average, float2* minMax, cudaStream_t* stream);
+
+/** @brief Loads a coarser level of the mip pyramid which was built earlier, such as from the volume cache
+*
+*  @param level The level to load, which must be at least 1 (level 0 being loaded as the image itself)
+*  @param levelSize The size of the level
+*  @param average The averaged values of the level
+*  @param minMax The min/max of the level
+*
+*  @pre The finer levels were loaded already
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadLevel(cuda1DVolumeInformation& volumeData, const int level, const int3& levelSize,
+                                                     const float* average, const float2* minMax, cudaStream_t* stream);
 
 /** @brief Prepares the container for the frame at the initialization of the renderer
 *
+*  @param volumeData Structure receiving the (empty) device arrays of the mapper's volume
 */
-void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(cudaStream_t* stream);
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(cuda1DVolumeInformation& volumeData, cudaStream_t* stream);
 
 /** @brief Deallocates the frames and clears the container (needed for ray caster deallocation)
 *
 */
-void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(cudaStream_t* stream);
+void CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(cuda1DVolumeInformation& volumeData, cudaStream_t* stream);
 
-/** @brief Loads the RGBA 2D transfer functions into texture memory
+/** @brief Loads the 1D transfer functions into texture memory, colour and opacity being packed so a sample needs a single fetch
 *
-*  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
-*  @param FunctionSize The size of each dimension of each transfer function
-*  @param redTF A floating point buffer containing the red transfer function
-*  @param greenTF A floating point buffer containing the green transfer function
-*  @param blueTF A floating point buffer containing the blue transfer function
-*  @param alphaTF A floating point buffer containing the opacity transfer function
+*  @param transInfo Structure holding the size of the transfer functions and receiving their arrays
+*  @param colourOpacityTF A buffer of transInfo.functionSize RGBA entries holding the colour and opacity transfer functions
+*  @param galphaTF A floating point buffer containing the gradient opacity transfer function
 *
-*  @pre Each transfer function is square with the intensities separated by 1, and gradients by FunctionSize
+*  @note The arrays are only allocated by the first load (or the first after unloading), later loads copying into them asynchronously, so the buffers have to stay untouched until the stream has passed the copies
+*  @note The arrays are read through texture objects kept in transInfo, which is passed to the kernels by value, so each set of tables belongs to its own mapper
 *
 */
 bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(cuda1DTransferFunctionInformation& transInfo,
-                                                        float* redTF, float* greenTF, float* blueTF, float* alphaTF, float* galphaTF,
+                                                        float4* colourOpacityTF, float* galphaTF,
                                                         cudaStream_t* stream);
+/** @brief Loads the pre-integrated transfer function into a 2D texture, each entry holding the colour and opacity of a ray segment a minimum spacing long
+*
+*  @param transInfo Structure holding the size of the pre-integrated table and receiving its array
+*  @param preIntegrationTF A buffer of transInfo.preIntegrationSize squared RGBA entries, the row being the front intensity and the column the back intensity
+*
+*  @note As with CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures, the array is allocated once and the buffer has to stay untouched until the stream has passed the copy
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPreIntegrationTexture(cuda1DTransferFunctionInformation& transInfo,
+                                                                     const float4* preIntegrationTF, cudaStream_t* stream);
+/** @brief Loads the sparse table of the opacity maxima used to classify the bricks of the volume
+*
+*  @param transInfo Structure holding the size and number of levels of the table and receiving its device copy
+*  @param opacityRangeMax A buffer of transInfo.opacityRangeLevels levels of transInfo.functionSize floats each
+*
+*  @note As with CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures, the buffer has to stay untouched until the stream has passed the copy
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadOpacityRange(cuda1DTransferFunctionInformation& transInfo,
+                                                            const float* opacityRangeMax, cudaStream_t* stream);
 bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures(cuda1DTransferFunctionInformation& transInfo, cudaStream_t* stream);
 
 /** @brief Loads an image into a 3D CUDA array which will be bound to a 3D texture for rendering
@@ -78,7 +193,27 @@ bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures(cuda1DTransferFunction
 *  @pre index is between 0 and 99 inclusive
 *
 */
-bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(const float* imageData, const cudaVolumeInformation& volumeInfo,
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo(cuda1DVolumeInformation& volumeData, const float* imageData, const cudaVolumeInformation& volumeInfo,
                                                          cudaStream_t* stream);
 
+/** @brief Allocates the 3D CUDA array for the image without filling it, so it can be streamed in slab by slab
+*
+*  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
+*  @param halfPrecision Whether the array holds halves rather than floats, the slabs then being loaded as halves
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateImage(cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo, const bool halfPrecision, cudaStream_t* stream);
+
+/** @brief Asynchronously copies a slab of slices into the 3D CUDA array allocated by CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateImage
+*
+*  @param slab A (preferably pinned) host buffer holding numSlices full slices of the image, as floats or halves depending on the allocation
+*  @param firstSlice The index of the first slice of the slab in the image
+*  @param numSlices The number of slices in the slab
+*
+*  @pre The slab stays untouched until the stream has passed the copy
+*
+*/
+bool CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageSlab(cuda1DVolumeInformation& volumeData, const void* slab, const int firstSlice, const int numSlices,
+                                                         const cudaVolumeInformation& volumeInfo, cudaStream_t* stream);
+
 #endif
@@ -0,0 +1,258 @@
+/** @file CUDA_vtkCUDA2DVolumeMapper_renderAlgo.cu
+ *
+ *  @brief Underlying CUDA implementation of the 2D (intensity by gradient magnitude) transfer function ray caster
+ *
+ *  @note The volume is loaded by the 1D ray caster and sampled through the texture objects it creates
+ *
+ */
+
+#include "CUDA_vtkCUDA2DVolumeMapper_renderAlgo.h"
+#include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
+#include <cuda.h>
+
+//as with the 1D ray caster, the transfer function is a kernel parameter read through the texture objects of the mapper's handler
+
+__device__ void CUDA_vtkCUDA2DVolumeMapper_CUDAkernel_CastRays2D(const cudaVolumeInformation& volInfo,
+                  const cudaTextureObject_t inputTexture,
+                  float3& rayStart,
+                  const float& numSteps,
+                  const float3& rayInc,
+                  const cuda2DTransferFunctionInformation& trfInfo,
+                  float4& outputVal) {
+
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  outputVal.x = 0.0f; //R
+  outputVal.y = 0.0f; //G
+  outputVal.z = 0.0f; //B
+  outputVal.w = 1.0f; //A
+
+  //fetch the required information about the size and range of the transfer function from memory to registers
+  __syncthreads();
+  const float functRangeLow = trfInfo.intensityLow;
+  const float functRangeMulti = trfInfo.intensityMultiplier;
+  const float gradRangeLow = trfInfo.gradientLow;
+  const float gradRangeMulti = trfInfo.gradientMultiplier;
+  const float3 space = volInfo.SpacingReciprocal;
+  const float3 incSpace = volInfo.Spacing;
+  const float ambient = volInfo.Ambient;
+  const float diffuse = volInfo.Diffuse;
+  const float2 spec = volInfo.Specular;
+  __syncthreads();
+
+  //apply a randomized offset to the ray
+  float retDepth = dRandomRayOffsets[threadIdx.x + BLOCK_DIM2D * threadIdx.y];
+  __syncthreads();
+  int maxSteps = __float2int_rd(numSteps - retDepth) ;
+  rayStart.x += retDepth*rayInc.x;
+  rayStart.y += retDepth*rayInc.y;
+  rayStart.z += retDepth*rayInc.z;
+  float rayLength;
+  const float opacityExponent = CUDAkernel_OpacityExponent(volInfo, rayInc, rayLength);
+  //allocate flags
+  char2 step;
+  step.x = 0;
+  step.y = 0;
+
+  //loop as long as we are still *roughly* in the range of the clipped and cropped volume
+  while( maxSteps > 0 ){
+
+    // fetching the intensity index into the transfer function
+    const float tempIndex = functRangeMulti * (tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z) - functRangeLow);
+
+    //samples transparent at every gradient magnitude are filtered out before computing the gradient
+    if(tex1D<float>(trfInfo.maxOpacityTexture, tempIndex) > 0.0f){
+
+      //determine which kind of step to make
+      step.x = step.y;
+      step.y = 0;
+
+      //move to the next sample point (may involve moving backward)
+      rayStart.x = rayStart.x + (step.x ? -rayInc.x : rayInc.x);
+      rayStart.y = rayStart.y + (step.x ? -rayInc.y : rayInc.y);
+      rayStart.z = rayStart.z + (step.x ? -rayInc.z : rayInc.z);
+      maxSteps = maxSteps + (step.x ? 1 : -1);
+
+      if(!step.x){
+
+        float3 gradient;
+        gradient.x = ( tex3D<float>(inputTexture, rayStart.x+0.5f, rayStart.y, rayStart.z)
+               - tex3D<float>(inputTexture, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
+        gradient.y = ( tex3D<float>(inputTexture, rayStart.x, rayStart.y+0.5f, rayStart.z)
+               - tex3D<float>(inputTexture, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
+        gradient.z = ( tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z+0.5f)
+               - tex3D<float>(inputTexture, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
+        float gradMag = sqrtf(dot(gradient, gradient));
+
+        //classify the sample by its intensity and gradient magnitude at once
+        const float4 colourOpacity = tex2D<float4>(trfInfo.colourOpacityTexture, tempIndex, gradRangeMulti*(gradMag-gradRangeLow));
+        float alpha = colourOpacity.w;
+        float phongLambert = saturate( abs ( gradient.x*rayInc.x*incSpace.x +
+                           gradient.y*rayInc.y*incSpace.y +
+                           gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) );
+        float shadeD = ambient + diffuse * phongLambert;
+        float shadeS = spec.x * pow(phongLambert, spec.y);
+
+        //accumulate the opacity for this sample point
+        if(opacityExponent > 0.0f) alpha = 1.0f - __powf(1.0f - alpha, opacityExponent);
+        float multiplier = outputVal.w * alpha;
+        outputVal.w *= (1.0f - alpha);
+
+        //accumulate the colour information from this sample point
+        outputVal.x += multiplier * saturate(shadeD * colourOpacity.x + shadeS);
+        outputVal.y += multiplier * saturate(shadeD * colourOpacity.y + shadeS);
+        outputVal.z += multiplier * saturate(shadeD * colourOpacity.z + shadeS);
+      }
+
+      //determine whether or not we've hit an opacity where further sampling becomes neglible
+      if(outputVal.w < 0.015625f){
+        outputVal.w = 0.0f;
+        break;
+      }
+
+    }else{
+
+      //if we aren't backstepping, we can skip a sample
+      if(!step.x){
+        rayStart.x += rayInc.x;
+        rayStart.y += rayInc.y;
+        rayStart.z += rayInc.z;
+        maxSteps--;
+      }
+      step.y = !(step.x);
+
+      //move to the next sample
+      rayStart.x += rayInc.x;
+      rayStart.y += rayInc.y;
+      rayStart.z += rayInc.z;
+      maxSteps--;
+      step.x = 0;
+
+    }
+
+  }//while
+
+  //adjust the opacity output to reflect the collected opacity, and not the remaining opacity
+  outputVal.w = 1.0f - outputVal.w;
+  outputVal.x = saturate( outputVal.x );
+  outputVal.y = saturate( outputVal.y );
+  outputVal.z = saturate( outputVal.z );
+
+}
+
+template< bool Clipping, bool Perspective >
+__global__ void CUDA_vtkCUDA2DVolumeMapper_CUDAkernel_Composite( const cudaVolumeInformation volInfo, const cudaRendererInformation renInfo,
+                                                                 const cudaOutputImageInformation outInfo, const cudaTextureObject_t inputTexture,
+                                                                 const cuda2DTransferFunctionInformation trfInfo ) {
+
+  //index in the output image (2D)
+  int2 index;
+  index.x = blockDim.x * blockIdx.x + threadIdx.x;
+  index.y = blockDim.y * blockIdx.y + threadIdx.y;
+
+  //index in the output image (1D)
+  int outindex = index.x + index.y * outInfo.resolution.x;
+
+  float3 rayStart; //ray starting point
+  float3 rayInc; // ray sample increment
+  float numSteps; //maximum number of samples along this ray
+  float4 outputVal; //rgba value of this ray (calculated in castRays, used in WriteData)
+
+  //form the ray in registers rather than reading it back from global memory
+  CUDAkernel_FormRay<Clipping, Perspective>(volInfo, renInfo, outInfo, index, rayStart, rayInc, numSteps);
+
+  // trace along the ray (composite)
+  CUDA_vtkCUDA2DVolumeMapper_CUDAkernel_CastRays2D(volInfo, inputTexture, rayStart, numSteps, rayInc, trfInfo, outputVal);
+
+  //convert output to uchar, adjusting it to be valued from [0,256) rather than [0,1]
+  uchar4 temp;
+  temp.x = 255.0f * outputVal.x;
+  temp.y = 255.0f * outputVal.y;
+  temp.z = 255.0f * outputVal.z;
+  temp.w = 255.0f * outputVal.w;
+
+  //place output in the image buffer
+  __syncthreads();
+  outInfo.deviceOutputImage[outindex] = temp;
+
+}
+
+//pre: the resolution of the image has been processed such that it's x and y size are both multiples of 16 (enforced automatically) and y > 256 (enforced automatically)
+//post: the OutputImage pointer will hold the ray casted information
+bool CUDA_vtkCUDA2DVolumeMapper_renderAlgo_doRender(const cuda1DVolumeInformation& volumeData,
+               const cudaOutputImageInformation& outputInfo,
+               const cudaRendererInformation& rendererInfo,
+               const cudaVolumeInformation& volumeInfo,
+               const cuda2DTransferFunctionInformation& transInfo,
+               cudaStream_t* stream)
+{
+
+  //sample this mapper's volume at the level it is rendering
+  const cudaTextureObject_t inputTexture = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_inputTexture(volumeData);
+  if(!inputTexture) return false;
+
+  //create the necessary execution amount parameters from the block sizes and calculate th volume rendering integral
+  int blockX = outputInfo.resolution.x / BLOCK_DIM2D ;
+  int blockY = outputInfo.resolution.y / BLOCK_DIM2D ;
+
+  dim3 grid(blockX, blockY, 1);
+  dim3 threads(BLOCK_DIM2D, BLOCK_DIM2D, 1);
+
+  //form the rays and composite them in one kernel, with only the clipping and projection code the renderer needs
+  const bool clipping = CUDA_vtkCUDAVolumeMapper_renderAlgo_useClipping(rendererInfo);
+  const bool perspective = CUDA_vtkCUDAVolumeMapper_renderAlgo_usePerspective(rendererInfo);
+  if(clipping && perspective)
+    CUDA_vtkCUDA2DVolumeMapper_CUDAkernel_Composite<true, true> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, inputTexture, transInfo);
+  else if(clipping)
+    CUDA_vtkCUDA2DVolumeMapper_CUDAkernel_Composite<true, false> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, inputTexture, transInfo);
+  else if(perspective)
+    CUDA_vtkCUDA2DVolumeMapper_CUDAkernel_Composite<false, true> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, inputTexture, transInfo);
+  else
+    CUDA_vtkCUDA2DVolumeMapper_CUDAkernel_Composite<false, false> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, inputTexture, transInfo);
+
+  return (cudaGetLastError() == 0);
+}
+
+//pre: the colour and opacity table holds transInfo.intensitySize by transInfo.gradientSize RGBA entries and the maximum opacity table one float per column
+//post: the colour and opacity texture object and the maximum opacity texture object will read the tables
+bool CUDA_vtkCUDA2DVolumeMapper_renderAlgo_loadTextures(cuda2DTransferFunctionInformation& transInfo,
+                  const float4* colourOpacityTF, const float* maxOpacityTF,
+                  cudaStream_t* stream){
+
+  //the arrays stay allocated across edits, each edit rewriting them in place in stream order
+  if(!transInfo.colourOpacityTransferArray2D)
+    cudaMallocArray( &(transInfo.colourOpacityTransferArray2D), &colourOpacityChannelDesc, transInfo.intensitySize, transInfo.gradientSize);
+  if(!transInfo.maxOpacityTransferArray1D)
+    cudaMallocArray( &(transInfo.maxOpacityTransferArray1D), &channelDesc, transInfo.intensitySize, 1);
+  if(!transInfo.colourOpacityTexture)
+    transInfo.colourOpacityTexture = CUDA_vtkCUDA1DVolumeMapper_createTableTexture(transInfo.colourOpacityTransferArray2D);
+  if(!transInfo.maxOpacityTexture)
+    transInfo.maxOpacityTexture = CUDA_vtkCUDA1DVolumeMapper_createTableTexture(transInfo.maxOpacityTransferArray1D);
+
+  //copy the colour and opacity, then the maximum opacity of each intensity
+  cudaMemcpyToArrayAsync(transInfo.colourOpacityTransferArray2D, 0, 0, colourOpacityTF,
+                         sizeof(float4) * transInfo.intensitySize * transInfo.gradientSize,
+                         cudaMemcpyHostToDevice, *stream);
+  cudaMemcpyToArrayAsync(transInfo.maxOpacityTransferArray1D, 0, 0, maxOpacityTF, sizeof(float) * transInfo.intensitySize,
+                         cudaMemcpyHostToDevice, *stream);
+
+  return (cudaGetLastError() == 0);
+
+}
+
+bool CUDA_vtkCUDA2DVolumeMapper_renderAlgo_UnloadTextures(cuda2DTransferFunctionInformation& transInfo, cudaStream_t* stream){
+
+  if(transInfo.colourOpacityTexture)
+    cudaDestroyTextureObject(transInfo.colourOpacityTexture);
+  transInfo.colourOpacityTexture = 0;
+  if(transInfo.maxOpacityTexture)
+    cudaDestroyTextureObject(transInfo.maxOpacityTexture);
+  transInfo.maxOpacityTexture = 0;
+  if(transInfo.colourOpacityTransferArray2D)
+    cudaFreeArray(transInfo.colourOpacityTransferArray2D);
+  transInfo.colourOpacityTransferArray2D = 0;
+  if(transInfo.maxOpacityTransferArray1D)
+    cudaFreeArray(transInfo.maxOpacityTransferArray1D);
+  transInfo.maxOpacityTransferArray1D = 0;
+
+  return (cudaGetLastError() == 0);
+}
@@ -0,0 +1,51 @@
+/** @file CUDA_vtkCUDA2DVolumeMapper_renderAlgo.h
+*
+*  @brief Header file with definitions for the CUDA functions classifying the volume through a 2D (intensity by gradient magnitude) transfer function
+*
+*  @note This is primarily an internal file used by the vtkCUDA2DVolumeMapper to manage the ray casting process, the volume itself being loaded through the CUDA_vtkCUDA1DVolumeMapper_renderAlgo functions
+*
+*/
+
+#ifndef __CUDA_vtkCUDA2DVolumeMapper_renderAlgo_h
+#define __CUDA_vtkCUDA2DVolumeMapper_renderAlgo_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_container1DVolumeInformation.h"
+#include "CUDA_container2DTransferFunctionInformation.h"
+#include "CUDA_containerOutputImageInformation.h"
+#include "CUDA_containerRendererInformation.h"
+#include "CUDA_containerVolumeInformation.h"
+
+/** @brief Compute the image of the volume classified through the 2D transfer function, returning it in a image buffer
+*
+*  @param volumeData Structure holding the device arrays of the mapper's volume, sampled at its current level of detail
+*  @param outputInfo Structure containing information for the rendering process describing the output image and how it is handled
+*  @param renderInfo Structure containing information for the rendering process taken primarily from the renderer, such as camera/shading properties
+*  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
+*  @param transInfo Structure containing the 2D transfer function arrays and the ranges they span
+*
+*  @pre The volume was loaded through CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateImage and CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageSlab
+*
+*/
+bool CUDA_vtkCUDA2DVolumeMapper_renderAlgo_doRender(const cuda1DVolumeInformation& volumeData,
+                                                    const cudaOutputImageInformation& outputInfo,
+                                                    const cudaRendererInformation& rendererInfo,
+                                                    const cudaVolumeInformation& volumeInfo,
+                                                    const cuda2DTransferFunctionInformation& transInfo,
+                                                    cudaStream_t* stream);
+
+/** @brief Loads the 2D transfer function into texture memory along with the highest opacity of each of its columns
+*
+*  @param transInfo Structure holding the size of the transfer function and receiving its arrays
+*  @param colourOpacityTF A buffer of transInfo.intensitySize by transInfo.gradientSize RGBA entries, the intensity varying fastest
+*  @param maxOpacityTF A buffer of transInfo.intensitySize floats holding the highest opacity of each column
+*
+*  @note The arrays are only allocated by the first load (or the first after unloading, which is needed when the size of the table changes), so the buffers have to stay untouched until the stream has passed the copies
+*
+*/
+bool CUDA_vtkCUDA2DVolumeMapper_renderAlgo_loadTextures(cuda2DTransferFunctionInformation& transInfo,
+                                                        const float4* colourOpacityTF, const float* maxOpacityTF,
+                                                        cudaStream_t* stream);
+bool CUDA_vtkCUDA2DVolumeMapper_renderAlgo_UnloadTextures(cuda2DTransferFunctionInformation& transInfo, cudaStream_t* stream);
+
+#endif
@@ -0,0 +1,389 @@
+/** @file CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo.cu
+ *
+ *  @brief Underlying CUDA implementation of the label map ray caster
+ *
+ *  @note The labels are held in the volume information of each mapper as a native 8 or 16 bit volume, rounded from the input on the host as it is streamed up
+ *
+ */
+
+#include "CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo.h"
+#include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
+#include <cuda.h>
+#include <string.h>
+
+//creates a texture object fetching the entry of a table at an unnormalized coordinate, without interpolation between the entries
+cudaTextureObject_t CUDA_vtkCUDALabelMapVolumeMapper_createLabelTexture(cudaArray* tableArray){
+  cudaResourceDesc resourceDesc;
+  memset(&resourceDesc, 0, sizeof(resourceDesc));
+  resourceDesc.resType = cudaResourceTypeArray;
+  resourceDesc.res.array.array = tableArray;
+
+  cudaTextureDesc textureDesc;
+  memset(&textureDesc, 0, sizeof(textureDesc));
+  textureDesc.normalizedCoords = 0;
+  textureDesc.filterMode = cudaFilterModePoint;
+  textureDesc.addressMode[0] = cudaAddressModeClamp;
+  textureDesc.readMode = cudaReadModeElementType;
+
+  cudaTextureObject_t tableTexture = 0;
+  cudaCreateTextureObject(&tableTexture, &resourceDesc, &textureDesc, 0);
+  return tableTexture;
+}
+
+//the label of the voxel a point lies in
+template< class T >
+__device__ unsigned int CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel(const cudaTextureObject_t labelTexture, const float x, const float y, const float z);
+
+template<>
+__device__ unsigned int CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<unsigned char>(const cudaTextureObject_t labelTexture, const float x, const float y, const float z) {
+  return tex3D<unsigned char>(labelTexture, x, y, z);
+}
+
+template<>
+__device__ unsigned int CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<unsigned short>(const cudaTextureObject_t labelTexture, const float x, const float y, const float z) {
+  return tex3D<unsigned short>(labelTexture, x, y, z);
+}
+
+template< class T >
+__device__ void CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_CastRaysLabels(const cudaVolumeInformation& volInfo,
+                  const cudaTextureObject_t labelTexture,
+                  float3& rayStart,
+                  const float& numSteps,
+                  const float3& rayInc,
+                  const cudaLabelMapInformation& labelInfo,
+                  float4& outputVal) {
+
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  outputVal.x = 0.0f; //R
+  outputVal.y = 0.0f; //G
+  outputVal.z = 0.0f; //B
+  outputVal.w = 1.0f; //A
+
+  //fetch the required information about the labels and the volume from memory to registers
+  __syncthreads();
+  const unsigned int numberOfLabels = labelInfo.numberOfLabels;
+  const unsigned int* visibility = labelInfo.visibility;
+  const unsigned char* brickOccupancy = labelInfo.brickOccupancy;
+  const int3 brickGrid = labelInfo.brickGridSize;
+  const float3 space = volInfo.SpacingReciprocal;
+  const float3 incSpace = volInfo.Spacing;
+  const float ambient = volInfo.Ambient;
+  const float diffuse = volInfo.Diffuse;
+  const float2 spec = volInfo.Specular;
+  __syncthreads();
+
+  //apply a randomized offset to the ray
+  float retDepth = dRandomRayOffsets[threadIdx.x + BLOCK_DIM2D * threadIdx.y];
+  __syncthreads();
+  int maxSteps = __float2int_rd(numSteps - retDepth) ;
+  rayStart.x += retDepth*rayInc.x;
+  rayStart.y += retDepth*rayInc.y;
+  rayStart.z += retDepth*rayInc.z;
+  float rayLength;
+  const float opacityExponent = CUDAkernel_OpacityExponent(volInfo, rayInc, rayLength);
+
+  //loop as long as we are still *roughly* in the range of the clipped and cropped volume
+  while( maxSteps > 0 ){
+
+    //labels are never interpolated, so the sample takes the label of the voxel it lies in
+    const unsigned int label = CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<T>(labelTexture, rayStart.x, rayStart.y, rayStart.z);
+    if( label < numberOfLabels && (visibility[label >> 5] & (1u << (label & 31))) ){
+
+      const float4 colourOpacity = tex1D<float4>(labelInfo.colourOpacityTexture, (float) label + 0.5f);
+
+      //the normal points out of the region of the label, as found from which neighbours carry it
+      float3 gradient;
+      gradient.x = ( (float) (CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<T>(labelTexture, rayStart.x-1.0f, rayStart.y, rayStart.z) == label)
+             - (float) (CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<T>(labelTexture, rayStart.x+1.0f, rayStart.y, rayStart.z) == label) ) * space.x;
+      gradient.y = ( (float) (CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<T>(labelTexture, rayStart.x, rayStart.y-1.0f, rayStart.z) == label)
+             - (float) (CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<T>(labelTexture, rayStart.x, rayStart.y+1.0f, rayStart.z) == label) ) * space.y;
+      gradient.z = ( (float) (CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<T>(labelTexture, rayStart.x, rayStart.y, rayStart.z-1.0f) == label)
+             - (float) (CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<T>(labelTexture, rayStart.x, rayStart.y, rayStart.z+1.0f) == label) ) * space.z;
+      float gradMag = sqrtf(dot(gradient, gradient));
+
+      //the inside of a region has no normal, and is lit fully
+      float alpha = colourOpacity.w;
+      float phongLambert = (gradMag > 0.0f) ? saturate( abs ( gradient.x*rayInc.x*incSpace.x +
+                           gradient.y*rayInc.y*incSpace.y +
+                           gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) ) : 1.0f;
+      float shadeD = ambient + diffuse * phongLambert;
+      float shadeS = spec.x * pow(phongLambert, spec.y);
+
+      //accumulate the opacity for this sample point
+      if(opacityExponent > 0.0f) alpha = 1.0f - __powf(1.0f - alpha, opacityExponent);
+      float multiplier = outputVal.w * alpha;
+      outputVal.w *= (1.0f - alpha);
+
+      //accumulate the colour information from this sample point
+      outputVal.x += multiplier * saturate(shadeD * colourOpacity.x + shadeS);
+      outputVal.y += multiplier * saturate(shadeD * colourOpacity.y + shadeS);
+      outputVal.z += multiplier * saturate(shadeD * colourOpacity.z + shadeS);
+
+      //determine whether or not we've hit an opacity where further sampling becomes neglible
+      if(outputVal.w < 0.015625f){
+        outputVal.w = 0.0f;
+        break;
+      }
+
+    }else{
+
+      //jump straight out of a brick which holds no visible label
+      const int emptySteps = brickOccupancy ? CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_EmptyBrickSteps(rayStart, rayInc, brickOccupancy, brickGrid) : 0;
+      if(emptySteps){
+        rayStart.x += emptySteps * rayInc.x;
+        rayStart.y += emptySteps * rayInc.y;
+        rayStart.z += emptySteps * rayInc.z;
+        maxSteps -= emptySteps;
+        continue;
+      }
+
+    }
+
+    //move to the next sample
+    rayStart.x += rayInc.x;
+    rayStart.y += rayInc.y;
+    rayStart.z += rayInc.z;
+    maxSteps--;
+
+  }//while
+
+  //adjust the opacity output to reflect the collected opacity, and not the remaining opacity
+  outputVal.w = 1.0f - outputVal.w;
+  outputVal.x = saturate( outputVal.x );
+  outputVal.y = saturate( outputVal.y );
+  outputVal.z = saturate( outputVal.z );
+
+}
+
+template< class T, bool Clipping, bool Perspective >
+__global__ void CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_Composite( const cudaVolumeInformation volInfo, const cudaRendererInformation renInfo,
+                                                                       const cudaOutputImageInformation outInfo, const cudaTextureObject_t labelTexture,
+                                                                       const cudaLabelMapInformation labelInfo ) {
+
+  //index in the output image (2D)
+  int2 index;
+  index.x = blockDim.x * blockIdx.x + threadIdx.x;
+  index.y = blockDim.y * blockIdx.y + threadIdx.y;
+
+  //index in the output image (1D)
+  int outindex = index.x + index.y * outInfo.resolution.x;
+
+  float3 rayStart; //ray starting point
+  float3 rayInc; // ray sample increment
+  float numSteps; //maximum number of samples along this ray
+  float4 outputVal; //rgba value of this ray (calculated in castRays, used in WriteData)
+
+  //form the ray in registers rather than reading it back from global memory
+  CUDAkernel_FormRay<Clipping, Perspective>(volInfo, renInfo, outInfo, index, rayStart, rayInc, numSteps);
+
+  // trace along the ray (composite)
+  CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_CastRaysLabels<T>(volInfo, labelTexture, rayStart, numSteps, rayInc, labelInfo, outputVal);
+
+  //convert output to uchar, adjusting it to be valued from [0,256) rather than [0,1]
+  uchar4 temp;
+  temp.x = 255.0f * outputVal.x;
+  temp.y = 255.0f * outputVal.y;
+  temp.z = 255.0f * outputVal.z;
+  temp.w = 255.0f * outputVal.w;
+
+  //place output in the image buffer
+  __syncthreads();
+  outInfo.deviceOutputImage[outindex] = temp;
+
+}
+
+//find the range of labels in each brick, including the voxels one past its faces (the z index is folded into the y index of the grid)
+template< class T >
+__global__ void CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_BrickMinMax( float2* minMaxOut, const cudaTextureObject_t labelTexture, const int3 volumeSize,
+                                                                         const int3 gridSize, const int blocksY ) {
+
+  int3 brick;
+  brick.x = blockDim.x * blockIdx.x + threadIdx.x;
+  brick.y = blockDim.y * (blockIdx.y % blocksY) + threadIdx.y;
+  brick.z = blockIdx.y / blocksY;
+  if( brick.x >= gridSize.x || brick.y >= gridSize.y ) return;
+
+  const int3 first = make_int3( max( brick.x * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1, 0 ),
+                                max( brick.y * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1, 0 ),
+                                max( brick.z * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1, 0 ) );
+  const int3 last = make_int3( min( (brick.x + 1) * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE, volumeSize.x - 1 ),
+                               min( (brick.y + 1) * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE, volumeSize.y - 1 ),
+                               min( (brick.z + 1) * CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE, volumeSize.z - 1 ) );
+  unsigned int minLabel = CUDA_VTKCUDALABELMAPVOLUMEMAPPER_MAX_LABEL;
+  unsigned int maxLabel = 0;
+  for( int z = first.z; z <= last.z; z++ )
+    for( int y = first.y; y <= last.y; y++ )
+      for( int x = first.x; x <= last.x; x++ ){
+        const unsigned int label = CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_FetchLabel<T>(labelTexture, x+0.5f, y+0.5f, z+0.5f);
+        minLabel = min( minLabel, label );
+        maxLabel = max( maxLabel, label );
+      }
+
+  minMaxOut[brick.x + gridSize.x*(brick.y + gridSize.y*brick.z)] = make_float2( (float) minLabel, (float) maxLabel );
+}
+
+//classify each brick as visible if any label over its range is visible
+__global__ void CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_ClassifyBricks( unsigned char* occupancy, const float2* minMax, const int numBricks,
+                                                                            const unsigned int* visibility, const int numberOfLabels ) {
+
+  const int brick = blockDim.x * blockIdx.x + threadIdx.x;
+  if( brick >= numBricks ) return;
+
+  const float2 range = minMax[brick];
+  const int first = max( __float2int_rn( fmaxf( range.x, 0.0f ) ), 0 );
+  const int last = min( __float2int_rn( fminf( range.y, (float) CUDA_VTKCUDALABELMAPVOLUMEMAPPER_MAX_LABEL ) ), numberOfLabels - 1 );
+
+  //test the words of the bitmask over the range, masking out the labels either side of it
+  unsigned char visible = 0;
+  for( int word = first >> 5; word <= (last >> 5) && first <= last && !visible; word++ ){
+    unsigned int bits = visibility[word];
+    if( word == (first >> 5) ) bits &= 0xffffffffu << (first & 31);
+    if( word == (last >> 5) ) bits &= 0xffffffffu >> (31 - (last & 31));
+    visible = (bits != 0) ? 1 : 0;
+  }
+  occupancy[brick] = visible;
+}
+
+//launch the variant of the composite kernel forming its rays with only the clipping and projection code the renderer needs
+template< class T >
+void CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_composite(const cudaVolumeInformation& volumeInfo, const cudaRendererInformation& rendererInfo,
+                                                           const cudaOutputImageInformation& outputInfo, const cudaTextureObject_t labelTexture,
+                                                           const cudaLabelMapInformation& labelInfo,
+                                                           const dim3& grid, const dim3& threads, cudaStream_t* stream){
+  const bool clipping = CUDA_vtkCUDAVolumeMapper_renderAlgo_useClipping(rendererInfo);
+  const bool perspective = CUDA_vtkCUDAVolumeMapper_renderAlgo_usePerspective(rendererInfo);
+  if(clipping && perspective)
+    CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_Composite<T, true, true> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, labelTexture, labelInfo);
+  else if(clipping)
+    CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_Composite<T, true, false> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, labelTexture, labelInfo);
+  else if(perspective)
+    CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_Composite<T, false, true> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, labelTexture, labelInfo);
+  else
+    CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_Composite<T, false, false> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, labelTexture, labelInfo);
+}
+
+//pre: the resolution of the image has been processed such that it's x and y size are both multiples of 16 (enforced automatically) and y > 256 (enforced automatically)
+//post: the OutputImage pointer will hold the ray casted information
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_doRender(cuda1DVolumeInformation& volumeData,
+               const cudaOutputImageInformation& outputInfo,
+               const cudaRendererInformation& rendererInfo,
+               const cudaVolumeInformation& volumeInfo,
+               const cudaLabelMapInformation& labelInfo,
+               cudaStream_t* stream)
+{
+
+  if( !volumeData.sourceTexture || !labelInfo.visibility ) return false;
+  const bool sixteenBit = (volumeData.sourceVoxelSize == sizeof(unsigned short));
+
+  //classify the bricks whenever the visibility changes, which costs no more than the bitmask and a pass over the bricks,
+  //a single visibility being in use so only the first set of occupancies is kept
+  cudaLabelMapInformation renderLabelInfo = labelInfo;
+  renderLabelInfo.brickOccupancy = 0;
+  if( volumeData.brickMinMax && volumeData.brickOccupancy && labelInfo.visibilityVersion != 0 ){
+    const int numBricks = volumeData.brickGridSize.x * volumeData.brickGridSize.y * volumeData.brickGridSize.z;
+    if( volumeData.brickVersion[0] != labelInfo.visibilityVersion ){
+      CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_ClassifyBricks <<< (numBricks + 255) / 256, 256, 0, *stream >>>(volumeData.brickOccupancy, volumeData.brickMinMax, numBricks, labelInfo.visibility, labelInfo.numberOfLabels);
+      volumeData.brickVersion[0] = labelInfo.visibilityVersion;
+    }
+    renderLabelInfo.brickOccupancy = volumeData.brickOccupancy;
+    renderLabelInfo.brickGridSize = volumeData.brickGridSize;
+  }
+
+  //create the necessary execution amount parameters from the block sizes and calculate th volume rendering integral
+  int blockX = outputInfo.resolution.x / BLOCK_DIM2D ;
+  int blockY = outputInfo.resolution.y / BLOCK_DIM2D ;
+
+  dim3 grid(blockX, blockY, 1);
+  dim3 threads(BLOCK_DIM2D, BLOCK_DIM2D, 1);
+  if( sixteenBit )
+    CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_composite<unsigned short>(volumeInfo, rendererInfo, outputInfo, volumeData.sourceTexture, renderLabelInfo, grid, threads, stream);
+  else
+    CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_composite<unsigned char>(volumeInfo, rendererInfo, outputInfo, volumeData.sourceTexture, renderLabelInfo, grid, threads, stream);
+
+  return (cudaGetLastError() == 0);
+}
+
+//pre: the volume information of the mapper holds no labels yet, or ones it can free
+//post: the source data array holds room for the labels as 8 or 16 bit integers, filled in by the 1D ray caster's slab loads,
+//      and the source texture object fetches them without interpolation
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_allocateLabels(cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo,
+                                                                const bool sixteenBit, cudaStream_t* stream){
+
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(volumeData, stream);
+
+  //the labels take a quarter (or half) the room of a float volume, and are never averaged into a pyramid
+  cudaChannelFormatDesc labelDesc = sixteenBit ? cudaCreateChannelDesc<unsigned short>() : cudaCreateChannelDesc<unsigned char>();
+  volumeData.sourceVoxelSize = sixteenBit ? sizeof(unsigned short) : sizeof(unsigned char);
+  volumeData.currentLevel = 0;
+  if( cudaMalloc3DArray( &(volumeData.sourceDataArray), &labelDesc,
+                         make_cudaExtent(volumeInfo.VolumeSize.x, volumeInfo.VolumeSize.y, volumeInfo.VolumeSize.z) ) != cudaSuccess ){
+    volumeData.sourceDataArray = 0;
+    return false;
+  }
+  volumeData.sourceTexture = CUDA_vtkCUDAVolumeMapper_createVolumeTexture(volumeData.sourceDataArray, cudaFilterModePoint);
+  return (cudaGetLastError() == 0);
+}
+
+//pre: the labels have all been loaded
+//post: the bricks hold the range of labels within each, to be classified against the visibility on the next render
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_buildBricks(cuda1DVolumeInformation& volumeData, const int3& volumeSize, cudaStream_t* stream){
+
+  if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateBricks(volumeData, volumeSize) ) return false;
+  const int3 gridSize = volumeData.brickGridSize;
+
+  int blocksX = (gridSize.x + 7) / 8;
+  int blocksY = (gridSize.y + 7) / 8;
+  dim3 grid(blocksX, blocksY * gridSize.z, 1);
+  dim3 threads(8, 8, 1);
+  if( volumeData.sourceVoxelSize == sizeof(unsigned short) )
+    CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_BrickMinMax<unsigned short> <<< grid, threads, 0, *stream >>>(volumeData.brickMinMax, volumeData.sourceTexture, volumeSize, gridSize, blocksY);
+  else
+    CUDA_vtkCUDALabelMapVolumeMapper_CUDAkernel_BrickMinMax<unsigned char> <<< grid, threads, 0, *stream >>>(volumeData.brickMinMax, volumeData.sourceTexture, volumeSize, gridSize, blocksY);
+
+  return (cudaGetLastError() == 0);
+}
+
+//pre: the colour table holds labelInfo.numberOfLabels RGBA entries and the bitmask one bit per label
+//post: the colour texture object will fetch the table and the bitmask will be on the device
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_loadTable(cudaLabelMapInformation& labelInfo,
+                  const float4* colourOpacity, const unsigned int* visibility,
+                  cudaStream_t* stream){
+
+  //the table and bitmask stay allocated across edits, each edit rewriting them in place in stream order
+  if(!labelInfo.colourOpacityArray)
+    cudaMallocArray( &(labelInfo.colourOpacityArray), &colourOpacityChannelDesc, labelInfo.numberOfLabels, 1);
+  if(!labelInfo.colourOpacityTexture)
+    labelInfo.colourOpacityTexture = CUDA_vtkCUDALabelMapVolumeMapper_createLabelTexture(labelInfo.colourOpacityArray);
+  if(!labelInfo.visibility)
+    cudaMalloc( (void**) &(labelInfo.visibility), sizeof(unsigned int) * ((labelInfo.numberOfLabels + 31) / 32) );
+
+  cudaMemcpyToArrayAsync(labelInfo.colourOpacityArray, 0, 0, colourOpacity, sizeof(float4) * labelInfo.numberOfLabels,
+                         cudaMemcpyHostToDevice, *stream);
+  return CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_loadVisibility(labelInfo, visibility, stream);
+
+}
+
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_loadVisibility(cudaLabelMapInformation& labelInfo, const unsigned int* visibility,
+                  cudaStream_t* stream){
+
+  if(!labelInfo.visibility) return false;
+  cudaMemcpyAsync( labelInfo.visibility, visibility, sizeof(unsigned int) * ((labelInfo.numberOfLabels + 31) / 32),
+                   cudaMemcpyHostToDevice, *stream );
+
+  return (cudaGetLastError() == 0);
+}
+
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_unloadTable(cudaLabelMapInformation& labelInfo, cudaStream_t* stream){
+
+  if(labelInfo.colourOpacityTexture)
+    cudaDestroyTextureObject(labelInfo.colourOpacityTexture);
+  labelInfo.colourOpacityTexture = 0;
+  if(labelInfo.colourOpacityArray)
+    cudaFreeArray(labelInfo.colourOpacityArray);
+  labelInfo.colourOpacityArray = 0;
+  if(labelInfo.visibility)
+    cudaFree(labelInfo.visibility);
+  labelInfo.visibility = 0;
+
+  return (cudaGetLastError() == 0);
+}
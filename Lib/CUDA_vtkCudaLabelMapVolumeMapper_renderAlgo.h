@@ -0,0 +1,81 @@
+/** @file CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo.h
+*
+*  @brief Header file with definitions for the CUDA functions ray casting label maps
+*
+*  @note This is primarily an internal file used by the vtkCUDALabelMapVolumeMapper to manage the ray casting process, the labels being streamed up through CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageSlab
+*
+*/
+
+#ifndef __CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_h
+#define __CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_container1DVolumeInformation.h"
+#include "CUDA_containerLabelMapInformation.h"
+#include "CUDA_containerOutputImageInformation.h"
+#include "CUDA_containerRendererInformation.h"
+#include "CUDA_containerVolumeInformation.h"
+
+//the highest label a label map can hold
+#define CUDA_VTKCUDALABELMAPVOLUMEMAPPER_MAX_LABEL 65535
+
+/** @brief Compute the image of the label map, returning it in a image buffer
+*
+*  @param volumeData Structure holding the device arrays of the mapper's labels and bricks, whose first set of occupancies is classified against the visibility
+*  @param outputInfo Structure containing information for the rendering process describing the output image and how it is handled
+*  @param renderInfo Structure containing information for the rendering process taken primarily from the renderer, such as camera/shading properties
+*  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
+*  @param labelInfo Structure containing the colour table and the visibility bitmask of the labels
+*
+*  @pre The labels were allocated through CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_allocateLabels and loaded
+*
+*/
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_doRender(cuda1DVolumeInformation& volumeData,
+                                                          const cudaOutputImageInformation& outputInfo,
+                                                          const cudaRendererInformation& rendererInfo,
+                                                          const cudaVolumeInformation& volumeInfo,
+                                                          const cudaLabelMapInformation& labelInfo,
+                                                          cudaStream_t* stream);
+
+/** @brief Allocates the native 8 or 16 bit label volume the ray caster fetches from, in place of the float volume of the 1D ray caster
+*
+*  @param volumeData Structure holding the device arrays of the mapper, its previous volume and bricks being freed
+*  @param volumeInfo Structure describing the volume to be loaded
+*  @param sixteenBit Whether the labels need 16 bits
+*
+*  @note The slabs are then loaded through CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageSlab, already rounded to labels of the width chosen
+*
+*/
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_allocateLabels(cuda1DVolumeInformation& volumeData, const cudaVolumeInformation& volumeInfo,
+                                                                const bool sixteenBit, cudaStream_t* stream);
+
+/** @brief Finds the range of labels within each brick of the label volume, so bricks without a visible label can be jumped over
+*
+*  @pre The labels were all loaded
+*
+*/
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_buildBricks(cuda1DVolumeInformation& volumeData, const int3& volumeSize, cudaStream_t* stream);
+
+/** @brief Loads the colour table of the labels into texture memory along with their visibility
+*
+*  @param labelInfo Structure holding the number of labels and receiving the table and bitmask
+*  @param colourOpacity A buffer of labelInfo.numberOfLabels RGBA entries
+*  @param visibility A buffer of one bit per label, in words of 32 labels
+*
+*  @note The table and bitmask are only allocated by the first load (or the first after unloading, which is needed when the number of labels changes), so the buffers have to stay untouched until the stream has passed the copies
+*
+*/
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_loadTable(cudaLabelMapInformation& labelInfo,
+                                                           const float4* colourOpacity, const unsigned int* visibility,
+                                                           cudaStream_t* stream);
+
+/** @brief Loads only the visibility bitmask of the labels, for an edit leaving their colours be
+*
+*  @pre The table was loaded through CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_loadTable for the same number of labels
+*
+*/
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_loadVisibility(cudaLabelMapInformation& labelInfo, const unsigned int* visibility,
+                                                                cudaStream_t* stream);
+bool CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_unloadTable(cudaLabelMapInformation& labelInfo, cudaStream_t* stream);
+
+#endif
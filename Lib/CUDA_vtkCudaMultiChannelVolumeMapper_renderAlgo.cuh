@@ -0,0 +1,379 @@
+/** @file CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo.cu
+ *
+ *  @brief Underlying CUDA implementation of the ray caster sampling several co-registered channels in a single pass
+ *
+ *  @note The first channel is loaded by the 1D ray caster and sampled through the texture objects it creates, the others through texture objects
+ *        of their own, each mapper holding its channels and their bricks in its own channel information
+ *
+ */
+
+#include "CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo.h"
+#include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
+#include <cuda.h>
+#include <string.h>
+
+//the intensity of a channel at a point
+__device__ float CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Sample(const cudaMultiChannelInformation& channelInfo, const int channel,
+                  const float x, const float y, const float z) {
+  return tex3D<float>(channelInfo.volumeTexture[channel], x, y, z);
+}
+
+__device__ void CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_CastRaysMultiChannel(const cudaVolumeInformation& volInfo,
+                  float3& rayStart,
+                  const float& numSteps,
+                  const float3& rayInc,
+                  const cudaMultiChannelInformation& channelInfo,
+                  float4& outputVal) {
+
+  //set the default values for the output (note A is currently the remaining opacity, not the output opacity)
+  outputVal.x = 0.0f; //R
+  outputVal.y = 0.0f; //G
+  outputVal.z = 0.0f; //B
+  outputVal.w = 1.0f; //A
+
+  //fetch the required information about the channels and the volume from memory to registers
+  __syncthreads();
+  const int numberOfChannels = channelInfo.numberOfChannels;
+  const int blendMaximum = (channelInfo.blendMode == CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_MAXIMUM);
+  const unsigned char* brickOccupancy = channelInfo.brickOccupancy;
+  const int3 brickGrid = channelInfo.brickGridSize;
+  const float3 space = volInfo.SpacingReciprocal;
+  const float3 incSpace = volInfo.Spacing;
+  const float ambient = volInfo.Ambient;
+  const float diffuse = volInfo.Diffuse;
+  const float2 spec = volInfo.Specular;
+  __syncthreads();
+
+  //apply a randomized offset to the ray
+  float retDepth = dRandomRayOffsets[threadIdx.x + BLOCK_DIM2D * threadIdx.y];
+  __syncthreads();
+  int maxSteps = __float2int_rd(numSteps - retDepth) ;
+  rayStart.x += retDepth*rayInc.x;
+  rayStart.y += retDepth*rayInc.y;
+  rayStart.z += retDepth*rayInc.z;
+  float rayLength;
+  const float opacityExponent = CUDAkernel_OpacityExponent(volInfo, rayInc, rayLength);
+
+  //loop as long as we are still *roughly* in the range of the clipped and cropped volume
+  while( maxSteps > 0 ){
+
+    //classify every channel at the sample, each costing a fetch from its volume and one from its table
+    float4 colourSum = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+    float4 dominant = make_float4(0.0f, 0.0f, 0.0f, 0.0f);
+    float transparency = 1.0f;
+    int dominantChannel = 0;
+    for( int c = 0; c < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; c++ ){
+      if( c >= numberOfChannels ) break;
+      const float intensity = CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Sample(channelInfo, c, rayStart.x, rayStart.y, rayStart.z);
+      const float4 colourOpacity = tex1D<float4>(channelInfo.colourOpacityTexture[c],
+                                                 channelInfo.intensityMultiplier[c] * (intensity - channelInfo.intensityLow[c]));
+      const float alpha = saturate(colourOpacity.w * channelInfo.weight[c]);
+      colourSum.x += alpha * colourOpacity.x;
+      colourSum.y += alpha * colourOpacity.y;
+      colourSum.z += alpha * colourOpacity.z;
+      colourSum.w += alpha;
+      transparency *= (1.0f - alpha);
+      if( alpha > dominant.w ){
+        dominant = make_float4(colourOpacity.x, colourOpacity.y, colourOpacity.z, alpha);
+        dominantChannel = c;
+      }
+    }
+
+    if( dominant.w > 0.0f ){
+
+      //blend the channels, either layering all of them or taking the most opaque alone
+      float4 colourOpacity = dominant;
+      if( !blendMaximum ){
+        colourOpacity.x = colourSum.x / colourSum.w;
+        colourOpacity.y = colourSum.y / colourSum.w;
+        colourOpacity.z = colourSum.z / colourSum.w;
+        colourOpacity.w = 1.0f - transparency;
+      }
+
+      //shade by the gradient of the most opaque channel, whose gradient opacity scales the blended opacity
+      float3 gradient;
+      gradient.x = ( CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Sample(channelInfo, dominantChannel, rayStart.x+0.5f, rayStart.y, rayStart.z)
+             - CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Sample(channelInfo, dominantChannel, rayStart.x-0.5f, rayStart.y, rayStart.z) ) * space.x;
+      gradient.y = ( CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Sample(channelInfo, dominantChannel, rayStart.x, rayStart.y+0.5f, rayStart.z)
+             - CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Sample(channelInfo, dominantChannel, rayStart.x, rayStart.y-0.5f, rayStart.z) ) * space.y;
+      gradient.z = ( CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Sample(channelInfo, dominantChannel, rayStart.x, rayStart.y, rayStart.z+0.5f)
+             - CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Sample(channelInfo, dominantChannel, rayStart.x, rayStart.y, rayStart.z-0.5f) ) * space.z;
+      float gradMag = sqrtf(dot(gradient, gradient));
+      const float gradRangeMulti = channelInfo.gradientMultiplier[dominantChannel];
+      float alpha = colourOpacity.w;
+      alpha *= isfinite(gradRangeMulti) ? tex1D<float>(channelInfo.galphaTexture[dominantChannel],
+                                                        gradRangeMulti*(gradMag-channelInfo.gradientLow[dominantChannel])) : 1.0f;
+      alpha = saturate(alpha);
+      float phongLambert = (gradMag > 0.0f) ? saturate( abs ( gradient.x*rayInc.x*incSpace.x +
+                           gradient.y*rayInc.y*incSpace.y +
+                           gradient.z*rayInc.z*incSpace.z   ) / (gradMag * rayLength) ) : 1.0f;
+      float shadeD = ambient + diffuse * phongLambert;
+      float shadeS = spec.x * pow(phongLambert, spec.y);
+
+      //accumulate the opacity for this sample point
+      if(opacityExponent > 0.0f) alpha = 1.0f - __powf(1.0f - alpha, opacityExponent);
+      float multiplier = outputVal.w * alpha;
+      outputVal.w *= (1.0f - alpha);
+
+      //accumulate the colour information from this sample point
+      outputVal.x += multiplier * saturate(shadeD * colourOpacity.x + shadeS);
+      outputVal.y += multiplier * saturate(shadeD * colourOpacity.y + shadeS);
+      outputVal.z += multiplier * saturate(shadeD * colourOpacity.z + shadeS);
+
+      //determine whether or not we've hit an opacity where further sampling becomes neglible
+      if(outputVal.w < 0.015625f){
+        outputVal.w = 0.0f;
+        break;
+      }
+
+    }else{
+
+      //jump straight out of a brick which is transparent in every channel
+      const int emptySteps = brickOccupancy ? CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_EmptyBrickSteps(rayStart, rayInc, brickOccupancy, brickGrid) : 0;
+      if(emptySteps){
+        rayStart.x += emptySteps * rayInc.x;
+        rayStart.y += emptySteps * rayInc.y;
+        rayStart.z += emptySteps * rayInc.z;
+        maxSteps -= emptySteps;
+        continue;
+      }
+
+    }
+
+    //move to the next sample
+    rayStart.x += rayInc.x;
+    rayStart.y += rayInc.y;
+    rayStart.z += rayInc.z;
+    maxSteps--;
+
+  }//while
+
+  //adjust the opacity output to reflect the collected opacity, and not the remaining opacity
+  outputVal.w = 1.0f - outputVal.w;
+  outputVal.x = saturate( outputVal.x );
+  outputVal.y = saturate( outputVal.y );
+  outputVal.z = saturate( outputVal.z );
+
+}
+
+template< bool Clipping, bool Perspective >
+__global__ void CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Composite( const cudaVolumeInformation volInfo, const cudaRendererInformation renInfo,
+                                                                           const cudaOutputImageInformation outInfo,
+                                                                           const cudaMultiChannelInformation channelInfo ) {
+
+  //index in the output image (2D)
+  int2 index;
+  index.x = blockDim.x * blockIdx.x + threadIdx.x;
+  index.y = blockDim.y * blockIdx.y + threadIdx.y;
+
+  //index in the output image (1D)
+  int outindex = index.x + index.y * outInfo.resolution.x;
+
+  float3 rayStart; //ray starting point
+  float3 rayInc; // ray sample increment
+  float numSteps; //maximum number of samples along this ray
+  float4 outputVal; //rgba value of this ray (calculated in castRays, used in WriteData)
+
+  //form the ray in registers rather than reading it back from global memory
+  CUDAkernel_FormRay<Clipping, Perspective>(volInfo, renInfo, outInfo, index, rayStart, rayInc, numSteps);
+
+  // trace along the ray (composite)
+  CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_CastRaysMultiChannel(volInfo, rayStart, numSteps, rayInc, channelInfo, outputVal);
+
+  //convert output to uchar, adjusting it to be valued from [0,256) rather than [0,1]
+  uchar4 temp;
+  temp.x = 255.0f * outputVal.x;
+  temp.y = 255.0f * outputVal.y;
+  temp.z = 255.0f * outputVal.z;
+  temp.w = 255.0f * outputVal.w;
+
+  //place output in the image buffer
+  __syncthreads();
+  outInfo.deviceOutputImage[outindex] = temp;
+
+}
+
+//classify each brick by one channel, a brick being visible if it is visible in any channel classified so far
+__global__ void CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_ClassifyChannelBricks( unsigned char* occupancy, const float2* minMax, const int numBricks,
+                                                                                       const float* rangeMax, const int functionSize,
+                                                                                       const float low, const float multiplier, const int firstChannel ) {
+
+  const int brick = blockDim.x * blockIdx.x + threadIdx.x;
+  if( brick >= numBricks ) return;
+  const unsigned char visible = CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_RangeVisible( minMax[brick], rangeMax, functionSize, low, multiplier, 0 ) ? 1 : 0;
+  occupancy[brick] = firstChannel ? visible : (occupancy[brick] | visible);
+}
+
+//pre: the resolution of the image has been processed such that it's x and y size are both multiples of 16 (enforced automatically) and y > 256 (enforced automatically)
+//post: the OutputImage pointer will hold the ray casted information
+bool CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_doRender(const cuda1DVolumeInformation& volumeData,
+               cudaMultiChannelVolumeInformation& channelData,
+               const cudaOutputImageInformation& outputInfo,
+               const cudaRendererInformation& rendererInfo,
+               const cudaVolumeInformation& volumeInfo,
+               const cudaMultiChannelInformation& channelInfo,
+               const cuda1DTransferFunctionInformation* transInfo,
+               cudaStream_t* stream)
+{
+
+  //gather the tables and volumes of the channels, sampling the first at the level it is rendering
+  const int numberOfChannels = channelInfo.numberOfChannels;
+  cudaMultiChannelInformation renderChannelInfo = channelInfo;
+  for( int c = 0; c < numberOfChannels; c++ ){
+    renderChannelInfo.volumeTexture[c] = (c > 0) ? channelData.channelTexture[c] : CUDA_vtkCUDA1DVolumeMapper_renderAlgo_inputTexture(volumeData);
+    if( !renderChannelInfo.volumeTexture[c] ) return false;
+    renderChannelInfo.intensityLow[c] = transInfo[c].intensityLow;
+    renderChannelInfo.intensityMultiplier[c] = transInfo[c].intensityMultiplier;
+    renderChannelInfo.gradientLow[c] = transInfo[c].gradientLow;
+    renderChannelInfo.gradientMultiplier[c] = transInfo[c].gradientMultiplier;
+    renderChannelInfo.colourOpacityTexture[c] = transInfo[c].colourOpacityTexture;
+    renderChannelInfo.galphaTexture[c] = transInfo[c].galphaTexture;
+  }
+
+  //a brick can only be jumped over once it is known to be transparent in every channel, so classify the bricks by each channel in
+  //turn whenever the tables of any of them change, only jumping over them at full resolution where the bricks line up with the samples
+  renderChannelInfo.brickOccupancy = 0;
+  bool skipBricks = volumeData.brickMinMax && volumeData.currentLevel == 0;
+  for( int c = 0; c < numberOfChannels && skipBricks; c++ ){
+    skipBricks = transInfo[c].opacityRangeMax && (c == 0 || channelData.channelMinMax[c]);
+  }
+  if( skipBricks ){
+    const int numBricks = volumeData.brickGridSize.x * volumeData.brickGridSize.y * volumeData.brickGridSize.z;
+    if( !channelData.brickOccupancy &&
+        cudaMalloc( (void**) &channelData.brickOccupancy, sizeof(unsigned char)*numBricks ) != cudaSuccess ){
+      cudaGetLastError();
+      channelData.brickOccupancy = 0;
+    }
+  }
+  if( skipBricks && channelData.brickOccupancy ){
+    const int numBricks = volumeData.brickGridSize.x * volumeData.brickGridSize.y * volumeData.brickGridSize.z;
+    bool classified = (channelData.brickChannels == numberOfChannels);
+    for( int c = 0; c < numberOfChannels; c++ ){
+      classified = classified && (channelData.brickVersion[c] == transInfo[c].opacityVersion);
+    }
+    for( int c = 0; c < numberOfChannels && !classified; c++ ){
+      const float2* minMax = (c > 0) ? channelData.channelMinMax[c] : volumeData.brickMinMax;
+      CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_ClassifyChannelBricks <<< (numBricks + 255) / 256, 256, 0, *stream >>>(channelData.brickOccupancy, minMax, numBricks, transInfo[c].opacityRangeMax, transInfo[c].functionSize, transInfo[c].intensityLow, transInfo[c].intensityMultiplier, c == 0);
+      channelData.brickVersion[c] = transInfo[c].opacityVersion;
+    }
+    channelData.brickChannels = numberOfChannels;
+    renderChannelInfo.brickOccupancy = channelData.brickOccupancy;
+    renderChannelInfo.brickGridSize = volumeData.brickGridSize;
+  }
+
+  //create the necessary execution amount parameters from the block sizes and calculate th volume rendering integral
+  int blockX = outputInfo.resolution.x / BLOCK_DIM2D ;
+  int blockY = outputInfo.resolution.y / BLOCK_DIM2D ;
+
+  dim3 grid(blockX, blockY, 1);
+  dim3 threads(BLOCK_DIM2D, BLOCK_DIM2D, 1);
+
+  //form the rays and composite them in one kernel, with only the clipping and projection code the renderer needs
+  const bool clipping = CUDA_vtkCUDAVolumeMapper_renderAlgo_useClipping(rendererInfo);
+  const bool perspective = CUDA_vtkCUDAVolumeMapper_renderAlgo_usePerspective(rendererInfo);
+  if(clipping && perspective)
+    CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Composite<true, true> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, renderChannelInfo);
+  else if(clipping)
+    CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Composite<true, false> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, renderChannelInfo);
+  else if(perspective)
+    CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Composite<false, true> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, renderChannelInfo);
+  else
+    CUDA_vtkCUDAMultiChannelVolumeMapper_CUDAkernel_Composite<false, false> <<< grid, threads, 0, *stream >>>(volumeInfo, rendererInfo, outputInfo, renderChannelInfo);
+
+  return (cudaGetLastError() == 0);
+}
+
+void CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannel(cudaMultiChannelVolumeInformation& channelData, const int channel, cudaStream_t* stream){
+  if(channelData.channelTexture[channel])
+    cudaDestroyTextureObject(channelData.channelTexture[channel]);
+  if(channelData.channelArray[channel])
+    cudaFreeArray(channelData.channelArray[channel]);
+  if(channelData.channelMinMax[channel])
+    cudaFree(channelData.channelMinMax[channel]);
+  channelData.channelTexture[channel] = 0;
+  channelData.channelArray[channel] = 0;
+  channelData.channelMinMax[channel] = 0;
+  channelData.brickChannels = 0;
+}
+
+void CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_initChannels(cudaMultiChannelVolumeInformation& channelData){
+  for( int channel = 0; channel < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; channel++ ){
+    channelData.channelArray[channel] = 0;
+    channelData.channelTexture[channel] = 0;
+    channelData.channelMinMax[channel] = 0;
+    channelData.brickVersion[channel] = 0;
+  }
+  channelData.brickOccupancy = 0;
+  channelData.brickChannels = 0;
+}
+
+void CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannels(cudaMultiChannelVolumeInformation& channelData, cudaStream_t* stream){
+  for( int channel = 1; channel < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; channel++ ){
+    CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannel(channelData, channel, stream);
+  }
+  if(channelData.brickOccupancy)
+    cudaFree(channelData.brickOccupancy);
+  channelData.brickOccupancy = 0;
+}
+
+bool CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_allocateChannel(cudaMultiChannelVolumeInformation& channelData, const int channel,
+                                                                     const int3& volumeSize, cudaStream_t* stream){
+
+  CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannel(channelData, channel, stream);
+  cudaChannelFormatDesc channelDesc = cudaCreateChannelDesc<float>();
+  if( cudaMalloc3DArray( &(channelData.channelArray[channel]), &channelDesc,
+                         make_cudaExtent(volumeSize.x, volumeSize.y, volumeSize.z) ) != cudaSuccess ){
+    channelData.channelArray[channel] = 0;
+    cudaGetLastError();
+    return false;
+  }
+  channelData.channelTexture[channel] =
+    CUDA_vtkCUDAVolumeMapper_createVolumeTexture(channelData.channelArray[channel], cudaFilterModeLinear);
+
+  return (cudaGetLastError() == 0);
+}
+
+bool CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_loadChannelSlab(const cudaMultiChannelVolumeInformation& channelData, const int channel, const float* slab, const int firstSlice, const int numSlices,
+                                                                     const int3& volumeSize, cudaStream_t* stream){
+
+  if(!channelData.channelArray[channel]) return false;
+
+  // copy the slices into their place in the 3D array
+  cudaMemcpy3DParms copyParams = {0};
+  copyParams.srcPtr   = make_cudaPitchedPtr( (void*) slab, volumeSize.x*sizeof(float), volumeSize.x, volumeSize.y);
+  copyParams.dstArray = channelData.channelArray[channel];
+  copyParams.dstPos   = make_cudaPos(0, 0, firstSlice);
+  copyParams.extent   = make_cudaExtent(volumeSize.x, volumeSize.y, numSlices);
+  copyParams.kind     = cudaMemcpyHostToDevice;
+  cudaMemcpy3DAsync(&copyParams, *stream);
+  return (cudaGetLastError() == 0);
+
+}
+
+bool CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_buildChannelBricks(const cuda1DVolumeInformation& volumeData, cudaMultiChannelVolumeInformation& channelData,
+                                                                        const int channel, const int3& volumeSize, cudaStream_t* stream){
+
+  //the bricks of the channel line up with those of the first channel
+  if( channelData.channelMinMax[channel] )
+    cudaFree(channelData.channelMinMax[channel]);
+  channelData.channelMinMax[channel] = 0;
+  channelData.brickChannels = 0;
+  if( !channelData.channelTexture[channel] || !volumeData.brickMinMax ) return false;
+  const int3 gridSize = volumeData.brickGridSize;
+  const size_t numBricks = (size_t) gridSize.x * (size_t) gridSize.y * (size_t) gridSize.z;
+  if( cudaMalloc( (void**) &(channelData.channelMinMax[channel]), sizeof(float2)*numBricks ) != cudaSuccess ){
+    cudaGetLastError();
+    channelData.channelMinMax[channel] = 0;
+    return false;
+  }
+
+  //read the channel through its own texture object, the interpolation having no effect at the voxel centres the bricks are read at
+
+  int blocksX = (gridSize.x + 7) / 8;
+  int blocksY = (gridSize.y + 7) / 8;
+  dim3 grid(blocksX, blocksY * gridSize.z, 1);
+  dim3 threads(8, 8, 1);
+  CUDA_vtkCUDA1DVolumeMapper_CUDAkernel_BrickMinMax <<< grid, threads, 0, *stream >>>(channelData.channelMinMax[channel], channelData.channelTexture[channel], volumeSize, gridSize, blocksY);
+
+  return (cudaGetLastError() == 0);
+}
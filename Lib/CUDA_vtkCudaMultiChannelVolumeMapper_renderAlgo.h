@@ -0,0 +1,70 @@
+/** @file CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo.h
+*
+*  @brief Header file with definitions for the CUDA functions ray casting several co-registered channels in a single pass
+*
+*  @note This is primarily an internal file used by the vtkCUDAMultiChannelVolumeMapper to manage the ray casting process, the first channel being loaded through the CUDA_vtkCUDA1DVolumeMapper_renderAlgo functions
+*
+*/
+
+#ifndef __CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_h
+#define __CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_container1DTransferFunctionInformation.h"
+#include "CUDA_container1DVolumeInformation.h"
+#include "CUDA_containerMultiChannelInformation.h"
+#include "CUDA_containerMultiChannelVolumeInformation.h"
+#include "CUDA_containerOutputImageInformation.h"
+#include "CUDA_containerRendererInformation.h"
+#include "CUDA_containerVolumeInformation.h"
+
+/** @brief Compute the image of the blended channels, returning it in a image buffer
+*
+*  @param volumeData Structure holding the device arrays of the first channel, the mapper's own 1D volume
+*  @param channelData Structure holding the device arrays of the other channels and the occupancy of the bricks over all of them
+*  @param outputInfo Structure containing information for the rendering process describing the output image and how it is handled
+*  @param renderInfo Structure containing information for the rendering process taken primarily from the renderer, such as camera/shading properties
+*  @param volumeInfo Structure containing information for the rendering process taken primarily from the volume, such as dimensions and location in space
+*  @param channelInfo Structure holding the number of channels, their weights and how they are blended
+*  @param transInfo The transfer function of each channel, channelInfo.numberOfChannels of them
+*
+*  @pre The first channel was loaded through the 1D ray caster, and the others through CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_allocateChannel and CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_loadChannelSlab
+*
+*/
+bool CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_doRender(const cuda1DVolumeInformation& volumeData,
+                                                              cudaMultiChannelVolumeInformation& channelData,
+                                                              const cudaOutputImageInformation& outputInfo,
+                                                              const cudaRendererInformation& rendererInfo,
+                                                              const cudaVolumeInformation& volumeInfo,
+                                                              const cudaMultiChannelInformation& channelInfo,
+                                                              const cuda1DTransferFunctionInformation* transInfo,
+                                                              cudaStream_t* stream);
+
+/** @brief Allocates the volume of a channel past the first, of the same size as the first
+*
+*/
+bool CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_allocateChannel(cudaMultiChannelVolumeInformation& channelData, const int channel,
+                                                                     const int3& volumeSize, cudaStream_t* stream);
+
+/** @brief Copies a slab of float slices into the volume of a channel
+*
+*  @note The copy is queued in the stream, so the slab has to stay untouched until the stream has passed it
+*/
+bool CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_loadChannelSlab(const cudaMultiChannelVolumeInformation& channelData, const int channel, const float* slab, const int firstSlice, const int numSlices,
+                                                                     const int3& volumeSize, cudaStream_t* stream);
+
+/** @brief Finds the intensity range of each brick of a channel, so bricks transparent in every channel can be jumped over
+*
+*  @pre The bricks of the first channel, in volumeData, were built through CUDA_vtkCUDA1DVolumeMapper_renderAlgo_buildBricks
+*/
+bool CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_buildChannelBricks(const cuda1DVolumeInformation& volumeData, cudaMultiChannelVolumeInformation& channelData,
+                                                                        const int channel, const int3& volumeSize, cudaStream_t* stream);
+
+/** @brief Zeroes the channel information of a mapper, which holds no device arrays yet
+*
+*/
+void CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_initChannels(cudaMultiChannelVolumeInformation& channelData);
+void CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannel(cudaMultiChannelVolumeInformation& channelData, const int channel, cudaStream_t* stream);
+void CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannels(cudaMultiChannelVolumeInformation& channelData, cudaStream_t* stream);
+
+#endif
@@ -12,28 +12,45 @@
 
 #include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
 #include <cuda.h>
+#include <string.h>
 
 #define BLOCK_DIM2D 16 //16 is optimal, 4 is the minimum and 16 is the maximum
 
-//execution parameters and general information
-__constant__ cudaVolumeInformation        volInfo;
-__constant__ cudaRendererInformation      renInfo;
-__constant__ cudaOutputImageInformation      outInfo;
+//the volume, renderer and output image information are handed to the kernels as parameters and every volume is read through
+//a texture object of the mapper owning it, so renders of different mappers can run side by side in their own streams; the ray
+//offsets are the one table every mapper loads, so rewriting them while another mapper renders changes nothing it reads
 __constant__ float dRandomRayOffsets[BLOCK_DIM2D*BLOCK_DIM2D];
 
-//texture element information for the ZBuffer
-cudaArray* ZBufferArray = 0;
-texture<float, 2, cudaReadModeElementType> zbuffer_texture;
-
 //channel for loading input data and transfer functions
 cudaChannelFormatDesc channelDesc = cudaCreateChannelDesc<float>();
 
+//creates a texture object reading a volume at unnormalized, clamped coordinates, either interpolating it or fetching its voxels as they are
+cudaTextureObject_t CUDA_vtkCUDAVolumeMapper_createVolumeTexture(cudaArray* volumeArray, const cudaTextureFilterMode filterMode){
+  cudaResourceDesc resourceDesc;
+  memset(&resourceDesc, 0, sizeof(resourceDesc));
+  resourceDesc.resType = cudaResourceTypeArray;
+  resourceDesc.res.array.array = volumeArray;
+
+  cudaTextureDesc textureDesc;
+  memset(&textureDesc, 0, sizeof(textureDesc));
+  textureDesc.normalizedCoords = 0;
+  textureDesc.filterMode = filterMode;
+  textureDesc.addressMode[0] = cudaAddressModeClamp;
+  textureDesc.addressMode[1] = cudaAddressModeClamp;
+  textureDesc.addressMode[2] = cudaAddressModeClamp;
+  textureDesc.readMode = cudaReadModeElementType;
+
+  cudaTextureObject_t volumeTexture = 0;
+  cudaCreateTextureObject(&volumeTexture, &resourceDesc, &textureDesc, 0);
+  return volumeTexture;
+}
+
 inline __host__ __device__ float dot(float3 a, float3 b)
 { 
     return a.x * b.x + a.y * b.y + a.z * b.z;
 }
 
-__device__ void CUDAkernel_ClipRayAgainstClippingPlanes(float3& rayStart, float3& rayEnd, float3& rayDir) {
+__device__ void CUDAkernel_ClipRayAgainstClippingPlanes(const cudaRendererInformation& renInfo, float3& rayStart, float3& rayEnd, float3& rayDir) {
   
   __syncthreads();
   const int numPlanes = renInfo.NumberOfClippingPlanes;
@@ -95,7 +112,7 @@ __device__ void CUDAkernel_ClipRayAgainstClippingPlanes(float3& rayStart, float3
 
 }
 
-__device__ void CUDAkernel_ClipRayAgainstVolume(float3& rayStart, float3& rayEnd, float3& rayDir) {
+__device__ void CUDAkernel_ClipRayAgainstVolume(const cudaVolumeInformation& volInfo, float3& rayStart, float3& rayEnd, float3& rayDir) {
   
   //define the ray's length and direction to account for any changes in starting and ending position
   rayDir.x = rayEnd.x - rayStart.x;
@@ -208,21 +225,22 @@ __device__ void CUDAkernel_ClipRayAgainstVolume(float3& rayStart, float3& rayEnd
 
 }
 
-__device__ void CUDAkernel_SetRayEnds(const int2& index, float3& rayStart, float3& rayDir, const int& outIndex) {
+template< bool Clipping, bool Perspective >
+__device__ void CUDAkernel_SetRayEnds(const cudaVolumeInformation& volInfo, const cudaRendererInformation& renInfo,
+                                      const cudaOutputImageInformation& outInfo, const int2& index, float3& rayStart, float3& rayDir) {
   //set the original estimates of the starting and ending co-ordinates in the co-ordinates of the view (not voxels)
   //note: viewRayZ = 0 for start and viewRayZ = 1 for end
   __syncthreads();
   float viewRayX =  1.0f - ( ((float) index.x) / (float) outInfo.resolution.x );
   float viewRayY =  ( ((float) index.y) / (float) outInfo.resolution.y );
   __syncthreads();
-  float endDepth = tex2D(zbuffer_texture, 1.0f-viewRayX, viewRayY );
+  float endDepth = tex2D<float>(renInfo.ZBufferTexture, 1.0f-viewRayX, viewRayY );
 
   //multiply the start co-ordinate in the view by the view to voxels matrix to get the co-ordinate in voxels (NOT YET NORMALIZED)
   __syncthreads();
   rayStart.x = viewRayX*renInfo.ViewToVoxelsMatrix[0] + viewRayY*renInfo.ViewToVoxelsMatrix[1] + renInfo.ViewToVoxelsMatrix[3];
   rayStart.y = viewRayX*renInfo.ViewToVoxelsMatrix[4] + viewRayY*renInfo.ViewToVoxelsMatrix[5] + renInfo.ViewToVoxelsMatrix[7];
   rayStart.z = viewRayX*renInfo.ViewToVoxelsMatrix[8] + viewRayY*renInfo.ViewToVoxelsMatrix[9] + renInfo.ViewToVoxelsMatrix[11];
-  float startNorm = viewRayX*renInfo.ViewToVoxelsMatrix[12] + viewRayY*renInfo.ViewToVoxelsMatrix[13] + renInfo.ViewToVoxelsMatrix[15];
 
   //multiply the equivalent for the end ray, noting that much of the pre-normalized computation is the same as the start ray
   __syncthreads();
@@ -230,92 +248,199 @@ __device__ void CUDAkernel_SetRayEnds(const int2& index, float3& rayStart, float
   rayEnd.x = rayStart.x + endDepth*renInfo.ViewToVoxelsMatrix[2];
   rayEnd.y = rayStart.y + endDepth*renInfo.ViewToVoxelsMatrix[6];
   rayEnd.z = rayStart.z + endDepth*renInfo.ViewToVoxelsMatrix[10];
-  float endNorm = startNorm + endDepth*renInfo.ViewToVoxelsMatrix[14];
   __syncthreads();
-  
-  //normalize (and ergo finish) the start ray's matrix multiplication
-  rayStart.x /= startNorm;
-  rayStart.y /= startNorm;
-  rayStart.z /= startNorm;
-  
-  //normalize (and ergo finish) the end ray's matrix multiplication
-  rayEnd.x /= endNorm;
-  rayEnd.y /= endNorm;
-  rayEnd.z /= endNorm;
+
+  if(Perspective){
+    float startNorm = viewRayX*renInfo.ViewToVoxelsMatrix[12] + viewRayY*renInfo.ViewToVoxelsMatrix[13] + renInfo.ViewToVoxelsMatrix[15];
+    float endNorm = startNorm + endDepth*renInfo.ViewToVoxelsMatrix[14];
+
+    //normalize (and ergo finish) the start ray's matrix multiplication
+    rayStart.x /= startNorm;
+    rayStart.y /= startNorm;
+    rayStart.z /= startNorm;
+
+    //normalize (and ergo finish) the end ray's matrix multiplication
+    rayEnd.x /= endNorm;
+    rayEnd.y /= endNorm;
+    rayEnd.z /= endNorm;
+  }else{
+
+    //a parallel projection leaves the same homogeneous co-ordinate at every point of every ray
+    const float norm = 1.0f / renInfo.ViewToVoxelsMatrix[15];
+    rayStart.x *= norm;
+    rayStart.y *= norm;
+    rayStart.z *= norm;
+    rayEnd.x *= norm;
+    rayEnd.y *= norm;
+    rayEnd.z *= norm;
+  }
 
   //refine the ray to only include areas that are both within the volume, and within the clipping planes of said volume
   //note that ClipRayAgainstVolume calculate the ray's correct length and direction and returns it in rayInc
-  CUDAkernel_ClipRayAgainstClippingPlanes(rayStart, rayEnd, rayDir);
-  CUDAkernel_ClipRayAgainstVolume(rayStart, rayEnd, rayDir);
+  if(Clipping) CUDAkernel_ClipRayAgainstClippingPlanes(renInfo, rayStart, rayEnd, rayDir);
+  CUDAkernel_ClipRayAgainstVolume(volInfo, rayStart, rayEnd, rayDir);
 }
 
-__global__ void CUDAkernel_renderAlgo_formRays( ) {
-
-  //index in the output image (2D)
-  int2 index;
-  index.x = blockDim.x * blockIdx.x + threadIdx.x;
-  index.y = blockDim.y * blockIdx.y + threadIdx.y;
-
-  //index in the output image (1D)
-  int outindex = index.x + index.y * outInfo.resolution.x;
-  
-  float3 rayStart; //ray starting point
-  float3 rayInc; // ray sample increment
-  float numSteps; //maximum number of samples along this ray
+//form the ray through a pixel in registers, giving its starting point, its sample increment and its maximum number of samples
+template< bool Clipping, bool Perspective >
+__device__ void CUDAkernel_FormRay(const cudaVolumeInformation& volInfo, const cudaRendererInformation& renInfo,
+                                   const cudaOutputImageInformation& outInfo, const int2& index,
+                                   float3& rayStart, float3& rayInc, float& numSteps) {
 
   // Calculate the starting and ending points of the ray, as well as the direction vector
-  CUDAkernel_SetRayEnds(index, rayStart, rayInc, outindex);
+  CUDAkernel_SetRayEnds<Clipping, Perspective>(volInfo, renInfo, outInfo, index, rayStart, rayInc);
 
   //determine the maximum number of steps the ray should sample and determine the length of each step
-  numSteps = __fsqrt_rz(  rayInc.x*rayInc.x*volInfo.Spacing.x*volInfo.Spacing.x+
-              rayInc.y*rayInc.y*volInfo.Spacing.y*volInfo.Spacing.y+
-              rayInc.z*rayInc.z*volInfo.Spacing.z*volInfo.Spacing.z) / volInfo.MinSpacing;
+  //(either one step per voxel along the ray, or one step per minimum spacing which oversamples thick slices,
+  //scaled by the sample distance)
+  if( volInfo.VoxelSpaceSampling ){
+    numSteps = __fsqrt_rz(  rayInc.x*rayInc.x + rayInc.y*rayInc.y + rayInc.z*rayInc.z );
+  }else{
+    numSteps = __fsqrt_rz(  rayInc.x*rayInc.x*volInfo.Spacing.x*volInfo.Spacing.x+
+                rayInc.y*rayInc.y*volInfo.Spacing.y*volInfo.Spacing.y+
+                rayInc.z*rayInc.z*volInfo.Spacing.z*volInfo.Spacing.z) / volInfo.MinSpacing;
+  }
+  numSteps /= volInfo.SampleDistance;
   rayInc.x /= numSteps;
   rayInc.y /= numSteps;
   rayInc.z /= numSteps;
-  
-  //write out data
-  __syncthreads();
-  outInfo.rayStartX[outindex] = rayStart.x;
-  __syncthreads();
-  outInfo.rayStartY[outindex] = rayStart.y;
-  __syncthreads();
-  outInfo.rayStartZ[outindex] = rayStart.z;
-  __syncthreads();
-  outInfo.rayIncX[outindex] = rayInc.x;
-  __syncthreads();
-  outInfo.rayIncY[outindex] = rayInc.y;
-  __syncthreads();
-  outInfo.rayIncZ[outindex] = rayInc.z;
-  __syncthreads();
-  outInfo.numSteps[outindex] = numSteps;
-  __syncthreads();
 }
 
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(const float* zBuffer, const int zBufferSizeX, const int zBufferSizeY, cudaStream_t* stream){
+//steps sized in voxels, scaled by the sample distance or taken through a coarser level cover a varying distance, so correct the opacity
+//to that of a step of the input's minimum spacing; this gives the length of a step and the exponent correcting the opacity of a sample
+//over it, which is 0 when the host found every step to be of the input's minimum spacing so the opacities are taken as they are
+__device__ float CUDAkernel_OpacityExponent(const cudaVolumeInformation& volInfo, const float3& rayInc, float& rayLength) {
+  rayLength = sqrtf(rayInc.x*rayInc.x*volInfo.Spacing.x*volInfo.Spacing.x +
+                    rayInc.y*rayInc.y*volInfo.Spacing.y*volInfo.Spacing.y +
+                    rayInc.z*rayInc.z*volInfo.Spacing.z*volInfo.Spacing.z);
+  return volInfo.CorrectOpacity ? rayLength / volInfo.OpacitySpacing : 0.0f;
+}
+
+//the variant of the ray forming code the renderer needs, the composite kernels forming their rays through CUDAkernel_FormRay
+//with these as template parameters (the projection being parallel when the view to voxels matrix leaves the homogeneous co-ordinate constant)
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_useClipping(const cudaRendererInformation& rendererInfo){
+  return rendererInfo.NumberOfClippingPlanes > 0;
+}
+
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_usePerspective(const cudaRendererInformation& rendererInfo){
+  return rendererInfo.ViewToVoxelsMatrix[12] != 0.0f || rendererInfo.ViewToVoxelsMatrix[13] != 0.0f ||
+         rendererInfo.ViewToVoxelsMatrix[14] != 0.0f;
+}
+
+//reduce one level of the mip pyramid into the next coarser one (2x2x2 blocks, clamped at the far borders)
+__global__ void CUDAkernel_renderAlgo_reduceLevel( float* avgOut, float2* minMaxOut, const cudaTextureObject_t finerTexture, const float2* minMaxIn,
+                                                  const int3 inSize, const int3 outSize, const int blocksY ) {
 
-  if(ZBufferArray)
-    cudaFreeArray(ZBufferArray);
+  //index in the coarser level (the z index is folded into the y index of the grid)
+  int3 index;
+  index.x = blockDim.x * blockIdx.x + threadIdx.x;
+  index.y = blockDim.y * (blockIdx.y % blocksY) + threadIdx.y;
+  index.z = blockIdx.y / blocksY;
+  if( index.x >= outSize.x || index.y >= outSize.y ) return;
+
+  float sum = 0.0f;
+  float2 minMax = make_float2( 1.0e+38f, -1.0e+38f );
+  for( int i = 0; i < 8; i++ ){
+    const int x = min( 2*index.x + (i & 1), inSize.x - 1 );
+    const int y = min( 2*index.y + ((i >> 1) & 1), inSize.y - 1 );
+    const int z = min( 2*index.z + ((i >> 2) & 1), inSize.z - 1 );
+    const float value = tex3D<float>(finerTexture, x+0.5f, y+0.5f, z+0.5f);
+    sum += value;
+
+    //the finest level has no min/max buffer, so the voxel itself is the extremum
+    const float2 childMinMax = minMaxIn ? minMaxIn[x + inSize.x*(y + inSize.y*z)] : make_float2(value, value);
+    minMax.x = fminf( minMax.x, childMinMax.x );
+    minMax.y = fmaxf( minMax.y, childMinMax.y );
+  }
+
+  const int outIndex = index.x + outSize.x*(index.y + outSize.y*index.z);
+  avgOut[outIndex] = 0.125f * sum;
+  minMaxOut[outIndex] = minMax;
+}
+
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_buildPyramidLevel(cudaArray* finerArray, const int3& finerSize, const float2* finerMinMax,
+                                                           cudaArray** coarserArray, float2** coarserMinMax, int3& coarserSize,
+                                                           cudaStream_t* stream){
+
+  coarserSize.x = (finerSize.x + 1) / 2;
+  coarserSize.y = (finerSize.y + 1) / 2;
+  coarserSize.z = (finerSize.z + 1) / 2;
+  const size_t numVoxels = (size_t) coarserSize.x * (size_t) coarserSize.y * (size_t) coarserSize.z;
+
+  //allocate the coarser level, bailing out quietly if the device is running short on memory
+  float* avgBuffer = 0;
+  *coarserArray = 0;
+  *coarserMinMax = 0;
+  cudaExtent levelSize = make_cudaExtent(coarserSize.x, coarserSize.y, coarserSize.z);
+  if( cudaMalloc( (void**) &avgBuffer, sizeof(float)*numVoxels ) != cudaSuccess ||
+      cudaMalloc( (void**) coarserMinMax, sizeof(float2)*numVoxels ) != cudaSuccess ||
+      cudaMalloc3DArray( coarserArray, &channelDesc, levelSize ) != cudaSuccess ){
+    if( avgBuffer ) cudaFree( avgBuffer );
+    if( *coarserMinMax ) cudaFree( *coarserMinMax );
+    *coarserMinMax = 0;
+    *coarserArray = 0;
+    cudaGetLastError();
+    return false;
+  }
+
+  //read the finer level through point sampling, the texture living only until the level is built
+  cudaTextureObject_t finerTexture = CUDA_vtkCUDAVolumeMapper_createVolumeTexture(finerArray, cudaFilterModePoint);
+
+  int blocksX = (coarserSize.x + 7) / 8;
+  int blocksY = (coarserSize.y + 7) / 8;
+  dim3 grid(blocksX, blocksY * coarserSize.z, 1);
+  dim3 threads(8, 8, 1);
+  CUDAkernel_renderAlgo_reduceLevel <<< grid, threads, 0, *stream >>>(avgBuffer, *coarserMinMax, finerTexture, finerMinMax, finerSize, coarserSize, blocksY);
+
+  //move the averaged level into an array so it can be sampled with trilinear interpolation
+  cudaMemcpy3DParms copyParams = {0};
+  copyParams.srcPtr   = make_cudaPitchedPtr( (void*) avgBuffer, coarserSize.x*sizeof(float), coarserSize.x, coarserSize.y);
+  copyParams.dstArray = *coarserArray;
+  copyParams.extent   = levelSize;
+  copyParams.kind     = cudaMemcpyDeviceToDevice;
+  cudaMemcpy3DAsync(&copyParams, *stream);
+  cudaStreamSynchronize(*stream);
+  cudaFree(avgBuffer);
+  cudaDestroyTextureObject(finerTexture);
+
+  return (cudaGetLastError() == 0);
+}
+
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(cudaRendererInformation& rendererInfo, const float* zBuffer,
+                                                     const int zBufferSizeX, const int zBufferSizeY, cudaStream_t* stream){
+
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(rendererInfo, stream);
 
   //load the zBuffer from the host to the array
-  cudaMallocArray(&ZBufferArray, &channelDesc, zBufferSizeX, zBufferSizeY);
-  cudaMemcpyToArrayAsync(ZBufferArray, 0, 0, zBuffer, sizeof(float)*zBufferSizeX*zBufferSizeY, cudaMemcpyHostToDevice, *stream);
-
-  //define the texture parameters and bind the texture to the array
-  zbuffer_texture.normalized = true;
-  zbuffer_texture.filterMode = cudaFilterModePoint;
-  zbuffer_texture.addressMode[0] = cudaAddressModeClamp;
-  zbuffer_texture.addressMode[1] = cudaAddressModeClamp;
-  cudaBindTextureToArray(zbuffer_texture, ZBufferArray, channelDesc);
-    
+  cudaMallocArray(&(rendererInfo.ZBufferArray), &channelDesc, zBufferSizeX, zBufferSizeY);
+  cudaMemcpyToArrayAsync(rendererInfo.ZBufferArray, 0, 0, zBuffer, sizeof(float)*zBufferSizeX*zBufferSizeY, cudaMemcpyHostToDevice, *stream);
+
+  //read it at normalized, clamped coordinates without interpolation
+  cudaResourceDesc resourceDesc;
+  memset(&resourceDesc, 0, sizeof(resourceDesc));
+  resourceDesc.resType = cudaResourceTypeArray;
+  resourceDesc.res.array.array = rendererInfo.ZBufferArray;
+
+  cudaTextureDesc textureDesc;
+  memset(&textureDesc, 0, sizeof(textureDesc));
+  textureDesc.normalizedCoords = 1;
+  textureDesc.filterMode = cudaFilterModePoint;
+  textureDesc.addressMode[0] = cudaAddressModeClamp;
+  textureDesc.addressMode[1] = cudaAddressModeClamp;
+  textureDesc.readMode = cudaReadModeElementType;
+  cudaCreateTextureObject(&(rendererInfo.ZBufferTexture), &resourceDesc, &textureDesc, 0);
+
   return (cudaGetLastError() == 0);
 
 }
 
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(cudaStream_t* stream){
-  if(ZBufferArray)
-    cudaFreeArray(ZBufferArray);
-  ZBufferArray = 0;
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(cudaRendererInformation& rendererInfo, cudaStream_t* stream){
+  if(rendererInfo.ZBufferTexture)
+    cudaDestroyTextureObject(rendererInfo.ZBufferTexture);
+  rendererInfo.ZBufferTexture = 0;
+  if(rendererInfo.ZBufferArray)
+    cudaFreeArray(rendererInfo.ZBufferArray);
+  rendererInfo.ZBufferArray = 0;
 
   return (cudaGetLastError() == 0);
 }
@@ -331,5 +456,8 @@ bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadrandomRayOffsets(cudaStream_t* st
 }
 
 #include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.cuh"
+#include "CUDA_vtkCUDA2DVolumeMapper_renderAlgo.cuh"
+#include "CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo.cuh"
+#include "CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo.cuh"
 
 #endif
\ No newline at end of file
@@ -19,8 +19,26 @@
 #include "CUDA_containerRendererInformation.h"
 #include "CUDA_containerVolumeInformation.h"
 
+#define CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS 6 /**< Maximum number of levels in the mip pyramid, including the full resolution volume */
+
+/** @brief Builds the next coarser level of the min/max/average mip pyramid on the device
+*
+*  @param finerArray The 3D array holding the average intensities of the finer level
+*  @param finerSize The size of the finer level in voxels
+*  @param finerMinMax The min/max intensities of the finer level, or NULL if the finer level is the full resolution volume
+*  @param coarserArray Returns the 3D array holding the average intensities of the coarser level
+*  @param coarserMinMax Returns the min/max intensities of the coarser level in linear device memory
+*  @param coarserSize Returns the size of the coarser level in voxels (half the finer size, rounded up)
+*
+*  @note Returns false without leaking if the device cannot hold the coarser level
+*/
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_buildPyramidLevel(cudaArray* finerArray, const int3& finerSize, const float2* finerMinMax,
+                                                           cudaArray** coarserArray, float2** coarserMinMax, int3& coarserSize,
+                                                           cudaStream_t* stream);
+
 /** @brief Loads the ZBuffer into a 2D texture for checking during the rendering process
 *
+*  @param rendererInfo Structure receiving the array holding the z buffer and the texture object reading it
 *  @param zBuffer A floating point buffer 
 *  @param zBufferSizeX The size of the z buffer in the x direction
 *  @param zBufferSizeY The size of the z buffer in the y direction
@@ -28,9 +46,9 @@
 *  @pre The zBuffer consists only of numbers between 0.0f and 1.0f inclusive
 *
 */
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(const float* zBuffer, const int zBufferSizeX,
-                                                     const int zBufferSizeY, cudaStream_t* stream);
-bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(cudaStream_t* stream);
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(cudaRendererInformation& rendererInfo, const float* zBuffer,
+                                                     const int zBufferSizeX, const int zBufferSizeY, cudaStream_t* stream);
+bool CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(cudaRendererInformation& rendererInfo, cudaStream_t* stream);
 
 /** @brief Loads an random image into a 2D CUDA array for de-artifacting
 *
@@ -17,9 +17,75 @@
 #include "vtkImageData.h"
 
 #include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
+#include "cuda_runtime_api.h"
+
+// STD includes
+#include <cmath>
+#include <cstring>
+
+//number of front (and back) intensities in the pre-integrated table
+#define VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_PREINTEGRATION_SIZE 256
+
+//number of entries of the interpolated tables, and the most entries of the exact tables of integer data
+#define VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_FUNCTION_SIZE 512
+#define VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_MAX_FUNCTION_SIZE 65536
+
+//fewest entries each thread bakes, below which a thread costs more than it saves
+#define VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_MIN_BAKE_CHUNK 64
+
+//versions of the baked tables, shared by all the handlers so the ray caster never mistakes one handler's tables for another's
+static unsigned int vtkCUDA1DTransferFunctionInformationHandlerVersion = 0;
 
 vtkStandardNewMacro(vtkCUDA1DTransferFunctionInformationHandler);
 
+//----------------------------------------------------------------------------
+// FNV-1a hash of the bytes of a cache key
+static vtkTypeUInt64 vtkCUDA1DTransferFunctionInformationHandlerHash(const std::vector<double>& key)
+{
+  vtkTypeUInt64 hash = 14695981039346656037ULL;
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>( key.empty() ? NULL : &key[0] );
+  for( size_t i = 0; i < key.size() * sizeof(double); i++ )
+    {
+    hash = (hash ^ bytes[i]) * 1099511628211ULL;
+    }
+  return hash;
+}
+
+//----------------------------------------------------------------------------
+// Number of levels of the sparse table of the opacity maxima over a table of the given size
+static unsigned int vtkCUDA1DTransferFunctionInformationHandlerLevels(int functionSize)
+{
+  unsigned int levels = 1;
+  while( (1 << levels) <= functionSize )
+    {
+    levels++;
+    }
+  return levels;
+}
+
+//----------------------------------------------------------------------------
+// Narrowest span between neighbouring nodes of a function within the range, a sharp segment counting as narrower by its sharpness
+template< class TFunction >
+static double vtkCUDA1DTransferFunctionInformationHandlerNarrowest(TFunction* function, int sharpnessIndex, double low, double high)
+{
+  double narrowest = high - low;
+  double node[6];
+  double previous = 0.0;
+  double previousSharpness = 0.0;
+  for( int i = 0; i < function->GetSize(); i++ )
+    {
+    function->GetNodeValue( i, node );
+    if( i > 0 && node[0] > low && previous < high )
+      {
+      double width = (node[0] - previous) * (1.0 - previousSharpness);
+      narrowest = (width < narrowest) ? width : narrowest;
+      }
+    previous = node[0];
+    previousSharpness = node[sharpnessIndex];
+    }
+  return narrowest;
+}
+
 vtkCUDA1DTransferFunctionInformationHandler
 ::vtkCUDA1DTransferFunctionInformationHandler()
 {
@@ -28,16 +94,55 @@ vtkCUDA1DTransferFunctionInformationHandler
   this->gradientopacityFunction = NULL;
   this->useGradientOpacity = false;
 
-  this->FunctionSize = 512;
+  this->FunctionSize = VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_FUNCTION_SIZE;
+  this->ExactTables = false;
   this->lastModifiedTime = 0;
 
-  this->TransInfo.alphaTransferArray1D = 0;
+  this->TransInfo.colourOpacityTransferArray1D = 0;
   this->TransInfo.galphaTransferArray1D = 0;
-  this->TransInfo.colorRTransferArray1D = 0;
-  this->TransInfo.colorGTransferArray1D = 0;
-  this->TransInfo.colorBTransferArray1D = 0;
+  this->TransInfo.colourOpacityTexture = 0;
+  this->TransInfo.galphaTexture = 0;
+  this->TransInfo.useGradientOpacity = 0;
+  this->TransInfo.preIntegrationTransferArray2D = 0;
+  this->TransInfo.preIntegrationTexture = 0;
+  this->TransInfo.preIntegrationSize = VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_PREINTEGRATION_SIZE;
+  this->TransInfo.usePreIntegration = 0;
+  this->TransInfo.functionSize = this->FunctionSize;
+  this->TransInfo.opacityRangeMax = 0;
+  this->TransInfo.opacityRangeLevels = vtkCUDA1DTransferFunctionInformationHandlerLevels( this->FunctionSize );
+  this->TransInfo.opacityVersion = 0;
+  this->TransInfo.brickOccupancy = 0;
+  this->TransInfo.brickGridSize.x = this->TransInfo.brickGridSize.y = this->TransInfo.brickGridSize.z = 0;
+  this->TransInfo.usePreClassified = 0;
+  for( int i = 0; i < VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE; i++ )
+    {
+    this->CachedTables[i] = this->TransInfo;
+    this->CachedHash[i] = 0;
+    this->CachedLastUse[i] = 0;
+    this->CachedHits[i] = 0;
+    this->CachedValid[i] = false;
+    this->CachedReleaseEvent[i] = 0;
+    }
+  this->FrontTables = 0;
+  this->UseCounter = 0;
 
   this->InputData = NULL;
+  this->InputRange[0] = 0.0;
+  this->InputRange[1] = 1.0;
+  this->LowGradient = 0.0;
+  this->HighGradient = 0.0;
+
+  this->Threader = vtkMultiThreader::New();
+  this->BakeArena = NULL;
+  this->UploadArena = NULL;
+  this->UploadArenaPinned = false;
+  this->UploadEvent = 0;
+  this->CopyStream = 0;
+  this->IntegralArena = NULL;
+  this->ArenaSize = 0;
+  this->AllocateArenas( this->FunctionSize );
+  this->PreIntegrationArena = NULL;
+  this->PreIntegrationArenaPinned = false;
   this->Reinitialize();
 }
 
@@ -46,22 +151,85 @@ vtkCUDA1DTransferFunctionInformationHandler
 {
   this->Deinitialize();
   this->SetInputData(NULL, 0);
+  this->Threader->Delete();
+  delete[] this->BakeArena;
+  if( this->UploadArenaPinned ) cudaFreeHost( this->UploadArena );
+  else delete[] this->UploadArena;
+  delete[] this->IntegralArena;
+  if( this->PreIntegrationArenaPinned ) cudaFreeHost( this->PreIntegrationArena );
+  else delete[] this->PreIntegrationArena;
 }
 
 void vtkCUDA1DTransferFunctionInformationHandler
 ::Deinitialize(int vtkNotUsed(withData))
 {
   this->ReserveGPU();
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures( this->TransInfo, this->GetStream() );
+  if( this->UploadEvent )
+    {
+    cudaEventSynchronize( this->UploadEvent );
+    cudaEventDestroy( this->UploadEvent );
+    this->UploadEvent = 0;
+    }
+  if( this->CopyStream )
+    {
+    cudaStreamDestroy( this->CopyStream );
+    this->CopyStream = 0;
+    }
+  for( int i = 0; i < VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE; i++ )
+    {
+    if( this->CachedReleaseEvent[i] )
+      {
+      cudaEventSynchronize( this->CachedReleaseEvent[i] );
+      cudaEventDestroy( this->CachedReleaseEvent[i] );
+      this->CachedReleaseEvent[i] = 0;
+      }
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures( this->CachedTables[i], this->GetStream() );
+    this->CachedValid[i] = false;
+    this->CachedLastUse[i] = 0;
+    this->CachedHits[i] = 0;
+    this->CachedKey[i].clear();
+    }
+  this->TransInfo = this->CachedTables[this->FrontTables];
 }
 
 void vtkCUDA1DTransferFunctionInformationHandler
 ::Reinitialize(int vtkNotUsed(withData))
 {
+  this->ReserveGPU();
+  if( !this->UploadEvent )
+    {
+    cudaEventCreateWithFlags( &this->UploadEvent, cudaEventDisableTiming );
+    }
+  if( !this->CopyStream && cudaStreamCreate( &this->CopyStream ) != cudaSuccess )
+    {
+    //the tables are then copied through the default stream, which waits for (and holds up) the rendering
+    cudaGetLastError();
+    this->CopyStream = 0;
+    }
+  for( int i = 0; i < VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE; i++ )
+    {
+    if( !this->CachedReleaseEvent[i] )
+      {
+      cudaEventCreateWithFlags( &this->CachedReleaseEvent[i], cudaEventDisableTiming );
+      }
+    }
   lastModifiedTime = 0;
   UpdateTransferFunction();
 }
 
+void vtkCUDA1DTransferFunctionInformationHandler
+::AcquireTables(cudaStream_t* stream)
+{
+  //the copy stream is in order, so the last copy finishing means the front tables are on the device
+  if( this->UploadEvent ) cudaStreamWaitEvent( *stream, this->UploadEvent, 0 );
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler
+::ReleaseTables(cudaStream_t* stream)
+{
+  if( this->CachedReleaseEvent[this->FrontTables] ) cudaEventRecord( this->CachedReleaseEvent[this->FrontTables], *stream );
+}
+
 void vtkCUDA1DTransferFunctionInformationHandler
 ::SetInputData(vtkImageData* inputData, int vtkNotUsed(index))
 {
@@ -77,10 +245,138 @@ void vtkCUDA1DTransferFunctionInformationHandler
   else
     {
     this->InputData = inputData;
+    if( this->ExactTables )
+      {
+      //whether the tables can be exact depends on the scalar type
+      this->lastModifiedTime = 0;
+      }
+    this->Modified();
+    }
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler
+::SetInputRange(const double range[2])
+{
+  if( range[0] != this->InputRange[0] || range[1] != this->InputRange[1] )
+    {
+    this->InputRange[0] = range[0];
+    this->InputRange[1] = range[1];
+    this->lastModifiedTime = 0;
+    this->Modified();
+    }
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler
+::SetInputGradientRange(const double range[2])
+{
+  if( range[0] != this->LowGradient || range[1] != this->HighGradient )
+    {
+    this->LowGradient = range[0];
+    this->HighGradient = range[1];
+    this->lastModifiedTime = 0;
+    this->Modified();
+    }
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler
+::SetPreIntegration(bool preIntegrate)
+{
+  if( preIntegrate != this->GetPreIntegration() )
+    {
+    this->TransInfo.usePreIntegration = preIntegrate ? 1 : 0;
+    this->lastModifiedTime = 0;
     this->Modified();
     }
 }
 
+void vtkCUDA1DTransferFunctionInformationHandler
+::SetExactTables(bool exact)
+{
+  if( exact != this->ExactTables )
+    {
+    this->ExactTables = exact;
+    this->lastModifiedTime = 0;
+    this->Modified();
+    }
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler
+::AllocateArenas(int functionSize)
+{
+  if( functionSize <= this->ArenaSize )
+    {
+    return;
+    }
+
+  //the copies out of the old upload arena have to finish before it is freed
+  if( this->UploadEvent ) cudaEventSynchronize( this->UploadEvent );
+  delete[] this->BakeArena;
+  if( this->UploadArenaPinned ) cudaFreeHost( this->UploadArena );
+  else delete[] this->UploadArena;
+  delete[] this->IntegralArena;
+
+  //the tables keep their host buffers across edits, only growing for larger tables, the uploaded copy (followed by the
+  //sparse table of the opacity maxima) being pinned so it can be copied asynchronously
+  this->ArenaSize = functionSize;
+  this->BakeArena = new float[9*functionSize];
+  const int uploadSize = (5 + vtkCUDA1DTransferFunctionInformationHandlerLevels(functionSize)) * functionSize;
+  this->UploadArenaPinned = (cudaHostAlloc( (void**) &this->UploadArena, sizeof(float)*uploadSize, cudaHostAllocPortable ) == cudaSuccess);
+  if( !this->UploadArenaPinned )
+    {
+    cudaGetLastError();
+    this->UploadArena = new float[uploadSize];
+    }
+  this->IntegralArena = new float[4*functionSize];
+}
+
+bool vtkCUDA1DTransferFunctionInformationHandler
+::ComputeExactTableSize(int scalarType, double minIntensity, double maxIntensity, double& firstValue, int& values)
+{
+  switch( scalarType )
+    {
+    case VTK_CHAR:
+    case VTK_SIGNED_CHAR:
+    case VTK_UNSIGNED_CHAR:
+    case VTK_SHORT:
+    case VTK_UNSIGNED_SHORT:
+      break;
+    default:
+      return false;
+    }
+
+  //one entry per integer value in the range
+  firstValue = ceil( minIntensity );
+  const double count = floor( maxIntensity ) - firstValue + 1.0;
+  if( count < 2.0 || count > VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_MAX_FUNCTION_SIZE )
+    {
+    return false;
+    }
+  values = (int) count;
+  return true;
+}
+
+bool vtkCUDA1DTransferFunctionInformationHandler
+::FitExactTable(double minIntensity, double maxIntensity, double& firstValue, int& values)
+{
+  if( !this->ExactTables || !this->InputData ||
+      !vtkCUDA1DTransferFunctionInformationHandler::ComputeExactTableSize( this->InputData->GetScalarType(), minIntensity, maxIntensity, firstValue, values ) )
+    {
+    return false;
+    }
+
+  //a narrow range is exact for fewer entries than the interpolated table has, whereas a wide one is only worth an entry
+  //per value if the interpolated table would blur the narrowest feature of the transfer function over a few entries
+  if( values <= VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_FUNCTION_SIZE )
+    {
+    return true;
+    }
+  double narrowest = vtkCUDA1DTransferFunctionInformationHandlerNarrowest( this->opacityFunction, 3, minIntensity, maxIntensity );
+  double narrowestColour = vtkCUDA1DTransferFunctionInformationHandlerNarrowest( this->colourFunction, 5, minIntensity, maxIntensity );
+  narrowest = (narrowestColour < narrowest) ? narrowestColour : narrowest;
+  const double entrySpacing = (maxIntensity - minIntensity) / (VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_FUNCTION_SIZE - 1);
+  return narrowest < 4.0 * entrySpacing;
+}
+
 void vtkCUDA1DTransferFunctionInformationHandler
 ::SetColourTransferFunction(vtkColorTransferFunction* f)
 {
@@ -117,95 +413,385 @@ void vtkCUDA1DTransferFunctionInformationHandler
 void vtkCUDA1DTransferFunctionInformationHandler::UpdateTransferFunction()
 {
   //if we don't need to update the transfer function, don't
-  if(!this->colourFunction || !this->opacityFunction ||
-    (this->colourFunction->GetMTime() <= lastModifiedTime &&
-    this->opacityFunction->GetMTime() <= lastModifiedTime) )
+  unsigned long functionTime = 0;
+  if( this->colourFunction && this->opacityFunction )
+    {
+    functionTime = (this->colourFunction->GetMTime() > this->opacityFunction->GetMTime()) ?
+      this->colourFunction->GetMTime() : this->opacityFunction->GetMTime();
+    if( this->gradientopacityFunction && this->gradientopacityFunction->GetMTime() > functionTime )
+      {
+      functionTime = this->gradientopacityFunction->GetMTime();
+      }
+    }
+  if( functionTime == 0 || functionTime <= lastModifiedTime )
     {
     return;
     }
-  lastModifiedTime = (this->colourFunction->GetMTime() > this->opacityFunction->GetMTime()) ?
-    this->colourFunction->GetMTime() : this->opacityFunction->GetMTime();
+  lastModifiedTime = functionTime;
 
   //get the ranges from the transfer function
   double minIntensity; 
   double maxIntensity;
   this->opacityFunction->GetRange( minIntensity, maxIntensity );
-  minIntensity = (this->InputData->GetScalarRange()[0] > minIntensity ) ? this->InputData->GetScalarRange()[0] : minIntensity;
-  maxIntensity = (this->InputData->GetScalarRange()[1] < maxIntensity ) ? this->InputData->GetScalarRange()[1] : maxIntensity;
+  minIntensity = (this->InputRange[0] > minIntensity ) ? this->InputRange[0] : minIntensity;
+  maxIntensity = (this->InputRange[1] < maxIntensity ) ? this->InputRange[1] : maxIntensity;
 
   //get the gradient ranges from the transfer function
-  double minGradient; 
-  double maxGradient;
-  this->gradientopacityFunction->GetRange( minGradient, maxGradient );
+  double minGradient = 0.0;
+  double maxGradient = 1.0;
+  if( this->gradientopacityFunction )
+    {
+    this->gradientopacityFunction->GetRange( minGradient, maxGradient );
 
-  //figure out the multipliers for applying the transfer function in GPU
-  this->TransInfo.intensityLow = minIntensity;
-  this->TransInfo.intensityMultiplier = 1.0 / ( maxIntensity - minIntensity );
-  this->TransInfo.gradientLow = minGradient;
-  this->TransInfo.gradientMultiplier = 1.0 / ( maxGradient - minGradient );
-
-  //create local buffers to house the transfer function
-  float* LocalColorRedTransferFunction = new float[this->FunctionSize];
-  float* LocalColorGreenTransferFunction = new float[this->FunctionSize];
-  float* LocalColorBlueTransferFunction = new float[this->FunctionSize];
-  float* LocalColorWholeTransferFunction = new float[3*this->FunctionSize];
-  float* LocalAlphaTransferFunction = new float[this->FunctionSize];
-  float* LocalGAlphaTransferFunction = new float[this->FunctionSize];
-
-  memset( (void*) LocalColorRedTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalColorGreenTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalColorBlueTransferFunction, 0.0f, sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalColorWholeTransferFunction, 0.0f, 3*sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalAlphaTransferFunction, 1.0f, sizeof(float) * this->FunctionSize);
-  memset( (void*) LocalGAlphaTransferFunction, 1.0f, sizeof(float) * this->FunctionSize);
-
-  //populate the table
-  this->opacityFunction->GetTable( minIntensity, maxIntensity, this->FunctionSize,
-    LocalAlphaTransferFunction );
-  this->gradientopacityFunction->GetTable( minGradient, maxGradient, this->FunctionSize,
-    LocalGAlphaTransferFunction );
-  this->colourFunction->GetTable( minIntensity, maxIntensity, this->FunctionSize,
-    LocalColorWholeTransferFunction );
-  for( int i = 0; i < this->FunctionSize; i++ )
-    {
-    LocalColorRedTransferFunction[i] = LocalColorWholeTransferFunction[3*i];
-    LocalColorGreenTransferFunction[i] = LocalColorWholeTransferFunction[3*i+1];
-    LocalColorBlueTransferFunction[i] = LocalColorWholeTransferFunction[3*i+2];
-    }
-
-  //map the trasfer functions to textures for fast access
-  this->TransInfo.functionSize = this->FunctionSize;
+    //gradients beyond those of the input are never looked up, so the table only spans the gradients both cover
+    //(the lookup clamping to its ends anyway)
+    double low = (this->LowGradient > minGradient) ? this->LowGradient : minGradient;
+    double high = (this->HighGradient < maxGradient) ? this->HighGradient : maxGradient;
+    if( this->HighGradient > this->LowGradient && high > low )
+      {
+      minGradient = low;
+      maxGradient = high;
+      }
+    }
+
+  //integer data may get an entry per value, centred where the ray caster looks the value up, otherwise the default
+  //table is sampled over the range and interpolated between entries
+  double intensityLow = minIntensity;
+  double intensityMultiplier = 1.0 / ( maxIntensity - minIntensity );
+  this->FunctionSize = VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_FUNCTION_SIZE;
+  this->BakeRange[0] = minIntensity;
+  this->BakeRange[1] = maxIntensity;
+  double firstValue = 0.0;
+  int values = 0;
+  if( this->FitExactTable(minIntensity, maxIntensity, firstValue, values) )
+    {
+    intensityLow = firstValue - 0.5;
+    intensityMultiplier = 1.0 / values;
+    this->FunctionSize = values;
+    this->BakeRange[0] = firstValue;
+    this->BakeRange[1] = firstValue + values - 1;
+    }
+  this->BakeRange[2] = minGradient;
+  this->BakeRange[3] = maxGradient;
+
+  //the tables are determined by the control points, the ranges they are sampled over and the table settings, so a transfer
+  //function used lately (such as a preset switched back to) only has its tables swapped in
+  this->BuildCacheKey(intensityLow, intensityMultiplier);
+  const vtkTypeUInt64 hash = vtkCUDA1DTransferFunctionInformationHandlerHash( this->CacheKey );
+  this->UseCounter++;
+  for( int i = 0; i < VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE; i++ )
+    {
+    if( this->CachedValid[i] && this->CachedHash[i] == hash && this->CachedKey[i] == this->CacheKey )
+      {
+      this->CachedLastUse[i] = this->UseCounter;
+      if( i != this->FrontTables )
+        {
+        this->CachedHits[i]++;
+        this->FrontTables = i;
+        this->TransInfo = this->CachedTables[i];
+        }
+      return;
+      }
+    }
+
+  //otherwise rebake into the least recently used tables other than the front ones (which frames in flight may still read),
+  //preferring tables never switched back to so that dragging a control point does not flush the presets out
+  int victim = -1;
+  for( int i = 0; i < VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE; i++ )
+    {
+    if( i == this->FrontTables )
+      {
+      continue;
+      }
+    if( victim < 0 || (this->CachedHits[i] == 0 && this->CachedHits[victim] != 0) ||
+        ((this->CachedHits[i] == 0) == (this->CachedHits[victim] == 0) && this->CachedLastUse[i] < this->CachedLastUse[victim]) )
+      {
+      victim = i;
+      }
+    }
+  cuda1DTransferFunctionInformation& tables = this->CachedTables[victim];
 
+  //tables of another size are reallocated rather than rewritten in place
   this->ReserveGPU();
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(this->TransInfo,
-    LocalColorRedTransferFunction,
-    LocalColorGreenTransferFunction,
-    LocalColorBlueTransferFunction,
-    LocalAlphaTransferFunction,
-    LocalGAlphaTransferFunction,
-    this->GetStream() );
-
-  //clean up the garbage
-  delete LocalColorRedTransferFunction;
-  delete LocalColorGreenTransferFunction;
-  delete LocalColorBlueTransferFunction;
-  delete LocalColorWholeTransferFunction;
-  delete LocalAlphaTransferFunction;
-  delete LocalGAlphaTransferFunction;
+  if( tables.functionSize != (unsigned int) this->FunctionSize )
+    {
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_UnloadTextures( tables, this->GetStream() );
+    }
+  this->AllocateArenas( this->FunctionSize );
+
+  //figure out the multipliers for applying the transfer function in GPU
+  tables.intensityLow = intensityLow;
+  tables.intensityMultiplier = intensityMultiplier;
+  tables.gradientLow = minGradient;
+  tables.gradientMultiplier = 1.0 / ( maxGradient - minGradient );
+  tables.functionSize = this->FunctionSize;
+  tables.opacityRangeLevels = vtkCUDA1DTransferFunctionInformationHandlerLevels( this->FunctionSize );
+  tables.usePreIntegration = this->TransInfo.usePreIntegration;
+  tables.useGradientOpacity = this->useGradientOpacity ? 1 : 0;
+
+  //the intensity mapping may change even if the tables do not, so every bake has the bricks reclassified
+  tables.opacityVersion = ++vtkCUDA1DTransferFunctionInformationHandlerVersion;
+
+  //bake the tables in parallel, each thread sampling and packing a run of entries of every function
+  int threads = vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  const int chunks = this->FunctionSize / VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_MIN_BAKE_CHUNK;
+  threads = (chunks < threads) ? chunks : threads;
+  this->Threader->SetNumberOfThreads( (threads > 1) ? threads : 1 );
+  this->Threader->SetSingleMethod( vtkCUDA1DTransferFunctionInformationHandler::BakeTablesThread, this );
+  this->Threader->SingleMethodExecute();
+
+  //wait for the previous copies out of the upload arenas before rewriting them
+  if( this->UploadEvent ) cudaEventSynchronize( this->UploadEvent );
+  memcpy( this->UploadArena, this->BakeArena, 4 * sizeof(float) * this->FunctionSize );
+  memcpy( this->UploadArena + 4*this->FunctionSize, this->BakeArena + 8*this->FunctionSize, sizeof(float) * this->FunctionSize );
+
+  //level k of the sparse table holds the maximum opacity of the 2^k entries from each entry on (clamped at the end)
+  float* rangeMax = this->UploadArena + 5*this->FunctionSize;
+  memcpy( rangeMax, this->BakeArena + 7*this->FunctionSize, sizeof(float) * this->FunctionSize );
+  for( unsigned int level = 1; level < tables.opacityRangeLevels; level++ )
+    {
+    const float* finer = rangeMax + (level - 1) * this->FunctionSize;
+    float* coarser = rangeMax + level * this->FunctionSize;
+    const int half = 1 << (level - 1);
+    for( int i = 0; i < this->FunctionSize; i++ )
+      {
+      const float other = finer[ (i + half < this->FunctionSize) ? i + half : this->FunctionSize - 1 ];
+      coarser[i] = (finer[i] > other) ? finer[i] : other;
+      }
+    }
+
+  //copy the tables in place of the evicted ones through the copy stream, once the frames which last read them are done,
+  //the frames in flight reading the front tables meanwhile
+  if( this->CachedReleaseEvent[victim] ) cudaStreamWaitEvent( this->CopyStream, this->CachedReleaseEvent[victim], 0 );
+  bool uploaded = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadTextures(tables,
+    reinterpret_cast<float4*>(this->UploadArena),
+    this->UploadArena + 4*this->FunctionSize,
+    &this->CopyStream );
+  uploaded = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadOpacityRange(tables, rangeMax, &this->CopyStream ) && uploaded;
+  if( tables.usePreIntegration )
+    {
+    uploaded = this->UpdatePreIntegration(tables) && uploaded;
+    }
+  if( this->UploadEvent ) cudaEventRecord( this->UploadEvent, this->CopyStream );
+  if( !this->UploadArenaPinned || (tables.usePreIntegration && !this->PreIntegrationArenaPinned) )
+    {
+    //pageable copies may still read the arena when they return
+    cudaStreamSynchronize( this->CopyStream );
+    }
+
+  //swap the new tables in at the frame boundary
+  this->CachedKey[victim] = this->CacheKey;
+  this->CachedHash[victim] = hash;
+  this->CachedLastUse[victim] = this->UseCounter;
+  this->CachedHits[victim] = 0;
+  this->CachedValid[victim] = uploaded;
+  this->FrontTables = victim;
+  this->TransInfo = tables;
 }
 
-void vtkCUDA1DTransferFunctionInformationHandler::UseGradientOpacity(int u)
+void vtkCUDA1DTransferFunctionInformationHandler
+::BuildCacheKey(double intensityLow, double intensityMultiplier)
+{
+  this->CacheKey.clear();
+  this->CacheKey.insert( this->CacheKey.end(), this->BakeRange, this->BakeRange + 4 );
+  this->CacheKey.push_back( intensityLow );
+  this->CacheKey.push_back( intensityMultiplier );
+  this->CacheKey.push_back( this->FunctionSize );
+  this->CacheKey.push_back( this->TransInfo.usePreIntegration );
+  this->CacheKey.push_back( this->useGradientOpacity );
+
+  //the nodes of each function (position, value(s), midpoint and sharpness) preceded by their number and the settings they are interpolated with
+  double node[6];
+  this->CacheKey.push_back( this->opacityFunction->GetSize() );
+  this->CacheKey.push_back( this->opacityFunction->GetClamping() );
+  for( int i = 0; i < this->opacityFunction->GetSize(); i++ )
+    {
+    this->opacityFunction->GetNodeValue( i, node );
+    this->CacheKey.insert( this->CacheKey.end(), node, node + 4 );
+    }
+  this->CacheKey.push_back( this->colourFunction->GetSize() );
+  this->CacheKey.push_back( this->colourFunction->GetClamping() );
+  this->CacheKey.push_back( this->colourFunction->GetColorSpace() );
+  this->CacheKey.push_back( this->colourFunction->GetHSVWrap() );
+  this->CacheKey.push_back( this->colourFunction->GetScale() );
+  for( int i = 0; i < this->colourFunction->GetSize(); i++ )
+    {
+    this->colourFunction->GetNodeValue( i, node );
+    this->CacheKey.insert( this->CacheKey.end(), node, node + 6 );
+    }
+  if( this->gradientopacityFunction )
+    {
+    this->CacheKey.push_back( this->gradientopacityFunction->GetSize() );
+    this->CacheKey.push_back( this->gradientopacityFunction->GetClamping() );
+    for( int i = 0; i < this->gradientopacityFunction->GetSize(); i++ )
+      {
+      this->gradientopacityFunction->GetNodeValue( i, node );
+      this->CacheKey.insert( this->CacheKey.end(), node, node + 4 );
+      }
+    }
+}
+
+bool vtkCUDA1DTransferFunctionInformationHandler::UpdatePreIntegration(cuda1DTransferFunctionInformation& tables)
 {
-  this->useGradientOpacity = (u != 0);
+  const int size = this->FunctionSize;
+  const int tableSize = this->TransInfo.preIntegrationSize;
+  if( !this->PreIntegrationArena )
+    {
+    this->PreIntegrationArenaPinned = (cudaHostAlloc( (void**) &this->PreIntegrationArena, sizeof(float4)*tableSize*tableSize, cudaHostAllocPortable ) == cudaSuccess);
+    if( !this->PreIntegrationArenaPinned )
+      {
+      cudaGetLastError();
+      this->PreIntegrationArena = new float4[tableSize*tableSize];
+      }
+    }
+
+  //running trapezoid integrals of the extinction coefficient and of the colour weighted by it, per table entry
+  const float* colour = this->BakeArena + 4*size;
+  const float* opacity = this->BakeArena + 7*size;
+  float* integral = this->IntegralArena;
+  double sums[4] = { 0.0, 0.0, 0.0, 0.0 };
+  double previous[4] = { 0.0, 0.0, 0.0, 0.0 };
+  for( int i = 0; i < size; i++ )
+    {
+    double alpha = (opacity[i] < 0.9999f) ? opacity[i] : 0.9999;
+    double extinction = -log( 1.0 - ((alpha > 0.0) ? alpha : 0.0) );
+    double current[4] = { extinction, extinction*colour[3*i], extinction*colour[3*i+1], extinction*colour[3*i+2] };
+    for( int c = 0; c < 4; c++ )
+      {
+      if( i > 0 ) sums[c] += 0.5 * (previous[c] + current[c]);
+      previous[c] = current[c];
+      integral[4*i+c] = (float) sums[c];
+      }
+    }
+
+  this->Threader->SetNumberOfThreads( vtkMultiThreader::GetGlobalDefaultNumberOfThreads() );
+  this->Threader->SetSingleMethod( vtkCUDA1DTransferFunctionInformationHandler::BakePreIntegrationThread, this );
+  this->Threader->SingleMethodExecute();
+
+  return CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadPreIntegrationTexture(tables, this->PreIntegrationArena, &this->CopyStream );
 }
 
-void vtkCUDA1DTransferFunctionInformationHandler::Update()
+VTK_THREAD_RETURN_TYPE vtkCUDA1DTransferFunctionInformationHandler::BakePreIntegrationThread(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkCUDA1DTransferFunctionInformationHandler* self = static_cast<vtkCUDA1DTransferFunctionInformationHandler*>(threadInfo->UserData);
+  const int size = self->FunctionSize;
+  const int tableSize = self->TransInfo.preIntegrationSize;
+  const float* colour = self->BakeArena + 4*size;
+  const float* opacity = self->BakeArena + 7*size;
+  const float* integral = self->IntegralArena;
+  const float scale = (float) (size - 1) / (float) (tableSize - 1);
+
+  for( int front = threadInfo->ThreadID; front < tableSize; front += threadInfo->NumberOfThreads )
+    {
+    //position of the front intensity in the 1D tables, with the integrals interpolated there
+    float frontPosition = scale * front;
+    int frontIndex = (int) frontPosition;
+    frontIndex = (frontIndex < size - 1) ? frontIndex : size - 2;
+    float frontWeight = frontPosition - frontIndex;
+    float frontIntegral[4];
+    for( int c = 0; c < 4; c++ )
+      {
+      frontIntegral[c] = (1.0f - frontWeight) * integral[4*frontIndex+c] + frontWeight * integral[4*frontIndex+4+c];
+      }
+
+    float4* row = self->PreIntegrationArena + front * tableSize;
+    for( int back = 0; back < tableSize; back++ )
+      {
+      float backPosition = scale * back;
+      int backIndex = (int) backPosition;
+      backIndex = (backIndex < size - 1) ? backIndex : size - 2;
+      float backWeight = backPosition - backIndex;
+      float delta[4];
+      for( int c = 0; c < 4; c++ )
+        {
+        delta[c] = (1.0f - backWeight) * integral[4*backIndex+c] + backWeight * integral[4*backIndex+4+c] - frontIntegral[c];
+        }
+
+      //a segment of constant intensity (or without any extinction) takes the point sample at its centre
+      float length = fabs( backPosition - frontPosition );
+      if( length < 0.001f || fabs(delta[0]) < 1e-6f )
+        {
+        float centre = 0.5f * (frontPosition + backPosition);
+        int index = (int) centre;
+        index = (index < size - 1) ? index : size - 2;
+        float weight = centre - index;
+        row[back].x = (1.0f - weight) * colour[3*index]   + weight * colour[3*index+3];
+        row[back].y = (1.0f - weight) * colour[3*index+1] + weight * colour[3*index+4];
+        row[back].z = (1.0f - weight) * colour[3*index+2] + weight * colour[3*index+5];
+        row[back].w = (1.0f - weight) * opacity[index]    + weight * opacity[index+1];
+        continue;
+        }
+
+      //the segment is as opaque as its average extinction and coloured by the extinction weighted average colour
+      row[back].x = delta[1] / delta[0];
+      row[back].y = delta[2] / delta[0];
+      row[back].z = delta[3] / delta[0];
+      row[back].w = 1.0f - exp( -fabs(delta[0]) / length );
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+VTK_THREAD_RETURN_TYPE vtkCUDA1DTransferFunctionInformationHandler::BakeTablesThread(void* arg)
 {
-  if(this->InputData)
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkCUDA1DTransferFunctionInformationHandler* self = static_cast<vtkCUDA1DTransferFunctionInformationHandler*>(threadInfo->UserData);
+  const int size = self->FunctionSize;
+  float4* packed = reinterpret_cast<float4*>(self->BakeArena);
+  float* colour = self->BakeArena + 4*size;
+  float* opacity = self->BakeArena + 7*size;
+  float* gradientOpacity = self->BakeArena + 8*size;
+
+  //this thread's run of entries, sampled where a table baked as a whole samples them (the functions only being read)
+  const int first = size * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  const int last = size * (threadInfo->ThreadID + 1) / threadInfo->NumberOfThreads;
+  if( last <= first )
+    {
+    return VTK_THREAD_RETURN_VALUE;
+    }
+  const double intensityStep = (self->BakeRange[1] - self->BakeRange[0]) / (size - 1);
+  const double gradientStep = (self->BakeRange[3] - self->BakeRange[2]) / (size - 1);
+  self->opacityFunction->GetTable( self->BakeRange[0] + first * intensityStep, self->BakeRange[0] + (last - 1) * intensityStep,
+                                   last - first, opacity + first );
+  self->colourFunction->GetTable( self->BakeRange[0] + first * intensityStep, self->BakeRange[0] + (last - 1) * intensityStep,
+                                  last - first, colour + 3*first );
+  if( self->gradientopacityFunction )
+    {
+    self->gradientopacityFunction->GetTable( self->BakeRange[2] + first * gradientStep, self->BakeRange[2] + (last - 1) * gradientStep,
+                                             last - first, gradientOpacity + first );
+    }
+  else
+    {
+    for( int i = first; i < last; i++ )
+      {
+      gradientOpacity[i] = 1.0f;
+      }
+    }
+
+  //pack the colour and opacity so the ray caster fetches both at once
+  for( int i = first; i < last; i++ )
     {
-    this->InputData->Update();
+    packed[i].x = colour[3*i];
+    packed[i].y = colour[3*i+1];
+    packed[i].z = colour[3*i+2];
+    packed[i].w = opacity[i];
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler::UseGradientOpacity(int u)
+{
+  if( (u != 0) != this->useGradientOpacity )
+    {
+    this->useGradientOpacity = (u != 0);
+    this->lastModifiedTime = 0;
     this->Modified();
     }
+}
+
+void vtkCUDA1DTransferFunctionInformationHandler::Update()
+{
   if(this->colourFunction && this->opacityFunction)
     {
     this->UpdateTransferFunction();
@@ -15,11 +15,18 @@
 #include "vtkCUDAObject.h"
 
 // VTK includes
+#include <vtkMultiThreader.h>
 #include <vtkObject.h>
 class vtkColorTransferFunction;
 class vtkImageData;
 class vtkPiecewiseFunction;
 
+// STD includes
+#include <vector>
+
+//number of transfer functions whose tables are kept on the device
+#define VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE 4
+
 /** @brief vtkCUDA1DTransferFunctionInformationHandler handles all volume and transfer function related information on behalf of the CUDA volume mapper to facilitate the rendering process
 *
 */
@@ -57,9 +64,21 @@ public:
 
   /** @brief Gets the CUDA compatible container for volume/transfer function related information needed during the rendering process
   *
+  *  @note This is the front buffer, holding the tables of the last update until the next update swaps in other cached tables, so it belongs to this handler alone and needs no lock
   */
   const cuda1DTransferFunctionInformation& GetTransferFunctionInfo() const { return (this->TransInfo); }
 
+  /** @brief Makes the work queued on a stream from now on wait until the front tables are on the device
+  *
+  *  @note The tables are copied through a stream of the handler's own, so an edit neither waits for the frames in flight nor holds them up
+  */
+  void AcquireTables(cudaStream_t* stream);
+
+  /** @brief Marks the front tables as read by the work queued on a stream so far, so that they are not rewritten before it has finished
+  *
+  */
+  void ReleaseTables(cudaStream_t* stream);
+
   /** @brief Set the transfer function used for determining colour in the volume rendering process
   *
   *  @param func The 1 dimensional transfer function (from vtkVolumeProperty)
@@ -84,8 +103,51 @@ public:
   */
   void SetGradientOpacityTransferFunction(vtkPiecewiseFunction* func);
 
+  /** @brief Sets whether the gradient opacity function is applied, as given by the volume property
+  *
+  *  @note This also resets the lastModifiedTime if the setting changed, the tables being baked anew so the classified volume follows it
+  */
   void UseGradientOpacity( int u );
 
+  /** @brief Sets the scalar range of the input, as gathered by the mapper when uploading it
+  *
+  *  @note This also resets the lastModifiedTime if the range changed, forcing the lookup tables to be rebuilt on the next render
+  */
+  void SetInputRange(const double range[2]);
+
+  /** @brief Sets the range of the gradient magnitudes of the input, gathered by the mapper after uploading it
+  *
+  *  @note The gradient opacity table only spans the part of the range of its function the input reaches, an empty range (as for a live stream) leaving the whole range of the function
+  */
+  void SetInputGradientRange(const double range[2]);
+
+  /** @brief Sets whether the ray caster composites ray segments from a pre-integrated table rather than point samples
+  *
+  *  @note Pre-integration keeps larger sample distances free of the slab artefacts of sharp transfer functions, at the cost of baking a 2D table whenever the transfer function changes
+  */
+  void SetPreIntegration(bool preIntegrate);
+  bool GetPreIntegration() const { return this->TransInfo.usePreIntegration != 0; }
+
+  /** @brief Sets whether integer data of at most 16 bits may be classified through exact tables, holding an entry per value in the range rather than interpolating the default 512 entries
+  *
+  *  @note A range of at most 512 values always gets an exact (and smaller) table, whereas a wider range (up to 65536 values) only gets one if a feature of the transfer function is narrower than four entries of the default table
+  *  @note Volumes uploaded in half precision are only exact for values up to 2048 in magnitude
+  */
+  void SetExactTables(bool exact);
+  bool GetExactTables() const { return this->ExactTables; }
+
+  /** @brief Gets the size of the exact table of a range of integer values, with an entry per value from firstValue on
+  *
+  *  @param scalarType The VTK scalar type of the input, only integer types of at most 16 bits having exact tables
+  *  @param minIntensity The lower end of the range, rounded up to the first value
+  *  @param maxIntensity The upper end of the range, rounded down to the last value
+  *  @param firstValue Set to the value of the first entry
+  *  @param values Set to the number of entries
+  *
+  *  @return false if the type has no exact tables, or the range holds fewer than 2 or more than 65536 values
+  */
+  static bool ComputeExactTableSize(int scalarType, double minIntensity, double maxIntensity, double& firstValue, int& values);
+
   /** @brief Triggers an update for the volume information, checking all subsidary information for modifications
   *
   */
@@ -105,9 +167,44 @@ protected:
 
   /** @brief Update attributes associated with the transfer function after comparing MTimes and determining if the lookup tables have changed since last update
   *
+  *  @note The tables of the last few transfer functions stay on the device, keyed by their control points and ranges, so switching back to one only swaps its tables in
+  *  @note Otherwise the tables are baked in parallel into persistent host buffers and copied asynchronously over the least recently used cached tables
   */
   void UpdateTransferFunction();
 
+  /** @brief Fills the cache key with the ranges, table settings and control points of the functions, which determine the baked tables
+  *
+  */
+  void BuildCacheKey(double intensityLow, double intensityMultiplier);
+
+  /** @brief Determines whether the intensity range gets an exact table, with an entry per integer value from firstValue on
+  *
+  */
+  bool FitExactTable(double minIntensity, double maxIntensity, double& firstValue, int& values);
+
+  /** @brief Grows the host buffers of the tables to hold tables of the given size
+  *
+  */
+  void AllocateArenas(int functionSize);
+
+  /** @brief Entry point of the threads baking the opacity, colour and gradient opacity tables, each thread baking and packing a contiguous run of entries
+  *
+  */
+  static VTK_THREAD_RETURN_TYPE BakeTablesThread( void* arg );
+
+  /** @brief Bakes the pre-integrated table from the colour and opacity tables and copies it to the device
+  *
+  *  @param tables The cached tables receiving the pre-integrated table
+  *
+  *  @pre The colour and opacity tables in the bake arena are up to date, and the previous copy out of the upload arenas has finished
+  */
+  bool UpdatePreIntegration(cuda1DTransferFunctionInformation& tables);
+
+  /** @brief Entry point of the threads baking the pre-integrated table, each thread baking every n-th row (front intensity)
+  *
+  */
+  static VTK_THREAD_RETURN_TYPE BakePreIntegrationThread( void* arg );
+
   void Deinitialize(int withData = 0);
   void Reinitialize(int withData = 0);
 
@@ -118,17 +215,42 @@ private:
 private:
 
   vtkImageData*            InputData;    /**< The 3D image data currently being renderered */
-  cuda1DTransferFunctionInformation  TransInfo;    /**< The CUDA specific structure holding the required volume related information for rendering */
+  cuda1DTransferFunctionInformation  TransInfo;    /**< The CUDA specific structure holding the required volume related information for rendering (a copy of the front cached tables) */
+
+  cuda1DTransferFunctionInformation CachedTables[VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE]; /**< Device tables of the most recently used transfer functions */
+  std::vector<double> CachedKey[VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE]; /**< The key each set of cached tables was baked from */
+  vtkTypeUInt64   CachedHash[VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE];     /**< Hash of each key, compared before the keys themselves */
+  unsigned long   CachedLastUse[VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE];  /**< The update each set of tables was last used by */
+  unsigned int    CachedHits[VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE];     /**< How often each set of tables was switched back to, tables never switched back to being evicted first */
+  bool            CachedValid[VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE];    /**< Whether each set of tables was uploaded successfully */
+  cudaEvent_t     CachedReleaseEvent[VTKCUDA1DTRANSFERFUNCTIONINFORMATIONHANDLER_CACHE_SIZE]; /**< Recorded after the last work reading each set of tables */
+  int             FrontTables;    /**< The cached tables the ray caster reads */
+  unsigned long   UseCounter;     /**< Counts the updates, to find the least recently used tables */
+  std::vector<double> CacheKey;   /**< The key of the current transfer function */
 
   vtkPiecewiseFunction*        opacityFunction;
   vtkPiecewiseFunction*        gradientopacityFunction;
   vtkColorTransferFunction*      colourFunction;
   bool                useGradientOpacity;
 
+  double          InputRange[2];  /**< The scalar range of the input, so it is never scanned while rendering */
+
+  vtkMultiThreader*  Threader;    /**< The threads baking the tables */
+  float*          BakeArena;      /**< Persistent host buffer the tables are baked into: packed RGBA, colour, opacity then gradient opacity */
+  int             ArenaSize;      /**< The largest table size the arenas hold */
+  float*          UploadArena;    /**< Persistent (preferably pinned) copy of the tables on the device, which the copies read from */
+  bool            UploadArenaPinned; /**< Whether the upload arena is pinned */
+  cudaEvent_t     UploadEvent;    /**< Recorded after the last copy out of the upload arena */
+  cudaStream_t    CopyStream;     /**< The stream the tables are copied through, apart from the rendering */
+  double          BakeRange[4];   /**< The intensity and gradient ranges the baking threads sample */
+  float*          IntegralArena;  /**< Running integrals of the extinction and extinction weighted colour over the 1D tables */
+  float4*         PreIntegrationArena; /**< Persistent (preferably pinned) host copy of the pre-integrated table, allocated when first used */
+  bool            PreIntegrationArenaPinned; /**< Whether the pre-integration arena is pinned */
   unsigned long lastModifiedTime;      /**< The last time the transfer function was modified, used to determine when to repopulate the transfer function lookup tables */
-  int            FunctionSize;  /**< The size of the transfer function which is square */
-  double          HighGradient;  /**< The maximum gradient of the current image */
-  double          LowGradient;  /**< The minimum gradient of the current image */
+  int            FunctionSize;  /**< The size of the last baked tables */
+  bool            ExactTables;   /**< Whether integer data may get a table entry per value */
+  double          HighGradient;  /**< The maximum gradient magnitude of the current image */
+  double          LowGradient;  /**< The minimum gradient magnitude of the current image */
 
 };
 
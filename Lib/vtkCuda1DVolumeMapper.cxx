@@ -9,11 +9,13 @@
 
 // Type
 #include "vtkCUDA1DVolumeMapper.h"
+#include "vtkCUDAVolumeCache.h"
 #include "vtkCUDAVolumeInformationHandler.h"
 #include "vtkCUDA1DTransferFunctionInformationHandler.h"
 
 // CUDA Volume Rendering includes
 #include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
+#include "cuda_runtime_api.h"
 
 // Volume
 #include <vtkVolume.h>
@@ -22,21 +24,33 @@
 // Rendering
 #include <vtkCamera.h>
 #include <vtkColorTransferFunction.h>
-#include <vtkMutexLock.h>
 #include <vtkObjectFactory.h>
 #include <vtkPiecewiseFunction.h>
 #include <vtkRenderer.h>
 #include <vtkVolume.h>
 #include <vtkVolumeProperty.h>
 
+// STD includes
+#include <cstring>
+#include <vector>
+
+// Sections of the volume cache holding the levels of the mip pyramid
+#define VTKCUDA1DVOLUMEMAPPER_CACHE_INFO          VTKCUDAVOLUMECACHE_TAG('I','N','F','O')
+#define VTKCUDA1DVOLUMEMAPPER_CACHE_LEVEL(level)  VTKCUDAVOLUMECACHE_TAG('L','V','L','0'+(level))
+#define VTKCUDA1DVOLUMEMAPPER_CACHE_MINMAX(level) VTKCUDAVOLUMECACHE_TAG('M','M','X','0'+(level))
+
+// Size of the host buffer the levels are copied through when stored in the volume cache
+#define VTKCUDA1DVOLUMEMAPPER_CACHE_SLAB_BYTES (16 << 20)
+
 vtkStandardNewMacro(vtkCUDA1DVolumeMapper);
 
-vtkMutexLock* vtkCUDA1DVolumeMapper::tfLock = 0;
 vtkCUDA1DVolumeMapper::vtkCUDA1DVolumeMapper()
   {
-  if( !vtkCUDA1DVolumeMapper::tfLock ) vtkCUDA1DVolumeMapper::tfLock = vtkMutexLock::New();
-  else tfLock->Register( this );
   this->transferFunctionInfoHandler = vtkCUDA1DTransferFunctionInformationHandler::New();
+  this->PreClassification = false;
+  this->PreClassificationDelay = 10;
+  this->StableRenders = 0;
+  this->StableVersion = 0;
   this->Reinitialize();
   }
 
@@ -44,7 +58,7 @@ void vtkCUDA1DVolumeMapper::Deinitialize(int withData)
   {
   this->vtkCUDAVolumeMapper::Deinitialize(withData);
   this->ReserveGPU();
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(this->GetStream());
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(this->VolumeData, this->GetStream());
   }
 
 void vtkCUDA1DVolumeMapper::Reinitialize(int withData)
@@ -52,117 +66,309 @@ void vtkCUDA1DVolumeMapper::Reinitialize(int withData)
   this->vtkCUDAVolumeMapper::Reinitialize(withData);
   this->transferFunctionInfoHandler->ReplicateObject(this, withData);
   this->ReserveGPU();
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(this->GetStream());
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(0, this->GetStream());
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_initImageArray(this->VolumeData, this->GetStream());
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(this->VolumeData, 0, this->GetStream());
   }
 
 vtkCUDA1DVolumeMapper::~vtkCUDA1DVolumeMapper()
   {
   this->Deinitialize();
-  int tfLockReferenceCount = tfLock->GetReferenceCount() - 1;
-  tfLock->UnRegister( this );
-  if (tfLockReferenceCount == 0)
-    {
-    tfLock = 0;
-    }
   this->transferFunctionInfoHandler->UnRegister( this );
   }
 
 void vtkCUDA1DVolumeMapper::SetInputInternal(vtkImageData * input, int index)
   {
 
-  //convert data to float
-  const cudaVolumeInformation& VolumeInfo = this->VolumeInfoHandler->GetVolumeInfo();
-  float* buffer = new float[VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z];
-  if(input->GetScalarType() == VTK_CHAR)
+  //the data is uploaded at the finest level, which the sizes of the volume information have to match until the coarser levels are rebuilt
+  if( this->VolumeInfoHandler->GetLevelOfDetail() != 0 )
     {
-    char* tempPtr = (char*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    this->VolumeInfoHandler->SetNumberOfLevelsOfDetail(1);
+    this->volModified = 0;
     }
-  else if(input->GetScalarType() == VTK_UNSIGNED_CHAR)
+
+  //allocate the uploaded sub-extent of the data on the GPU, downsampled or in half precision if it would not fit
+  if(!this->erroredOut)
     {
-    unsigned char* tempPtr = (unsigned char*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    this->ChooseUploadFormat(input);
+    this->ReserveGPU();
+    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_allocateImage( this->VolumeData, VolumeInfoHandler->GetVolumeInfo(),
+      this->GetUploadHalfPrecision(), this->GetStream());
     }
-  else if(input->GetScalarType() == VTK_SIGNED_CHAR)
+
+  //reuse the converted data and mip pyramid from the cache if this sub-extent was seen before,
+  //the cache only holding float volumes
+  vtkTypeUInt64 key = 0;
+  int numLevels = 0;
+  bool useCache = this->GetCacheDirectory() && !this->IsLiveInput(input) && !this->GetUploadHalfPrecision();
+  if(!this->erroredOut && useCache)
     {
-    signed char* tempPtr = (signed char*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    key = this->ComputeCacheKey(input);
+    numLevels = this->LoadFromCache(key);
     }
-  else if(input->GetScalarType() == VTK_INT)
+
+  if(!this->erroredOut && numLevels == 0)
     {
-    int* tempPtr = (int*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    //stream the data to the GPU, converting it to float a slab at a time
+    this->erroredOut = !this->StreamInput(input);
+
+    //build the mip pyramid on the device so coarser levels can be sampled when the full resolution is wasted,
+    //which a live volume does without as its slices keep changing
+    if(!this->erroredOut && this->IsLiveInput(input))
+      {
+      numLevels = 1;
+      }
+    else if(!this->erroredOut)
+      {
+      if( !this->InputGradientStatisticsValid ) this->GatherGradientStatistics();
+      numLevels = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_buildPyramid( this->VolumeData, VolumeInfoHandler->GetVolumeInfo(),
+        this->GetMaximumNumberOfLevels(), this->GetStream());
+      if( useCache ) this->StoreInCache(key, numLevels);
+      }
     }
-  else if(input->GetScalarType() == VTK_UNSIGNED_INT)
+  else if(!this->erroredOut && !this->InputGradientStatisticsValid)
     {
-    unsigned int* tempPtr = (unsigned int*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    //a cache file predating the gradient statistics
+    this->GatherGradientStatistics();
     }
-  else if(input->GetScalarType() == VTK_SHORT)
+
+  //find the intensity range of each brick so the ray caster can jump over transparent ones,
+  //which a live volume does without as its slices keep changing (and which is only an optimization, so failing is fine)
+  if(!this->erroredOut && !this->IsLiveInput(input))
     {
-    short* tempPtr = (short*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    const int* dims = this->VolumeInfoHandler->GetDimensions();
+    int3 volumeSize;
+    volumeSize.x = dims[0];
+    volumeSize.y = dims[1];
+    volumeSize.z = dims[2];
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_buildBricks(this->VolumeData, volumeSize, this->GetStream());
     }
-  else if(input->GetScalarType() == VTK_UNSIGNED_SHORT)
+
+  if(!this->erroredOut)
     {
-    unsigned short* tempPtr = (unsigned short*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    this->VolumeInfoHandler->SetNumberOfLevelsOfDetail(numLevels);
+    this->ChangeLevelInternal(this->VolumeInfoHandler->GetLevelOfDetail());
     }
-  else if(input->GetScalarType() == VTK_LONG)
+
+  //inform transfer function handler of the data and of the range gathered while uploading it
+  this->transferFunctionInfoHandler->SetInputRange(this->GetInputScalarRange());
+  this->transferFunctionInfoHandler->SetInputGradientRange(this->GetInputGradientRange());
+  this->transferFunctionInfoHandler->SetInputData(input,index);
+  }
+
+void vtkCUDA1DVolumeMapper::GatherGradientStatistics()
+  {
+  //the statistics only narrow the gradient lookup, so failing to gather them is fine
+  float range[2];
+  unsigned int histogram[CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS];
+  this->ReserveGPU();
+  if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_gradientStatistics( this->VolumeData, this->VolumeInfoHandler->GetVolumeInfo(), range, histogram, this->GetStream() ) )
     {
-    long* tempPtr = (long*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    return;
     }
-  else if(input->GetScalarType() == VTK_UNSIGNED_LONG)
+  this->InputGradientRange[0] = range[0];
+  this->InputGradientRange[1] = range[1];
+  memset( this->InputGradientHistogram, 0, sizeof(this->InputGradientHistogram) );
+  for( int bin = 0; bin < CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS; bin++ )
     {
-    unsigned long* tempPtr = (unsigned long*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    this->InputGradientHistogram[ bin * VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS / CUDA_VTKCUDA1DVOLUMEMAPPER_GRADIENT_BINS ] += histogram[bin];
     }
-  else if(input->GetScalarType() == VTK_FLOAT)
+  this->InputGradientStatisticsValid = true;
+  }
+
+int vtkCUDA1DVolumeMapper::LoadFromCache(vtkTypeUInt64 key)
+  {
+  if( !this->Cache->Open(key) ) return 0;
+
+  //a file without the statistics of the input is of no use, as they would need a pass over the input anyway
+  if( !this->LoadStatisticsFromCache(this->VolumeInfoHandler->GetInputData()) )
     {
-    delete buffer;
-    buffer = (float*) input->GetScalarPointer();
+    this->Cache->Close();
+    return 0;
     }
-  else if(input->GetScalarType() == VTK_DOUBLE)
+
+  vtkTypeUInt64 size = 0;
+  const int* info = static_cast<const int*>( this->Cache->GetSection(VTKCUDA1DVOLUMEMAPPER_CACHE_INFO, &size) );
+  int numLevels = (info && size == sizeof(int)) ? info[0] : 0;
+  const int maxLevels = this->GetMaximumNumberOfLevels();
+  numLevels = (numLevels < maxLevels) ? numLevels : maxLevels;
+
+  //load the levels from the finest, stopping at the first one that is missing or does not fit on the device
+  const int* dims = this->VolumeInfoHandler->GetDimensions();
+  int3 levelSize;
+  levelSize.x = dims[0];
+  levelSize.y = dims[1];
+  levelSize.z = dims[2];
+  int loaded = 0;
+  for( ; loaded < numLevels; loaded++ )
     {
-    double* tempPtr = (double*) input->GetScalarPointer();
-    for(int i = 0; i < VolumeInfo.VolumeSize.x*VolumeInfo.VolumeSize.y*VolumeInfo.VolumeSize.z; i++)
-      buffer[i] = (float)(tempPtr[i]);
+    vtkTypeUInt64 numVoxels = (vtkTypeUInt64) levelSize.x * levelSize.y * levelSize.z;
+    const void* average = this->Cache->GetSection(VTKCUDA1DVOLUMEMAPPER_CACHE_LEVEL(loaded), &size);
+    if( !average || size != numVoxels * sizeof(float) ) break;
+    if( loaded == 0 )
+      {
+      if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageSlab( this->VolumeData, static_cast<const float*>(average), 0, levelSize.z,
+            this->VolumeInfoHandler->GetVolumeInfo(), this->GetStream()) ) break;
+      }
+    else
+      {
+      const void* minMax = this->Cache->GetSection(VTKCUDA1DVOLUMEMAPPER_CACHE_MINMAX(loaded), &size);
+      if( !minMax || size != numVoxels * sizeof(float2) ) break;
+      if( !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadLevel( this->VolumeData, loaded, levelSize, static_cast<const float*>(average),
+            static_cast<const float2*>(minMax), this->GetStream()) ) break;
+      }
+    levelSize.x = (levelSize.x + 1) / 2;
+    levelSize.y = (levelSize.y + 1) / 2;
+    levelSize.z = (levelSize.z + 1) / 2;
+    }
+
+  //the mapping has to outlive the copies out of it
+  cudaStreamSynchronize( *(this->GetStream()) );
+  this->Cache->Close();
+  return loaded;
+  }
+
+void vtkCUDA1DVolumeMapper::StoreInCache(vtkTypeUInt64 key, int numLevels)
+  {
+  if( numLevels < 1 || !this->Cache->BeginWrite(key) ) return;
+
+  bool written = this->Cache->BeginSection(VTKCUDA1DVOLUMEMAPPER_CACHE_INFO) &&
+                 this->Cache->AppendToSection(&numLevels, sizeof(int)) &&
+                 this->StoreStatisticsInCache();
+
+  //copy each level back a slab at a time, so storing never needs a host copy of the whole volume
+  const int* dims = this->VolumeInfoHandler->GetDimensions();
+  int3 levelSize;
+  levelSize.x = dims[0];
+  levelSize.y = dims[1];
+  levelSize.z = dims[2];
+  std::vector<float> average;
+  std::vector<float2> minMax;
+  for( int level = 0; written && level < numLevels; level++ )
+    {
+    size_t sliceVoxels = (size_t) levelSize.x * levelSize.y;
+    int slabSlices = (int) (VTKCUDA1DVOLUMEMAPPER_CACHE_SLAB_BYTES / (sliceVoxels * sizeof(float2)));
+    slabSlices = (slabSlices < 1) ? 1 : (slabSlices > levelSize.z) ? levelSize.z : slabSlices;
+    average.resize(sliceVoxels * slabSlices);
+    minMax.resize(level ? sliceVoxels * slabSlices : 0);
+
+    //the averages and min/max of a level are separate sections, so each is copied back in turn
+    for( int pass = 0; written && pass < (level ? 2 : 1); pass++ )
+      {
+      written = this->Cache->BeginSection( pass ? VTKCUDA1DVOLUMEMAPPER_CACHE_MINMAX(level) : VTKCUDA1DVOLUMEMAPPER_CACHE_LEVEL(level) );
+      for( int firstSlice = 0; written && firstSlice < levelSize.z; firstSlice += slabSlices )
+        {
+        int numSlices = (levelSize.z - firstSlice < slabSlices) ? levelSize.z - firstSlice : slabSlices;
+        this->ReserveGPU();
+        written = CUDA_vtkCUDA1DVolumeMapper_renderAlgo_getLevelSlab( this->VolumeData, level, levelSize, firstSlice, numSlices,
+          &(average[0]), pass ? &(minMax[0]) : 0, this->GetStream() );
+        written = written && ( pass ? this->Cache->AppendToSection( &(minMax[0]), sizeof(float2) * sliceVoxels * numSlices ) :
+                                      this->Cache->AppendToSection( &(average[0]), sizeof(float) * sliceVoxels * numSlices ) );
+        }
+      }
+
+    levelSize.x = (levelSize.x + 1) / 2;
+    levelSize.y = (levelSize.y + 1) / 2;
+    levelSize.z = (levelSize.z + 1) / 2;
+    }
+
+  //a failed write leaves any previous file in place, and the rendering unaffected
+  if( written )
+    {
+    this->Cache->EndWrite();
     }
   else
     {
-    vtkErrorMacro(<<"Input cannot be of that type.");
-    return;
+    this->Cache->AbortWrite();
+    vtkWarningMacro(<<"Could not store the input in the volume cache.");
     }
+  }
 
-  //load data onto the GPU and clean up the CPU
+vtkTypeUInt64 vtkCUDA1DVolumeMapper::GetDeviceBytesInternal(const int dims[3], int voxelSize, bool live)
+  {
+  //the bricks of a volume hold its intensity range and the occupancy of each slot, a live volume doing without them
+  vtkTypeUInt64 bytes = this->vtkCUDAVolumeMapper::GetDeviceBytesInternal(dims, voxelSize, live);
+  if( !live )
+    {
+    vtkTypeUInt64 numBricks = 1;
+    for( int i = 0; i < 3; i++ )
+      {
+      numBricks *= (dims[i] + CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1) / CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE;
+      }
+    bytes += numBricks * (sizeof(float2) + CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS);
+    }
+  return bytes;
+  }
+
+vtkTypeUInt64 vtkCUDA1DVolumeMapper::GetClassifiedBytes()
+  {
+  const int* dims = this->VolumeInfoHandler->GetDimensions();
+  return (vtkTypeUInt64) dims[0] * dims[1] * dims[2] * sizeof(uchar4);
+  }
+
+bool vtkCUDA1DVolumeMapper::UploadSlabInternal(void* slab, int firstSlice, int numSlices, int vtkNotUsed(channel))
+  {
+  return CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageSlab( this->VolumeData, slab, firstSlice, numSlices,
+    this->VolumeInfoHandler->GetVolumeInfo(), this->GetStream());
+  }
+
+void vtkCUDA1DVolumeMapper::ChangeFrameInternal(unsigned int frame){
   if(!this->erroredOut)
     {
     this->ReserveGPU();
-    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_loadImageInfo( buffer, VolumeInfoHandler->GetVolumeInfo(), this->GetStream());
+    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(this->VolumeData, frame, this->GetStream());
     }
-  if(input->GetScalarType() != VTK_FLOAT) delete buffer;
 
-  //inform transfer function handler of the data
-  this->transferFunctionInfoHandler->SetInputData(input,index);
+  //keep sampling the level of detail the volume information describes
+  if( this->VolumeInfoHandler->GetLevelOfDetail() > 0 )
+    {
+    this->ChangeLevelInternal(this->VolumeInfoHandler->GetLevelOfDetail());
+    }
   }
 
-void vtkCUDA1DVolumeMapper::ChangeFrameInternal(unsigned int frame){
+void vtkCUDA1DVolumeMapper::ChangeLevelInternal(unsigned int level){
   if(!this->erroredOut)
     {
     this->ReserveGPU();
-    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeFrame(frame, this->GetStream());
+    this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_changeLevel(this->VolumeData, level, this->GetStream());
+    }
+  }
+
+void vtkCUDA1DVolumeMapper::SetPreIntegration(bool preIntegrate)
+  {
+  this->transferFunctionInfoHandler->SetPreIntegration(preIntegrate);
+  this->Modified();
+  }
+
+bool vtkCUDA1DVolumeMapper::GetPreIntegration()
+  {
+  return this->transferFunctionInfoHandler->GetPreIntegration();
+  }
+
+void vtkCUDA1DVolumeMapper::SetExactTables(bool exact)
+  {
+  this->transferFunctionInfoHandler->SetExactTables(exact);
+  this->Modified();
+  }
+
+bool vtkCUDA1DVolumeMapper::GetExactTables()
+  {
+  return this->transferFunctionInfoHandler->GetExactTables();
+  }
+
+void vtkCUDA1DVolumeMapper::SetPreClassification(bool preClassify)
+  {
+  if( preClassify == this->PreClassification ) return;
+  this->PreClassification = preClassify;
+  if( !preClassify )
+    {
+    this->ReserveGPU();
+    if( this->VolumeData.classifiedArray )
+      {
+      this->UploadedBytes -= this->GetClassifiedBytes();
+      }
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearPreClassification(this->VolumeData, this->GetStream());
     }
+  this->Modified();
   }
 
 void vtkCUDA1DVolumeMapper::InternalRender (  vtkRenderer* vtkNotUsed(ren), vtkVolume* vol,
@@ -177,12 +383,43 @@ void vtkCUDA1DVolumeMapper::InternalRender (  vtkRenderer* vtkNotUsed(ren), vtkV
   this->transferFunctionInfoHandler->UseGradientOpacity( !vol->GetProperty()->GetDisableGradientOpacity() );
   this->transferFunctionInfoHandler->Update();
 
-  //perform the render
-  this->tfLock->Lock();
+  //classify the volume once the transfer function has been stable for long enough, which a live volume does without as its slices keep changing
+  const cuda1DTransferFunctionInformation& transInfo = this->transferFunctionInfoHandler->GetTransferFunctionInfo();
+  this->ReserveGPU();
+  this->transferFunctionInfoHandler->AcquireTables( this->GetStream() );
+  if( transInfo.opacityVersion != this->StableVersion )
+    {
+    this->StableVersion = transInfo.opacityVersion;
+    this->StableRenders = 0;
+    }
+  else if( this->StableRenders < this->PreClassificationDelay )
+    {
+    this->StableRenders++;
+    }
+  if( this->PreClassification && this->StableRenders >= this->PreClassificationDelay &&
+      this->VolumeData.classifiedVersion != transInfo.opacityVersion &&
+      this->VolumeInfoHandler->GetInputData() && !this->IsLiveInput(this->VolumeInfoHandler->GetInputData()) )
+    {
+    //the classified volume is only allocated if it fits in what the budget leaves, counting against it from then on
+    const bool allocated = (this->VolumeData.classifiedArray != 0);
+    const vtkTypeUInt64 available = allocated ? 0 : this->GetDeviceBytesAvailable();
+    this->ReserveGPU();
+    CUDA_vtkCUDA1DVolumeMapper_renderAlgo_preClassify(this->VolumeData, volumeInfo, transInfo, (size_t) available, this->GetStream());
+    if( !allocated && this->VolumeData.classifiedArray )
+      {
+      this->UploadedBytes += this->GetClassifiedBytes();
+      }
+    else if( allocated && !this->VolumeData.classifiedArray )
+      {
+      this->UploadedBytes -= this->GetClassifiedBytes();
+      }
+    }
+
+  //perform the render, the transfer function, volume and constants being handed to the kernels as this mapper's own
   this->ReserveGPU();
-  this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(outputInfo, rendererInfo, volumeInfo,
+  this->erroredOut = !CUDA_vtkCUDA1DVolumeMapper_renderAlgo_doRender(this->VolumeData, outputInfo, rendererInfo, volumeInfo,
 								     this->transferFunctionInfoHandler->GetTransferFunctionInfo(), this->GetStream());
-  this->tfLock->Unlock();
+  this->transferFunctionInfoHandler->ReleaseTables( this->GetStream() );
 
 }
 
@@ -190,5 +427,5 @@ void vtkCUDA1DVolumeMapper::ClearInputInternal()
   {
   this->ReserveGPU();
 
-  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(this->GetStream());
+  CUDA_vtkCUDA1DVolumeMapper_renderAlgo_clearImageArray(this->VolumeData, this->GetStream());
   }
@@ -11,11 +11,9 @@
 #define __vtkCUDA1DVolumeMapper_h
 
 #include "vtkCUDAVolumeMapper.h"
+#include "CUDA_container1DVolumeInformation.h"
 class vtkCUDA1DTransferFunctionInformationHandler;
 
-// VTK includes
-class vtkMutexLock;
-
 /** @brief vtkCUDA1DVolumeMapper is a volume mapper, taking a set of 3D image data objects, volume and renderer as input and creates a 2D ray casted projection of the scene which is then displayed to screen
 *
 */
@@ -34,11 +32,43 @@ public:
   virtual void SetInputInternal( vtkImageData * image, int frame);
   virtual void ClearInputInternal();
   virtual void ChangeFrameInternal(unsigned int frame);
+  virtual void ChangeLevelInternal(unsigned int level);
   virtual void InternalRender (  vtkRenderer* ren, vtkVolume* vol,
     const cudaRendererInformation& rendererInfo,
     const cudaVolumeInformation& volumeInfo,
     const cudaOutputImageInformation& outputInfo );
 
+  /** @brief Sets whether ray segments are composited from a pre-integrated transfer function rather than point samples
+  *
+  *  @note Pre-integration is best paired with a sample distance scale above 1.0, which it keeps free of slab artefacts
+  */
+  void SetPreIntegration(bool preIntegrate);
+  bool GetPreIntegration();
+  vtkBooleanMacro(PreIntegration, bool);
+
+  /** @brief Sets whether integer volumes of at most 16 bits are classified through a table entry per value, keeping narrow transfer function features sharp
+  *
+  *  @note The table is sized to the values in the range, so narrow ranges get smaller tables and wide ones only get up to 65536 entries when the transfer function has features too narrow for the default table
+  */
+  void SetExactTables(bool exact);
+  bool GetExactTables();
+  vtkBooleanMacro(ExactTables, bool);
+
+  /** @brief Sets whether the volume is classified into an RGBA volume once the transfer function has not changed for a number of renders, the ray caster then sampling colour and opacity directly
+  *
+  *  @note Any change to the transfer function falls back to classifying each sample until it is stable again
+  *  @note The classified volume takes as much device memory as a float volume, and is done without if it does not fit in what the device memory budget leaves
+  */
+  void SetPreClassification(bool preClassify);
+  vtkGetMacro(PreClassification, bool);
+  vtkBooleanMacro(PreClassification, bool);
+
+  /** @brief Sets the number of renders the transfer function has to stay unchanged for before the volume is classified
+  *
+  */
+  vtkSetClampMacro(PreClassificationDelay, int, 1, VTK_INT_MAX);
+  vtkGetMacro(PreClassificationDelay, int);
+
 protected:
   /** @brief Constructor which initializes the number of frames, rendering type and other constants to safe initial values, and creates the required information handlers
   *
@@ -51,10 +81,41 @@ protected:
   ~vtkCUDA1DVolumeMapper();
   virtual void Reinitialize(int withData = 0);
   virtual void Deinitialize(int withData = 0);
+  virtual bool UploadSlabInternal(void* slab, int firstSlice, int numSlices, int channel);
+  virtual vtkTypeUInt64 GetDeviceBytesInternal(const int dims[3], int voxelSize, bool live);
+
+  /** @brief Gets the device memory taken by the classified volume of the uploaded volume, which is counted in the uploaded bytes while it is allocated
+  *
+  */
+  vtkTypeUInt64 GetClassifiedBytes();
+
+  /** @brief Loads the image and its mip pyramid from the volume cache
+  *
+  *  @param key The key of the uploaded sub-extent of the input
+  *
+  *  @return The number of levels of detail loaded, 0 if the input was not cached
+  */
+  int LoadFromCache(vtkTypeUInt64 key);
+
+  /** @brief Stores the image and its mip pyramid, as currently on the device, in the volume cache
+  *
+  *  @param key The key of the uploaded sub-extent of the input
+  *  @param numLevels The number of levels of detail built for the input
+  */
+  void StoreInCache(vtkTypeUInt64 key, int numLevels);
+
+  /** @brief Gathers the range and histogram of the gradient magnitudes of the full resolution volume on the device
+  *
+  */
+  void GatherGradientStatistics();
 
   vtkCUDA1DTransferFunctionInformationHandler* transferFunctionInfoHandler;
+  cuda1DVolumeInformation VolumeData; /**< The device arrays of the volume, its mip pyramid and its bricks, owned by this mapper alone */
 
-  static vtkMutexLock* tfLock;
+  bool          PreClassification;      /**< Whether the volume is classified once the transfer function is stable */
+  int           PreClassificationDelay; /**< The number of renders the transfer function has to be stable for before classifying */
+  int           StableRenders;          /**< The number of renders since the transfer function last changed */
+  unsigned int  StableVersion;          /**< The version of the transfer function tables the stable renders used */
 
 private:
   vtkCUDA1DVolumeMapper operator=(const vtkCUDA1DVolumeMapper&); /**< not implemented */
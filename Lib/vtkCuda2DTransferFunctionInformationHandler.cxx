@@ -0,0 +1,300 @@
+/** @file vtkCUDA2DTransferFunctionInformationHandler.cxx
+*
+*  @brief Implementation of an internal class for vtkCUDA2DVolumeMapper which manages the 2D (intensity by gradient magnitude) transfer function
+*
+*/
+
+#include "vtkCUDA2DTransferFunctionInformationHandler.h"
+#include "vtkObjectFactory.h"
+
+#include "vtkImageData.h"
+
+#include "CUDA_vtkCUDA2DVolumeMapper_renderAlgo.h"
+#include "cuda_runtime_api.h"
+
+// STD includes
+#include <cstring>
+
+vtkStandardNewMacro(vtkCUDA2DTransferFunctionInformationHandler);
+
+//----------------------------------------------------------------------------
+// Converts the RGBA entries of the table to floats, keeping the highest opacity of each column
+template <class T>
+void vtkCUDA2DTransferFunctionInformationHandlerBake(const T* table, int width, int height, float scale,
+                                                     float4* colourOpacity, float* maxOpacity)
+{
+  for( int x = 0; x < width; x++ )
+    {
+    maxOpacity[x] = 0.0f;
+    }
+  for( int i = 0; i < width * height; i++ )
+    {
+    colourOpacity[i].x = scale * (float) table[4*i];
+    colourOpacity[i].y = scale * (float) table[4*i+1];
+    colourOpacity[i].z = scale * (float) table[4*i+2];
+    colourOpacity[i].w = scale * (float) table[4*i+3];
+    colourOpacity[i].w = (colourOpacity[i].w < 0.0f) ? 0.0f : (colourOpacity[i].w > 1.0f) ? 1.0f : colourOpacity[i].w;
+    float& columnMax = maxOpacity[i % width];
+    columnMax = (colourOpacity[i].w > columnMax) ? colourOpacity[i].w : columnMax;
+    }
+}
+
+vtkCUDA2DTransferFunctionInformationHandler
+::vtkCUDA2DTransferFunctionInformationHandler()
+{
+  this->Table = NULL;
+  this->lastModifiedTime = 0;
+
+  this->TransInfo.colourOpacityTransferArray2D = 0;
+  this->TransInfo.maxOpacityTransferArray1D = 0;
+  this->TransInfo.colourOpacityTexture = 0;
+  this->TransInfo.maxOpacityTexture = 0;
+  this->TransInfo.intensitySize = 0;
+  this->TransInfo.gradientSize = 0;
+  this->BackTransInfo = this->TransInfo;
+
+  this->BakeArena = NULL;
+  this->UploadArena = NULL;
+  this->UploadArenaPinned = false;
+  this->ArenaSize[0] = this->ArenaSize[1] = 0;
+  this->TablesUploaded = false;
+  this->UploadEvent = 0;
+  this->CopyStream = 0;
+  this->FrontReleaseEvent = 0;
+  this->BackReleaseEvent = 0;
+  this->Reinitialize();
+}
+
+vtkCUDA2DTransferFunctionInformationHandler
+::~vtkCUDA2DTransferFunctionInformationHandler()
+{
+  this->Deinitialize();
+  this->SetTransferFunction(NULL);
+  this->AllocateArenas(0, 0);
+}
+
+void vtkCUDA2DTransferFunctionInformationHandler
+::Deinitialize(int vtkNotUsed(withData))
+{
+  this->ReserveGPU();
+  if( this->UploadEvent )
+    {
+    cudaEventSynchronize( this->UploadEvent );
+    cudaEventDestroy( this->UploadEvent );
+    this->UploadEvent = 0;
+    }
+  if( this->CopyStream )
+    {
+    cudaStreamDestroy( this->CopyStream );
+    this->CopyStream = 0;
+    }
+  cudaEvent_t* releaseEvents[2] = { &this->FrontReleaseEvent, &this->BackReleaseEvent };
+  for( int i = 0; i < 2; i++ )
+    {
+    if( *releaseEvents[i] )
+      {
+      cudaEventSynchronize( *releaseEvents[i] );
+      cudaEventDestroy( *releaseEvents[i] );
+      *releaseEvents[i] = 0;
+      }
+    }
+  CUDA_vtkCUDA2DVolumeMapper_renderAlgo_UnloadTextures( this->TransInfo, this->GetStream() );
+  CUDA_vtkCUDA2DVolumeMapper_renderAlgo_UnloadTextures( this->BackTransInfo, this->GetStream() );
+  this->TablesUploaded = false;
+}
+
+void vtkCUDA2DTransferFunctionInformationHandler
+::Reinitialize(int vtkNotUsed(withData))
+{
+  this->ReserveGPU();
+  if( !this->UploadEvent )
+    {
+    cudaEventCreateWithFlags( &this->UploadEvent, cudaEventDisableTiming );
+    }
+  if( !this->CopyStream && cudaStreamCreate( &this->CopyStream ) != cudaSuccess )
+    {
+    //the table is then copied through the default stream, which waits for (and holds up) the rendering
+    cudaGetLastError();
+    this->CopyStream = 0;
+    }
+  if( !this->FrontReleaseEvent ) cudaEventCreateWithFlags( &this->FrontReleaseEvent, cudaEventDisableTiming );
+  if( !this->BackReleaseEvent ) cudaEventCreateWithFlags( &this->BackReleaseEvent, cudaEventDisableTiming );
+  lastModifiedTime = 0;
+  UpdateTransferFunction();
+}
+
+void vtkCUDA2DTransferFunctionInformationHandler
+::SetTransferFunction(vtkImageData* table)
+{
+  if( table == this->Table )
+    {
+    return;
+    }
+  if( this->Table )
+    {
+    this->Table->UnRegister(this);
+    }
+  this->Table = table;
+  if( this->Table )
+    {
+    this->Table->Register(this);
+    }
+  this->lastModifiedTime = 0;
+  this->Modified();
+}
+
+void vtkCUDA2DTransferFunctionInformationHandler
+::AcquireTables(cudaStream_t* stream)
+{
+  if( this->UploadEvent ) cudaStreamWaitEvent( *stream, this->UploadEvent, 0 );
+}
+
+void vtkCUDA2DTransferFunctionInformationHandler
+::ReleaseTables(cudaStream_t* stream)
+{
+  if( this->FrontReleaseEvent ) cudaEventRecord( this->FrontReleaseEvent, *stream );
+}
+
+void vtkCUDA2DTransferFunctionInformationHandler
+::AllocateArenas(int intensitySize, int gradientSize)
+{
+  if( intensitySize == this->ArenaSize[0] && gradientSize == this->ArenaSize[1] )
+    {
+    return;
+    }
+
+  //the previous copies have to be done with the upload arena before it goes
+  if( this->UploadEvent ) cudaEventSynchronize( this->UploadEvent );
+  delete[] this->BakeArena;
+  if( this->UploadArenaPinned ) cudaFreeHost( this->UploadArena );
+  else delete[] this->UploadArena;
+  this->BakeArena = NULL;
+  this->UploadArena = NULL;
+  this->UploadArenaPinned = false;
+  this->ArenaSize[0] = intensitySize;
+  this->ArenaSize[1] = gradientSize;
+  if( intensitySize * gradientSize == 0 )
+    {
+    return;
+    }
+
+  size_t numFloats = 4 * (size_t) intensitySize * gradientSize + intensitySize;
+  this->BakeArena = new float[numFloats];
+  this->UploadArenaPinned = (cudaHostAlloc( (void**) &this->UploadArena, sizeof(float) * numFloats, cudaHostAllocPortable ) == cudaSuccess);
+  if( !this->UploadArenaPinned )
+    {
+    cudaGetLastError();
+    this->UploadArena = new float[numFloats];
+    }
+}
+
+void vtkCUDA2DTransferFunctionInformationHandler::UpdateTransferFunction()
+{
+  //if we don't need to update the transfer function, don't
+  if( !this->Table || this->Table->GetMTime() <= lastModifiedTime )
+    {
+    return;
+    }
+  lastModifiedTime = this->Table->GetMTime();
+
+  int dims[3];
+  this->Table->GetDimensions(dims);
+  if( this->Table->GetNumberOfScalarComponents() != 4 || dims[0] < 2 || dims[1] < 2 )
+    {
+    vtkErrorMacro(<<"The 2D transfer function has to be an RGBA image of at least 2 by 2 entries.");
+    return;
+    }
+
+  //the columns and rows are placed by the origin and spacing, the ranges spanning the texels so their centres land on the entries
+  double origin[3];
+  double spacing[3];
+  this->Table->GetOrigin(origin);
+  this->Table->GetSpacing(spacing);
+  this->TransInfo.intensityLow = origin[0] - 0.5 * spacing[0];
+  this->TransInfo.intensityMultiplier = 1.0 / ( spacing[0] * dims[0] );
+  this->TransInfo.gradientLow = origin[1] - 0.5 * spacing[1];
+  this->TransInfo.gradientMultiplier = 1.0 / ( spacing[1] * dims[1] );
+
+  //a table of a new size needs new arrays on the device
+  if( (int) this->TransInfo.intensitySize != dims[0] || (int) this->TransInfo.gradientSize != dims[1] )
+    {
+    this->ReserveGPU();
+    this->AllocateArenas(dims[0], dims[1]);
+    CUDA_vtkCUDA2DVolumeMapper_renderAlgo_UnloadTextures( this->TransInfo, this->GetStream() );
+    CUDA_vtkCUDA2DVolumeMapper_renderAlgo_UnloadTextures( this->BackTransInfo, this->GetStream() );
+    this->TablesUploaded = false;
+    this->TransInfo.intensitySize = dims[0];
+    this->TransInfo.gradientSize = dims[1];
+    }
+
+  //bake the table, integer entries being normalized by the maximum of their type
+  const int numEntries = dims[0] * dims[1];
+  float4* colourOpacity = reinterpret_cast<float4*>(this->BakeArena);
+  float* maxOpacity = this->BakeArena + 4*numEntries;
+  int scalarType = this->Table->GetScalarType();
+  float scale = (scalarType == VTK_FLOAT || scalarType == VTK_DOUBLE) ? 1.0f : (float) (1.0 / this->Table->GetScalarTypeMax());
+  void* table = this->Table->GetScalarPointer();
+  switch( scalarType )
+    {
+    vtkTemplateMacro( vtkCUDA2DTransferFunctionInformationHandlerBake( static_cast<VTK_TT*>(table), dims[0], dims[1], scale,
+                                                                       colourOpacity, maxOpacity ) );
+    default:
+      vtkErrorMacro(<<"The scalar type of the 2D transfer function is not supported.");
+      return;
+    }
+
+  //unchanged bytes need no copy
+  const size_t numBytes = sizeof(float) * (4 * (size_t) numEntries + dims[0]);
+  if( this->TablesUploaded && memcmp( this->UploadArena, this->BakeArena, numBytes ) == 0 )
+    {
+    return;
+    }
+
+  //wait for the previous copy out of the upload arena before rewriting it, then copy the tables into the back buffer
+  this->ReserveGPU();
+  if( this->UploadEvent ) cudaEventSynchronize( this->UploadEvent );
+  memcpy( this->UploadArena, this->BakeArena, numBytes );
+  cuda2DTransferFunctionInformation back = this->TransInfo;
+  back.colourOpacityTransferArray2D = this->BackTransInfo.colourOpacityTransferArray2D;
+  back.maxOpacityTransferArray1D = this->BackTransInfo.maxOpacityTransferArray1D;
+  back.colourOpacityTexture = this->BackTransInfo.colourOpacityTexture;
+  back.maxOpacityTexture = this->BackTransInfo.maxOpacityTexture;
+  this->BackTransInfo = back;
+
+  //the copy goes through the copy stream once the frames which last read the back buffer are done
+  if( this->BackReleaseEvent ) cudaStreamWaitEvent( this->CopyStream, this->BackReleaseEvent, 0 );
+  this->TablesUploaded = CUDA_vtkCUDA2DVolumeMapper_renderAlgo_loadTextures(this->BackTransInfo,
+    reinterpret_cast<float4*>(this->UploadArena),
+    this->UploadArena + 4*numEntries,
+    &this->CopyStream );
+  if( this->UploadEvent ) cudaEventRecord( this->UploadEvent, this->CopyStream );
+  if( !this->UploadArenaPinned )
+    {
+    //pageable copies may still read the arena when they return
+    cudaStreamSynchronize( this->CopyStream );
+    }
+
+  //swap the buffers (and the events marking the frames reading them) at the frame boundary, the frames still in flight
+  //having read the old tables from the front buffer
+  back = this->BackTransInfo;
+  this->BackTransInfo = this->TransInfo;
+  this->TransInfo = back;
+  cudaEvent_t releaseEvent = this->BackReleaseEvent;
+  this->BackReleaseEvent = this->FrontReleaseEvent;
+  this->FrontReleaseEvent = releaseEvent;
+}
+
+void vtkCUDA2DTransferFunctionInformationHandler::Update()
+{
+  if(this->Table)
+    {
+    //only a table modified since its last bake is baked again, and only then is the handler modified
+    this->Table->Update();
+    unsigned long bakedTime = this->lastModifiedTime;
+    this->UpdateTransferFunction();
+    if( this->lastModifiedTime != bakedTime )
+      {
+      this->Modified();
+      }
+    }
+}
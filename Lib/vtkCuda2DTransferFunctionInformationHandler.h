@@ -0,0 +1,114 @@
+/** @file vtkCUDA2DTransferFunctionInformationHandler.h
+*
+*  @brief Header file defining an internal class for vtkCUDA2DVolumeMapper which manages the 2D (intensity by gradient magnitude) transfer function
+*
+*/
+
+#ifndef __vtkCUDA2DTransferFunctionInformationHandler_h
+#define __vtkCUDA2DTransferFunctionInformationHandler_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_container2DTransferFunctionInformation.h"
+#include "vtkCUDAObject.h"
+
+// VTK includes
+#include <vtkObject.h>
+class vtkImageData;
+
+/** @brief vtkCUDA2DTransferFunctionInformationHandler bakes a 2D transfer function, given as an RGBA image, into the lookup tables of the 2D ray caster on behalf of the vtkCUDA2DVolumeMapper
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDA2DTransferFunctionInformationHandler
+  : public vtkObject
+  , public vtkCUDAObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDA2DTransferFunctionInformationHandler,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDA2DTransferFunctionInformationHandler* New();
+
+  /** @brief Gets the CUDA compatible container for transfer function related information needed during the rendering process
+  *
+  *  @note This is the front buffer, which the next update swaps with the back buffer once it copied the new tables into it
+  */
+  const cuda2DTransferFunctionInformation& GetTransferFunctionInfo() const { return (this->TransInfo); }
+
+  /** @brief Makes the work queued on a stream from now on wait until the front buffer's tables are on the device
+  *
+  *  @note The tables are copied through a stream of the handler's own, so an edit neither waits for the frames in flight nor holds them up
+  */
+  void AcquireTables(cudaStream_t* stream);
+
+  /** @brief Marks the front buffer as read by the work queued on a stream so far, so that it is not rewritten before that work has finished
+  *
+  */
+  void ReleaseTables(cudaStream_t* stream);
+
+  /** @brief Set the 2D transfer function used for determining colour and opacity in the volume rendering process
+  *
+  *  @param table A 2D image with 4 (RGBA) components, whose columns are intensities and rows are gradient magnitudes, as placed by its origin and spacing
+  *
+  *  @note Integer tables are normalized by the maximum of their type, floating point tables being taken as already between 0 and 1
+  */
+  void SetTransferFunction(vtkImageData* table);
+  vtkImageData* GetTransferFunction() const { return this->Table; }
+
+  /** @brief Triggers an update for the transfer function, rebaking and uploading the lookup tables if the table image was modified
+  *
+  */
+  virtual void Update();
+
+protected:
+
+  /** @brief Constructor which sets the table to null and the lookup tables to unallocated
+  *
+  */
+  vtkCUDA2DTransferFunctionInformationHandler();
+
+  /** @brief Destructor which releases the table image and the lookup tables on the host and the GPU
+  *
+  */
+  ~vtkCUDA2DTransferFunctionInformationHandler();
+
+  /** @brief Bakes the table image into the packed lookup tables, copying them to the device if their bytes changed
+  *
+  */
+  void UpdateTransferFunction();
+
+  /** @brief Reallocates the host buffers for a table of the given size
+  *
+  */
+  void AllocateArenas(int intensitySize, int gradientSize);
+
+  void Deinitialize(int withData = 0);
+  void Reinitialize(int withData = 0);
+
+private:
+  vtkCUDA2DTransferFunctionInformationHandler& operator=(const vtkCUDA2DTransferFunctionInformationHandler&); /**< Not implemented */
+  vtkCUDA2DTransferFunctionInformationHandler(const vtkCUDA2DTransferFunctionInformationHandler&); /**< Not implemented */
+
+private:
+
+  cuda2DTransferFunctionInformation  TransInfo;  /**< The CUDA specific structure holding the required transfer function related information for rendering (the front buffer) */
+  cuda2DTransferFunctionInformation  BackTransInfo; /**< The back buffer, whose device tables the next edit is copied into before the buffers are swapped */
+
+  vtkImageData*   Table;          /**< The RGBA image defining the transfer function */
+  unsigned long   lastModifiedTime; /**< The last time the table was baked, used to determine when to repopulate the lookup tables */
+
+  float*          BakeArena;      /**< Host buffer the table is baked into: packed RGBA entries then the maximum opacity of each column */
+  float*          UploadArena;    /**< (Preferably pinned) copy of the tables on the device, which the copies read from */
+  bool            UploadArenaPinned; /**< Whether the upload arena is pinned */
+  int             ArenaSize[2];   /**< The intensity and gradient magnitude sizes the arenas are allocated for */
+  bool            TablesUploaded; /**< Whether the device tables of the front buffer hold the upload arena */
+  cudaEvent_t     UploadEvent;    /**< Recorded after the last copy out of the upload arena */
+  cudaStream_t    CopyStream;     /**< The stream the tables are copied through, apart from the rendering */
+  cudaEvent_t     FrontReleaseEvent; /**< Recorded after the last work reading the front buffer */
+  cudaEvent_t     BackReleaseEvent;  /**< Recorded after the last work reading the back buffer */
+
+};
+
+#endif
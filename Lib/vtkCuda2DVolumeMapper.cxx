@@ -0,0 +1,68 @@
+/** @file vtkCUDA2DVolumeMapper.cxx
+*
+*  @brief Implementation of a volume mapper (ray caster) classifying the volume through a 2D (intensity by gradient magnitude) transfer function
+*
+*/
+
+// Type
+#include "vtkCUDA2DVolumeMapper.h"
+#include "vtkCUDA2DTransferFunctionInformationHandler.h"
+
+// CUDA Volume Rendering includes
+#include "CUDA_vtkCUDA2DVolumeMapper_renderAlgo.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+
+vtkStandardNewMacro(vtkCUDA2DVolumeMapper);
+
+vtkCUDA2DVolumeMapper::vtkCUDA2DVolumeMapper()
+  {
+  this->transferFunction2DInfoHandler = vtkCUDA2DTransferFunctionInformationHandler::New();
+  this->transferFunction2DInfoHandler->ReplicateObject(this);
+  }
+
+vtkCUDA2DVolumeMapper::~vtkCUDA2DVolumeMapper()
+  {
+  this->transferFunction2DInfoHandler->UnRegister( this );
+  }
+
+void vtkCUDA2DVolumeMapper::Reinitialize(int withData)
+  {
+  this->vtkCUDA1DVolumeMapper::Reinitialize(withData);
+  this->transferFunction2DInfoHandler->ReplicateObject(this, withData);
+  }
+
+void vtkCUDA2DVolumeMapper::SetTransferFunction2D(vtkImageData* table)
+  {
+  this->transferFunction2DInfoHandler->SetTransferFunction(table);
+  this->Modified();
+  }
+
+vtkImageData* vtkCUDA2DVolumeMapper::GetTransferFunction2D()
+  {
+  return this->transferFunction2DInfoHandler->GetTransferFunction();
+  }
+
+void vtkCUDA2DVolumeMapper::InternalRender (  vtkRenderer* vtkNotUsed(ren), vtkVolume* vtkNotUsed(vol),
+                                            const cudaRendererInformation& rendererInfo,
+                                            const cudaVolumeInformation& volumeInfo,
+                                            const cudaOutputImageInformation& outputInfo )
+{
+  //handle the transfer function changes
+  this->transferFunction2DInfoHandler->Update();
+  if( !this->transferFunction2DInfoHandler->GetTransferFunctionInfo().colourOpacityTransferArray2D )
+    {
+    vtkErrorMacro(<<"No 2D transfer function has been loaded.");
+    return;
+    }
+
+  //perform the render once the tables are on the device
+  this->ReserveGPU();
+  this->transferFunction2DInfoHandler->AcquireTables( this->GetStream() );
+  this->erroredOut = !CUDA_vtkCUDA2DVolumeMapper_renderAlgo_doRender(this->VolumeData, outputInfo, rendererInfo, volumeInfo,
+                     this->transferFunction2DInfoHandler->GetTransferFunctionInfo(), this->GetStream());
+  this->transferFunction2DInfoHandler->ReleaseTables( this->GetStream() );
+
+}
@@ -0,0 +1,68 @@
+/** @file vtkCUDA2DVolumeMapper.h
+*
+*  @brief Header file defining a volume mapper (ray caster) classifying the volume through a 2D (intensity by gradient magnitude) transfer function
+*
+*/
+
+#ifndef __vtkCUDA2DVolumeMapper_h
+#define __vtkCUDA2DVolumeMapper_h
+
+#include "vtkCUDA1DVolumeMapper.h"
+class vtkCUDA2DTransferFunctionInformationHandler;
+
+// VTK includes
+class vtkImageData;
+
+/** @brief vtkCUDA2DVolumeMapper is a volume mapper which classifies each sample through a 2D lookup table indexed by intensity and gradient magnitude, rather than the 1D colour and opacity functions of the volume property
+*
+*  @note The volume is uploaded (and cached, streamed and mip mapped) exactly as by the vtkCUDA1DVolumeMapper, only the classification differing
+*  @note Samples whose intensity is transparent at every gradient magnitude skip computing the gradient, so empty space stays as cheap as with the 1D mapper
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDA2DVolumeMapper
+  : public vtkCUDA1DVolumeMapper
+{
+public:
+
+  vtkTypeMacro (vtkCUDA2DVolumeMapper,vtkCUDA1DVolumeMapper);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDA2DVolumeMapper *New();
+
+  /** @brief Sets the 2D transfer function, as an image with 4 (RGBA) components whose columns are intensities and rows are gradient magnitudes
+  *
+  *  @param table The transfer function, the intensity and gradient magnitude of its entries being given by its origin and spacing
+  *
+  *  @note The volume property still provides the shading parameters, its colour and opacity functions being ignored
+  */
+  void SetTransferFunction2D(vtkImageData* table);
+  vtkImageData* GetTransferFunction2D();
+
+  virtual void InternalRender (  vtkRenderer* ren, vtkVolume* vol,
+    const cudaRendererInformation& rendererInfo,
+    const cudaVolumeInformation& volumeInfo,
+    const cudaOutputImageInformation& outputInfo );
+
+protected:
+  /** @brief Constructor which creates the 2D transfer function handler
+  *
+  */
+  vtkCUDA2DVolumeMapper();
+
+  /** @brief Destructor which deallocates the 2D transfer function handler
+  *
+  */
+  ~vtkCUDA2DVolumeMapper();
+  virtual void Reinitialize(int withData = 0);
+
+  vtkCUDA2DTransferFunctionInformationHandler* transferFunction2DInfoHandler;
+
+private:
+  vtkCUDA2DVolumeMapper operator=(const vtkCUDA2DVolumeMapper&); /**< not implemented */
+  vtkCUDA2DVolumeMapper(const vtkCUDA2DVolumeMapper&); /**< not implemented */
+
+};
+
+#endif
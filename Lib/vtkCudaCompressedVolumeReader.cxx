@@ -0,0 +1,261 @@
+/** @file vtkCUDACompressedVolumeReader.cxx
+*
+*  @brief Implementation of a reader which decompresses NRRD and MetaImage volumes in the background, a slab at a time
+*
+*/
+
+#include "vtkCUDACompressedVolumeReader.h"
+
+// VTK includes
+#include <vtkByteSwap.h>
+#include <vtkConditionVariable.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkMutexLock.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+#include <vtk_zlib.h>
+
+// STD includes
+#include <cstring>
+
+// Compression includes
+#ifdef VTKCUDA_USE_ZSTD
+#include <zstd.h>
+#endif
+
+// Amount of output decompressed between two publications of the progress
+#define VTKCUDACOMPRESSEDVOLUMEREADER_CHUNK_BYTES (4 << 20)
+
+// Largest amount of input handed to zlib at once, as its counters are 32 bit
+#define VTKCUDACOMPRESSEDVOLUMEREADER_ZLIB_INPUT_BYTES (1 << 30)
+
+vtkStandardNewMacro(vtkCUDACompressedVolumeReader);
+
+vtkCUDACompressedVolumeReader::vtkCUDACompressedVolumeReader()
+  {
+  this->Pipelined = false;
+  this->Threader = vtkMultiThreader::New();
+  this->ThreadID = -1;
+  this->ProgressLock = vtkMutexLock::New();
+  this->ProgressCondition = vtkConditionVariable::New();
+  this->CompressedData = NULL;
+  this->OutputPointer = NULL;
+  this->SliceBytes = 0;
+  this->WordSize = 1;
+  this->NumberOfSlices = 0;
+  this->DecompressedSlices = 0;
+  this->Finished = true;
+  this->Failed = false;
+  this->Abort = 0;
+  }
+
+vtkCUDACompressedVolumeReader::~vtkCUDACompressedVolumeReader()
+  {
+  this->StopDecompression();
+  this->Threader->Delete();
+  this->ProgressLock->Delete();
+  this->ProgressCondition->Delete();
+  }
+
+void vtkCUDACompressedVolumeReader::PrintSelf(ostream& os, vtkIndent indent)
+  {
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "Pipelined: " << this->Pipelined << "\n";
+  os << indent << "DecompressedSlices: " << this->DecompressedSlices << "/" << this->NumberOfSlices << "\n";
+  }
+
+bool vtkCUDACompressedVolumeReader::CanReadEncoding(int encoding)
+  {
+#ifdef VTKCUDA_USE_ZSTD
+  return encoding == ENCODING_RAW || encoding == ENCODING_ZLIB || encoding == ENCODING_ZSTD;
+#else
+  return encoding == ENCODING_RAW || encoding == ENCODING_ZLIB;
+#endif
+  }
+
+void vtkCUDACompressedVolumeReader::ExecuteData(vtkDataObject* output)
+  {
+  //the previous output is about to go away
+  this->StopDecompression();
+  this->NumberOfSlices = this->DataExtent[5] - this->DataExtent[4] + 1;
+  if( this->Encoding == ENCODING_RAW )
+    {
+    this->Superclass::ExecuteData(output);
+    this->DecompressedSlices = this->NumberOfSlices;
+    this->Failed = false;
+    return;
+    }
+
+  vtkImageData* data = vtkImageData::SafeDownCast(output);
+  if( !data || this->DataFileName.empty() ) return;
+  data->GetPointData()->SetScalars(NULL);
+  this->UnmapDataFile();
+
+  //the output owns its voxels, which the decompression fills in place
+  data->SetExtent(this->DataExtent);
+  data->SetScalarType(this->DataScalarType);
+  data->SetNumberOfScalarComponents(this->NumberOfScalarComponents);
+  data->AllocateScalars();
+  if( !data->GetPointData()->GetScalars() )
+    {
+    vtkErrorMacro(<<"Could not allocate the output.");
+    return;
+    }
+  data->GetPointData()->GetScalars()->SetName("ImageFile");
+  this->OutputPointer = static_cast<char*>(data->GetScalarPointer());
+  this->WordSize = data->GetScalarSize();
+  this->SliceBytes = (vtkTypeUInt64) (this->DataExtent[1] - this->DataExtent[0] + 1) *
+                                     (this->DataExtent[3] - this->DataExtent[2] + 1) *
+                                     this->NumberOfScalarComponents * this->WordSize;
+
+  this->CompressedData = static_cast<const unsigned char*>( this->MapDataFile(this->DataOffset, this->CompressedSize) );
+  if( !this->CompressedData )
+    {
+    vtkErrorMacro(<<"Could not map the compressed data of " << this->DataFileName << ".");
+    return;
+    }
+
+  this->DecompressedSlices = 0;
+  this->Finished = false;
+  this->Failed = false;
+  this->Abort = 0;
+  this->ThreadID = this->Threader->SpawnThread( vtkCUDACompressedVolumeReader::DecompressThread, this );
+
+  //unless pipelined, the output is complete when the reader returns
+  if( !this->Pipelined )
+    {
+    this->WaitForSlices(this->NumberOfSlices);
+    this->StopDecompression();
+    if( this->Failed )
+      {
+      vtkErrorMacro(<<"Could not decompress " << this->DataFileName << ".");
+      }
+    }
+  }
+
+VTK_THREAD_RETURN_TYPE vtkCUDACompressedVolumeReader::DecompressThread(void* arg)
+  {
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkCUDACompressedVolumeReader* self = static_cast<vtkCUDACompressedVolumeReader*>(threadInfo->UserData);
+  bool succeeded = self->Decompress();
+
+  self->ProgressLock->Lock();
+  self->Failed = !succeeded;
+  self->Finished = true;
+  self->ProgressCondition->Broadcast();
+  self->ProgressLock->Unlock();
+  return VTK_THREAD_RETURN_VALUE;
+  }
+
+bool vtkCUDACompressedVolumeReader::Decompress()
+  {
+  vtkTypeUInt64 total = this->SliceBytes * this->NumberOfSlices;
+  vtkTypeUInt64 produced = 0;
+
+  //publish whole slices, at least a few megabytes at a time
+  vtkTypeUInt64 chunk = (VTKCUDACOMPRESSEDVOLUMEREADER_CHUNK_BYTES / this->SliceBytes) * this->SliceBytes;
+  chunk = (chunk > 0) ? chunk : this->SliceBytes;
+
+  if( this->Encoding == ENCODING_ZLIB )
+    {
+    //gzip and zlib headers are both detected, and concatenated gzip members are read one after the other
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if( inflateInit2(&stream, 15 + 32) != Z_OK ) return false;
+    const unsigned char* input = this->CompressedData;
+    vtkTypeUInt64 inputLeft = this->CompressedSize;
+    while( produced < total && !this->Abort )
+      {
+      if( stream.avail_in == 0 )
+        {
+        if( inputLeft == 0 ) break;
+        uInt inputSize = (uInt) ((inputLeft < VTKCUDACOMPRESSEDVOLUMEREADER_ZLIB_INPUT_BYTES) ? inputLeft : VTKCUDACOMPRESSEDVOLUMEREADER_ZLIB_INPUT_BYTES);
+        stream.next_in = const_cast<Bytef*>(input);
+        stream.avail_in = inputSize;
+        input += inputSize;
+        inputLeft -= inputSize;
+        }
+      uInt outputSize = (uInt) ((total - produced < chunk) ? total - produced : chunk);
+      stream.next_out = reinterpret_cast<Bytef*>(this->OutputPointer + produced);
+      stream.avail_out = outputSize;
+      int result = inflate(&stream, Z_NO_FLUSH);
+      produced += outputSize - stream.avail_out;
+      this->PublishSlices(produced);
+      if( result == Z_STREAM_END && produced < total ) result = inflateReset(&stream);
+      if( result != Z_OK && result != Z_STREAM_END ) break;
+      }
+    inflateEnd(&stream);
+    }
+#ifdef VTKCUDA_USE_ZSTD
+  else if( this->Encoding == ENCODING_ZSTD )
+    {
+    ZSTD_DStream* stream = ZSTD_createDStream();
+    if( !stream ) return false;
+    ZSTD_initDStream(stream);
+    ZSTD_inBuffer input = { this->CompressedData, (size_t) this->CompressedSize, 0 };
+    while( produced < total && !this->Abort )
+      {
+      ZSTD_outBuffer outputBuffer = { this->OutputPointer + produced, (size_t) ((total - produced < chunk) ? total - produced : chunk), 0 };
+      size_t result = ZSTD_decompressStream(stream, &outputBuffer, &input);
+      produced += outputBuffer.pos;
+      this->PublishSlices(produced);
+      if( ZSTD_isError(result) || (outputBuffer.pos == 0 && input.pos == input.size) ) break;
+      }
+    ZSTD_freeDStream(stream);
+    }
+#endif
+
+  return produced == total;
+  }
+
+void vtkCUDACompressedVolumeReader::PublishSlices(vtkTypeUInt64 decompressedBytes)
+  {
+  int slices = (int) (decompressedBytes / this->SliceBytes);
+  if( slices <= this->DecompressedSlices ) return;
+
+  //swap the completed slices before anyone may read them
+  if( this->SwapBytes && this->WordSize > 1 )
+    {
+    vtkTypeUInt64 first = this->SliceBytes * this->DecompressedSlices;
+    vtkByteSwap::SwapVoidRange( this->OutputPointer + first, (int) ((this->SliceBytes * slices - first) / this->WordSize), this->WordSize );
+    }
+
+  this->ProgressLock->Lock();
+  this->DecompressedSlices = slices;
+  this->ProgressCondition->Broadcast();
+  this->ProgressLock->Unlock();
+  }
+
+int vtkCUDACompressedVolumeReader::WaitForSlices(int numSlices)
+  {
+  this->ProgressLock->Lock();
+  while( this->DecompressedSlices < numSlices && !this->Finished )
+    {
+    this->ProgressCondition->Wait(this->ProgressLock);
+    }
+  int slices = this->DecompressedSlices;
+  this->ProgressLock->Unlock();
+  return slices;
+  }
+
+bool vtkCUDACompressedVolumeReader::GetDecompressionFailed()
+  {
+  this->ProgressLock->Lock();
+  bool failed = this->Failed;
+  this->ProgressLock->Unlock();
+  return failed;
+  }
+
+void vtkCUDACompressedVolumeReader::StopDecompression()
+  {
+  if( this->ThreadID < 0 ) return;
+  this->Abort = 1;
+  this->Threader->TerminateThread(this->ThreadID);
+  this->ThreadID = -1;
+  this->Abort = 0;
+
+  //the compressed stream is not needed anymore, while the output keeps its own voxels
+  this->UnmapDataFile();
+  this->CompressedData = NULL;
+  }
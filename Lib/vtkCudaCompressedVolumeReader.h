@@ -0,0 +1,120 @@
+/** @file vtkCUDACompressedVolumeReader.h
+*
+*  @brief Header file defining a reader which decompresses NRRD and MetaImage volumes in the background, a slab at a time
+*
+*/
+
+#ifndef __vtkCUDACompressedVolumeReader_h
+#define __vtkCUDACompressedVolumeReader_h
+
+// CUDA Volume Rendering includes
+#include "vtkCUDAMappedVolumeReader.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+class vtkConditionVariable;
+class vtkMutexLock;
+
+/** @brief vtkCUDACompressedVolumeReader reads gzip compressed NRRD (.nrrd, .nhdr) and compressed MetaImage (.mha, .mhd)
+*   volumes, as well as zstd compressed NRRD volumes when the library is built with zstd support.
+*
+*   The compressed stream is mapped and decompressed on a thread of its own straight into the output, a slab of slices
+*   at a time. When pipelined, the output is handed over as soon as the decompression starts, so that a CUDA volume
+*   mapper given the reader through vtkCUDAVolumeMapper::SetInputReader converts and uploads each slab while the
+*   following ones are still being decompressed.
+*
+*   @note Uncompressed files are mapped as by vtkCUDAMappedVolumeReader
+*   @note A single gzip or zstd stream cannot be split, so the decompression itself runs on one thread which the
+*   conversion and upload of the earlier slabs overlap
+*/
+class CUDA_LIB_EXPORT vtkCUDACompressedVolumeReader : public vtkCUDAMappedVolumeReader
+{
+public:
+
+  vtkTypeMacro( vtkCUDACompressedVolumeReader, vtkCUDAMappedVolumeReader );
+  void PrintSelf( ostream& os, vtkIndent indent );
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDACompressedVolumeReader *New();
+
+  virtual const char* GetFileExtensions() { return ".nrrd .nhdr .mha .mhd"; }
+  virtual const char* GetDescriptiveName() { return "Compressed volume"; }
+
+  /** @brief Sets whether the reader returns as soon as the decompression has started rather than once it completed
+  *
+  *  @note This does not modify the reader, as the output is the same once decompressed. Consumers of a pipelined
+  *  output have to call WaitForSlices before reading any slice of it
+  */
+  void SetPipelined( bool pipelined ) { this->Pipelined = pipelined; }
+  bool GetPipelined() { return this->Pipelined; }
+
+  /** @brief Waits until at least the given number of slices of the output have been decompressed
+  *
+  *  @return The number of slices decompressed so far, which is less than asked for only if the decompression failed
+  */
+  int WaitForSlices( int numSlices );
+
+  /** @brief Gets whether the last decompression stopped before the end of the volume
+  *
+  */
+  bool GetDecompressionFailed();
+
+protected:
+
+  vtkCUDACompressedVolumeReader();
+  ~vtkCUDACompressedVolumeReader();
+
+  virtual bool CanReadEncoding( int encoding );
+
+  /** @brief Allocates the output and starts decompressing the data file into it
+  *
+  */
+  virtual void ExecuteData( vtkDataObject* output );
+
+  /** @brief Entry point of the decompression thread
+  *
+  */
+  static VTK_THREAD_RETURN_TYPE DecompressThread( void* arg );
+
+  /** @brief Decompresses the mapped stream into the output, publishing the slices as they complete
+  *
+  *  @return true if the whole volume was decompressed
+  */
+  bool Decompress();
+
+  /** @brief Swaps the bytes of the newly completed slices if needed and makes them visible to WaitForSlices
+  *
+  *  @param decompressedBytes The number of bytes of the output decompressed so far
+  */
+  void PublishSlices( vtkTypeUInt64 decompressedBytes );
+
+  /** @brief Stops and joins the decompression thread, if running
+  *
+  */
+  void StopDecompression();
+
+  bool                  Pipelined;          /**< Whether ExecuteData returns before the decompression completes */
+  vtkMultiThreader*     Threader;           /**< The threader running the decompression */
+  int                   ThreadID;           /**< The decompression thread, -1 if none is running */
+  vtkMutexLock*         ProgressLock;       /**< Guards the progress of the decompression */
+  vtkConditionVariable* ProgressCondition;  /**< Signalled whenever slices complete or the decompression ends */
+
+  const unsigned char*  CompressedData;     /**< The mapped compressed stream */
+  char*                 OutputPointer;      /**< The first voxel of the output */
+  vtkTypeUInt64         SliceBytes;         /**< The size in bytes of a slice of the output */
+  int                   WordSize;           /**< The size in bytes of a scalar of the output */
+  int                   NumberOfSlices;     /**< The number of slices of the output */
+  int                   DecompressedSlices; /**< The number of slices of the output decompressed so far */
+  bool                  Finished;           /**< Whether the decompression thread ended */
+  bool                  Failed;             /**< Whether the decompression stopped before the end of the volume */
+  volatile int          Abort;              /**< Set to stop the decompression thread early */
+
+private:
+  vtkCUDACompressedVolumeReader operator=(const vtkCUDACompressedVolumeReader&); /**< not implemented */
+  vtkCUDACompressedVolumeReader(const vtkCUDACompressedVolumeReader&); /**< not implemented */
+
+};
+
+#endif
@@ -0,0 +1,277 @@
+/** @file vtkCUDALabelMapInformationHandler.cxx
+*
+*  @brief Implementation of an internal class for vtkCUDALabelMapVolumeMapper which manages the colour, opacity and visibility of the labels
+*
+*/
+
+#include "vtkCUDALabelMapInformationHandler.h"
+#include "vtkObjectFactory.h"
+
+#include "CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo.h"
+#include "cuda_runtime_api.h"
+
+// STD includes
+#include <cstring>
+
+//versions of the uploaded visibility, shared by all the handlers so the ray caster never mistakes one handler's bricks for another's
+static unsigned int vtkCUDALabelMapInformationHandlerVersion = 0;
+
+vtkStandardNewMacro(vtkCUDALabelMapInformationHandler);
+
+vtkCUDALabelMapInformationHandler
+::vtkCUDALabelMapInformationHandler()
+{
+  this->LabelInfo.numberOfLabels = 0;
+  this->LabelInfo.visibilityVersion = 0;
+  this->LabelInfo.colourOpacityArray = 0;
+  this->LabelInfo.colourOpacityTexture = 0;
+  this->LabelInfo.visibility = 0;
+  this->LabelInfo.brickOccupancy = 0;
+  this->LabelInfo.brickGridSize.x = this->LabelInfo.brickGridSize.y = this->LabelInfo.brickGridSize.z = 0;
+
+  this->ColoursModified = false;
+  this->VisibilityModified = false;
+  this->UploadArena = NULL;
+  this->UploadArenaPinned = false;
+  this->ArenaSize = 0;
+  this->UploadEvent = 0;
+  this->CopyStream = 0;
+  this->ReleaseEvent = 0;
+  this->Reinitialize();
+}
+
+vtkCUDALabelMapInformationHandler
+::~vtkCUDALabelMapInformationHandler()
+{
+  this->Deinitialize();
+  this->AllocateArena(0);
+}
+
+void vtkCUDALabelMapInformationHandler
+::Deinitialize(int vtkNotUsed(withData))
+{
+  this->ReserveGPU();
+  if( this->UploadEvent )
+    {
+    cudaEventSynchronize( this->UploadEvent );
+    cudaEventDestroy( this->UploadEvent );
+    this->UploadEvent = 0;
+    }
+  if( this->CopyStream )
+    {
+    cudaStreamDestroy( this->CopyStream );
+    this->CopyStream = 0;
+    }
+  if( this->ReleaseEvent )
+    {
+    cudaEventSynchronize( this->ReleaseEvent );
+    cudaEventDestroy( this->ReleaseEvent );
+    this->ReleaseEvent = 0;
+    }
+  CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_unloadTable( this->LabelInfo, this->GetStream() );
+  this->LabelInfo.numberOfLabels = 0;
+  this->LabelInfo.visibilityVersion = 0;
+}
+
+void vtkCUDALabelMapInformationHandler
+::Reinitialize(int vtkNotUsed(withData))
+{
+  this->ReserveGPU();
+  if( !this->UploadEvent )
+    {
+    cudaEventCreateWithFlags( &this->UploadEvent, cudaEventDisableTiming );
+    }
+  if( !this->CopyStream && cudaStreamCreate( &this->CopyStream ) != cudaSuccess )
+    {
+    //the table is then copied through the default stream, which waits for (and holds up) the rendering
+    cudaGetLastError();
+    this->CopyStream = 0;
+    }
+  if( !this->ReleaseEvent ) cudaEventCreateWithFlags( &this->ReleaseEvent, cudaEventDisableTiming );
+
+  //the table has to go onto the (new) device with the next update
+  this->ColoursModified = !this->Colours.empty();
+}
+
+void vtkCUDALabelMapInformationHandler
+::AcquireTables(cudaStream_t* stream)
+{
+  if( this->UploadEvent ) cudaStreamWaitEvent( *stream, this->UploadEvent, 0 );
+}
+
+void vtkCUDALabelMapInformationHandler
+::ReleaseTables(cudaStream_t* stream)
+{
+  if( this->ReleaseEvent ) cudaEventRecord( this->ReleaseEvent, *stream );
+}
+
+bool vtkCUDALabelMapInformationHandler
+::ReserveLabel(int label)
+{
+  if( label < 0 || label > CUDA_VTKCUDALABELMAPVOLUMEMAPPER_MAX_LABEL )
+    {
+    return false;
+    }
+
+  //labels never given a colour are transparent, and all labels start out visible
+  if( (int) this->Colours.size() < 4 * (label + 1) )
+    {
+    this->Colours.resize( 4 * (label + 1), 0.0f );
+    this->Visibility.resize( (label + 32) / 32, 0xffffffffu );
+    }
+  return true;
+}
+
+void vtkCUDALabelMapInformationHandler
+::SetLabelColour(int label, double r, double g, double b, double opacity)
+{
+  if( !this->ReserveLabel(label) )
+    {
+    vtkErrorMacro(<<"Label " << label << " is out of the range of a label map.");
+    return;
+    }
+  float* colour = &(this->Colours[4*label]);
+  const float newColour[4] = { (float) r, (float) g, (float) b,
+                               (float) ( (opacity < 0.0) ? 0.0 : (opacity > 1.0) ? 1.0 : opacity ) };
+  if( memcmp( colour, newColour, sizeof(newColour) ) == 0 )
+    {
+    return;
+    }
+  memcpy( colour, newColour, sizeof(newColour) );
+  this->ColoursModified = true;
+  this->Modified();
+}
+
+void vtkCUDALabelMapInformationHandler
+::GetLabelColour(int label, double colour[4])
+{
+  for( int i = 0; i < 4; i++ )
+    {
+    colour[i] = ( label >= 0 && 4 * label + i < (int) this->Colours.size() ) ? this->Colours[4*label+i] : 0.0;
+    }
+}
+
+void vtkCUDALabelMapInformationHandler
+::SetLabelVisibility(int label, bool visible)
+{
+  if( !this->ReserveLabel(label) )
+    {
+    vtkErrorMacro(<<"Label " << label << " is out of the range of a label map.");
+    return;
+    }
+  unsigned int& word = this->Visibility[label >> 5];
+  const unsigned int bit = 1u << (label & 31);
+  if( ((word & bit) != 0) == visible )
+    {
+    return;
+    }
+  word = visible ? (word | bit) : (word & ~bit);
+  this->VisibilityModified = true;
+  this->Modified();
+}
+
+bool vtkCUDALabelMapInformationHandler
+::GetLabelVisibility(int label)
+{
+  if( label < 0 || (label >> 5) >= (int) this->Visibility.size() )
+    {
+    return true;
+    }
+  return (this->Visibility[label >> 5] & (1u << (label & 31))) != 0;
+}
+
+void vtkCUDALabelMapInformationHandler
+::AllocateArena(int numberOfLabels)
+{
+  if( numberOfLabels == this->ArenaSize )
+    {
+    return;
+    }
+
+  //the previous copies have to be done with the upload arena before it goes
+  if( this->UploadEvent ) cudaEventSynchronize( this->UploadEvent );
+  if( this->UploadArenaPinned ) cudaFreeHost( this->UploadArena );
+  else delete[] this->UploadArena;
+  this->UploadArena = NULL;
+  this->UploadArenaPinned = false;
+  this->ArenaSize = numberOfLabels;
+  if( numberOfLabels == 0 )
+    {
+    return;
+    }
+
+  //the table then the bitmask, whose words are as large as floats
+  size_t numFloats = 4 * (size_t) numberOfLabels + (numberOfLabels + 31) / 32;
+  this->UploadArenaPinned = (cudaHostAlloc( (void**) &this->UploadArena, sizeof(float) * numFloats, cudaHostAllocPortable ) == cudaSuccess);
+  if( !this->UploadArenaPinned )
+    {
+    cudaGetLastError();
+    this->UploadArena = new float[numFloats];
+    }
+}
+
+void vtkCUDALabelMapInformationHandler::Update()
+{
+  const int numberOfLabels = (int) this->Colours.size() / 4;
+  if( numberOfLabels == 0 || (!this->ColoursModified && !this->VisibilityModified) )
+    {
+    return;
+    }
+  const int numWords = (numberOfLabels + 31) / 32;
+
+  //a new number of labels needs a new table on the device, once the frames in flight are done with the old one
+  this->ReserveGPU();
+  if( (int) this->LabelInfo.numberOfLabels != numberOfLabels )
+    {
+    this->AllocateArena(numberOfLabels);
+    if( this->ReleaseEvent ) cudaEventSynchronize( this->ReleaseEvent );
+    CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_unloadTable( this->LabelInfo, this->GetStream() );
+    this->LabelInfo.numberOfLabels = numberOfLabels;
+    this->ColoursModified = true;
+    }
+
+  //wait for the previous copy out of the upload arena before rewriting it
+  if( this->UploadEvent ) cudaEventSynchronize( this->UploadEvent );
+  float4* colourArena = reinterpret_cast<float4*>(this->UploadArena);
+  unsigned int* visibilityArena = reinterpret_cast<unsigned int*>(this->UploadArena + 4*numberOfLabels);
+  if( this->ColoursModified )
+    {
+    memcpy( colourArena, &(this->Colours[0]), sizeof(float4) * numberOfLabels );
+    }
+
+  //transparent labels are hidden from the ray caster as well, so the bricks holding only those are jumped over
+  for( int word = 0; word < numWords; word++ )
+    {
+    unsigned int bits = this->Visibility[word];
+    for( int bit = 0; bit < 32; bit++ )
+      {
+      const int label = 32 * word + bit;
+      if( label >= numberOfLabels || this->Colours[4*label+3] <= 0.0f )
+        {
+        bits &= ~(1u << bit);
+        }
+      }
+    visibilityArena[word] = bits;
+    }
+
+  //the copy goes through the copy stream once the frames which last read the table are done, a visibility edit only copying the bitmask
+  if( this->ReleaseEvent ) cudaStreamWaitEvent( this->CopyStream, this->ReleaseEvent, 0 );
+  bool loaded = this->ColoursModified ?
+    CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_loadTable( this->LabelInfo, colourArena, visibilityArena, &this->CopyStream ) :
+    CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_loadVisibility( this->LabelInfo, visibilityArena, &this->CopyStream );
+  if( this->UploadEvent ) cudaEventRecord( this->UploadEvent, this->CopyStream );
+  if( !this->UploadArenaPinned )
+    {
+    //pageable copies may still read the arena when they return
+    cudaStreamSynchronize( this->CopyStream );
+    }
+  if( !loaded )
+    {
+    vtkErrorMacro(<<"Could not load the label colours onto the device.");
+    return;
+    }
+
+  this->LabelInfo.visibilityVersion = ++vtkCUDALabelMapInformationHandlerVersion;
+  this->ColoursModified = false;
+  this->VisibilityModified = false;
+}
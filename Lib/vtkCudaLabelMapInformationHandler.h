@@ -0,0 +1,119 @@
+/** @file vtkCUDALabelMapInformationHandler.h
+*
+*  @brief Header file defining an internal class for vtkCUDALabelMapVolumeMapper which manages the colour, opacity and visibility of the labels
+*
+*/
+
+#ifndef __vtkCUDALabelMapInformationHandler_h
+#define __vtkCUDALabelMapInformationHandler_h
+
+// CUDA Volume Rendering includes
+#include "CUDA_containerLabelMapInformation.h"
+#include "vtkCUDAObject.h"
+
+// VTK includes
+#include <vtkObject.h>
+
+// STD includes
+#include <vector>
+
+/** @brief vtkCUDALabelMapInformationHandler keeps the colour table and visibility bitmask of the labels of a label map on the device on behalf of the vtkCUDALabelMapVolumeMapper
+*
+*  @note An edit to the visibility alone only uploads the bitmask, the colour table being uploaded when a colour or opacity changes
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDALabelMapInformationHandler
+  : public vtkObject
+  , public vtkCUDAObject
+{
+public:
+
+  vtkTypeMacro (vtkCUDALabelMapInformationHandler,vtkObject);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDALabelMapInformationHandler* New();
+
+  /** @brief Gets the CUDA compatible container for label related information needed during the rendering process
+  *
+  */
+  const cudaLabelMapInformation& GetLabelMapInfo() const { return (this->LabelInfo); }
+
+  /** @brief Makes the work queued on a stream from now on wait until the table and bitmask are on the device
+  *
+  */
+  void AcquireTables(cudaStream_t* stream);
+
+  /** @brief Marks the table and bitmask as read by the work queued on a stream so far, so that they are not rewritten before that work has finished
+  *
+  */
+  void ReleaseTables(cudaStream_t* stream);
+
+  /** @brief Sets the colour and opacity of a label, each between 0 and 1
+  *
+  *  @param label A label between 0 and 65535, labels never given a colour being transparent
+  */
+  void SetLabelColour(int label, double r, double g, double b, double opacity);
+  void GetLabelColour(int label, double colour[4]);
+
+  /** @brief Sets whether a label is shown, all labels being visible until hidden
+  *
+  *  @param label A label between 0 and 65535
+  */
+  void SetLabelVisibility(int label, bool visible);
+  bool GetLabelVisibility(int label);
+
+  /** @brief Triggers an update for the labels, uploading the colour table or only the visibility bitmask depending on what changed
+  *
+  */
+  virtual void Update();
+
+protected:
+
+  /** @brief Constructor which sets the labels to none and the table to unallocated
+  *
+  */
+  vtkCUDALabelMapInformationHandler();
+
+  /** @brief Destructor which releases the table and bitmask on the host and the GPU
+  *
+  */
+  ~vtkCUDALabelMapInformationHandler();
+
+  /** @brief Grows the host table and bitmask to hold a label, returning whether the label is in range
+  *
+  */
+  bool ReserveLabel(int label);
+
+  /** @brief Reallocates the upload arena for a number of labels
+  *
+  */
+  void AllocateArena(int numberOfLabels);
+
+  void Deinitialize(int withData = 0);
+  void Reinitialize(int withData = 0);
+
+private:
+  vtkCUDALabelMapInformationHandler& operator=(const vtkCUDALabelMapInformationHandler&); /**< Not implemented */
+  vtkCUDALabelMapInformationHandler(const vtkCUDALabelMapInformationHandler&); /**< Not implemented */
+
+private:
+
+  cudaLabelMapInformation  LabelInfo;  /**< The CUDA specific structure holding the required label related information for rendering */
+
+  std::vector<float>        Colours;    /**< Colour and opacity of each label, as 4 floats per label */
+  std::vector<unsigned int> Visibility; /**< Whether each label is shown, as one bit per label */
+  bool            ColoursModified;      /**< Whether a colour or opacity changed since the last upload of the table */
+  bool            VisibilityModified;   /**< Whether the visibility changed since the last upload of the bitmask */
+
+  float*          UploadArena;    /**< (Preferably pinned) copy of the table then the bitmask on the device, which the copies read from */
+  bool            UploadArenaPinned; /**< Whether the upload arena is pinned */
+  int             ArenaSize;      /**< The number of labels the arena is allocated for */
+  cudaEvent_t     UploadEvent;    /**< Recorded after the last copy out of the upload arena */
+  cudaStream_t    CopyStream;     /**< The stream the table and bitmask are copied through, apart from the rendering */
+  cudaEvent_t     ReleaseEvent;   /**< Recorded after the last work reading the table and bitmask */
+
+};
+
+#endif
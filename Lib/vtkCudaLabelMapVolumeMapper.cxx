@@ -0,0 +1,182 @@
+/** @file vtkCUDALabelMapVolumeMapper.cxx
+*
+*  @brief Implementation of a volume mapper (ray caster) rendering integer label maps with a colour, opacity and visibility per label
+*
+*/
+
+// Type
+#include "vtkCUDALabelMapVolumeMapper.h"
+#include "vtkCUDALabelMapInformationHandler.h"
+
+// CUDA Volume Rendering includes
+#include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
+#include "CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo.h"
+#include "vtkCUDAVolumeInformationHandler.h"
+
+// VTK includes
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+vtkStandardNewMacro(vtkCUDALabelMapVolumeMapper);
+
+vtkCUDALabelMapVolumeMapper::vtkCUDALabelMapVolumeMapper()
+  {
+  this->SixteenBitLabels = false;
+  this->labelMapInfoHandler = vtkCUDALabelMapInformationHandler::New();
+  this->labelMapInfoHandler->ReplicateObject(this);
+  }
+
+vtkCUDALabelMapVolumeMapper::~vtkCUDALabelMapVolumeMapper()
+  {
+  this->labelMapInfoHandler->UnRegister( this );
+  }
+
+void vtkCUDALabelMapVolumeMapper::Reinitialize(int withData)
+  {
+  this->vtkCUDA1DVolumeMapper::Reinitialize(withData);
+  this->labelMapInfoHandler->ReplicateObject(this, withData);
+  }
+
+void vtkCUDALabelMapVolumeMapper::SetInputInternal(vtkImageData * input, int index)
+  {
+
+  //the coarser levels would average labels into ones found nowhere in the map, so only the full resolution is kept
+  if( this->VolumeInfoHandler->GetLevelOfDetail() != 0 )
+    {
+    this->VolumeInfoHandler->SetNumberOfLevelsOfDetail(1);
+    this->volModified = 0;
+    }
+
+  //8 bits hold byte inputs and any input labelled up to 255, the range of a live volume or of a buffer (whose image holds no scalars)
+  //not being known until it is streamed
+  const bool live = this->IsLiveInput(input);
+  vtkDataArray* scalars = input->GetPointData() ? input->GetPointData()->GetScalars() : 0;
+  this->SixteenBitLabels = ( input->GetScalarSize() > 1 && (live || !scalars || scalars->GetRange(0)[1] > 255.0) );
+
+  //allocate the labels in place of the float volume, the staging staying in full precision as the labels are rounded out of it on the host
+  if(!this->erroredOut)
+    {
+    this->ChooseUploadFormat(input);
+    this->UploadHalfPrecision = false;
+    this->ReserveGPU();
+    this->erroredOut = !CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_allocateLabels( this->VolumeData, VolumeInfoHandler->GetVolumeInfo(),
+      this->SixteenBitLabels, this->GetStream());
+    }
+  if(!this->erroredOut)
+    {
+    this->erroredOut = !this->StreamInput(input);
+    }
+  if( !this->erroredOut && this->SixteenBitLabels && this->GetInputScalarRange()[1] > CUDA_VTKCUDALABELMAPVOLUMEMAPPER_MAX_LABEL )
+    {
+    vtkWarningMacro(<<"The label map holds labels above " << CUDA_VTKCUDALABELMAPVOLUMEMAPPER_MAX_LABEL << ", which are clamped.");
+    }
+
+  //find the range of labels in each brick so the ray caster can jump over those without a visible label,
+  //which a live volume does without as its slices keep changing
+  if(!this->erroredOut && !live)
+    {
+    const int* dims = this->VolumeInfoHandler->GetDimensions();
+    int3 volumeSize;
+    volumeSize.x = dims[0];
+    volumeSize.y = dims[1];
+    volumeSize.z = dims[2];
+    CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_buildBricks(this->VolumeData, volumeSize, this->GetStream());
+    }
+
+  if(!this->erroredOut)
+    {
+    this->VolumeInfoHandler->SetNumberOfLevelsOfDetail(1);
+    this->ChangeLevelInternal(this->VolumeInfoHandler->GetLevelOfDetail());
+    }
+  }
+
+//rounds the floats of a slab to labels in place, each label taking no more room than the float it is read from
+template< class T >
+static void vtkCUDALabelMapVolumeMapperRoundLabels( void* slab, vtkIdType numVoxels, float maxLabel )
+  {
+  const float* values = static_cast<const float*>(slab);
+  T* labels = static_cast<T*>(slab);
+  for( vtkIdType i = 0; i < numVoxels; i++ )
+    {
+    float value = values[i];
+    value = (value < 0.0f) ? 0.0f : (value > maxLabel) ? maxLabel : value;
+    labels[i] = static_cast<T>( value + 0.5f );
+    }
+  }
+
+bool vtkCUDALabelMapVolumeMapper::UploadSlabInternal(void* slab, int firstSlice, int numSlices, int channel)
+  {
+  const int* dims = this->VolumeInfoHandler->GetDimensions();
+  const vtkIdType numVoxels = (vtkIdType) dims[0] * dims[1] * numSlices;
+  if( this->SixteenBitLabels )
+    {
+    vtkCUDALabelMapVolumeMapperRoundLabels<unsigned short>( slab, numVoxels, (float) CUDA_VTKCUDALABELMAPVOLUMEMAPPER_MAX_LABEL );
+    }
+  else
+    {
+    vtkCUDALabelMapVolumeMapperRoundLabels<unsigned char>( slab, numVoxels, 255.0f );
+    }
+  return this->vtkCUDA1DVolumeMapper::UploadSlabInternal(slab, firstSlice, numSlices, channel);
+  }
+
+vtkTypeUInt64 vtkCUDALabelMapVolumeMapper::GetDeviceBytesInternal(const int dims[3], int vtkNotUsed(voxelSize), bool live)
+  {
+  //the labels take their own width whatever the staging, and have no mip pyramid
+  vtkTypeUInt64 bytes = (vtkTypeUInt64) dims[0] * dims[1] * dims[2] * (this->SixteenBitLabels ? sizeof(unsigned short) : sizeof(unsigned char));
+  if( !live )
+    {
+    vtkTypeUInt64 numBricks = 1;
+    for( int i = 0; i < 3; i++ )
+      {
+      numBricks *= (dims[i] + CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1) / CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE;
+      }
+    bytes += numBricks * (sizeof(float2) + CUDA_VTKCUDA1DVOLUMEMAPPER_OCCUPANCY_SLOTS);
+    }
+  return bytes;
+  }
+
+void vtkCUDALabelMapVolumeMapper::SetLabelColour(int label, double r, double g, double b, double opacity)
+  {
+  this->labelMapInfoHandler->SetLabelColour(label, r, g, b, opacity);
+  this->Modified();
+  }
+
+void vtkCUDALabelMapVolumeMapper::GetLabelColour(int label, double colour[4])
+  {
+  this->labelMapInfoHandler->GetLabelColour(label, colour);
+  }
+
+void vtkCUDALabelMapVolumeMapper::SetLabelVisibility(int label, bool visible)
+  {
+  this->labelMapInfoHandler->SetLabelVisibility(label, visible);
+  this->Modified();
+  }
+
+bool vtkCUDALabelMapVolumeMapper::GetLabelVisibility(int label)
+  {
+  return this->labelMapInfoHandler->GetLabelVisibility(label);
+  }
+
+void vtkCUDALabelMapVolumeMapper::InternalRender (  vtkRenderer* vtkNotUsed(ren), vtkVolume* vtkNotUsed(vol),
+                                            const cudaRendererInformation& rendererInfo,
+                                            const cudaVolumeInformation& volumeInfo,
+                                            const cudaOutputImageInformation& outputInfo )
+{
+  //handle the label changes
+  this->labelMapInfoHandler->Update();
+  if( !this->labelMapInfoHandler->GetLabelMapInfo().visibility )
+    {
+    vtkErrorMacro(<<"No label has been given a colour.");
+    return;
+    }
+
+  //perform the render once the table and bitmask are on the device
+  this->ReserveGPU();
+  this->labelMapInfoHandler->AcquireTables( this->GetStream() );
+  this->erroredOut = !CUDA_vtkCUDALabelMapVolumeMapper_renderAlgo_doRender(this->VolumeData, outputInfo, rendererInfo, volumeInfo,
+                     this->labelMapInfoHandler->GetLabelMapInfo(), this->GetStream());
+  this->labelMapInfoHandler->ReleaseTables( this->GetStream() );
+
+}
@@ -0,0 +1,78 @@
+/** @file vtkCUDALabelMapVolumeMapper.h
+*
+*  @brief Header file defining a volume mapper (ray caster) rendering integer label maps with a colour, opacity and visibility per label
+*
+*/
+
+#ifndef __vtkCUDALabelMapVolumeMapper_h
+#define __vtkCUDALabelMapVolumeMapper_h
+
+#include "vtkCUDA1DVolumeMapper.h"
+class vtkCUDALabelMapInformationHandler;
+
+/** @brief vtkCUDALabelMapVolumeMapper is a volume mapper for label maps such as segmentations, fetching the label of each sample without interpolation and colouring it by a table of labels rather than the transfer functions of the volume property
+*
+*  @note The volume is streamed up as by the vtkCUDA1DVolumeMapper, each slab being rounded on the host into a native 8 bit (or 16 bit, for labels above 255) volume owned by the mapper, with no float copy on the device
+*  @note Labels are only rendered at full resolution, as the levels of the mip pyramid average neighbouring labels together
+*  @note Bricks holding no visible label are jumped over, and hiding or showing a label only uploads a bitmask of the visible labels
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDALabelMapVolumeMapper
+  : public vtkCUDA1DVolumeMapper
+{
+public:
+
+  vtkTypeMacro (vtkCUDALabelMapVolumeMapper,vtkCUDA1DVolumeMapper);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDALabelMapVolumeMapper *New();
+
+  /** @brief Sets the colour and opacity of a label, each between 0 and 1
+  *
+  *  @param label A label between 0 and 65535, labels never given a colour being transparent
+  *
+  *  @note The volume property still provides the shading parameters, its colour and opacity functions being ignored
+  */
+  void SetLabelColour(int label, double r, double g, double b, double opacity);
+  void GetLabelColour(int label, double colour[4]);
+
+  /** @brief Sets whether a label is shown, all labels being visible until hidden
+  *
+  *  @param label A label between 0 and 65535
+  */
+  void SetLabelVisibility(int label, bool visible);
+  bool GetLabelVisibility(int label);
+
+  virtual void SetInputInternal( vtkImageData * image, int frame);
+  virtual void InternalRender (  vtkRenderer* ren, vtkVolume* vol,
+    const cudaRendererInformation& rendererInfo,
+    const cudaVolumeInformation& volumeInfo,
+    const cudaOutputImageInformation& outputInfo );
+
+protected:
+  /** @brief Constructor which creates the label handler
+  *
+  */
+  vtkCUDALabelMapVolumeMapper();
+
+  /** @brief Destructor which deallocates the label handler, the labels on the GPU being freed with the volume of the 1D ray caster
+  *
+  */
+  ~vtkCUDALabelMapVolumeMapper();
+  virtual void Reinitialize(int withData = 0);
+  virtual bool UploadSlabInternal(void* slab, int firstSlice, int numSlices, int channel);
+  virtual vtkTypeUInt64 GetDeviceBytesInternal(const int dims[3], int voxelSize, bool live);
+
+  vtkCUDALabelMapInformationHandler* labelMapInfoHandler;
+
+  bool  SixteenBitLabels;  /**< Whether the labels of the input need 16 bits */
+
+private:
+  vtkCUDALabelMapVolumeMapper operator=(const vtkCUDALabelMapVolumeMapper&); /**< not implemented */
+  vtkCUDALabelMapVolumeMapper(const vtkCUDALabelMapVolumeMapper&); /**< not implemented */
+
+};
+
+#endif
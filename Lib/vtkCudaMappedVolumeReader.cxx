@@ -0,0 +1,496 @@
+/** @file vtkCUDAMappedVolumeReader.cxx
+*
+*  @brief Implementation of a reader which memory maps uncompressed raw, NRRD and MetaImage volumes
+*
+*/
+
+#include "vtkCUDAMappedVolumeReader.h"
+
+// VTK includes
+#include <vtkByteSwap.h>
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkPointData.h>
+
+// STD includes
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+// Memory mapping includes
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+vtkStandardNewMacro(vtkCUDAMappedVolumeReader);
+
+//----------------------------------------------------------------------------
+// Header parsing helpers
+
+enum { FORMAT_RAW = 0, FORMAT_NRRD, FORMAT_METAIMAGE };
+
+static std::string vtkCUDAMappedVolumeReaderTrim(const std::string& str)
+  {
+  size_t first = str.find_first_not_of(" \t\r\n");
+  if( first == std::string::npos ) return std::string();
+  size_t last = str.find_last_not_of(" \t\r\n");
+  return str.substr(first, last - first + 1);
+  }
+
+static std::string vtkCUDAMappedVolumeReaderLower(const std::string& str)
+  {
+  std::string lower = str;
+  for( size_t i = 0; i < lower.size(); i++ )
+    lower[i] = (char) tolower(lower[i]);
+  return lower;
+  }
+
+static int vtkCUDAMappedVolumeReaderFormat(const char* fname)
+  {
+  std::ifstream file(fname, std::ios::in | std::ios::binary);
+  if( !file.good() ) return FORMAT_RAW;
+  std::string line;
+  std::getline(file, line);
+  if( line.compare(0, 4, "NRRD") == 0 ) return FORMAT_NRRD;
+
+  //MetaImage headers start with one of their tags rather than a magic number
+  for( int i = 0; i < 4 && file.good(); i++ )
+    {
+    std::string tag = vtkCUDAMappedVolumeReaderTrim(line.substr(0, line.find('=')));
+    if( tag == "ObjectType" || tag == "NDims" || tag == "DimSize" ) return FORMAT_METAIMAGE;
+    std::getline(file, line);
+    }
+  return FORMAT_RAW;
+  }
+
+static std::string vtkCUDAMappedVolumeReaderSiblingFile(const std::string& header, const std::string& name)
+  {
+  //detached data files are relative to the header unless given as absolute paths
+  if( name.empty() || name[0] == '/' || name[0] == '\\' || (name.size() > 1 && name[1] == ':') ) return name;
+  size_t slash = header.find_last_of("/\\");
+  if( slash == std::string::npos ) return name;
+  return header.substr(0, slash + 1) + name;
+  }
+
+static vtkTypeUInt64 vtkCUDAMappedVolumeReaderFileSize(const char* fname)
+  {
+#ifdef _WIN32
+  struct _stati64 info;
+  if( _stati64(fname, &info) != 0 ) return 0;
+#else
+  struct stat info;
+  if( stat(fname, &info) != 0 ) return 0;
+#endif
+  return (vtkTypeUInt64) info.st_size;
+  }
+
+static int vtkCUDAMappedVolumeReaderNRRDType(const std::string& type)
+  {
+  if( type == "signed char" || type == "int8" || type == "int8_t" ) return VTK_SIGNED_CHAR;
+  if( type == "uchar" || type == "unsigned char" || type == "uint8" || type == "uint8_t" ) return VTK_UNSIGNED_CHAR;
+  if( type == "short" || type == "short int" || type == "signed short" || type == "signed short int" ||
+      type == "int16" || type == "int16_t" ) return VTK_SHORT;
+  if( type == "ushort" || type == "unsigned short" || type == "unsigned short int" ||
+      type == "uint16" || type == "uint16_t" ) return VTK_UNSIGNED_SHORT;
+  if( type == "int" || type == "signed int" || type == "int32" || type == "int32_t" ) return VTK_INT;
+  if( type == "uint" || type == "unsigned int" || type == "uint32" || type == "uint32_t" ) return VTK_UNSIGNED_INT;
+  if( type == "float" ) return VTK_FLOAT;
+  if( type == "double" ) return VTK_DOUBLE;
+  return VTK_VOID;
+  }
+
+static int vtkCUDAMappedVolumeReaderMetaImageType(const std::string& type)
+  {
+  if( type == "MET_CHAR" ) return VTK_SIGNED_CHAR;
+  if( type == "MET_UCHAR" ) return VTK_UNSIGNED_CHAR;
+  if( type == "MET_SHORT" ) return VTK_SHORT;
+  if( type == "MET_USHORT" ) return VTK_UNSIGNED_SHORT;
+  if( type == "MET_INT" ) return VTK_INT;
+  if( type == "MET_UINT" ) return VTK_UNSIGNED_INT;
+  if( type == "MET_FLOAT" ) return VTK_FLOAT;
+  if( type == "MET_DOUBLE" ) return VTK_DOUBLE;
+  return VTK_VOID;
+  }
+
+static int vtkCUDAMappedVolumeReaderTypeSize(int type)
+  {
+  switch( type )
+    {
+    case VTK_SIGNED_CHAR: case VTK_UNSIGNED_CHAR: return 1;
+    case VTK_SHORT: case VTK_UNSIGNED_SHORT: return 2;
+    case VTK_INT: case VTK_UNSIGNED_INT: case VTK_FLOAT: return 4;
+    case VTK_DOUBLE: return 8;
+    default: return 0;
+    }
+  }
+
+static bool vtkCUDAMappedVolumeReaderHostIsBigEndian()
+  {
+#ifdef VTK_WORDS_BIGENDIAN
+  return true;
+#else
+  return false;
+#endif
+  }
+
+//----------------------------------------------------------------------------
+vtkCUDAMappedVolumeReader::vtkCUDAMappedVolumeReader()
+  {
+  this->FileDimensionality = 3;
+  this->DataOffset = 0;
+  this->Encoding = ENCODING_RAW;
+  this->CompressedSize = 0;
+  this->HeaderParsed = false;
+  this->MappedBase = NULL;
+  this->MappedLength = 0;
+  }
+
+vtkCUDAMappedVolumeReader::~vtkCUDAMappedVolumeReader()
+  {
+  this->UnmapDataFile();
+  }
+
+void vtkCUDAMappedVolumeReader::PrintSelf(ostream& os, vtkIndent indent)
+  {
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "DataFileName: " << this->DataFileName << "\n";
+  os << indent << "DataOffset: " << this->DataOffset << "\n";
+  os << indent << "Encoding: " << this->Encoding << "\n";
+  os << indent << "MappedLength: " << this->MappedLength << "\n";
+  }
+
+int vtkCUDAMappedVolumeReader::CanReadFile(const char* fname)
+  {
+  return (vtkCUDAMappedVolumeReaderFormat(fname) != FORMAT_RAW) ? 3 : 0;
+  }
+
+void vtkCUDAMappedVolumeReader::ExecuteInformation()
+  {
+  this->HeaderParsed = false;
+  this->DataOffset = 0;
+  this->Encoding = ENCODING_RAW;
+  this->CompressedSize = 0;
+  this->DataFileName = this->FileName ? this->FileName : "";
+  if( !this->FileName )
+    {
+    vtkErrorMacro(<<"A file name must be specified.");
+    return;
+    }
+
+  int format = vtkCUDAMappedVolumeReaderFormat(this->FileName);
+  if( format == FORMAT_NRRD ) this->HeaderParsed = this->ReadNRRDHeader();
+  else if( format == FORMAT_METAIMAGE ) this->HeaderParsed = this->ReadMetaImageHeader();
+  else this->DataOffset = this->GetHeaderSize();
+
+  if( format != FORMAT_RAW && !this->HeaderParsed )
+    {
+    vtkErrorMacro(<<"Cannot map " << this->FileName << ", only uncompressed 3D volumes held in a single file are supported.");
+    return;
+    }
+  if( !this->CanReadEncoding(this->Encoding) )
+    {
+    vtkErrorMacro(<<"Cannot map " << this->FileName << " as it is compressed, which vtkCUDACompressedVolumeReader reads.");
+    this->HeaderParsed = false;
+    return;
+    }
+
+  this->Superclass::ExecuteInformation();
+  }
+
+bool vtkCUDAMappedVolumeReader::ReadNRRDHeader()
+  {
+  std::ifstream file(this->FileName, std::ios::in | std::ios::binary);
+  std::string line;
+  std::getline(file, line);
+
+  int dimension = 0;
+  int type = VTK_VOID;
+  std::vector<int> sizes;
+  std::vector<double> spacings;
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  bool bigEndian = false;
+  std::string dataFile;
+  long long byteSkip = 0;
+
+  //the header ends at the first empty line, where attached data begins
+  while( std::getline(file, line) )
+    {
+    line = vtkCUDAMappedVolumeReaderTrim(line);
+    if( line.empty() ) break;
+    if( line[0] == '#' ) continue;
+    size_t colon = line.find(": ");
+    if( colon == std::string::npos ) continue;
+    std::string field = vtkCUDAMappedVolumeReaderLower(line.substr(0, colon));
+    std::string value = vtkCUDAMappedVolumeReaderTrim(line.substr(colon + 2));
+
+    //vectors are written as (x,y,z), which reads as three numbers once the punctuation is gone
+    std::string numbers = value;
+    std::replace(numbers.begin(), numbers.end(), '(', ' ');
+    std::replace(numbers.begin(), numbers.end(), ')', ' ');
+    std::replace(numbers.begin(), numbers.end(), ',', ' ');
+    std::istringstream stream(numbers);
+
+    if( field == "type" ) type = vtkCUDAMappedVolumeReaderNRRDType(vtkCUDAMappedVolumeReaderLower(value));
+    else if( field == "dimension" ) stream >> dimension;
+    else if( field == "sizes" )
+      {
+      int size;
+      while( stream >> size ) sizes.push_back(size);
+      }
+    else if( field == "spacings" )
+      {
+      std::string token;
+      while( stream >> token ) spacings.push_back( atof(token.c_str()) );
+      }
+    else if( field == "space directions" )
+      {
+      //the spacing of each axis is the length of its direction, "none" marking a non-spatial axis
+      spacings.clear();
+      size_t pos = 0;
+      while( pos < value.size() )
+        {
+        size_t first = value.find_first_of("(n", pos);
+        if( first == std::string::npos ) break;
+        if( value[first] == 'n' )
+          {
+          spacings.push_back(0.0);
+          pos = first + 4;
+          continue;
+          }
+        size_t last = value.find(')', first);
+        if( last == std::string::npos ) break;
+        std::string direction = value.substr(first + 1, last - first - 1);
+        std::replace(direction.begin(), direction.end(), ',', ' ');
+        std::istringstream components(direction);
+        double c[3] = { 0.0, 0.0, 0.0 };
+        components >> c[0] >> c[1] >> c[2];
+        spacings.push_back( sqrt(c[0]*c[0] + c[1]*c[1] + c[2]*c[2]) );
+        pos = last + 1;
+        }
+      }
+    else if( field == "space origin" ) stream >> origin[0] >> origin[1] >> origin[2];
+    else if( field == "encoding" )
+      {
+      std::string encoding = vtkCUDAMappedVolumeReaderLower(value);
+      if( encoding == "gzip" || encoding == "gz" ) this->Encoding = ENCODING_ZLIB;
+      else if( encoding == "zstd" ) this->Encoding = ENCODING_ZSTD;
+      else if( encoding != "raw" ) return false;
+      }
+    else if( field == "endian" ) bigEndian = (vtkCUDAMappedVolumeReaderLower(value) == "big");
+    else if( field == "data file" || field == "datafile" ) dataFile = value;
+    else if( field == "byte skip" || field == "byteskip" ) stream >> byteSkip;
+    else if( (field == "line skip" || field == "lineskip") && atoi(value.c_str()) != 0 ) return false;
+    }
+  vtkTypeUInt64 headerEnd = file.good() ? (vtkTypeUInt64) file.tellg() : 0;
+
+  //only 3D volumes, optionally with their components along the first axis, can be mapped
+  if( type == VTK_VOID || (dimension != 3 && dimension != 4) || (int) sizes.size() != dimension ) return false;
+  if( dataFile.find(' ') != std::string::npos || dataFile == "LIST" ) return false;
+  int firstAxis = dimension - 3;
+  for( int i = 0; i < 3; i++ )
+    {
+    this->DataExtent[2*i] = 0;
+    this->DataExtent[2*i+1] = sizes[firstAxis + i] - 1;
+    this->DataSpacing[i] = ((int) spacings.size() == dimension && spacings[firstAxis + i] > 0.0) ? spacings[firstAxis + i] : 1.0;
+    this->DataOrigin[i] = origin[i];
+    }
+  this->DataScalarType = type;
+  this->NumberOfScalarComponents = (dimension == 4) ? sizes[0] : 1;
+  this->SwapBytes = (bigEndian != vtkCUDAMappedVolumeReaderHostIsBigEndian()) ? 1 : 0;
+
+  //the byte skip of compressed data applies to the decompressed voxels, which is not supported
+  if( this->Encoding != ENCODING_RAW && byteSkip != 0 ) return false;
+
+  //a byte skip of -1 places the data at the end of the file
+  vtkTypeUInt64 dataSize = (vtkTypeUInt64) sizes[0] * sizes[1] * sizes[2] * (dimension == 4 ? sizes[3] : 1) *
+    vtkCUDAMappedVolumeReaderTypeSize(type);
+  if( dataFile.empty() )
+    {
+    this->DataFileName = this->FileName;
+    this->DataOffset = (byteSkip < 0) ? vtkCUDAMappedVolumeReaderFileSize(this->FileName) - dataSize : headerEnd + byteSkip;
+    }
+  else
+    {
+    this->DataFileName = vtkCUDAMappedVolumeReaderSiblingFile(this->FileName, dataFile);
+    this->DataOffset = (byteSkip < 0) ? vtkCUDAMappedVolumeReaderFileSize(this->DataFileName.c_str()) - dataSize : byteSkip;
+    }
+
+  //compressed data runs up to the end of the file
+  if( this->Encoding != ENCODING_RAW )
+    {
+    this->CompressedSize = vtkCUDAMappedVolumeReaderFileSize(this->DataFileName.c_str()) - this->DataOffset;
+    }
+  return true;
+  }
+
+bool vtkCUDAMappedVolumeReader::ReadMetaImageHeader()
+  {
+  std::ifstream file(this->FileName, std::ios::in | std::ios::binary);
+  std::string line;
+
+  int dimension = 0;
+  int type = VTK_VOID;
+  int components = 1;
+  int sizes[3] = { 0, 0, 0 };
+  double spacing[3] = { 1.0, 1.0, 1.0 };
+  double origin[3] = { 0.0, 0.0, 0.0 };
+  bool bigEndian = false;
+  long long headerSize = 0;
+  long long compressedSize = 0;
+  std::string dataFile;
+
+  //ElementDataFile is always the last tag, attached data following it directly
+  while( dataFile.empty() && std::getline(file, line) )
+    {
+    size_t equals = line.find('=');
+    if( equals == std::string::npos ) continue;
+    std::string tag = vtkCUDAMappedVolumeReaderTrim(line.substr(0, equals));
+    std::string value = vtkCUDAMappedVolumeReaderTrim(line.substr(equals + 1));
+    std::istringstream stream(value);
+
+    if( tag == "NDims" ) stream >> dimension;
+    else if( tag == "DimSize" ) stream >> sizes[0] >> sizes[1] >> sizes[2];
+    else if( tag == "ElementSpacing" ) stream >> spacing[0] >> spacing[1] >> spacing[2];
+    else if( tag == "Offset" || tag == "Origin" || tag == "Position" ) stream >> origin[0] >> origin[1] >> origin[2];
+    else if( tag == "ElementType" ) type = vtkCUDAMappedVolumeReaderMetaImageType(value);
+    else if( tag == "ElementNumberOfChannels" ) stream >> components;
+    else if( tag == "BinaryDataByteOrderMSB" || tag == "ElementByteOrderMSB" ) bigEndian = (vtkCUDAMappedVolumeReaderLower(value) == "true");
+    else if( tag == "CompressedData" && vtkCUDAMappedVolumeReaderLower(value) == "true" ) this->Encoding = ENCODING_ZLIB;
+    else if( tag == "CompressedDataSize" ) stream >> compressedSize;
+    else if( tag == "HeaderSize" ) stream >> headerSize;
+    else if( tag == "ElementDataFile" ) dataFile = value;
+    }
+  vtkTypeUInt64 headerEnd = file.good() ? (vtkTypeUInt64) file.tellg() : 0;
+
+  if( type == VTK_VOID || dimension != 3 || components < 1 || dataFile.empty() ) return false;
+  if( dataFile == "LIST" || dataFile.find(' ') != std::string::npos || dataFile.find('%') != std::string::npos ) return false;
+  for( int i = 0; i < 3; i++ )
+    {
+    this->DataExtent[2*i] = 0;
+    this->DataExtent[2*i+1] = sizes[i] - 1;
+    this->DataSpacing[i] = spacing[i];
+    this->DataOrigin[i] = origin[i];
+    }
+  this->DataScalarType = type;
+  this->NumberOfScalarComponents = components;
+  this->SwapBytes = (bigEndian != vtkCUDAMappedVolumeReaderHostIsBigEndian()) ? 1 : 0;
+
+  //a header size of -1 places the data at the end of the file
+  vtkTypeUInt64 dataSize = (vtkTypeUInt64) sizes[0] * sizes[1] * sizes[2] * components * vtkCUDAMappedVolumeReaderTypeSize(type);
+  if( dataFile == "LOCAL" )
+    {
+    this->DataFileName = this->FileName;
+    this->DataOffset = headerEnd;
+    }
+  else
+    {
+    this->DataFileName = vtkCUDAMappedVolumeReaderSiblingFile(this->FileName, dataFile);
+    this->DataOffset = (headerSize < 0) ? vtkCUDAMappedVolumeReaderFileSize(this->DataFileName.c_str()) - dataSize : headerSize;
+    }
+
+  //compressed data runs up to the end of the file unless its size is given
+  if( this->Encoding != ENCODING_RAW )
+    {
+    if( headerSize < 0 ) return false;
+    vtkTypeUInt64 available = vtkCUDAMappedVolumeReaderFileSize(this->DataFileName.c_str()) - this->DataOffset;
+    this->CompressedSize = (compressedSize > 0 && (vtkTypeUInt64) compressedSize < available) ? (vtkTypeUInt64) compressedSize : available;
+    }
+  return true;
+  }
+
+void vtkCUDAMappedVolumeReader::ExecuteData(vtkDataObject* output)
+  {
+  vtkImageData* data = vtkImageData::SafeDownCast(output);
+  if( !data || this->DataFileName.empty() ) return;
+
+  //drop the scalars of the previous file before its mapping goes away
+  data->GetPointData()->SetScalars(NULL);
+  data->SetExtent(this->DataExtent);
+
+  vtkDataArray* scalars = vtkDataArray::CreateDataArray(this->DataScalarType);
+  if( !scalars )
+    {
+    vtkErrorMacro(<<"Unsupported scalar type.");
+    return;
+    }
+  vtkIdType numValues = (vtkIdType) (this->DataExtent[1] - this->DataExtent[0] + 1) *
+                                    (this->DataExtent[3] - this->DataExtent[2] + 1) *
+                                    (this->DataExtent[5] - this->DataExtent[4] + 1) *
+                                    this->NumberOfScalarComponents;
+  int wordSize = scalars->GetDataTypeSize();
+  void* voxels = this->MapDataFile(this->DataOffset, (vtkTypeUInt64) numValues * wordSize);
+  if( !voxels )
+    {
+    vtkErrorMacro(<<"Could not map " << numValues << " voxels from " << this->DataFileName << ".");
+    scalars->Delete();
+    return;
+    }
+
+  //the pages are copy-on-write, so swapping only copies the data in the other byte order
+  if( this->SwapBytes && wordSize > 1 )
+    {
+    vtkByteSwap::SwapVoidRange(voxels, numValues, wordSize);
+    }
+
+  //hand the mapped voxels to the output without copying them
+  scalars->SetNumberOfComponents(this->NumberOfScalarComponents);
+  scalars->SetVoidArray(voxels, numValues, 1);
+  scalars->SetName("ImageFile");
+  data->GetPointData()->SetScalars(scalars);
+  scalars->Delete();
+  }
+
+void* vtkCUDAMappedVolumeReader::MapDataFile(vtkTypeUInt64 offset, vtkTypeUInt64 length)
+  {
+  this->UnmapDataFile();
+  if( offset + length > vtkCUDAMappedVolumeReaderFileSize(this->DataFileName.c_str()) ) return NULL;
+
+  //map from the start of the file, as mappings have to begin on a page boundary
+  size_t mapLength = (size_t) (offset + length);
+#ifdef _WIN32
+  HANDLE file = CreateFileA(this->DataFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                            OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if( file == INVALID_HANDLE_VALUE ) return NULL;
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+  CloseHandle(file);
+  if( !mapping ) return NULL;
+  void* base = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, mapLength);
+  CloseHandle(mapping);
+  if( !base ) return NULL;
+#else
+  int file = open(this->DataFileName.c_str(), O_RDONLY);
+  if( file < 0 ) return NULL;
+  void* base = mmap(NULL, mapLength, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+  close(file);
+  if( base == MAP_FAILED ) return NULL;
+
+  //the mappers walk the volume a slab at a time, so let the kernel read ahead
+  madvise(base, mapLength, MADV_SEQUENTIAL);
+#endif
+
+  this->MappedBase = base;
+  this->MappedLength = mapLength;
+  return (char*) base + offset;
+  }
+
+void vtkCUDAMappedVolumeReader::UnmapDataFile()
+  {
+  if( !this->MappedBase ) return;
+#ifdef _WIN32
+  UnmapViewOfFile(this->MappedBase);
+#else
+  munmap(this->MappedBase, (size_t) this->MappedLength);
+#endif
+  this->MappedBase = NULL;
+  this->MappedLength = 0;
+  }
@@ -0,0 +1,122 @@
+/** @file vtkCUDAMappedVolumeReader.h
+*
+*  @brief Header file defining a reader which memory maps uncompressed raw, NRRD and MetaImage volumes
+*
+*  @note The output image shares the pages of the mapped file rather than holding its own copy of the voxels
+*
+*/
+
+#ifndef __vtkCUDAMappedVolumeReader_h
+#define __vtkCUDAMappedVolumeReader_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+
+// VTK includes
+#include <vtkImageReader2.h>
+
+// STD includes
+#include <string>
+
+/** @brief vtkCUDAMappedVolumeReader reads uncompressed volumes by mapping the file into memory, so the CUDA
+*   volume mappers convert and upload the voxels page by page straight from the file (or the page cache)
+*   instead of from a full copy of the volume in RAM.
+*
+*   NRRD (.nrrd, .nhdr) and MetaImage (.mha, .mhd) headers are parsed for the dimensions, spacing, origin and
+*   scalar type, while any other file is treated as raw data described through the vtkImageReader2 setters
+*   (data extent, scalar type, header size and byte order).
+*
+*   @note The scalars of the output point into the mapping, which stays valid until the reader reads another
+*   file or is destroyed, so the reader has to outlive any use of its output
+*   @note Data in the other byte order is swapped in place on copy-on-write pages, which costs the copy the
+*   mapping would otherwise avoid
+*/
+class CUDA_LIB_EXPORT vtkCUDAMappedVolumeReader : public vtkImageReader2
+{
+public:
+
+  vtkTypeMacro( vtkCUDAMappedVolumeReader, vtkImageReader2 );
+  void PrintSelf( ostream& os, vtkIndent indent );
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAMappedVolumeReader *New();
+
+  /** @brief Checks whether the file is a NRRD or MetaImage header that this reader can map
+  *
+  *  @return 3 if the file is a supported header, 0 otherwise (raw files cannot be recognized)
+  */
+  virtual int CanReadFile( const char* fname );
+  virtual const char* GetFileExtensions() { return ".nrrd .nhdr .mha .mhd .raw"; }
+  virtual const char* GetDescriptiveName() { return "Memory mapped volume"; }
+
+  /** @brief Gets the file holding the voxels, which is the header itself unless the header refers to a detached data file
+  *
+  */
+  const char* GetDataFileName() const { return this->DataFileName.c_str(); }
+
+protected:
+
+  vtkCUDAMappedVolumeReader();
+  ~vtkCUDAMappedVolumeReader();
+
+  /** @brief Encodings of the voxels in the data file
+  *
+  */
+  enum { ENCODING_RAW = 0, ENCODING_ZLIB, ENCODING_ZSTD };
+
+  /** @brief Checks whether this reader can read data of the given encoding, which only the raw encoding can be mapped
+  *
+  */
+  virtual bool CanReadEncoding( int encoding ) { return encoding == ENCODING_RAW; }
+
+  /** @brief Parses the header of the file, if any, into the data extent, spacing, origin, scalar type and header size
+  *
+  */
+  virtual void ExecuteInformation();
+
+  /** @brief Maps the data file and hands the mapped voxels to the output as its scalars, without copying them
+  *
+  */
+  virtual void ExecuteData( vtkDataObject* output );
+
+  /** @brief Parses a NRRD header (attached or detached)
+  *
+  *  @return true if the header describes a volume this reader can map
+  */
+  bool ReadNRRDHeader();
+
+  /** @brief Parses a MetaImage header (attached or detached)
+  *
+  *  @return true if the header describes a volume this reader can map
+  */
+  bool ReadMetaImageHeader();
+
+  /** @brief Maps the given range of the data file into memory, releasing any previous mapping
+  *
+  *  @return A pointer to the first mapped byte of the range, or NULL if the file could not be mapped
+  */
+  void* MapDataFile( vtkTypeUInt64 offset, vtkTypeUInt64 length );
+
+  /** @brief Releases the current mapping, if any
+  *
+  */
+  void UnmapDataFile();
+
+  std::string     DataFileName;   /**< The file holding the voxels */
+  vtkTypeUInt64   DataOffset;     /**< The offset of the first voxel (or of the compressed stream) in the data file */
+  int             Encoding;       /**< The encoding of the voxels in the data file */
+  vtkTypeUInt64   CompressedSize; /**< The size of the compressed stream in the data file, when compressed */
+  bool            HeaderParsed;   /**< Whether the information came from a header rather than the raw setters */
+
+  void*           MappedBase;     /**< The start of the current mapping */
+  vtkTypeUInt64   MappedLength;   /**< The length in bytes of the current mapping */
+
+private:
+  vtkCUDAMappedVolumeReader operator=(const vtkCUDAMappedVolumeReader&); /**< not implemented */
+  vtkCUDAMappedVolumeReader(const vtkCUDAMappedVolumeReader&); /**< not implemented */
+
+};
+
+#endif
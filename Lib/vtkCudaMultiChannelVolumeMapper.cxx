@@ -0,0 +1,333 @@
+/** @file vtkCUDAMultiChannelVolumeMapper.cxx
+*
+*  @brief Implementation of a volume mapper (ray caster) sampling several co-registered channels, each with its own transfer function, in a single pass
+*
+*/
+
+// Type
+#include "vtkCUDAMultiChannelVolumeMapper.h"
+#include "vtkCUDA1DTransferFunctionInformationHandler.h"
+
+// CUDA Volume Rendering includes
+#include "CUDA_vtkCUDA1DVolumeMapper_renderAlgo.h"
+#include "CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo.h"
+#include "vtkCUDAVolumeInformationHandler.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtkVolume.h>
+#include <vtkVolumeProperty.h>
+
+vtkStandardNewMacro(vtkCUDAMultiChannelVolumeMapper);
+
+vtkCUDAMultiChannelVolumeMapper::vtkCUDAMultiChannelVolumeMapper()
+  {
+  for( int c = 0; c < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; c++ )
+    {
+    this->ChannelInfoHandlers[c] = NULL;
+    if( c > 0 )
+      {
+      this->ChannelInfoHandlers[c] = vtkCUDA1DTransferFunctionInformationHandler::New();
+      this->ChannelInfoHandlers[c]->ReplicateObject(this);
+      }
+    this->ChannelInputs[c] = NULL;
+    this->ChannelProperties[c] = NULL;
+    this->ChannelUploadTime[c] = 0;
+    this->ChannelRanges[2*c] = 0.0;
+    this->ChannelRanges[2*c+1] = 1.0;
+    this->ChannelWeights[c] = 1.0;
+    }
+  this->ChannelBlendMode = CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_ADD;
+  CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_initChannels(this->ChannelData);
+  }
+
+vtkCUDAMultiChannelVolumeMapper::~vtkCUDAMultiChannelVolumeMapper()
+  {
+  this->ReserveGPU();
+  CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannels(this->ChannelData, this->GetStream());
+  for( int c = 1; c < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; c++ )
+    {
+    this->ChannelInfoHandlers[c]->UnRegister( this );
+    if( this->ChannelInputs[c] ) this->ChannelInputs[c]->UnRegister( this );
+    if( this->ChannelProperties[c] ) this->ChannelProperties[c]->UnRegister( this );
+    }
+  }
+
+void vtkCUDAMultiChannelVolumeMapper::Deinitialize(int withData)
+  {
+  this->vtkCUDA1DVolumeMapper::Deinitialize(withData);
+  this->ReserveGPU();
+  CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannels(this->ChannelData, this->GetStream());
+  for( int c = 0; c < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; c++ )
+    {
+    this->ChannelUploadTime[c] = 0;
+    }
+  }
+
+void vtkCUDAMultiChannelVolumeMapper::Reinitialize(int withData)
+  {
+  this->vtkCUDA1DVolumeMapper::Reinitialize(withData);
+  for( int c = 1; c < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; c++ )
+    {
+    this->ChannelInfoHandlers[c]->ReplicateObject(this, withData);
+    this->ChannelUploadTime[c] = 0;
+    }
+  }
+
+void vtkCUDAMultiChannelVolumeMapper::SetInputInternal(vtkImageData * input, int index)
+  {
+  this->vtkCUDA1DVolumeMapper::SetInputInternal(input, index);
+
+  //the other channels are copied again before the next render, their bricks lining up with the new ones of the input
+  this->ReserveGPU();
+  CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannels(this->ChannelData, this->GetStream());
+  for( int c = 0; c < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; c++ )
+    {
+    this->ChannelUploadTime[c] = 0;
+    }
+  }
+
+void vtkCUDAMultiChannelVolumeMapper::SetChannelInput(int channel, vtkImageData* image)
+  {
+  if( channel < 1 || channel >= CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS )
+    {
+    vtkErrorMacro(<<"Channel " << channel << " is not one of the channels past the first.");
+    return;
+    }
+  if( image == this->ChannelInputs[channel] )
+    {
+    return;
+    }
+  if( this->ChannelInputs[channel] )
+    {
+    this->ChannelInputs[channel]->UnRegister(this);
+    }
+  this->ChannelInputs[channel] = image;
+  if( image )
+    {
+    image->Register(this);
+    image->Update();
+    }
+  else
+    {
+    this->ReserveGPU();
+    CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannel(this->ChannelData, channel, this->GetStream());
+    }
+  this->ChannelUploadTime[channel] = 0;
+  this->Modified();
+  }
+
+vtkImageData* vtkCUDAMultiChannelVolumeMapper::GetChannelInput(int channel)
+  {
+  return ( channel >= 1 && channel < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS ) ? this->ChannelInputs[channel] : NULL;
+  }
+
+void vtkCUDAMultiChannelVolumeMapper::SetChannelProperty(int channel, vtkVolumeProperty* property)
+  {
+  if( channel < 1 || channel >= CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS )
+    {
+    vtkErrorMacro(<<"Channel " << channel << " is not one of the channels past the first.");
+    return;
+    }
+  if( property == this->ChannelProperties[channel] )
+    {
+    return;
+    }
+  if( this->ChannelProperties[channel] )
+    {
+    this->ChannelProperties[channel]->UnRegister(this);
+    }
+  this->ChannelProperties[channel] = property;
+  if( property )
+    {
+    property->Register(this);
+    }
+  this->Modified();
+  }
+
+vtkVolumeProperty* vtkCUDAMultiChannelVolumeMapper::GetChannelProperty(int channel)
+  {
+  return ( channel >= 1 && channel < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS ) ? this->ChannelProperties[channel] : NULL;
+  }
+
+void vtkCUDAMultiChannelVolumeMapper::SetChannelWeight(int channel, double weight)
+  {
+  if( channel < 0 || channel >= CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS )
+    {
+    vtkErrorMacro(<<"Channel " << channel << " is out of range.");
+    return;
+    }
+  weight = (weight > 0.0) ? weight : 0.0;
+  if( weight != this->ChannelWeights[channel] )
+    {
+    this->ChannelWeights[channel] = weight;
+    this->Modified();
+    }
+  }
+
+double vtkCUDAMultiChannelVolumeMapper::GetChannelWeight(int channel)
+  {
+  return ( channel >= 0 && channel < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS ) ? this->ChannelWeights[channel] : 0.0;
+  }
+
+bool vtkCUDAMultiChannelVolumeMapper::UploadChannel(int channel)
+  {
+  vtkImageData* image = this->ChannelInputs[channel];
+  if( this->IsLiveInput(image) )
+    {
+    vtkErrorMacro(<<"Channel " << channel << " cannot be the volume of a live stream, which only streams into the first channel.");
+    return false;
+    }
+  if( this->ChannelUploadTime[channel] != 0 && this->ChannelUploadTime[channel] >= image->GetMTime() )
+    {
+    return true;
+    }
+  this->ChannelUploadTime[channel] = 0;
+
+  //the channel is sampled at the voxels of the uploaded sub-extent of the input, so it has to cover that sub-extent
+  const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+  const int* extent = image->GetExtent();
+  for( int i = 0; i < 3; i++ )
+    {
+    if( extent[2*i] > subExtent[2*i] || extent[2*i+1] < subExtent[2*i+1] )
+      {
+      vtkErrorMacro(<<"Channel " << channel << " does not cover the uploaded extent of the input.");
+      return false;
+      }
+    }
+  const int* dims = this->VolumeInfoHandler->GetDimensions();
+  int3 volumeSize;
+  volumeSize.x = dims[0];
+  volumeSize.y = dims[1];
+  volumeSize.z = dims[2];
+  this->ReserveGPU();
+  if( !CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_allocateChannel(this->ChannelData, channel, volumeSize, this->GetStream()) )
+    {
+    vtkErrorMacro(<<"Channel " << channel << " could not be allocated on the device.");
+    return false;
+    }
+
+  //convert the first component of the channel to floats through the double buffered staging of the input, downsampled alike
+  if( !this->StreamInput(image, channel, &(this->ChannelRanges[2*channel])) )
+    {
+    CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_clearChannel(this->ChannelData, channel, this->GetStream());
+    return false;
+    }
+
+  //find the intensity range of each brick along with those of the input (which is only an optimization, so failing is fine)
+  if( this->VolumeInfoHandler->GetInputData() && !this->IsLiveInput(this->VolumeInfoHandler->GetInputData()) )
+    {
+    CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_buildChannelBricks(this->VolumeData, this->ChannelData, channel, volumeSize, this->GetStream());
+    }
+  this->ChannelUploadTime[channel] = image->GetMTime();
+  return true;
+  }
+
+vtkTypeUInt64 vtkCUDAMultiChannelVolumeMapper::GetDeviceBytesInternal(const int dims[3], int voxelSize, bool live)
+  {
+  //each channel past the first is held in float, with the range of each brick, and the bricks of all the channels share one occupancy
+  vtkTypeUInt64 bytes = this->vtkCUDA1DVolumeMapper::GetDeviceBytesInternal(dims, voxelSize, live);
+  vtkTypeUInt64 numBricks = 1;
+  for( int i = 0; i < 3; i++ )
+    {
+    numBricks *= (dims[i] + CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE - 1) / CUDA_VTKCUDA1DVOLUMEMAPPER_BRICK_SIZE;
+    }
+  bool anyChannel = false;
+  for( int c = 1; c < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; c++ )
+    {
+    if( !this->ChannelInputs[c] )
+      {
+      continue;
+      }
+    anyChannel = true;
+    bytes += (vtkTypeUInt64) dims[0] * dims[1] * dims[2] * sizeof(float);
+    bytes += live ? 0 : numBricks * sizeof(float2);
+    }
+  bytes += (anyChannel && !live) ? numBricks * sizeof(unsigned char) : 0;
+  return bytes;
+  }
+
+int vtkCUDAMultiChannelVolumeMapper::GetMaximumNumberOfLevels()
+  {
+  //the other channels have no mip pyramid, so the input keeps to the full resolution and none is built over it
+  return 1;
+  }
+
+bool vtkCUDAMultiChannelVolumeMapper::UploadSlabInternal(void* slab, int firstSlice, int numSlices, int channel)
+  {
+  if( channel == 0 )
+    {
+    return this->vtkCUDA1DVolumeMapper::UploadSlabInternal(slab, firstSlice, numSlices, channel);
+    }
+  const int* dims = this->VolumeInfoHandler->GetDimensions();
+  int3 volumeSize;
+  volumeSize.x = dims[0];
+  volumeSize.y = dims[1];
+  volumeSize.z = dims[2];
+  return CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_loadChannelSlab(this->ChannelData, channel, static_cast<const float*>(slab),
+                                                                         firstSlice, numSlices, volumeSize, this->GetStream());
+  }
+
+void vtkCUDAMultiChannelVolumeMapper::InternalRender (  vtkRenderer* vtkNotUsed(ren), vtkVolume* vol,
+                                            const cudaRendererInformation& rendererInfo,
+                                            const cudaVolumeInformation& volumeInfo,
+                                            const cudaOutputImageInformation& outputInfo )
+{
+  //the channels go up to the last with an image, channel 0 being the input, and are all rendered or none are (each failure being reported)
+  vtkCUDA1DTransferFunctionInformationHandler* handlers[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];
+  cuda1DTransferFunctionInformation transInfo[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];
+  cudaMultiChannelInformation channelInfo;
+  handlers[0] = this->transferFunctionInfoHandler;
+  channelInfo.numberOfChannels = 1;
+  channelInfo.blendMode = this->ChannelBlendMode;
+  for( int c = 1; c < CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS; c++ )
+    {
+    if( this->ChannelInputs[c] )
+      {
+      channelInfo.numberOfChannels = c + 1;
+      }
+    }
+  for( int c = 1; c < channelInfo.numberOfChannels; c++ )
+    {
+    if( !this->ChannelInputs[c] )
+      {
+      vtkErrorMacro(<<"Channel " << c << " has no image, though a later channel has one.");
+      return;
+      }
+    if( !this->UploadChannel(c) )
+      {
+      return;
+      }
+    handlers[c] = this->ChannelInfoHandlers[c];
+    handlers[c]->SetInputRange( &(this->ChannelRanges[2*c]) );
+    handlers[c]->SetInputData( this->ChannelInputs[c], 0 );
+    }
+
+  //handle the transfer function changes, the channels without a property of their own sharing the volume's
+  for( int c = 0; c < channelInfo.numberOfChannels; c++ )
+    {
+    vtkVolumeProperty* property = (c > 0 && this->ChannelProperties[c]) ? this->ChannelProperties[c] : vol->GetProperty();
+    handlers[c]->SetColourTransferFunction( property->GetRGBTransferFunction() );
+    handlers[c]->SetOpacityTransferFunction( property->GetScalarOpacity() );
+    handlers[c]->SetGradientOpacityTransferFunction( property->GetGradientOpacity() );
+    handlers[c]->UseGradientOpacity( !property->GetDisableGradientOpacity() );
+    handlers[c]->Update();
+    transInfo[c] = handlers[c]->GetTransferFunctionInfo();
+    channelInfo.weight[c] = (float) this->ChannelWeights[c];
+    }
+
+  //perform the render once the tables of every channel are on the device
+  this->ReserveGPU();
+  for( int c = 0; c < channelInfo.numberOfChannels; c++ )
+    {
+    handlers[c]->AcquireTables( this->GetStream() );
+    }
+  this->erroredOut = !CUDA_vtkCUDAMultiChannelVolumeMapper_renderAlgo_doRender(this->VolumeData, this->ChannelData, outputInfo, rendererInfo, volumeInfo,
+                     channelInfo, transInfo, this->GetStream());
+  for( int c = 0; c < channelInfo.numberOfChannels; c++ )
+    {
+    handlers[c]->ReleaseTables( this->GetStream() );
+    }
+
+}
@@ -0,0 +1,114 @@
+/** @file vtkCUDAMultiChannelVolumeMapper.h
+*
+*  @brief Header file defining a volume mapper (ray caster) sampling several co-registered channels, each with its own transfer function, in a single pass
+*
+*/
+
+#ifndef __vtkCUDAMultiChannelVolumeMapper_h
+#define __vtkCUDAMultiChannelVolumeMapper_h
+
+#include "vtkCUDA1DVolumeMapper.h"
+#include "CUDA_containerMultiChannelInformation.h"
+#include "CUDA_containerMultiChannelVolumeInformation.h"
+class vtkCUDA1DTransferFunctionInformationHandler;
+
+// VTK includes
+class vtkImageData;
+class vtkVolumeProperty;
+
+/** @brief vtkCUDAMultiChannelVolumeMapper is a volume mapper for fused volumes such as PET/CT or multiple stains, classifying up to 4 co-registered channels at each sample of a single ray march and blending them
+*
+*  @note Channel 0 is the input of the mapper, classified by the volume property, the others being co-registered images over its extent each given a volume property of its own
+*  @note The rays and the jumps over empty space are shared by the channels, a brick being jumped over when it is transparent in every channel
+*  @note The channels are only rendered at full resolution, as the others have no mip pyramid
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDAMultiChannelVolumeMapper
+  : public vtkCUDA1DVolumeMapper
+{
+public:
+
+  vtkTypeMacro (vtkCUDAMultiChannelVolumeMapper,vtkCUDA1DVolumeMapper);
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAMultiChannelVolumeMapper *New();
+
+  /** @brief Sets the image of a channel past the first, the channels being given in order as a channel following one without an image is an error
+  *
+  *  @param channel A channel between 1 and 3
+  *  @param image An image covering the uploaded sub-extent of the input, whose first component is sampled at the voxels of the input, or NULL to drop the channel
+  *
+  *  @note The image is brought up to date when it is set, and copied to the device again whenever it is modified after that
+  */
+  void SetChannelInput(int channel, vtkImageData* image);
+  vtkImageData* GetChannelInput(int channel);
+
+  /** @brief Sets the colour, opacity and gradient opacity functions of a channel past the first, which otherwise shares the volume property
+  *
+  *  @param channel A channel between 1 and 3
+  *  @note The shading parameters are always those of the volume property
+  */
+  void SetChannelProperty(int channel, vtkVolumeProperty* property);
+  vtkVolumeProperty* GetChannelProperty(int channel);
+
+  /** @brief Sets the scale applied to the opacity of a channel, 1 by default
+  *
+  *  @param channel A channel between 0 and 3
+  */
+  void SetChannelWeight(int channel, double weight);
+  double GetChannelWeight(int channel);
+
+  /** @brief Sets how the classified channels of a sample are blended, either layering them (CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_ADD, the default) or taking the most opaque (CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_MAXIMUM)
+  *
+  */
+  vtkSetClampMacro(ChannelBlendMode, int, CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_ADD, CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_MAXIMUM);
+  vtkGetMacro(ChannelBlendMode, int);
+  void SetChannelBlendModeToAdd() { this->SetChannelBlendMode(CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_ADD); }
+  void SetChannelBlendModeToMaximum() { this->SetChannelBlendMode(CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_BLEND_MAXIMUM); }
+
+  virtual void SetInputInternal( vtkImageData * image, int frame);
+  virtual void InternalRender (  vtkRenderer* ren, vtkVolume* vol,
+    const cudaRendererInformation& rendererInfo,
+    const cudaVolumeInformation& volumeInfo,
+    const cudaOutputImageInformation& outputInfo );
+
+protected:
+  /** @brief Constructor which creates the transfer function handlers of the channels past the first
+  *
+  */
+  vtkCUDAMultiChannelVolumeMapper();
+
+  /** @brief Destructor which deallocates the channel handlers and the channels on the GPU
+  *
+  */
+  ~vtkCUDAMultiChannelVolumeMapper();
+  virtual void Reinitialize(int withData = 0);
+  virtual void Deinitialize(int withData = 0);
+  virtual vtkTypeUInt64 GetDeviceBytesInternal(const int dims[3], int voxelSize, bool live);
+  virtual int GetMaximumNumberOfLevels();
+
+  /** @brief Converts the image of a channel to floats and streams it to the device if it changed since it was last copied
+  *
+  *  @return Whether the channel is on the device
+  */
+  bool UploadChannel(int channel);
+  virtual bool UploadSlabInternal(void* slab, int firstSlice, int numSlices, int channel);
+
+  vtkCUDA1DTransferFunctionInformationHandler* ChannelInfoHandlers[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS]; /**< Transfer function handlers of the channels past the first */
+  vtkImageData*       ChannelInputs[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];      /**< Images of the channels past the first */
+  vtkVolumeProperty*  ChannelProperties[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];  /**< Volume properties of the channels past the first */
+  unsigned long       ChannelUploadTime[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];  /**< Modified time of each channel's image when it was copied to the device, 0 if it is not there */
+  double              ChannelRanges[2*CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];    /**< Scalar range of each channel's image */
+  double              ChannelWeights[CUDA_VTKCUDAMULTICHANNELVOLUMEMAPPER_MAX_CHANNELS];     /**< Opacity scale of each channel */
+  int                 ChannelBlendMode; /**< How the channels of a sample are blended */
+  cudaMultiChannelVolumeInformation ChannelData; /**< The device arrays of the channels past the first and the occupancy of the bricks over all of them, owned by this mapper alone */
+
+private:
+  vtkCUDAMultiChannelVolumeMapper operator=(const vtkCUDAMultiChannelVolumeMapper&); /**< not implemented */
+  vtkCUDAMultiChannelVolumeMapper(const vtkCUDAMultiChannelVolumeMapper&); /**< not implemented */
+
+};
+
+#endif
@@ -27,9 +27,6 @@ vtkCUDAOutputImageInformationHandler::vtkCUDAOutputImageInformationHandler()
   this->RenderOutputScaleFactor = 1.0f;
   this->OutputImageInfo.resolution.x = this->OutputImageInfo.resolution.y = 0;
   this->oldResolution.x = this->oldResolution.y = 0;
-  this->OutputImageInfo.rayIncX = this->OutputImageInfo.rayStartX = 0;
-  this->OutputImageInfo.rayIncY = this->OutputImageInfo.rayStartY = 0;
-  this->OutputImageInfo.rayIncZ = this->OutputImageInfo.rayStartZ = 0;
   this->hostOutputImage = 0;
   this->deviceOutputImage = 0;
   this->oldRenderType = 1;
@@ -45,20 +42,10 @@ vtkCUDAOutputImageInformationHandler::~vtkCUDAOutputImageInformationHandler()
 
 void vtkCUDAOutputImageInformationHandler::Deinitialize(int withData)
   {  
-  if(this->OutputImageInfo.numSteps) cudaFree(this->OutputImageInfo.numSteps);
-  if(this->OutputImageInfo.rayIncX) cudaFree(this->OutputImageInfo.rayIncX);
-  if(this->OutputImageInfo.rayIncY) cudaFree(this->OutputImageInfo.rayIncY);
-  if(this->OutputImageInfo.rayIncZ) cudaFree(this->OutputImageInfo.rayIncZ);
-  if(this->OutputImageInfo.rayStartX) cudaFree(this->OutputImageInfo.rayStartX);
-  if(this->OutputImageInfo.rayStartY) cudaFree(this->OutputImageInfo.rayStartY);
-  if(this->OutputImageInfo.rayStartZ) cudaFree(this->OutputImageInfo.rayStartZ);
   if(this->hostOutputImage) delete this->hostOutputImage;
   if(this->deviceOutputImage) cudaFree(this->deviceOutputImage);
   this->OutputImageInfo.resolution.x = this->OutputImageInfo.resolution.y = 0;
   this->oldResolution.x = this->oldResolution.y = 0;
-  this->OutputImageInfo.rayIncX = this->OutputImageInfo.rayStartX = 0;
-  this->OutputImageInfo.rayIncY = this->OutputImageInfo.rayStartY = 0;
-  this->OutputImageInfo.rayIncZ = this->OutputImageInfo.rayStartZ = 0;
   this->hostOutputImage = 0;
   this->deviceOutputImage = 0;
   }
@@ -131,23 +118,6 @@ void vtkCUDAOutputImageInformationHandler::Update()
   //reset the values for the old resolution to the current (for the next update)
   this->oldResolution = this->OutputImageInfo.resolution;
 
-  //allocate the buffers used for intermediate output results in rendering
-  this->ReserveGPU();
-  if(this->OutputImageInfo.numSteps) cudaFree(this->OutputImageInfo.numSteps);
-  cudaMalloc( (void**) &this->OutputImageInfo.numSteps, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayIncX) cudaFree(this->OutputImageInfo.rayIncX);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayIncX, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayIncY) cudaFree(this->OutputImageInfo.rayIncY);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayIncY, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayIncZ) cudaFree(this->OutputImageInfo.rayIncZ);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayIncZ, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayStartX) cudaFree(this->OutputImageInfo.rayStartX);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayStartX, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayStartY) cudaFree(this->OutputImageInfo.rayStartY);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayStartY, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-  if(this->OutputImageInfo.rayStartZ) cudaFree(this->OutputImageInfo.rayStartZ);
-  cudaMalloc( (void**) &this->OutputImageInfo.rayStartZ, sizeof(float)*this->OutputImageInfo.resolution.x * this->OutputImageInfo.resolution.y);
-
   //allocate the buffers
   this->ReserveGPU();
   if(this->deviceOutputImage) cudaFree(this->deviceOutputImage);
@@ -34,6 +34,8 @@ vtkCUDARendererInformationHandler::vtkCUDARendererInformationHandler()
   SetGradientShadingConstants(0.605f);
 
   this->ZBuffer = 0;
+  this->RendererInfo.ZBufferArray = 0;
+  this->RendererInfo.ZBufferTexture = 0;
 
   this->clipModified = 0;
 
@@ -43,7 +45,7 @@ vtkCUDARendererInformationHandler::vtkCUDARendererInformationHandler()
 void vtkCUDARendererInformationHandler::Deinitialize(int withData)
   {
   this->ReserveGPU();
-  CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(this->GetStream());
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_unloadZBuffer(this->RendererInfo, this->GetStream());
   }
 
 void vtkCUDARendererInformationHandler::Reinitialize(int withData)
@@ -158,7 +160,7 @@ void vtkCUDARendererInformationHandler::LoadZBuffer()
   if(this->ZBuffer) delete this->ZBuffer;
   this->ZBuffer = this->Renderer->GetRenderWindow()->GetZbufferData(x1,y1,x2,y2);
   this->ReserveGPU();
-  CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(this->ZBuffer, this->RendererInfo.actualResolution.x, this->RendererInfo.actualResolution.y, this->GetStream() );
+  CUDA_vtkCUDAVolumeMapper_renderAlgo_loadZBuffer(this->RendererInfo, this->ZBuffer, this->RendererInfo.actualResolution.x, this->RendererInfo.actualResolution.y, this->GetStream() );
 
   }
 
@@ -0,0 +1,442 @@
+/** @file vtkCUDAVolumeCache.cxx
+*
+*  @brief Implementation of an on-disk cache of the preprocessed volumes uploaded by the CUDA volume mappers
+*
+*/
+
+#include "vtkCUDAVolumeCache.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObjectFactory.h>
+
+// STD includes
+#include <cstring>
+#include <sstream>
+
+// Memory mapping includes
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Compression
+#ifdef VTKCUDA_USE_ZSTD
+#include <zstd.h>
+#endif
+
+vtkStandardNewMacro(vtkCUDAVolumeCache);
+
+//----------------------------------------------------------------------------
+// File layout: a fixed header, page aligned sections, then the section table
+
+#define VTKCUDAVOLUMECACHE_VERSION 1
+#define VTKCUDAVOLUMECACHE_ALIGNMENT 4096
+
+static const char vtkCUDAVolumeCacheMagic[8] = { 'V', 'T', 'K', 'C', 'U', 'D', 'A', 'C' };
+
+struct vtkCUDAVolumeCacheHeader
+{
+  char          Magic[8];
+  unsigned int  Version;
+  unsigned int  NumberOfSections;
+  vtkTypeUInt64 Key;
+  vtkTypeUInt64 TableOffset;
+};
+
+//----------------------------------------------------------------------------
+// Content hashing (64 bit FNV-1a), one slice per task and then over the slice hashes
+
+#define VTKCUDAVOLUMECACHE_FNV_OFFSET 14695981039346656037ULL
+#define VTKCUDAVOLUMECACHE_FNV_PRIME  1099511628211ULL
+
+static vtkTypeUInt64 vtkCUDAVolumeCacheHash(vtkTypeUInt64 hash, const void* data, size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for( size_t i = 0; i < size; i++ )
+    {
+    hash ^= bytes[i];
+    hash *= VTKCUDAVOLUMECACHE_FNV_PRIME;
+    }
+  return hash;
+}
+
+struct vtkCUDAVolumeCacheHashInfo
+{
+  const char*     InputPointer;  // first voxel to hash
+  vtkIdType       Increments[3]; // in bytes
+  int             ScalarSize;
+  int             Size[3];
+  vtkTypeUInt64*  SliceHashes;
+};
+
+static VTK_THREAD_RETURN_TYPE vtkCUDAVolumeCacheHashSlices(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkCUDAVolumeCacheHashInfo* info = static_cast<vtkCUDAVolumeCacheHashInfo*>(threadInfo->UserData);
+
+  //rows of single component voxels are hashed at once, anything else voxel by voxel
+  bool contiguous = (info->Increments[0] == info->ScalarSize);
+  int first = info->Size[2] * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  int last = info->Size[2] * (threadInfo->ThreadID + 1) / threadInfo->NumberOfThreads;
+  for( int z = first; z < last; z++ )
+    {
+    vtkTypeUInt64 hash = VTKCUDAVOLUMECACHE_FNV_OFFSET;
+    for( int y = 0; y < info->Size[1]; y++ )
+      {
+      const char* rowPtr = info->InputPointer + z*info->Increments[2] + y*info->Increments[1];
+      if( contiguous )
+        {
+        hash = vtkCUDAVolumeCacheHash(hash, rowPtr, (size_t) info->Size[0] * info->ScalarSize);
+        continue;
+        }
+      for( int x = 0; x < info->Size[0]; x++ )
+        {
+        hash = vtkCUDAVolumeCacheHash(hash, rowPtr + x*info->Increments[0], info->ScalarSize);
+        }
+      }
+    info->SliceHashes[z] = hash;
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+vtkCUDAVolumeCache::vtkCUDAVolumeCache()
+{
+  this->Directory = NULL;
+  this->Compression = 0;
+  this->MappedBase = NULL;
+  this->MappedLength = 0;
+  this->WriteFile = NULL;
+  this->WriteKey = 0;
+  this->WriteError = false;
+}
+
+//----------------------------------------------------------------------------
+vtkCUDAVolumeCache::~vtkCUDAVolumeCache()
+{
+  this->Close();
+  this->AbortWrite();
+  this->SetDirectory(NULL);
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeCache::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os,indent);
+  os << indent << "Directory: " << (this->Directory ? this->Directory : "(none)") << "\n";
+  os << indent << "Compression: " << this->Compression << "\n";
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCUDAVolumeCache::ComputeKey(const void* firstVoxel, int scalarType, int scalarSize, const vtkIdType increments[3],
+                                             const int size[3], vtkMultiThreader* threader)
+{
+  vtkCUDAVolumeCacheHashInfo info;
+  info.InputPointer = static_cast<const char*>(firstVoxel);
+  info.ScalarSize = scalarSize;
+  for( int i = 0; i < 3; i++ )
+    {
+    info.Increments[i] = increments[i] * scalarSize;
+    info.Size[i] = size[i];
+    }
+  std::vector<vtkTypeUInt64> sliceHashes(info.Size[2]);
+  info.SliceHashes = &sliceHashes[0];
+
+  threader->SetSingleMethod( vtkCUDAVolumeCacheHashSlices, &info );
+  threader->SingleMethodExecute();
+
+  //fold in the description of the voxels so equal bytes of another shape or type give another key
+  int description[4] = { info.Size[0], info.Size[1], info.Size[2], scalarType };
+  vtkTypeUInt64 key = vtkCUDAVolumeCacheHash(VTKCUDAVOLUMECACHE_FNV_OFFSET, description, sizeof(description));
+  return vtkCUDAVolumeCacheHash(key, &sliceHashes[0], sizeof(vtkTypeUInt64) * sliceHashes.size());
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCUDAVolumeCache::CombineKey(vtkTypeUInt64 key, const void* data, size_t size)
+{
+  return vtkCUDAVolumeCacheHash(key, data, size);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeCache::ComputeFileKey(const char* fileName, vtkTypeUInt64* key)
+{
+  if( !fileName || !*fileName ) return false;
+  vtkTypeUInt64 description[2];
+#ifdef _WIN32
+  WIN32_FILE_ATTRIBUTE_DATA attributes;
+  if( !GetFileAttributesExA(fileName, GetFileExInfoStandard, &attributes) ) return false;
+  description[0] = ((vtkTypeUInt64) attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+  description[1] = ((vtkTypeUInt64) attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+#else
+  struct stat info;
+  if( stat(fileName, &info) != 0 ) return false;
+  description[0] = (vtkTypeUInt64) info.st_size;
+  description[1] = (vtkTypeUInt64) info.st_mtime;
+#endif
+
+  //the name tells the files apart, and the size and time tell a file apart from a rewritten version of it
+  vtkTypeUInt64 hash = vtkCUDAVolumeCacheHash(VTKCUDAVOLUMECACHE_FNV_OFFSET, fileName, strlen(fileName));
+  *key = vtkCUDAVolumeCacheHash(hash, description, sizeof(description));
+  return true;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkCUDAVolumeCache::GetFileName(vtkTypeUInt64 key)
+{
+  std::ostringstream name;
+  name << (this->Directory ? this->Directory : ".") << "/";
+  name.fill('0');
+  name.width(16);
+  name << std::hex << key << ".vtkcudacache";
+  return name.str();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeCache::Open(vtkTypeUInt64 key)
+{
+  this->Close();
+  if( !this->Directory ) return false;
+  std::string fileName = this->GetFileName(key);
+
+  //map the whole file read-only
+#ifdef _WIN32
+  HANDLE file = CreateFileA(fileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, 0, NULL);
+  if( file == INVALID_HANDLE_VALUE ) return false;
+  LARGE_INTEGER fileSize;
+  GetFileSizeEx(file, &fileSize);
+  HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+  CloseHandle(file);
+  if( !mapping ) return false;
+  void* base = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+  CloseHandle(mapping);
+  if( !base ) return false;
+  vtkTypeUInt64 length = (vtkTypeUInt64) fileSize.QuadPart;
+#else
+  int file = open(fileName.c_str(), O_RDONLY);
+  if( file < 0 ) return false;
+  struct stat info;
+  if( fstat(file, &info) != 0 || info.st_size < (off_t) sizeof(vtkCUDAVolumeCacheHeader) )
+    {
+    close(file);
+    return false;
+    }
+  void* base = mmap(NULL, (size_t) info.st_size, PROT_READ, MAP_SHARED, file, 0);
+  close(file);
+  if( base == MAP_FAILED ) return false;
+  vtkTypeUInt64 length = (vtkTypeUInt64) info.st_size;
+#endif
+  this->MappedBase = base;
+  this->MappedLength = length;
+
+  //check the header before trusting the section table
+  const vtkCUDAVolumeCacheHeader* header = static_cast<const vtkCUDAVolumeCacheHeader*>(base);
+  if( length < sizeof(vtkCUDAVolumeCacheHeader) ||
+      memcmp(header->Magic, vtkCUDAVolumeCacheMagic, 8) != 0 ||
+      header->Version != VTKCUDAVOLUMECACHE_VERSION || header->Key != key ||
+      header->TableOffset + header->NumberOfSections * sizeof(Section) > length )
+    {
+    vtkDebugMacro(<<"Ignoring cache file " << fileName << " of another version or content.");
+    this->Close();
+    return false;
+    }
+
+  const Section* table = reinterpret_cast<const Section*>(static_cast<const char*>(base) + header->TableOffset);
+  for( unsigned int i = 0; i < header->NumberOfSections; i++ )
+    {
+    if( table[i].Offset + table[i].StoredSize > length )
+      {
+      this->Close();
+      return false;
+      }
+    this->Sections[table[i].Tag] = table[i];
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+const void* vtkCUDAVolumeCache::GetSection(unsigned int tag, vtkTypeUInt64* size)
+{
+  std::map<unsigned int, Section>::iterator section = this->Sections.find(tag);
+  if( section == this->Sections.end() ) return NULL;
+  *size = section->second.Size;
+  const char* stored = static_cast<const char*>(this->MappedBase) + section->second.Offset;
+  if( !section->second.Compressed ) return stored;
+
+#ifdef VTKCUDA_USE_ZSTD
+  //sections are written as a run of frames, which zstd decompresses in one call
+  std::vector<char>& buffer = this->Decompressed[tag];
+  if( buffer.size() != section->second.Size )
+    {
+    buffer.resize( (size_t) section->second.Size );
+    size_t result = ZSTD_decompress( &buffer[0], buffer.size(), stored, (size_t) section->second.StoredSize );
+    if( ZSTD_isError(result) || result != buffer.size() )
+      {
+      vtkErrorMacro(<<"Corrupt cache section: " << ZSTD_getErrorName(result));
+      this->Decompressed.erase(tag);
+      return NULL;
+      }
+    }
+  return &buffer[0];
+#else
+  vtkWarningMacro(<<"Cache section is compressed, but zstd support is not built in.");
+  return NULL;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeCache::Close()
+{
+  this->Sections.clear();
+  this->Decompressed.clear();
+  if( !this->MappedBase ) return;
+#ifdef _WIN32
+  UnmapViewOfFile(this->MappedBase);
+#else
+  munmap(this->MappedBase, (size_t) this->MappedLength);
+#endif
+  this->MappedBase = NULL;
+  this->MappedLength = 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeCache::BeginWrite(vtkTypeUInt64 key)
+{
+  if( !this->Directory || this->WriteFile ) return false;
+
+  //write to a temporary file so that readers never see a partial cache
+  this->WriteFileName = this->GetFileName(key);
+  this->WriteFile = fopen( (this->WriteFileName + ".tmp").c_str(), "wb" );
+  if( !this->WriteFile )
+    {
+    vtkWarningMacro(<<"Cannot write the cache file " << this->WriteFileName << ".");
+    return false;
+    }
+  this->WriteSections.clear();
+  this->WriteError = false;
+
+  //the header is completed once the section table is known
+  vtkCUDAVolumeCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.Magic, vtkCUDAVolumeCacheMagic, 8);
+  header.Version = VTKCUDAVOLUMECACHE_VERSION;
+  header.Key = key;
+  this->WriteKey = key;
+  this->WriteError |= (fwrite(&header, sizeof(header), 1, this->WriteFile) != 1);
+  return !this->WriteError;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeCache::BeginSection(unsigned int tag)
+{
+  if( !this->WriteFile ) return false;
+
+  //pad up to the next page so the section can be used straight from the mapping
+  vtkTypeUInt64 offset = sizeof(vtkCUDAVolumeCacheHeader);
+  if( !this->WriteSections.empty() )
+    {
+    const Section& previous = this->WriteSections.back();
+    offset = previous.Offset + previous.StoredSize;
+    }
+  static const char padding[VTKCUDAVOLUMECACHE_ALIGNMENT] = { 0 };
+  size_t paddingSize = (size_t) ((VTKCUDAVOLUMECACHE_ALIGNMENT - offset % VTKCUDAVOLUMECACHE_ALIGNMENT) % VTKCUDAVOLUMECACHE_ALIGNMENT);
+  if( paddingSize ) this->WriteError |= (fwrite(padding, 1, paddingSize, this->WriteFile) != paddingSize);
+
+  Section section;
+  section.Tag = tag;
+#ifdef VTKCUDA_USE_ZSTD
+  section.Compressed = this->Compression ? 1 : 0;
+#else
+  section.Compressed = 0;
+#endif
+  section.Offset = offset + paddingSize;
+  section.StoredSize = 0;
+  section.Size = 0;
+  this->WriteSections.push_back(section);
+  return !this->WriteError;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeCache::AppendToSection(const void* data, vtkTypeUInt64 size)
+{
+  if( !this->WriteFile || this->WriteSections.empty() ) return false;
+  Section& section = this->WriteSections.back();
+
+#ifdef VTKCUDA_USE_ZSTD
+  if( section.Compressed )
+    {
+    //each appended block becomes a frame of its own
+    std::vector<char> frame( ZSTD_compressBound( (size_t) size ) );
+    size_t frameSize = ZSTD_compress( &frame[0], frame.size(), data, (size_t) size, 3 );
+    if( ZSTD_isError(frameSize) )
+      {
+      this->WriteError = true;
+      return false;
+      }
+    this->WriteError |= (fwrite(&frame[0], 1, frameSize, this->WriteFile) != frameSize);
+    section.StoredSize += frameSize;
+    section.Size += size;
+    return !this->WriteError;
+    }
+#endif
+
+  this->WriteError |= (fwrite(data, 1, (size_t) size, this->WriteFile) != (size_t) size);
+  section.StoredSize += size;
+  section.Size += size;
+  return !this->WriteError;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeCache::EndWrite()
+{
+  if( !this->WriteFile ) return false;
+
+  //append the section table and complete the header
+  vtkCUDAVolumeCacheHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.Magic, vtkCUDAVolumeCacheMagic, 8);
+  header.Version = VTKCUDAVOLUMECACHE_VERSION;
+  header.NumberOfSections = (unsigned int) this->WriteSections.size();
+  header.TableOffset = sizeof(vtkCUDAVolumeCacheHeader);
+  if( !this->WriteSections.empty() )
+    {
+    //keep the table aligned so it can be read in place
+    static const char padding[8] = { 0 };
+    header.TableOffset = this->WriteSections.back().Offset + this->WriteSections.back().StoredSize;
+    size_t paddingSize = (size_t) ((8 - header.TableOffset % 8) % 8);
+    if( paddingSize ) this->WriteError |= (fwrite(padding, 1, paddingSize, this->WriteFile) != paddingSize);
+    header.TableOffset += paddingSize;
+    this->WriteError |= (fwrite(&this->WriteSections[0], sizeof(Section), this->WriteSections.size(), this->WriteFile) != this->WriteSections.size());
+    }
+  header.Key = this->WriteKey;
+  this->WriteError |= (fseek(this->WriteFile, 0, SEEK_SET) != 0);
+  this->WriteError |= (fwrite(&header, sizeof(header), 1, this->WriteFile) != 1);
+  this->WriteError |= (fclose(this->WriteFile) != 0);
+  this->WriteFile = NULL;
+
+  //only publish complete files, replacing any older one
+  std::string tempName = this->WriteFileName + ".tmp";
+  if( this->WriteError )
+    {
+    vtkWarningMacro(<<"Could not write the cache file " << this->WriteFileName << ".");
+    remove( tempName.c_str() );
+    return false;
+    }
+#ifdef _WIN32
+  remove( this->WriteFileName.c_str() );
+#endif
+  return rename( tempName.c_str(), this->WriteFileName.c_str() ) == 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeCache::AbortWrite()
+{
+  if( !this->WriteFile ) return;
+  fclose( this->WriteFile );
+  this->WriteFile = NULL;
+  remove( (this->WriteFileName + ".tmp").c_str() );
+}
@@ -0,0 +1,183 @@
+/** @file vtkCUDAVolumeCache.h
+*
+*  @brief Header file defining an on-disk cache of the preprocessed volumes uploaded by the CUDA volume mappers
+*
+*/
+
+#ifndef __vtkCUDAVolumeCache_h
+#define __vtkCUDAVolumeCache_h
+
+// CUDA Volume Rendering includes
+#include "CUDAVolumeRenderingLibExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+class vtkMultiThreader;
+
+// STD includes
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+/** @brief Builds the four character tag of a cache section
+*
+*/
+#define VTKCUDAVOLUMECACHE_TAG(a,b,c,d) ((unsigned int)(a) | ((unsigned int)(b) << 8) | ((unsigned int)(c) << 16) | ((unsigned int)(d) << 24))
+
+/** @brief vtkCUDAVolumeCache stores everything a mapper derives from an input volume (converted data, mip levels,
+*   statistics, bricks...) in a single file per volume, keyed by a hash of the voxels (or of the file they are read from), so a volume that was seen
+*   before is loaded without any preprocessing.
+*
+*   The file is made of tagged sections, each aligned on a page boundary so that uncompressed sections are read
+*   straight from the memory mapped file. Sections are optionally compressed with zstd when the library is built
+*   with VTKCUDA_USE_ZSTD, and files written by another version of the format are ignored.
+*
+*/
+class CUDA_LIB_EXPORT vtkCUDAVolumeCache : public vtkObject
+{
+public:
+
+  vtkTypeMacro( vtkCUDAVolumeCache, vtkObject );
+  void PrintSelf( ostream& os, vtkIndent indent );
+
+  /** @brief VTK compatible constructor method
+  *
+  */
+  static vtkCUDAVolumeCache *New();
+
+  /** @brief Sets the directory holding the cache files
+  *
+  */
+  vtkSetStringMacro(Directory);
+  vtkGetStringMacro(Directory);
+
+  /** @brief Sets whether new sections are compressed with zstd, which is ignored unless the library is built with zstd support
+  *
+  */
+  vtkSetMacro(Compression, int);
+  vtkGetMacro(Compression, int);
+  vtkBooleanMacro(Compression, int);
+
+  /** @brief Computes the key of the voxels uploaded from an image from their size, scalar type and values
+  *
+  *  @param firstVoxel The first voxel to hash
+  *  @param scalarType The VTK scalar type of the voxels
+  *  @param scalarSize The size in bytes of a scalar
+  *  @param increments The increments in scalars between consecutive voxels, rows and slices
+  *  @param size The number of voxels along each axis
+  *  @param threader The threads hashing the slices in parallel
+  */
+  static vtkTypeUInt64 ComputeKey( const void* firstVoxel, int scalarType, int scalarSize, const vtkIdType increments[3],
+                                   const int size[3], vtkMultiThreader* threader );
+
+  /** @brief Folds more of the description of an uploaded volume into its key, for anything derived from the voxels
+  *   which depends on more than their values (such as the spacing)
+  *
+  *  @param key The key computed so far
+  *  @param data The description to fold in
+  *  @param size The size in bytes of the description
+  */
+  static vtkTypeUInt64 CombineKey( vtkTypeUInt64 key, const void* data, size_t size );
+
+  /** @brief Computes the key of the voxels read from a file from its name, size and modification time, which unlike
+  *   ComputeKey needs none of the voxels, so it is known before the file is even decompressed
+  *
+  *  @param fileName The file holding the voxels
+  *  @param key Set to the key of the file
+  *
+  *  @return false if the file could not be found
+  */
+  static bool ComputeFileKey( const char* fileName, vtkTypeUInt64* key );
+
+  /** @brief Opens the cache file of a key for reading
+  *
+  *  @return true if a valid file of the current version exists for the key
+  */
+  bool Open( vtkTypeUInt64 key );
+
+  /** @brief Gets the content of a section of the open file, decompressing it if needed
+  *
+  *  @param tag The tag of the section
+  *  @param size Set to the size in bytes of the section
+  *
+  *  @return A pointer to the section which stays valid until the file is closed, or NULL if the section is missing
+  */
+  const void* GetSection( unsigned int tag, vtkTypeUInt64* size );
+
+  /** @brief Closes the open file, releasing its mapping and any decompressed section
+  *
+  */
+  void Close();
+
+  /** @brief Starts writing the cache file of a key, which only replaces any existing file once completed
+  *
+  */
+  bool BeginWrite( vtkTypeUInt64 key );
+
+  /** @brief Starts a new section of the file being written, closing the previous one
+  *
+  */
+  bool BeginSection( unsigned int tag );
+
+  /** @brief Appends data to the current section, so large sections can be written a slab at a time
+  *
+  */
+  bool AppendToSection( const void* data, vtkTypeUInt64 size );
+
+  /** @brief Closes the last section and completes the file being written
+  *
+  *  @return true if the file was written successfully and is now visible to Open
+  */
+  bool EndWrite();
+
+  /** @brief Discards the file being written, leaving any existing file of its key in place
+  *
+  */
+  void AbortWrite();
+
+protected:
+
+  vtkCUDAVolumeCache();
+  ~vtkCUDAVolumeCache();
+
+  /** @brief Gets the name of the cache file of a key
+  *
+  */
+  std::string GetFileName( vtkTypeUInt64 key );
+
+  /** @brief Description of a section as stored in the table at the end of the file
+  *
+  */
+  struct Section
+    {
+    unsigned int        Tag;
+    unsigned int        Compressed;
+    vtkTypeUInt64       Offset;
+    vtkTypeUInt64       StoredSize;
+    vtkTypeUInt64       Size;
+    };
+
+  char*       Directory;      /**< The directory holding the cache files */
+  int         Compression;    /**< Whether new sections are compressed */
+
+  //reading
+  void*       MappedBase;     /**< The start of the mapping of the open file */
+  vtkTypeUInt64 MappedLength; /**< The length of the mapping of the open file */
+  std::map<unsigned int, Section> Sections;               /**< The sections of the open file */
+  std::map<unsigned int, std::vector<char> > Decompressed; /**< The sections of the open file decompressed so far */
+
+  //writing
+  FILE*       WriteFile;      /**< The temporary file being written */
+  std::string WriteFileName;  /**< The name the temporary file gets once completed */
+  vtkTypeUInt64 WriteKey;     /**< The key of the file being written */
+  std::vector<Section> WriteSections; /**< The sections written so far */
+  bool        WriteError;     /**< Whether any write failed */
+
+private:
+  vtkCUDAVolumeCache operator=(const vtkCUDAVolumeCache&); /**< not implemented */
+  vtkCUDAVolumeCache(const vtkCUDAVolumeCache&); /**< not implemented */
+
+};
+
+#endif
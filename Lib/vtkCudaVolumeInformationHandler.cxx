@@ -25,6 +25,18 @@ vtkCUDAVolumeInformationHandler::vtkCUDAVolumeInformationHandler()
   this->lastModifiedTime = 0;
   this->Volume = NULL;
   this->InputData = NULL;
+  this->NumberOfLevelsOfDetail = 1;
+  this->LevelOfDetail = 0;
+  this->Downsampling = 0;
+  this->VolumeInfo.VoxelSpaceSampling = 0;
+  this->VolumeInfo.SampleDistance = 1.0f;
+  this->VolumeInfo.CorrectOpacity = 0;
+  for( int i = 0; i < 6; i++ )
+    {
+    this->CroppingExtent[i] = (i % 2) ? -1 : 0;
+    this->SubExtent[i] = (i % 2) ? -1 : 0;
+    }
+  this->Dimensions[0] = this->Dimensions[1] = this->Dimensions[2] = 0;
   }
 
 vtkCUDAVolumeInformationHandler::~vtkCUDAVolumeInformationHandler()
@@ -74,8 +86,147 @@ void vtkCUDAVolumeInformationHandler::UpdateImageData(int index)
   {
   this->InputData->Update();
 
-  int* dims = this->InputData->GetDimensions();
-  double* spacing = this->InputData->GetSpacing();
+  this->InputData->GetSpacing(this->Spacing);
+  this->UpdateSubExtent();
+
+  //a new input starts without any coarser levels until the mapper builds them
+  this->NumberOfLevelsOfDetail = 1;
+  this->LevelOfDetail = 0;
+  this->UpdateLevelInformation();
+  }
+
+void vtkCUDAVolumeInformationHandler::SetCroppingExtent(const int extent[6])
+  {
+  bool changed = false;
+  for( int i = 0; i < 6; i++ )
+    {
+    changed |= (this->CroppingExtent[i] != extent[i]);
+    this->CroppingExtent[i] = extent[i];
+    }
+  if( !changed ) return;
+
+  //only a change in what is uploaded invalidates the levels of detail
+  if( this->InputData && this->UpdateSubExtent() )
+    {
+    this->NumberOfLevelsOfDetail = 1;
+    this->LevelOfDetail = 0;
+    this->UpdateLevelInformation();
+    }
+  this->Modified();
+  }
+
+bool vtkCUDAVolumeInformationHandler::UpdateSubExtent()
+  {
+  int inputExtent[6];
+  this->InputData->GetExtent(inputExtent);
+
+  //intersect the cropping extent with the input, keeping the whole input if they do not overlap
+  int subExtent[6];
+  bool empty = false;
+  for( int i = 0; i < 3; i++ )
+    {
+    bool cropped = this->CroppingExtent[2*i] <= this->CroppingExtent[2*i+1];
+    subExtent[2*i]   = (cropped && this->CroppingExtent[2*i]   > inputExtent[2*i])   ? this->CroppingExtent[2*i]   : inputExtent[2*i];
+    subExtent[2*i+1] = (cropped && this->CroppingExtent[2*i+1] < inputExtent[2*i+1]) ? this->CroppingExtent[2*i+1] : inputExtent[2*i+1];
+    empty |= (subExtent[2*i] > subExtent[2*i+1]);
+    }
+
+  bool changed = false;
+  for( int i = 0; i < 6; i++ )
+    {
+    int value = empty ? inputExtent[i] : subExtent[i];
+    changed |= (this->SubExtent[i] != value);
+    this->SubExtent[i] = value;
+    }
+  this->Dimensions[0] = this->SubExtent[1] - this->SubExtent[0] + 1;
+  this->Dimensions[1] = this->SubExtent[3] - this->SubExtent[2] + 1;
+  this->Dimensions[2] = this->SubExtent[5] - this->SubExtent[4] + 1;
+
+  //a sub-extent too large for the device is uploaded downsampled, each halving rounding up like the mip pyramid
+  for( int level = 0; level < this->Downsampling; level++ )
+    {
+    for( int i = 0; i < 3; i++ )
+      {
+      this->Dimensions[i] = (this->Dimensions[i] + 1) / 2;
+      }
+    }
+  return changed;
+  }
+
+void vtkCUDAVolumeInformationHandler::SetDownsampling(int level)
+  {
+  level = (level > 0) ? level : 0;
+  if( level == this->Downsampling ) return;
+  this->Downsampling = level;
+
+  if( this->InputData )
+    {
+    this->UpdateSubExtent();
+    this->NumberOfLevelsOfDetail = 1;
+    this->LevelOfDetail = 0;
+    this->UpdateLevelInformation();
+    }
+  this->Modified();
+  }
+
+void vtkCUDAVolumeInformationHandler::SetNumberOfLevelsOfDetail(int numLevels)
+  {
+  this->NumberOfLevelsOfDetail = (numLevels > 1) ? numLevels : 1;
+  if( this->LevelOfDetail >= this->NumberOfLevelsOfDetail )
+    {
+    this->SetLevelOfDetail(this->NumberOfLevelsOfDetail - 1);
+    }
+  }
+
+void vtkCUDAVolumeInformationHandler::SetLevelOfDetail(int level)
+  {
+  if( level < 0 || level >= this->NumberOfLevelsOfDetail || level == this->LevelOfDetail )
+    {
+    return;
+    }
+  this->LevelOfDetail = level;
+  this->UpdateLevelInformation();
+  this->Modified();
+  }
+
+void vtkCUDAVolumeInformationHandler::SetVoxelSpaceSampling(bool voxelSpace)
+  {
+  if( (this->VolumeInfo.VoxelSpaceSampling != 0) == voxelSpace ) return;
+  this->VolumeInfo.VoxelSpaceSampling = voxelSpace ? 1 : 0;
+  this->UpdateOpacityCorrection();
+  this->Modified();
+  }
+
+void vtkCUDAVolumeInformationHandler::SetSampleDistance(float distance)
+  {
+  distance = (distance > 0.0625f) ? distance : 0.0625f;
+  if( this->VolumeInfo.SampleDistance == distance ) return;
+  this->VolumeInfo.SampleDistance = distance;
+  this->UpdateOpacityCorrection();
+  this->Modified();
+  }
+
+void vtkCUDAVolumeInformationHandler::UpdateOpacityCorrection()
+  {
+  //a step of one minimum spacing at the full resolution is the only one the opacities hold for as they are,
+  //each downsampling or level of detail doubling the spacing
+  this->VolumeInfo.CorrectOpacity = ( this->VolumeInfo.VoxelSpaceSampling || this->VolumeInfo.SampleDistance != 1.0f ||
+                                      this->Downsampling + this->LevelOfDetail > 0 ) ? 1 : 0;
+  }
+
+void vtkCUDAVolumeInformationHandler::UpdateLevelInformation()
+  {
+  //each level halves the resolution (rounding up) and doubles the spacing
+  int dims[3] = { this->Dimensions[0], this->Dimensions[1], this->Dimensions[2] };
+  double levelScale = (double) (1 << (this->Downsampling + this->LevelOfDetail));
+  double spacing[3] = { this->Spacing[0] * levelScale, this->Spacing[1] * levelScale, this->Spacing[2] * levelScale };
+  for( int level = 0; level < this->LevelOfDetail; level++ )
+    {
+    for( int i = 0; i < 3; i++ )
+      {
+      dims[i] = (dims[i] + 1) / 2;
+      }
+    }
 
   this->VolumeInfo.VolumeSize.x = dims[0];
   this->VolumeInfo.VolumeSize.y = dims[1];
@@ -91,6 +242,12 @@ void vtkCUDAVolumeInformationHandler::UpdateImageData(int index)
   this->VolumeInfo.MinSpacing = (this->VolumeInfo.MinSpacing > spacing[1]) ? spacing[1] : this->VolumeInfo.MinSpacing;
   this->VolumeInfo.MinSpacing = (this->VolumeInfo.MinSpacing > spacing[2]) ? spacing[2] : this->VolumeInfo.MinSpacing;
 
+  //the opacities stay those of the full resolution input, whatever the resolution rendered
+  this->VolumeInfo.OpacitySpacing = this->Spacing[0];
+  this->VolumeInfo.OpacitySpacing = (this->VolumeInfo.OpacitySpacing > this->Spacing[1]) ? this->Spacing[1] : this->VolumeInfo.OpacitySpacing;
+  this->VolumeInfo.OpacitySpacing = (this->VolumeInfo.OpacitySpacing > this->Spacing[2]) ? this->Spacing[2] : this->VolumeInfo.OpacitySpacing;
+  this->UpdateOpacityCorrection();
+
   //calculate the bounds
   this->VolumeInfo.Bounds[0] = 0.0f;
   this->VolumeInfo.Bounds[1] = (float) dims[0] - 1.0f;
@@ -119,12 +276,6 @@ void vtkCUDAVolumeInformationHandler::Update()
       this->VolumeInfo.Specular.y = this->Volume->GetProperty()->GetSpecularPower();
       }
     }
-
-  if(this->InputData)
-    {
-    this->InputData->Update();
-    this->Modified();
-    }
   }
 
 void vtkCUDAVolumeInformationHandler::ClearInput()
@@ -132,4 +283,6 @@ void vtkCUDAVolumeInformationHandler::ClearInput()
   this->Modified();
   this->Volume = NULL;
   this->InputData = NULL;
+  this->NumberOfLevelsOfDetail = 1;
+  this->LevelOfDetail = 0;
   }
@@ -72,6 +72,63 @@ public:
   */
   const cudaVolumeInformation& GetVolumeInfo() const { return (this->VolumeInfo); }
 
+  /** @brief Sets the extent of the input that is uploaded and rendered, in the index coordinates of the input extent
+  *
+  *  @param extent The cropping extent (xmin, xmax, ymin, ymax, zmin, zmax), which is clamped to the extent of the input, an empty extent (a minimum above its maximum) meaning the whole input
+  *
+  *  @note Changing the sub-extent resets the levels of detail, as the image has to be uploaded again
+  */
+  void SetCroppingExtent(const int extent[6]);
+
+  /** @brief Gets the extent of the input currently described by the volume information, in the index coordinates of the input extent
+  *
+  */
+  const int* GetSubExtent() const { return this->SubExtent; }
+
+  /** @brief Sets how many times the uploaded sub-extent is halved in resolution, so that it fits on the device
+  *
+  *  @param level The number of halvings, 0 uploading the sub-extent at full resolution
+  *
+  *  @note Changing the downsampling resets the levels of detail, as the image has to be uploaded again
+  */
+  void SetDownsampling(int level);
+  int GetDownsampling() const { return this->Downsampling; }
+
+  /** @brief Gets the dimensions of the uploaded volume, which are those of the sub-extent once downsampled
+  *
+  */
+  const int* GetDimensions() const { return this->Dimensions; }
+
+  /** @brief Sets the number of levels of the mip pyramid available for the current input
+  *
+  *  @param numLevels The number of levels built by the mapper, including the full resolution volume
+  */
+  void SetNumberOfLevelsOfDetail(int numLevels);
+  int GetNumberOfLevelsOfDetail() const { return this->NumberOfLevelsOfDetail; }
+
+  /** @brief Sets the level of the mip pyramid described by the volume information, recomputing its size, spacing and bounds
+  *
+  *  @param level The level of detail, 0 being full resolution and each further level halving the resolution
+  *
+  *  @pre level is a non-negative integer less than the number of levels of detail
+  */
+  void SetLevelOfDetail(int level);
+  int GetLevelOfDetail() const { return this->LevelOfDetail; }
+
+  /** @brief Sets whether the rays are stepped in voxels along their direction instead of by the minimum spacing
+  *
+  *  @param voxelSpace True to take one step per voxel along the ray, which avoids oversampling thick-slice volumes along their slice direction
+  */
+  void SetVoxelSpaceSampling(bool voxelSpace);
+  bool GetVoxelSpaceSampling() const { return this->VolumeInfo.VoxelSpaceSampling != 0; }
+
+  /** @brief Sets the length of a ray step relative to the voxel or minimum spacing step
+  *
+  *  @param distance The scale of a step, above 1.0 taking fewer samples (which is best paired with pre-integration)
+  */
+  void SetSampleDistance(float distance);
+  float GetSampleDistance() const { return this->VolumeInfo.SampleDistance; }
+
   /** @brief Clear all information about the volumes
   *
   *  @note This also resets the lastModifiedTime that the volume information handler has for the transfer function, forcing an updating in the lookup tables for the first render
@@ -104,6 +161,22 @@ protected:
   */
   void UpdateImageData(int index);
 
+  /** @brief Clamps the cropping extent to the extent of the input to find the sub-extent to upload
+  *
+  *  @return true if the sub-extent changed
+  */
+  bool UpdateSubExtent();
+
+  /** @brief Recomputes the size, spacing and bounds in the volume information for the current level of detail
+  *
+  */
+  void UpdateLevelInformation();
+
+  /** @brief Recomputes whether the ray steps may cover another distance than the opacity spacing, from the sampling and the level of detail
+  *
+  */
+  void UpdateOpacityCorrection();
+
   void Deinitialize(int withData = 0);
   void Reinitialize(int withData = 0);
 
@@ -119,6 +192,14 @@ private:
 
   unsigned long lastModifiedTime;      /**< The last time the transfer function was modified, used to determine when to repopulate the transfer function lookup tables */
 
+  int                    CroppingExtent[6];      /**< The requested extent of the input to upload, empty for the whole input */
+  int                    SubExtent[6];           /**< The extent of the input actually uploaded */
+  int                    Downsampling;           /**< The number of times the uploaded sub-extent is halved in resolution */
+  int                    Dimensions[3];          /**< The dimensions of the uploaded sub-extent once downsampled */
+  double                 Spacing[3];             /**< The full resolution spacing of the input */
+  int                    NumberOfLevelsOfDetail; /**< The number of mip pyramid levels available, including the full resolution volume */
+  int                    LevelOfDetail;          /**< The mip pyramid level currently described by VolumeInfo */
+
 };
 
 #endif
@@ -17,15 +17,20 @@
 #include "CUDA_containerOutputImageInformation.h"
 #include "vtkCUDAOutputImageInformationHandler.h"
 #include "vtkCUDARendererInformationHandler.h"
+#include "vtkCUDACompressedVolumeReader.h"
+#include "vtkCUDAVolumeCache.h"
 #include "vtkCUDAVolumeInformationHandler.h"
+#include "cuda_runtime_api.h"
 
 // CUDA Volume Rendering includes
 #include "vtkCUDAVolumeMapper.h"
 
 // VTK includes
 #include <vtkCamera.h>
+#include <vtkDataArray.h>
 #include <vtkImageData.h>
 #include <vtkMatrix4x4.h>
+#include <vtkMultiThreader.h>
 #include <vtkObjectFactory.h>
 #include <vtkPlane.h>
 #include <vtkPlaneCollection.h>
@@ -35,6 +40,294 @@
 #include <vtkTransform.h>
 #include <vtkVolume.h>
 
+// STD includes
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+// Size of each pinned staging buffer the input is converted into before its upload
+#define VTKCUDAVOLUMEMAPPER_STAGING_BYTES (16 << 20)
+
+// Device memory left to the ray casting buffers and transfer functions when sizing an upload to the free memory
+#define VTKCUDAVOLUMEMAPPER_MEMORY_HEADROOM (128 << 20)
+
+// Section of the volume cache holding the statistics of the input
+#define VTKCUDAVOLUMEMAPPER_CACHE_STATISTICS VTKCUDAVOLUMECACHE_TAG('S','T','A','T')
+
+// Full memory barrier ordering the slots of the live stream queue and their indices
+#ifdef _WIN32
+#include <windows.h>
+#define VTKCUDAVOLUMEMAPPER_MEMORY_BARRIER() MemoryBarrier()
+#else
+#define VTKCUDAVOLUMEMAPPER_MEMORY_BARRIER() __sync_synchronize()
+#endif
+
+//----------------------------------------------------------------------------
+// Conversion of a slab of the input shared with the threads of the mapper
+struct vtkCUDAVolumeMapperSlab
+{
+  const char* InputPointer;   // first voxel of the sub-extent
+  int ScalarType;
+  int ScalarSize;
+  vtkIdType Increments[3];
+  int InputSize[3];           // size of the sub-extent
+  int Downsampling;           // number of halvings of the sub-extent
+  int Size[3];                // size of the uploaded volume, which is the sub-extent once downsampled
+  int FirstSlice;             // first slice of the slab within the uploaded volume
+  int NumberOfSlices;
+  float* Buffer;
+  unsigned short* HalfBuffer; // receives the slab as halves when uploading with half precision, NULL otherwise
+  int Error;
+  double* ThreadRanges;       // min and max seen by each thread, NULL when the statistics are up to date
+  vtkIdType* ThreadCounts;    // counts of each value (or histogram bin) seen by each thread
+  int NumberOfValues;         // number of counts per thread, 0 if the values are binned in another pass
+  int ValueOffset;            // offset from a value to its count
+  double HistogramLow;        // first value of the histogram, when binning
+  double HistogramScale;      // bins per unit of value, when binning
+};
+
+//----------------------------------------------------------------------------
+// Single producer, single consumer queue of the live slices waiting for the next render
+struct vtkCUDAVolumeMapperLiveStream
+{
+  int ScalarType;
+  int ScalarSize;
+  int Dimensions[3];
+  int QueueLength;
+  char** Slots;               // copies of the queued slices
+  int* SliceIndices;          // slice of the volume each slot overwrites
+  volatile unsigned int Head; // slots pushed so far, only written by the producer
+  volatile unsigned int Tail; // slots uploaded so far, only written by the render thread
+  int NextSlice;              // slice following the last one pushed
+  unsigned long DroppedSlices;
+  float* Staging[2];          // converted slices on their way to the device, double buffered across renders
+  bool StagingPinned[2];
+  cudaEvent_t Uploaded[2];    // recorded once the uploads reading each staging buffer are queued
+  int StagingIndex;           // staging buffer the next render converts into
+};
+
+//----------------------------------------------------------------------------
+template <class T>
+static void vtkCUDAVolumeMapperConvertToFloat(const T* inputPtr, const vtkIdType increments[3], const int size[3], float* buffer,
+                                              double* range, vtkIdType* counts, int countOffset)
+{
+  //the range, and the count of each value for small integer types, come with the conversion rather than from another pass over the input
+  T minValue = inputPtr[0];
+  T maxValue = inputPtr[0];
+
+  //walk the sub-extent row by row, as it is not contiguous in the input when cropped
+  for(int z = 0; z < size[2]; z++)
+    {
+    for(int y = 0; y < size[1]; y++)
+      {
+      const T* rowPtr = inputPtr + z*increments[2] + y*increments[1];
+      for(int x = 0; x < size[0]; x++)
+        {
+        T value = rowPtr[x*increments[0]];
+        *(buffer++) = (float) value;
+        minValue = (value < minValue) ? value : minValue;
+        maxValue = (value > maxValue) ? value : maxValue;
+        if( counts ) counts[(int) value + countOffset]++;
+        }
+      }
+    }
+
+  if( range )
+    {
+    range[0] = ((double) minValue < range[0]) ? (double) minValue : range[0];
+    range[1] = ((double) maxValue > range[1]) ? (double) maxValue : range[1];
+    }
+}
+
+//----------------------------------------------------------------------------
+template <class T>
+static void vtkCUDAVolumeMapperDownsampleToFloat(const T* inputPtr, const vtkIdType increments[3], const int inputSize[3],
+                                                 int downsampling, const int size[3], float* buffer,
+                                                 double* range, vtkIdType* counts, int countOffset)
+{
+  //each voxel averages a block of 2^downsampling voxels per axis, the blocks at the far edges being partial
+  T minValue = inputPtr[0];
+  T maxValue = inputPtr[0];
+  int block = 1 << downsampling;
+  size_t sliceVoxels = (size_t) size[0] * size[1];
+  for(int z = 0; z < size[2]; z++)
+    {
+    float* slice = buffer + z * sliceVoxels;
+    memset( slice, 0, sizeof(float) * sliceVoxels );
+    int inputSlices = (inputSize[2] - z*block < block) ? inputSize[2] - z*block : block;
+    for(int iz = 0; iz < inputSlices; iz++)
+      {
+      for(int iy = 0; iy < inputSize[1]; iy++)
+        {
+        const T* rowPtr = inputPtr + (z*block + iz)*increments[2] + iy*increments[1];
+        float* sumRow = slice + (iy >> downsampling) * size[0];
+        for(int ix = 0; ix < inputSize[0]; ix++)
+          {
+          T value = rowPtr[ix*increments[0]];
+          sumRow[ix >> downsampling] += (float) value;
+          minValue = (value < minValue) ? value : minValue;
+          maxValue = (value > maxValue) ? value : maxValue;
+          if( counts ) counts[(int) value + countOffset]++;
+          }
+        }
+      }
+
+    for(int y = 0; y < size[1]; y++)
+      {
+      int rows = (inputSize[1] - y*block < block) ? inputSize[1] - y*block : block;
+      for(int x = 0; x < size[0]; x++)
+        {
+        int columns = (inputSize[0] - x*block < block) ? inputSize[0] - x*block : block;
+        slice[y*size[0] + x] /= (float) (inputSlices * rows * columns);
+        }
+      }
+    }
+
+  if( range )
+    {
+    range[0] = ((double) minValue < range[0]) ? (double) minValue : range[0];
+    range[1] = ((double) maxValue > range[1]) ? (double) maxValue : range[1];
+    }
+}
+
+//----------------------------------------------------------------------------
+unsigned short vtkCUDAVolumeMapper::FloatToHalf(float value)
+{
+  union { float f; unsigned int u; } bits;
+  bits.f = value;
+  unsigned int sign = (bits.u >> 16) & 0x8000;
+  int exponent = (int) ((bits.u >> 23) & 0xff) - 127 + 15;
+  unsigned int mantissa = bits.u & 0x7fffff;
+  if( ((bits.u >> 23) & 0xff) == 0xff )
+    {
+    return (unsigned short) (sign | (mantissa ? 0x7e00 : 0x7bff));
+    }
+  if( exponent >= 31 )
+    {
+    return (unsigned short) (sign | 0x7bff);
+    }
+  if( exponent <= 0 )
+    {
+    //subnormal halves keep the implicit bit in their mantissa
+    if( exponent < -10 ) return (unsigned short) sign;
+    mantissa |= 0x800000;
+    int shift = 14 - exponent;
+    unsigned int half = mantissa >> shift;
+    unsigned int rest = mantissa & ((1u << shift) - 1);
+    unsigned int halfway = 1u << (shift - 1);
+    if( rest > halfway || (rest == halfway && (half & 1)) ) half++;
+    return (unsigned short) (sign | half);
+    }
+  unsigned int half = ((unsigned int) exponent << 10) | (mantissa >> 13);
+  unsigned int rest = mantissa & 0x1fff;
+  if( rest > 0x1000 || (rest == 0x1000 && (half & 1)) ) half++;
+  half = (half > 0x7bff) ? 0x7bff : half;
+  return (unsigned short) (sign | half);
+}
+
+//----------------------------------------------------------------------------
+template <class T>
+static void vtkCUDAVolumeMapperCountBins(const T* inputPtr, const vtkIdType increments[3], const int size[3],
+                                         double low, double scale, vtkIdType* bins)
+{
+  for(int z = 0; z < size[2]; z++)
+    {
+    for(int y = 0; y < size[1]; y++)
+      {
+      const T* rowPtr = inputPtr + z*increments[2] + y*increments[1];
+      for(int x = 0; x < size[0]; x++)
+        {
+        int bin = (int) (((double) rowPtr[x*increments[0]] - low) * scale);
+        bins[ (bin < 0) ? 0 : (bin >= VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS) ? VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS - 1 : bin ]++;
+        }
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE vtkCUDAVolumeMapperConvertSlab(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkCUDAVolumeMapperSlab* slab = static_cast<vtkCUDAVolumeMapperSlab*>(threadInfo->UserData);
+
+  //each thread converts a contiguous run of the slices in the slab
+  int first = slab->NumberOfSlices * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  int last = slab->NumberOfSlices * (threadInfo->ThreadID + 1) / threadInfo->NumberOfThreads;
+  if( first >= last )
+    {
+    return VTK_THREAD_RETURN_VALUE;
+    }
+
+  int size[3] = { slab->Size[0], slab->Size[1], last - first };
+  const void* inputPtr = slab->InputPointer +
+    ((vtkIdType) (slab->FirstSlice + first) << slab->Downsampling) * slab->Increments[2] * slab->ScalarSize;
+  size_t firstVoxel = (size_t) first * size[0] * size[1];
+  float* buffer = slab->Buffer + firstVoxel;
+  double* range = slab->ThreadRanges ? slab->ThreadRanges + 2 * threadInfo->ThreadID : NULL;
+  vtkIdType* counts = (range && slab->NumberOfValues) ? slab->ThreadCounts + (size_t) slab->NumberOfValues * threadInfo->ThreadID : NULL;
+  if( slab->Downsampling == 0 )
+    {
+    switch( slab->ScalarType )
+      {
+      vtkTemplateMacro( vtkCUDAVolumeMapperConvertToFloat( static_cast<const VTK_TT*>(inputPtr), slab->Increments, size, buffer,
+                                                           range, counts, slab->ValueOffset ) );
+      default:
+        slab->Error = 1;
+      }
+    }
+  else
+    {
+    //the input slices of these output slices, the last block of the sub-extent being partial
+    int inputSize[3] = { slab->InputSize[0], slab->InputSize[1], 0 };
+    int firstInputSlice = (slab->FirstSlice + first) << slab->Downsampling;
+    int lastInputSlice = (slab->FirstSlice + last) << slab->Downsampling;
+    inputSize[2] = ((lastInputSlice < slab->InputSize[2]) ? lastInputSlice : slab->InputSize[2]) - firstInputSlice;
+    switch( slab->ScalarType )
+      {
+      vtkTemplateMacro( vtkCUDAVolumeMapperDownsampleToFloat( static_cast<const VTK_TT*>(inputPtr), slab->Increments, inputSize,
+                                                              slab->Downsampling, size, buffer, range, counts, slab->ValueOffset ) );
+      default:
+        slab->Error = 1;
+      }
+    }
+
+  //narrow the thread's part of the slab to halves once converted
+  if( slab->HalfBuffer )
+    {
+    size_t numVoxels = (size_t) size[0] * size[1] * size[2];
+    for( size_t i = 0; i < numVoxels; i++ )
+      {
+      slab->HalfBuffer[firstVoxel + i] = vtkCUDAVolumeMapper::FloatToHalf( buffer[i] );
+      }
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
+//----------------------------------------------------------------------------
+static VTK_THREAD_RETURN_TYPE vtkCUDAVolumeMapperCountSlab(void* arg)
+{
+  vtkMultiThreader::ThreadInfo* threadInfo = static_cast<vtkMultiThreader::ThreadInfo*>(arg);
+  vtkCUDAVolumeMapperSlab* slab = static_cast<vtkCUDAVolumeMapperSlab*>(threadInfo->UserData);
+
+  //each thread bins a contiguous run of the slices of the whole sub-extent
+  int first = slab->InputSize[2] * threadInfo->ThreadID / threadInfo->NumberOfThreads;
+  int last = slab->InputSize[2] * (threadInfo->ThreadID + 1) / threadInfo->NumberOfThreads;
+  if( first >= last )
+    {
+    return VTK_THREAD_RETURN_VALUE;
+    }
+
+  int size[3] = { slab->InputSize[0], slab->InputSize[1], last - first };
+  const void* inputPtr = slab->InputPointer + (vtkIdType) first * slab->Increments[2] * slab->ScalarSize;
+  vtkIdType* bins = slab->ThreadCounts + (size_t) VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS * threadInfo->ThreadID;
+  switch( slab->ScalarType )
+    {
+    vtkTemplateMacro( vtkCUDAVolumeMapperCountBins( static_cast<const VTK_TT*>(inputPtr), slab->Increments, size,
+                                                    slab->HistogramLow, slab->HistogramScale, bins ) );
+    }
+  return VTK_THREAD_RETURN_VALUE;
+}
+
 //----------------------------------------------------------------------------
 vtkCUDAVolumeMapper::vtkCUDAVolumeMapper()
 {
@@ -53,10 +346,48 @@ vtkCUDAVolumeMapper::vtkCUDAVolumeMapper()
   this->VoxelsTransform = vtkTransform::New();
   this->VoxelsToViewTransform = vtkTransform::New();
   this->NextVoxelsToViewTransform = vtkTransform::New();
+  this->Threader = vtkMultiThreader::New();
+  this->Cache = vtkCUDAVolumeCache::New();
+
+  this->InputBufferImage = NULL;
+  this->InputBuffer = NULL;
+  this->InputBufferStrides[0] = this->InputBufferStrides[1] = this->InputBufferStrides[2] = 0;
+  this->InputBufferRelease = NULL;
+  this->InputBufferClientData = NULL;
+  this->StreamingReader = NULL;
+  this->LiveStream = NULL;
+  this->LiveImage = NULL;
+
+  this->DeviceMemoryBudget = 0;
+  this->UploadedBytes = 0;
+  this->UploadHalfPrecision = false;
+
+  this->InputScalarRange[0] = 0.0;
+  this->InputScalarRange[1] = 1.0;
+  memset( this->InputHistogram, 0, sizeof(this->InputHistogram) );
+  this->InputGradientRange[0] = 0.0;
+  this->InputGradientRange[1] = 0.0;
+  memset( this->InputGradientHistogram, 0, sizeof(this->InputGradientHistogram) );
+  this->InputGradientStatisticsValid = false;
+  this->InputStatisticsTime = 0;
+  for( int i = 0; i < 6; i++ )
+    {
+    this->InputStatisticsExtent[i] = (i % 2) ? -1 : 0;
+    }
 
   this->renModified = 0;
   this->volModified = 0;
 
+  for( int i = 0; i < 6; i++ )
+    {
+    this->CroppingExtent[i] = (i % 2) ? -1 : 0;
+    }
+
+  this->LevelOfDetail = 0;
+  this->AutoAdjustLevelOfDetail = 0;
+  this->InteractiveLevelOfDetailBias = 0;
+  this->InteractiveUpdateRate = 1.0;
+
   this->Reinitialize();
 }
 
@@ -227,6 +558,10 @@ vtkCUDAVolumeMapper::~vtkCUDAVolumeMapper()
   this->VoxelsTransform->UnRegister(this);
   this->VoxelsToViewTransform->UnRegister(this);
   this->NextVoxelsToViewTransform->UnRegister(this);
+  this->Threader->UnRegister(this);
+  this->Cache->UnRegister(this);
+  this->ReleaseInputBuffer();
+  this->StopLiveStream();
 }
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::PrintSelf(ostream& os, vtkIndent indent)
@@ -249,12 +584,26 @@ void vtkCUDAVolumeMapper::SetInput(vtkImageData * input)
 
   //set information at this level
   this->vtkVolumeMapper::SetInput(input);
+  int extent[6];
+  this->ComputeCroppingExtent(input, extent);
+  this->VolumeInfoHandler->SetCroppingExtent(extent);
   this->VolumeInfoHandler->SetInputData(input, 0);
-  this->inputImages.insert( std::pair<int,vtkImageData*>(0,input) );
+  this->inputImages[0] = input;
 
   //pass down to subclass
   this->SetInputInternal( input, 0 );
   this->ChangeFrame(0);
+
+  //a buffer or stream given earlier is no longer read once replaced
+  if( this->InputBufferImage && input != this->InputBufferImage )
+    {
+    this->ReleaseInputBuffer();
+    }
+  if( this->LiveImage && input != this->LiveImage )
+    {
+    this->StopLiveStream();
+    this->LiveImage = NULL;
+    }
 }
 
 //----------------------------------------------------------------------------
@@ -265,12 +614,803 @@ void vtkCUDAVolumeMapper::SetInput(vtkImageData * input, int index)
 
   //set information at this level
   this->vtkVolumeMapper::SetInput(input);
+  int extent[6];
+  this->ComputeCroppingExtent(input, extent);
+  this->VolumeInfoHandler->SetCroppingExtent(extent);
   this->VolumeInfoHandler->SetInputData(input, index);
-  this->inputImages.insert( std::pair<int,vtkImageData*>(index,input) );
+  this->inputImages[index] = input;
 
   //pass down to subclass
   this->SetInputInternal(input, index);
   this->ChangeFrame(0);
+
+  //a buffer or stream given earlier is no longer read once replaced
+  if( this->InputBufferImage && input != this->InputBufferImage )
+    {
+    this->ReleaseInputBuffer();
+    }
+  if( this->LiveImage && input != this->LiveImage )
+    {
+    this->StopLiveStream();
+    this->LiveImage = NULL;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetInputReader(vtkCUDACompressedVolumeReader* reader)
+{
+  if( !reader )
+    {
+    return;
+    }
+
+  //start the decompression, the slabs being waited for as they are streamed to the device
+  reader->SetPipelined(true);
+  reader->Update();
+  reader->SetPipelined(false);
+
+  this->StreamingReader = reader;
+  this->SetInput(reader->GetOutput());
+  this->StreamingReader = NULL;
+
+  //the rest of the mapper reads the whole input, so it has to be complete from here on
+  vtkImageData* output = reader->GetOutput();
+  reader->WaitForSlices(output->GetExtent()[5] - output->GetExtent()[4] + 1);
+  if( reader->GetDecompressionFailed() )
+    {
+    vtkErrorMacro(<<"The input could not be decompressed.");
+    this->erroredOut = true;
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::StartLiveStream(int scalarType, const int dims[3], const double spacing[3],
+                                          const double origin[3], int queueLength)
+{
+  this->StopLiveStream();
+  if( dims[0] < 1 || dims[1] < 1 || dims[2] < 1 || queueLength < 1 )
+    {
+    vtkErrorMacro(<<"The live stream is empty.");
+    return;
+    }
+
+  //the image describing the volume only carries its geometry and type, the voxels living in the slots and on the device,
+  //so whatever reads the input checks IsLiveInput before touching its scalars
+  vtkDataArray* scalars = vtkDataArray::CreateDataArray(scalarType);
+  if( !scalars )
+    {
+    vtkErrorMacro(<<"Input cannot be of that type.");
+    return;
+    }
+  vtkImageData* image = vtkImageData::New();
+  image->SetExtent(0, dims[0]-1, 0, dims[1]-1, 0, dims[2]-1);
+  image->SetWholeExtent(image->GetExtent());
+  image->SetSpacing(spacing[0], spacing[1], spacing[2]);
+  image->SetOrigin(origin[0], origin[1], origin[2]);
+  image->SetScalarType(scalarType);
+  image->SetNumberOfScalarComponents(1);
+
+  vtkCUDAVolumeMapperLiveStream* live = new vtkCUDAVolumeMapperLiveStream;
+  live->ScalarType = scalarType;
+  live->ScalarSize = scalars->GetDataTypeSize();
+  scalars->Delete();
+  for( int i = 0; i < 3; i++ )
+    {
+    live->Dimensions[i] = dims[i];
+    }
+  live->QueueLength = queueLength;
+  live->Slots = new char*[queueLength];
+  live->SliceIndices = new int[queueLength];
+  size_t sliceVoxels = (size_t) dims[0] * dims[1];
+  for( int i = 0; i < queueLength; i++ )
+    {
+    live->Slots[i] = new char[sliceVoxels * live->ScalarSize];
+    live->SliceIndices[i] = 0;
+    }
+  live->Head = 0;
+  live->Tail = 0;
+  live->NextSlice = 0;
+  live->DroppedSlices = 0;
+
+  //the converted slices are uploaded asynchronously, so they are staged in pinned memory if possible,
+  //one render converting into a buffer while the uploads of the previous one still read the other
+  this->ReserveGPU();
+  for( int i = 0; i < 2; i++ )
+    {
+    live->StagingPinned[i] = (cudaMallocHost( (void**) &live->Staging[i], sizeof(float) * sliceVoxels * queueLength ) == cudaSuccess);
+    if( !live->StagingPinned[i] )
+      {
+      cudaGetLastError();
+      live->Staging[i] = new float[sliceVoxels * queueLength];
+      }
+    cudaEventCreateWithFlags( &live->Uploaded[i], cudaEventDisableTiming );
+    }
+  live->StagingIndex = 0;
+
+  //the volume starts empty on the device, and is kept by the pipeline for as long as it is the input
+  this->LiveStream = live;
+  this->LiveImage = image;
+  this->SetInput(image);
+  image->Delete();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::PushLiveSlice(const void* slice, int sliceIndex)
+{
+  vtkCUDAVolumeMapperLiveStream* live = this->LiveStream;
+  if( !live || !slice || sliceIndex >= live->Dimensions[2] )
+    {
+    return false;
+    }
+  unsigned int head = live->Head;
+  if( head - live->Tail >= (unsigned int) live->QueueLength )
+    {
+    live->DroppedSlices++;
+    return false;
+    }
+
+  //fill the slot before publishing it to the render thread
+  unsigned int slot = head % live->QueueLength;
+  sliceIndex = (sliceIndex < 0) ? live->NextSlice : sliceIndex;
+  memcpy( live->Slots[slot], slice, (size_t) live->Dimensions[0] * live->Dimensions[1] * live->ScalarSize );
+  live->SliceIndices[slot] = sliceIndex;
+  live->NextSlice = (sliceIndex + 1) % live->Dimensions[2];
+  VTKCUDAVOLUMEMAPPER_MEMORY_BARRIER();
+  live->Head = head + 1;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumeMapper::GetNumberOfPendingLiveSlices()
+{
+  return this->LiveStream ? (int) (this->LiveStream->Head - this->LiveStream->Tail) : 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned long vtkCUDAVolumeMapper::GetNumberOfDroppedLiveSlices()
+{
+  return this->LiveStream ? this->LiveStream->DroppedSlices : 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::StopLiveStream()
+{
+  vtkCUDAVolumeMapperLiveStream* live = this->LiveStream;
+  if( !live )
+    {
+    return;
+    }
+  this->LiveStream = NULL;
+
+  //wait for the uploads still reading the staging buffer
+  this->ReserveGPU();
+  cudaStreamSynchronize( *(this->GetStream()) );
+  for( int i = 0; i < 2; i++ )
+    {
+    if( live->StagingPinned[i] ) cudaFreeHost( live->Staging[i] );
+    else delete[] live->Staging[i];
+    cudaEventDestroy( live->Uploaded[i] );
+    }
+  for( int i = 0; i < live->QueueLength; i++ )
+    {
+    delete[] live->Slots[i];
+    }
+  delete[] live->Slots;
+  delete[] live->SliceIndices;
+
+  delete live;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::IsLiveInput(vtkImageData* image)
+{
+  return this->LiveImage && image == this->LiveImage;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::UploadLiveSlices()
+{
+  vtkCUDAVolumeMapperLiveStream* live = this->LiveStream;
+  if( !live || this->erroredOut )
+    {
+    return;
+    }
+  unsigned int head = live->Head;
+  VTKCUDAVOLUMEMAPPER_MEMORY_BARRIER();
+  if( head == live->Tail )
+    {
+    return;
+    }
+
+  //only the cropped part of each slice is uploaded
+  const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+  int size[3] = { subExtent[1] - subExtent[0] + 1, subExtent[3] - subExtent[2] + 1, 1 };
+  vtkIdType increments[3] = { 1, live->Dimensions[0], (vtkIdType) live->Dimensions[0] * live->Dimensions[1] };
+  size_t sliceVoxels = (size_t) size[0] * size[1];
+
+  //wait only for the uploads that last read this staging buffer, those of the previous render reading the other one
+  this->ReserveGPU();
+  const int index = live->StagingIndex;
+  cudaEventSynchronize( live->Uploaded[index] );
+  for( int staged = 0; live->Tail != head; )
+    {
+    unsigned int slot = live->Tail % live->QueueLength;
+    int z = live->SliceIndices[slot] - subExtent[4];
+    if( z >= 0 && z < subExtent[5] - subExtent[4] + 1 )
+      {
+      const char* slicePtr = live->Slots[slot] + (subExtent[0] + (vtkIdType) subExtent[2] * live->Dimensions[0]) * live->ScalarSize;
+      float* buffer = live->Staging[index] + sliceVoxels * staged++;
+      switch( live->ScalarType )
+        {
+        vtkTemplateMacro( vtkCUDAVolumeMapperConvertToFloat( reinterpret_cast<const VTK_TT*>(slicePtr), increments, size, buffer,
+                                                             NULL, NULL, 0 ) );
+        }
+      this->erroredOut |= !this->UploadSlabInternal(buffer, z, 1, 0);
+      }
+
+    //the slot is converted, so the producer can reuse it
+    VTKCUDAVOLUMEMAPPER_MEMORY_BARRIER();
+    live->Tail = live->Tail + 1;
+    }
+  cudaEventRecord( live->Uploaded[index], *(this->GetStream()) );
+  live->StagingIndex = 1 - index;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetInputBuffer(const void* buffer, int scalarType, const int dims[3], const double spacing[3],
+                                         const double origin[3], const vtkIdType strides[3],
+                                         InputBufferReleaseCallback release, void* clientData)
+{
+  if( !buffer || dims[0] < 1 || dims[1] < 1 || dims[2] < 1 )
+    {
+    vtkErrorMacro(<<"The input buffer is empty.");
+    return;
+    }
+  vtkIdType increments[3] = { 1, dims[0], (vtkIdType) dims[0] * dims[1] };
+  for( int i = 0; strides && i < 3; i++ )
+    {
+    increments[i] = strides[i];
+    }
+  if( increments[0] < 1 || increments[1] < 1 || increments[2] < 1 )
+    {
+    vtkErrorMacro(<<"The strides of the input buffer must be positive.");
+    return;
+    }
+  vtkDataArray* scalars = vtkDataArray::CreateDataArray(scalarType);
+  if( !scalars )
+    {
+    vtkErrorMacro(<<"Input cannot be of that type.");
+    return;
+    }
+  scalars->Delete();
+
+  //describe the buffer with an image carrying only its geometry and type, as scalars laid out by the image's own increments
+  //would misplace the voxels of a strided buffer, so its voxels are only read through GetUploadedVoxels
+  vtkImageData* image = vtkImageData::New();
+  image->SetExtent(0, dims[0]-1, 0, dims[1]-1, 0, dims[2]-1);
+  image->SetWholeExtent(image->GetExtent());
+  image->SetSpacing(spacing[0], spacing[1], spacing[2]);
+  image->SetOrigin(origin[0], origin[1], origin[2]);
+  image->SetScalarType(scalarType);
+  image->SetNumberOfScalarComponents(1);
+
+  //keep the previous buffer until the new one has replaced it on the device
+  vtkImageData* previousImage = this->InputBufferImage;
+  const void* previousBuffer = this->InputBuffer;
+  InputBufferReleaseCallback previousRelease = this->InputBufferRelease;
+  void* previousClientData = this->InputBufferClientData;
+
+  this->InputBufferImage = image;
+  this->InputBuffer = buffer;
+  for( int i = 0; i < 3; i++ )
+    {
+    this->InputBufferStrides[i] = increments[i];
+    }
+  this->InputBufferRelease = release;
+  this->InputBufferClientData = clientData;
+  this->SetInput(image);
+
+  if( previousImage )
+    {
+    if( previousRelease ) previousRelease(previousBuffer, previousClientData);
+    previousImage->Delete();
+    }
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::ReleaseInputBuffer()
+{
+  if( !this->InputBufferImage )
+    {
+    return;
+    }
+  if( this->InputBufferRelease )
+    {
+    this->InputBufferRelease(this->InputBuffer, this->InputBufferClientData);
+    }
+  this->InputBufferImage->Delete();
+  this->InputBufferImage = NULL;
+  this->InputBuffer = NULL;
+  this->InputBufferRelease = NULL;
+  this->InputBufferClientData = NULL;
+}
+
+//----------------------------------------------------------------------------
+const void* vtkCUDAVolumeMapper::GetUploadedVoxels(vtkImageData* image, vtkIdType increments[3])
+{
+  const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+  if( this->IsLiveInput(image) )
+    {
+    //the image of a live stream holds no voxels, its slices being uploaded as they are pushed
+    image->GetIncrements(increments);
+    return NULL;
+    }
+  if( image != this->InputBufferImage )
+    {
+    image->GetIncrements(increments);
+    return image->GetScalarPointer(subExtent[0], subExtent[2], subExtent[4]);
+    }
+
+  //the buffer keeps its own strides, which the image describing it cannot express
+  vtkIdType offset = 0;
+  for( int i = 0; i < 3; i++ )
+    {
+    increments[i] = this->InputBufferStrides[i];
+    offset += subExtent[2*i] * increments[i];
+    }
+  return static_cast<const char*>(this->InputBuffer) + offset * image->GetScalarSize();
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCUDAVolumeMapper::ComputeCacheKey(vtkImageData* image)
+{
+  const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+  int size[3] = { subExtent[1] - subExtent[0] + 1, subExtent[3] - subExtent[2] + 1, subExtent[5] - subExtent[4] + 1 };
+  vtkTypeUInt64 key = 0;
+
+  //a live volume keeps changing, so it is never cached
+  if( this->IsLiveInput(image) )
+    {
+    return key;
+    }
+
+  //a streamed file is keyed by its name, size and time rather than by its voxels, so the lookup does not wait for the decompression
+  if( this->StreamingReader && vtkCUDAVolumeCache::ComputeFileKey(this->StreamingReader->GetDataFileName(), &key) )
+    {
+    int description[7] = { subExtent[0], subExtent[1], subExtent[2], subExtent[3], subExtent[4], subExtent[5], image->GetScalarType() };
+    key = vtkCUDAVolumeCache::CombineKey(key, description, sizeof(description));
+    }
+  else
+    {
+    //hashing needs every uploaded slice, so a streamed input which cannot be keyed by its file waits for its decompression
+    if( this->StreamingReader )
+      {
+      this->StreamingReader->WaitForSlices(subExtent[5] - image->GetExtent()[4] + 1);
+      }
+    vtkIdType increments[3];
+    const void* firstVoxel = this->GetUploadedVoxels(image, increments);
+    key = vtkCUDAVolumeCache::ComputeKey(firstVoxel, image->GetScalarType(), image->GetScalarSize(), increments, size, this->Threader);
+    }
+
+  //the same voxels give other gradient statistics at another spacing, and another volume at another downsampling
+  double spacing[3];
+  image->GetSpacing(spacing);
+  int downsampling = this->VolumeInfoHandler->GetDownsampling();
+  key = vtkCUDAVolumeCache::CombineKey(key, spacing, sizeof(spacing));
+  return vtkCUDAVolumeCache::CombineKey(key, &downsampling, sizeof(downsampling));
+}
+
+//----------------------------------------------------------------------------
+// Device memory taken by a volume and the mip pyramid built over it, each coarser level holding its averages and min/max
+vtkTypeUInt64 vtkCUDAVolumeMapper::GetDeviceBytesInternal(const int dims[3], int voxelSize, bool live)
+{
+  vtkTypeUInt64 bytes = (vtkTypeUInt64) dims[0] * dims[1] * dims[2] * voxelSize;
+  int levelSize[3] = { dims[0], dims[1], dims[2] };
+  const int maxLevels = this->GetMaximumNumberOfLevels();
+  for( int level = 1; !live && level < maxLevels &&
+       levelSize[0] >= 16 && levelSize[1] >= 16 && levelSize[2] >= 16; level++ )
+    {
+    for( int i = 0; i < 3; i++ )
+      {
+      levelSize[i] = (levelSize[i] + 1) / 2;
+      }
+    bytes += (vtkTypeUInt64) levelSize[0] * levelSize[1] * levelSize[2] * (sizeof(float) + 2 * sizeof(float));
+    }
+  return bytes;
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumeMapper::GetMaximumNumberOfLevels()
+{
+  return CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS;
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkCUDAVolumeMapper::GetDeviceBytesAvailable()
+{
+  if( this->DeviceMemoryBudget != 0 )
+    {
+    return (this->DeviceMemoryBudget > this->UploadedBytes) ? this->DeviceMemoryBudget - this->UploadedBytes : 0;
+    }
+  this->ReserveGPU();
+  size_t freeBytes = 0;
+  size_t totalBytes = 0;
+  if( cudaMemGetInfo( &freeBytes, &totalBytes ) != cudaSuccess )
+    {
+    cudaGetLastError();
+    }
+  return (freeBytes > VTKCUDAVOLUMEMAPPER_MEMORY_HEADROOM) ? (vtkTypeUInt64) freeBytes - VTKCUDAVOLUMEMAPPER_MEMORY_HEADROOM : 0;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::ChooseUploadFormat(vtkImageData* image)
+{
+  //the volume being replaced gives its memory back, so it counts as free
+  vtkTypeUInt64 budget = this->DeviceMemoryBudget ? this->DeviceMemoryBudget : this->GetDeviceBytesAvailable() + this->UploadedBytes;
+
+  //try full precision before half, and each precision before halving the resolution again
+  const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+  bool live = this->IsLiveInput(image);
+  int downsampling = 0;
+  bool halfPrecision = false;
+  vtkTypeUInt64 bytes = 0;
+  for( int level = 0; level < (live ? 1 : CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS); level++ )
+    {
+    int dims[3];
+    for( int i = 0; i < 3; i++ )
+      {
+      dims[i] = subExtent[2*i+1] - subExtent[2*i] + 1;
+      for( int j = 0; j < level; j++ )
+        {
+        dims[i] = (dims[i] + 1) / 2;
+        }
+      }
+    downsampling = level;
+    halfPrecision = false;
+    bytes = this->GetDeviceBytesInternal( dims, sizeof(float), live );
+    if( bytes <= budget || live ) break;
+    halfPrecision = true;
+    bytes = this->GetDeviceBytesInternal( dims, sizeof(unsigned short), false );
+    if( bytes <= budget ) break;
+    }
+
+  if( live && bytes > budget )
+    {
+    vtkWarningMacro(<<"The live volume needs " << (bytes >> 20) << " MB of device memory, above the budget of " << (budget >> 20) << " MB.");
+    }
+
+  bool changed = (downsampling != this->VolumeInfoHandler->GetDownsampling() || halfPrecision != this->UploadHalfPrecision);
+  this->VolumeInfoHandler->SetDownsampling(downsampling);
+  this->UploadHalfPrecision = halfPrecision;
+  this->UploadedBytes = bytes;
+  if( changed )
+    {
+    //the voxel grid changes with the downsampling, so the matrices have to follow
+    this->volModified = 0;
+    }
+
+  if( downsampling > 0 || halfPrecision )
+    {
+    vtkWarningMacro(<<"The input does not fit the device memory budget of " << (budget >> 20) << " MB, so it is uploaded "
+                    << (halfPrecision ? "in half precision" : "in float") << " at 1/" << (1 << downsampling) << " of its resolution.");
+    this->InvokeEvent(vtkCUDAVolumeMapper::UploadDegradedEvent, NULL);
+    }
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumeMapper::GetUploadDownsampling()
+{
+  return this->VolumeInfoHandler->GetDownsampling();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::StreamInput(vtkImageData* input, int channel, double range[2])
+{
+  const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+  vtkCUDAVolumeMapperSlab slab;
+  slab.InputPointer = static_cast<const char*>(this->GetUploadedVoxels(input, slab.Increments));
+  slab.ScalarType = input->GetScalarType();
+  slab.ScalarSize = input->GetScalarSize();
+  slab.InputSize[0] = subExtent[1] - subExtent[0] + 1;
+  slab.InputSize[1] = subExtent[3] - subExtent[2] + 1;
+  slab.InputSize[2] = subExtent[5] - subExtent[4] + 1;
+  slab.Downsampling = this->VolumeInfoHandler->GetDownsampling();
+  const int* dims = this->VolumeInfoHandler->GetDimensions();
+  slab.Size[0] = dims[0];
+  slab.Size[1] = dims[1];
+  slab.Size[2] = dims[2];
+  slab.Error = 0;
+
+  //the statistics only have to be gathered again for modified data or another sub-extent
+  bool countStatistics = (input->GetMTime() != this->InputStatisticsTime);
+  for( int i = 0; i < 6; i++ )
+    {
+    countStatistics |= (subExtent[i] != this->InputStatisticsExtent[i]);
+    }
+  countStatistics &= !this->IsLiveInput(input) && channel == 0;
+  range = (channel != 0 && !this->IsLiveInput(input)) ? range : NULL;
+  int numThreads = this->Threader->GetNumberOfThreads();
+  std::vector<double> threadRanges( 2 * numThreads );
+  std::vector<vtkIdType> threadCounts;
+  for( int i = 0; i < numThreads; i++ )
+    {
+    threadRanges[2*i] = VTK_DOUBLE_MAX;
+    threadRanges[2*i+1] = -VTK_DOUBLE_MAX;
+    }
+  slab.NumberOfValues = !countStatistics ? 0 :
+                        (slab.ScalarType == VTK_UNSIGNED_CHAR || slab.ScalarType == VTK_SIGNED_CHAR) ? 256 :
+                        (slab.ScalarType == VTK_UNSIGNED_SHORT || slab.ScalarType == VTK_SHORT) ? 65536 : 0;
+  slab.ValueOffset = (slab.ScalarType == VTK_SIGNED_CHAR) ? 128 : (slab.ScalarType == VTK_SHORT) ? 32768 : 0;
+  if( countStatistics )
+    {
+    threadCounts.resize( (size_t) numThreads * (slab.NumberOfValues ? slab.NumberOfValues : VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS), 0 );
+    }
+  slab.ThreadRanges = (countStatistics || range) ? &threadRanges[0] : NULL;
+  slab.ThreadCounts = threadCounts.empty() ? NULL : &threadCounts[0];
+
+  //size the slabs so that two staging buffers stay small next to the volume, the other channels always being held as floats
+  const bool halfPrecision = this->UploadHalfPrecision && channel == 0;
+  size_t sliceVoxels = (size_t) slab.Size[0] * slab.Size[1];
+  size_t sliceBytes = (halfPrecision ? sizeof(unsigned short) : sizeof(float)) * sliceVoxels;
+  int slabSlices = (int) (VTKCUDAVOLUMEMAPPER_STAGING_BYTES / (sizeof(float) * sliceVoxels));
+  slabSlices = (slabSlices < 1) ? 1 : (slabSlices > slab.Size[2]) ? slab.Size[2] : slabSlices;
+
+  //double buffer the staging memory, using pageable memory if no pinned memory is left
+  this->ReserveGPU();
+  char* staging[2];
+  bool pinned[2];
+  cudaEvent_t uploaded[2];
+  for( int i = 0; i < 2; i++ )
+    {
+    pinned[i] = (cudaMallocHost( (void**) &staging[i], sliceBytes * slabSlices ) == cudaSuccess);
+    if( !pinned[i] )
+      {
+      cudaGetLastError();
+      staging[i] = new char[sliceBytes * slabSlices];
+      }
+    cudaEventCreate( &uploaded[i] );
+    }
+
+  //halves are staged once narrowed, the floats being converted into a scratch buffer first
+  std::vector<float> scratch( halfPrecision ? sliceVoxels * slabSlices : 0 );
+
+  bool result = true;
+  for( int z = 0, index = 0; result && z < slab.Size[2]; z += slabSlices, index = 1 - index )
+    {
+    //wait for the upload that last read this buffer before overwriting it
+    cudaEventSynchronize( uploaded[index] );
+
+    slab.FirstSlice = z;
+    slab.NumberOfSlices = (z + slabSlices > slab.Size[2]) ? slab.Size[2] - z : slabSlices;
+    slab.Buffer = halfPrecision ? &scratch[0] : reinterpret_cast<float*>(staging[index]);
+    slab.HalfBuffer = halfPrecision ? reinterpret_cast<unsigned short*>(staging[index]) : NULL;
+
+    //the volume of a live stream starts empty, its slices coming from PushLiveSlice
+    if( this->IsLiveInput(input) )
+      {
+      memset( staging[index], 0, sliceBytes * slab.NumberOfSlices );
+      result = this->UploadSlabInternal( staging[index], slab.FirstSlice, slab.NumberOfSlices, channel );
+      cudaEventRecord( uploaded[index], *(this->GetStream()) );
+      continue;
+      }
+
+    //a streamed input may still be decompressing the slices of the slab
+    int lastInputSlice = (z + slab.NumberOfSlices) << slab.Downsampling;
+    lastInputSlice = (lastInputSlice < slab.InputSize[2]) ? lastInputSlice : slab.InputSize[2];
+    int neededSlices = subExtent[4] - input->GetExtent()[4] + lastInputSlice;
+    if( channel == 0 && this->StreamingReader && this->StreamingReader->WaitForSlices(neededSlices) < neededSlices )
+      {
+      vtkErrorMacro(<<"The input could not be decompressed.");
+      result = false;
+      break;
+      }
+    this->Threader->SetSingleMethod( vtkCUDAVolumeMapperConvertSlab, &slab );
+    this->Threader->SingleMethodExecute();
+    if( slab.Error )
+      {
+      vtkErrorMacro(<<"Input cannot be of that type.");
+      result = false;
+      break;
+      }
+
+    result = this->UploadSlabInternal( staging[index], slab.FirstSlice, slab.NumberOfSlices, channel );
+    cudaEventRecord( uploaded[index], *(this->GetStream()) );
+    }
+
+  //the statistics of the input are gathered while the last uploads complete
+  if( result && this->IsLiveInput(input) )
+    {
+    //nothing is known of the live slices to come but the range of their type
+    this->InputScalarRange[0] = input->GetScalarTypeMin();
+    this->InputScalarRange[1] = input->GetScalarTypeMax();
+    memset( this->InputHistogram, 0, sizeof(this->InputHistogram) );
+    this->InputGradientRange[0] = this->InputGradientRange[1] = 0.0;
+    memset( this->InputGradientHistogram, 0, sizeof(this->InputGradientHistogram) );
+    this->InputGradientStatisticsValid = false;
+    this->InputStatisticsTime = 0;
+    }
+  else if( result && countStatistics )
+    {
+    this->GatherStatistics(&slab, numThreads);
+    this->InputStatisticsTime = input->GetMTime();
+    for( int i = 0; i < 6; i++ )
+      {
+      this->InputStatisticsExtent[i] = subExtent[i];
+      }
+    }
+  else if( result && range )
+    {
+    //a channel only needs the range, merged as for the input
+    range[0] = VTK_DOUBLE_MAX;
+    range[1] = -VTK_DOUBLE_MAX;
+    for( int i = 0; i < numThreads; i++ )
+      {
+      range[0] = (threadRanges[2*i] < range[0]) ? threadRanges[2*i] : range[0];
+      range[1] = (threadRanges[2*i+1] > range[1]) ? threadRanges[2*i+1] : range[1];
+      }
+    if( range[0] > range[1] )
+      {
+      range[0] = range[1] = 0.0;
+      }
+    }
+
+  cudaStreamSynchronize( *(this->GetStream()) );
+  for( int i = 0; i < 2; i++ )
+    {
+    if( pinned[i] ) cudaFreeHost( staging[i] );
+    else delete[] staging[i];
+    cudaEventDestroy( uploaded[i] );
+    }
+  return result;
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::GatherStatistics(vtkCUDAVolumeMapperSlab* slab, int numThreads)
+{
+  //merge the ranges seen by the threads
+  double range[2] = { VTK_DOUBLE_MAX, -VTK_DOUBLE_MAX };
+  for( int i = 0; i < numThreads; i++ )
+    {
+    range[0] = (slab->ThreadRanges[2*i] < range[0]) ? slab->ThreadRanges[2*i] : range[0];
+    range[1] = (slab->ThreadRanges[2*i+1] > range[1]) ? slab->ThreadRanges[2*i+1] : range[1];
+    }
+  if( range[0] > range[1] )
+    {
+    range[0] = range[1] = 0.0;
+    }
+  this->InputScalarRange[0] = range[0];
+  this->InputScalarRange[1] = range[1];
+  memset( this->InputHistogram, 0, sizeof(this->InputHistogram) );
+  this->InputGradientStatisticsValid = false;
+  double scale = (range[1] > range[0]) ? VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS / (range[1] - range[0]) : 0.0;
+
+  //small integer types were counted value by value while converting, so their counts only have to be binned
+  if( slab->NumberOfValues )
+    {
+    for( int value = 0; value < slab->NumberOfValues; value++ )
+      {
+      vtkIdType count = 0;
+      for( int i = 0; i < numThreads; i++ )
+        {
+        count += slab->ThreadCounts[(size_t) slab->NumberOfValues * i + value];
+        }
+      if( count == 0 ) continue;
+      int bin = (int) ((value - slab->ValueOffset - range[0]) * scale);
+      this->InputHistogram[ (bin >= VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS) ? VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS - 1 : bin ] += count;
+      }
+    return;
+    }
+
+  //other types need their range before they can be binned, in another parallel pass
+  slab->HistogramLow = range[0];
+  slab->HistogramScale = scale;
+  this->Threader->SetSingleMethod( vtkCUDAVolumeMapperCountSlab, slab );
+  this->Threader->SingleMethodExecute();
+  for( int i = 0; i < numThreads; i++ )
+    {
+    for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ )
+      {
+      this->InputHistogram[bin] += slab->ThreadCounts[(size_t) VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS * i + bin];
+      }
+    }
+}
+
+//----------------------------------------------------------------------------
+double vtkCUDAVolumeMapper::GetInputPercentile(double fraction)
+{
+  return vtkCUDAVolumeMapper::ComputePercentile(this->InputHistogram, this->InputScalarRange, fraction);
+}
+
+//----------------------------------------------------------------------------
+double vtkCUDAVolumeMapper::ComputePercentile(const vtkIdType histogram[VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS], const double range[2], double fraction)
+{
+  vtkIdType total = 0;
+  for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ )
+    {
+    total += histogram[bin];
+    }
+  if( total == 0 )
+    {
+    return range[0];
+    }
+
+  //interpolate within the bin holding the requested voxel
+  double target = (fraction < 0.0 ? 0.0 : fraction > 1.0 ? 1.0 : fraction) * total;
+  double binWidth = (range[1] - range[0]) / VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS;
+  double cumulative = 0.0;
+  for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ )
+    {
+    if( histogram[bin] > 0 && cumulative + histogram[bin] >= target )
+      {
+      return range[0] + (bin + (target - cumulative) / histogram[bin]) * binWidth;
+      }
+    cumulative += histogram[bin];
+    }
+  return range[1];
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::LoadStatisticsFromCache(vtkImageData* image)
+{
+  vtkTypeUInt64 size = 0;
+  const double* statistics = static_cast<const double*>( this->Cache->GetSection(VTKCUDAVOLUMEMAPPER_CACHE_STATISTICS, &size) );
+  const vtkTypeUInt64 scalarSize = sizeof(double) * (2 + VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS);
+  if( !statistics || (size != scalarSize && size != 2 * scalarSize) )
+    {
+    return false;
+    }
+  this->InputScalarRange[0] = statistics[0];
+  this->InputScalarRange[1] = statistics[1];
+  for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ )
+    {
+    this->InputHistogram[bin] = (vtkIdType) statistics[2 + bin];
+    }
+
+  //the gradient statistics follow in the same layout, if they were gathered
+  this->InputGradientStatisticsValid = (size == 2 * scalarSize);
+  if( this->InputGradientStatisticsValid )
+    {
+    const double* gradientStatistics = statistics + 2 + VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS;
+    this->InputGradientRange[0] = gradientStatistics[0];
+    this->InputGradientRange[1] = gradientStatistics[1];
+    for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ )
+      {
+      this->InputGradientHistogram[bin] = (vtkIdType) gradientStatistics[2 + bin];
+      }
+    }
+  this->InputStatisticsTime = image->GetMTime();
+  const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+  for( int i = 0; i < 6; i++ )
+    {
+    this->InputStatisticsExtent[i] = subExtent[i];
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::StoreStatisticsInCache()
+{
+  //stored as doubles, which hold the counts exactly
+  double statistics[2 * (2 + VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS)];
+  statistics[0] = this->InputScalarRange[0];
+  statistics[1] = this->InputScalarRange[1];
+  double* gradientStatistics = statistics + 2 + VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS;
+  gradientStatistics[0] = this->InputGradientRange[0];
+  gradientStatistics[1] = this->InputGradientRange[1];
+  for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ )
+    {
+    statistics[2 + bin] = (double) this->InputHistogram[bin];
+    gradientStatistics[2 + bin] = (double) this->InputGradientHistogram[bin];
+    }
+  const size_t size = this->InputGradientStatisticsValid ? sizeof(statistics) : sizeof(statistics) / 2;
+  return this->Cache->BeginSection(VTKCUDAVOLUMEMAPPER_CACHE_STATISTICS) &&
+         this->Cache->AppendToSection(statistics, size);
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::UploadSlabInternal(void* vtkNotUsed(slab), int vtkNotUsed(firstSlice), int vtkNotUsed(numSlices), int vtkNotUsed(channel))
+{
+  return false;
 }
 
 //----------------------------------------------------------------------------
@@ -279,6 +1419,14 @@ void vtkCUDAVolumeMapper::ClearInput()
   //clear information at this class level
   this->VolumeInfoHandler->ClearInput();
   std::map<int, vtkImageData*>::iterator it;
+
+  //the image describing an input buffer is owned by the mapper, so it is released along with the buffer rather than unregistered
+  for( it = this->inputImages.begin(); this->InputBufferImage && it!=this->inputImages.end(); )
+    {
+    if( it->second == this->InputBufferImage ) this->inputImages.erase(it++);
+    else it++;
+    }
+  this->ReleaseInputBuffer();
   for( it = this->inputImages.begin(); it!=this->inputImages.end(); it++)
     it->second->UnRegister(this);
   this->inputImages.clear();
@@ -287,12 +1435,142 @@ void vtkCUDAVolumeMapper::ClearInput()
   this->ClearInputInternal();
 }
 
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::ComputeCroppingExtent(vtkImageData* image, int extent[6])
+{
+  for( int i = 0; i < 6; i++ )
+    {
+    extent[i] = this->CroppingExtent[i];
+    }
+  if( !image || !this->Cropping || this->CroppingRegionFlags != VTK_CROP_SUBVOLUME )
+    {
+    return;
+    }
+
+  //convert the cropping region planes from data coordinates to indices, keeping the voxels they cut through
+  double origin[3];
+  double spacing[3];
+  int imageExtent[6];
+  image->GetOrigin(origin);
+  image->GetSpacing(spacing);
+  image->GetExtent(imageExtent);
+  for( int i = 0; i < 3; i++ )
+    {
+    double lower = (this->CroppingRegionPlanes[2*i]   - origin[i]) / spacing[i];
+    double upper = (this->CroppingRegionPlanes[2*i+1] - origin[i]) / spacing[i];
+    if( lower > upper )
+      {
+      double temp = lower; lower = upper; upper = temp;
+      }
+    int planeMin = (int) floor(lower);
+    int planeMax = (int) ceil(upper);
+
+    //intersect with the explicit cropping extent, if any
+    int axisMin = (extent[2*i] <= extent[2*i+1]) ? extent[2*i]   : imageExtent[2*i];
+    int axisMax = (extent[2*i] <= extent[2*i+1]) ? extent[2*i+1] : imageExtent[2*i+1];
+    extent[2*i]   = (planeMin > axisMin) ? planeMin : axisMin;
+    extent[2*i+1] = (planeMax < axisMax) ? planeMax : axisMax;
+    }
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::UpdateCroppingExtent()
+{
+  vtkImageData* input = this->VolumeInfoHandler->GetInputData();
+  if( !input )
+    {
+    return false;
+    }
+
+  int oldExtent[6];
+  const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+  for( int i = 0; i < 6; i++ )
+    {
+    oldExtent[i] = subExtent[i];
+    }
+
+  int extent[6];
+  this->ComputeCroppingExtent(input, extent);
+  this->VolumeInfoHandler->SetCroppingExtent(extent);
+  subExtent = this->VolumeInfoHandler->GetSubExtent();
+  bool changed = false;
+  for( int i = 0; i < 6; i++ )
+    {
+    changed |= (oldExtent[i] != subExtent[i]);
+    }
+  if( !changed )
+    {
+    return false;
+    }
+
+  //only the new sub-extent is converted and uploaded
+  for( std::map<int,vtkImageData*>::iterator it = this->inputImages.begin();
+    it != this->inputImages.end(); it++ )
+    {
+    this->SetInputInternal(it->second, it->first);
+    }
+  this->ChangeFrame(0);
+  return true;
+}
+
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::SetGradientShadingConstants(float darkness)
 {
   this->RendererInfoHandler->SetGradientShadingConstants(darkness);
 }
 
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetVoxelSpaceSampling(bool voxelSpace)
+{
+  this->VolumeInfoHandler->SetVoxelSpaceSampling(voxelSpace);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::GetVoxelSpaceSampling()
+{
+  return this->VolumeInfoHandler->GetVoxelSpaceSampling();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetSampleDistanceScale(float scale)
+{
+  this->VolumeInfoHandler->SetSampleDistance(scale);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+float vtkCUDAVolumeMapper::GetSampleDistanceScale()
+{
+  return this->VolumeInfoHandler->GetSampleDistance();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetCacheDirectory(const char* directory)
+{
+  this->Cache->SetDirectory(directory);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+const char* vtkCUDAVolumeMapper::GetCacheDirectory()
+{
+  return this->Cache->GetDirectory();
+}
+
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::SetCacheCompression(bool compression)
+{
+  this->Cache->SetCompression(compression ? 1 : 0);
+  this->Modified();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::GetCacheCompression()
+{
+  return this->Cache->GetCompression() != 0;
+}
+
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::SetRenderOutputScaleFactor(float scaleFactor)
 {
@@ -305,6 +1583,96 @@ void vtkCUDAVolumeMapper::ChangeFrame(unsigned int frame)
   this->ChangeFrameInternal(frame);
 }
 
+//----------------------------------------------------------------------------
+void vtkCUDAVolumeMapper::ChangeLevelInternal(unsigned int vtkNotUsed(level))
+{
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumeMapper::GetCurrentLevelOfDetail()
+{
+  return this->VolumeInfoHandler->GetLevelOfDetail();
+}
+
+//----------------------------------------------------------------------------
+bool vtkCUDAVolumeMapper::UpdateLevelOfDetail(vtkRenderer* renderer)
+{
+  int numLevels = this->VolumeInfoHandler->GetNumberOfLevelsOfDetail();
+  if( numLevels <= 1 || !this->VolumeInfoHandler->GetInputData() )
+    {
+    return false;
+    }
+
+  int level = this->LevelOfDetail;
+  if( this->AutoAdjustLevelOfDetail )
+    {
+    // Project the corners of the current voxel grid to find how many pixels
+    // the volume covers, and skip the levels whose voxels would be smaller
+    // than a pixel of the output image.
+    const cudaVolumeInformation& volumeInfo = this->VolumeInfoHandler->GetVolumeInfo();
+    const cudaOutputImageInformation& outputInfo = this->OutputInfoHandler->GetOutputImageInfo();
+    vtkMatrix4x4* voxelsToView = this->NextVoxelsToViewTransform->GetMatrix();
+    double viewMin[2] = {  1.0,  1.0 };
+    double viewMax[2] = { -1.0, -1.0 };
+    bool behindCamera = false;
+    for( int i = 0; i < 8; i++ )
+      {
+      double corner[4];
+      corner[0] = volumeInfo.Bounds[0 + (i & 1)];
+      corner[1] = volumeInfo.Bounds[2 + ((i >> 1) & 1)];
+      corner[2] = volumeInfo.Bounds[4 + ((i >> 2) & 1)];
+      corner[3] = 1.0;
+      double view[4];
+      voxelsToView->MultiplyPoint(corner, view);
+      if( view[3] <= 0.0 )
+        {
+        behindCamera = true;
+        break;
+        }
+      for( int j = 0; j < 2; j++ )
+        {
+        double v = view[j] / view[3];
+        v = (v < -1.0) ? -1.0 : (v > 1.0) ? 1.0 : v;
+        viewMin[j] = (v < viewMin[j]) ? v : viewMin[j];
+        viewMax[j] = (v > viewMax[j]) ? v : viewMax[j];
+        }
+      }
+
+    int footprintLevel = 0;
+    if( !behindCamera && viewMax[0] > viewMin[0] && viewMax[1] > viewMin[1] )
+      {
+      double pixelsX = 0.5 * (viewMax[0] - viewMin[0]) * outputInfo.resolution.x;
+      double pixelsY = 0.5 * (viewMax[1] - viewMin[1]) * outputInfo.resolution.y;
+      const int* dims = this->VolumeInfoHandler->GetDimensions();
+      int maxDim = (dims[0] > dims[1]) ? dims[0] : dims[1];
+      maxDim = (maxDim > dims[2]) ? maxDim : dims[2];
+      double voxelsPerPixel = (double) maxDim / ((pixelsX > pixelsY) ? pixelsX : pixelsY);
+      while( voxelsPerPixel >= 2.0 && footprintLevel < numLevels - 1 )
+        {
+        voxelsPerPixel *= 0.5;
+        footprintLevel++;
+        }
+      }
+    level = (footprintLevel > level) ? footprintLevel : level;
+
+    //trade resolution for frame rate while the user is interacting
+    vtkRenderWindow* window = renderer->GetRenderWindow();
+    if( window && window->GetDesiredUpdateRate() >= this->InteractiveUpdateRate )
+      {
+      level += this->InteractiveLevelOfDetailBias;
+      }
+    }
+  level = (level < numLevels) ? level : numLevels - 1;
+
+  if( level == this->VolumeInfoHandler->GetLevelOfDetail() )
+    {
+    return false;
+    }
+  this->VolumeInfoHandler->SetLevelOfDetail(level);
+  this->ChangeLevelInternal(level);
+  return true;
+}
+
 //----------------------------------------------------------------------------
 void vtkCUDAVolumeMapper::Render(vtkRenderer *renderer, vtkVolume *volume)
 {
@@ -313,11 +1681,25 @@ void vtkCUDAVolumeMapper::Render(vtkRenderer *renderer, vtkVolume *volume)
   this->VolumeInfoHandler->Update();
   this->RendererInfoHandler->SetRenderer(renderer);
   this->OutputInfoHandler->SetRenderer(renderer);
+  if( this->UpdateCroppingExtent() )
+    {
+    //the voxel grid starts at the cropped extent, so the matrices have to follow
+    this->volModified = 0;
+    }
   this->ComputeMatrices();
+  if( this->UpdateLevelOfDetail(renderer) )
+    {
+    //the voxel grid changes with the level of detail, so the matrices have to follow
+    this->volModified = 0;
+    this->ComputeMatrices();
+    }
   this->RendererInfoHandler->LoadZBuffer();
   this->RendererInfoHandler->SetClippingPlanes( this->ClippingPlanes );
   this->OutputInfoHandler->Prepare();
 
+  //bring the live volume up to date, the uploads being ordered before the ray casting on the stream
+  this->UploadLiveSlices();
+
   //pass the actual rendering process to the subclass
   if( erroredOut )
     {
@@ -390,6 +1772,13 @@ void vtkCUDAVolumeMapper::ComputeMatrices()
     img->GetSpacing(inputSpacing);
     img->GetExtent(inputExtent);
 
+    // Only the sub-extent is uploaded when cropping, so it replaces the input extent
+    const int* subExtent = this->VolumeInfoHandler->GetSubExtent();
+    for( int i = 0; i < 6; i++ )
+      {
+      inputExtent[i] = subExtent[i];
+      }
+
     // Compute the origin of the extent the volume origin is at voxel (0,0,0)
     // but we want to consider (0,0,0) in voxels to be at
     // (inputExtent[0], inputExtent[2], inputExtent[4]).
@@ -398,6 +1787,15 @@ void vtkCUDAVolumeMapper::ComputeMatrices()
     extentOrigin[1] = inputOrigin[1] + inputExtent[2]*inputSpacing[1];
     extentOrigin[2] = inputOrigin[2] + inputExtent[4]*inputSpacing[2];
 
+    // Coarser levels of detail (and a downsampled upload) average blocks of 2^level voxels,
+    // so voxel (0,0,0) of the level sits at the centre of the first block and the spacing grows
+    double levelScale = (double) (1 << (this->VolumeInfoHandler->GetDownsampling() + this->VolumeInfoHandler->GetLevelOfDetail()));
+    for( int i = 0; i < 3; i++ )
+      {
+      extentOrigin[i] += 0.5 * (levelScale - 1.0) * inputSpacing[i];
+      inputSpacing[i] *= levelScale;
+      }
+
     // Create a transform that will account for the scaling and translation of
     // the scalar data. The is the volume to voxels matrix.
     this->VoxelsTransform->Identity();
@@ -16,13 +16,20 @@
 #include "CUDA_containerRendererInformation.h"
 #include "CUDA_containerVolumeInformation.h"
 #include "CUDA_container1DTransferFunctionInformation.h"
+#include "CUDA_vtkCUDAVolumeMapper_renderAlgo.h"
 class vtkCUDAOutputImageInformationHandler;
 class vtkCUDARendererInformationHandler;
 class vtkCUDAVolumeInformationHandler;
+class vtkCUDACompressedVolumeReader;
+class vtkCUDAVolumeCache;
+struct vtkCUDAVolumeMapperLiveStream;
+struct vtkCUDAVolumeMapperSlab;
 
 // VTK includes
+#include <vtkCommand.h>
 #include <vtkVolumeMapper.h>
 class vtkMatrix4x4;
+class vtkMultiThreader;
 class vtkRenderer;
 class vtkRenderWindow;
 class vtkTransform;
@@ -32,6 +39,11 @@ class vtkVolumeProperty;
 // STD includes
 #include <map>
 
+/** @brief Number of bins of the histogram of the input gathered while uploading it
+*
+*/
+#define VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS 256
+
 /** @brief vtkCUDAVolumeMapper is an abstract CUDA volume mapper
 *   Taking a set of 3D image data objects, volume and renderer as input and
 *   creates a 2D ray casted projection of the scene which is then displayed to screen
@@ -44,6 +56,11 @@ public:
   vtkTypeMacro (vtkCUDAVolumeMapper,vtkVolumeMapper);
   void PrintSelf( ostream& os, vtkIndent indent );
 
+  /** @brief Event invoked when an input is uploaded downsampled or in half precision to fit the device memory budget
+  *
+  */
+  enum { UploadDegradedEvent = vtkCommand::UserEvent + 1 };
+
   using vtkVolumeMapper::SetInput;
   /** @brief Sets the 3D image data for the first frame in the 4D sequence
   *
@@ -63,6 +80,77 @@ public:
   void SetInput( vtkImageData * image, int frame);
   virtual void SetInputInternal( vtkImageData * image, int frame) = 0;
 
+  /** @brief Sets the first frame from a compressed volume reader, converting and uploading each slab of the volume as soon as it is decompressed rather than once the whole file is read
+  *
+  *  @param reader The reader, which is updated by the mapper and has to outlive any use of its output
+  *
+  *  @note The reader is pipelined for this update only, and has finished decompressing when this returns
+  */
+  void SetInputReader( vtkCUDACompressedVolumeReader* reader );
+
+  /** @brief Starts streaming live slices (such as from an ultrasound probe or a CBCT) into a volume kept on the device, which replaces the input
+  *
+  *  @param scalarType The VTK scalar type of the slices
+  *  @param dims The size of the volume, slices being along the third axis
+  *  @param spacing The spacing of the volume
+  *  @param origin The position of the first voxel of the volume
+  *  @param queueLength The number of slices that can be waiting for the next render
+  *
+  *  @note The volume starts empty and is not part of any pipeline, the image describing it holding no voxels as the slices only go to the device. The mip pyramid is not used while streaming, and a change of the cropping empties the volume again
+  */
+  void StartLiveStream( int scalarType, const int dims[3], const double spacing[3], const double origin[3], int queueLength = 16 );
+
+  /** @brief Queues a slice for the next render, which converts and uploads the queued slices asynchronously before ray casting
+  *
+  *  @param slice The voxels of the slice, contiguous and of the size and type given to StartLiveStream, which are copied before returning
+  *  @param sliceIndex The slice of the volume to overwrite, or -1 to write the slice following the last one pushed (wrapping around at the end of the volume)
+  *
+  *  @note This never blocks nor locks and may be called from one producer thread while rendering, but not concurrently with StartLiveStream or StopLiveStream
+  *
+  *  @return false if the queue is full (the slice is then dropped) or no stream was started
+  */
+  bool PushLiveSlice( const void* slice, int sliceIndex = -1 );
+
+  /** @brief Gets the number of slices waiting for the next render
+  *
+  */
+  int GetNumberOfPendingLiveSlices();
+
+  /** @brief Gets the number of slices dropped since the stream started because the queue was full
+  *
+  */
+  unsigned long GetNumberOfDroppedLiveSlices();
+
+  /** @brief Stops the live stream, keeping the last uploaded volume as the input until another one is set
+  *
+  *  @note The stream is stopped as well when another input is set
+  */
+  void StopLiveStream();
+
+  /** @brief Callback releasing a buffer given to SetInputBuffer once the mapper no longer reads it
+  *
+  *  @param buffer The buffer given to SetInputBuffer
+  *  @param clientData The client data given along with the buffer
+  */
+  typedef void (*InputBufferReleaseCallback)( const void* buffer, void* clientData );
+
+  /** @brief Sets the first frame from voxels held in a buffer of the caller, which are converted and uploaded straight from that buffer rather than copied into an image first
+  *
+  *  @param buffer The first voxel, which has to stay valid and unchanged until the release callback is called
+  *  @param scalarType The VTK scalar type of the voxels
+  *  @param dims The number of voxels along each axis
+  *  @param spacing The spacing of the voxels
+  *  @param origin The position of the first voxel
+  *  @param strides The increments in scalars between consecutive voxels, rows and slices, or NULL if the buffer is contiguous
+  *  @param release Called once the buffer is replaced (by another buffer or image) or the mapper is destroyed, may be NULL
+  *  @param clientData Passed to the release callback
+  *
+  *  @note The buffer is not part of any pipeline, so the mapper never updates it, and it is read again whenever the cropping changes what is uploaded
+  *  @note The image given to the pipeline in place of the buffer holds no scalars, the range of the voxels coming from the mapper's statistics
+  */
+  void SetInputBuffer( const void* buffer, int scalarType, const int dims[3], const double spacing[3], const double origin[3],
+                       const vtkIdType strides[3], InputBufferReleaseCallback release, void* clientData );
+
   /** @brief Uses the provided renderer and volume to render the image data at the current frame
   *
   *  @note This is an internal method used primarily by the rendering pipeline
@@ -84,6 +172,140 @@ public:
   */
   void SetRenderOutputScaleFactor(float scaleFactor);
 
+  /** @brief Sets the finest level of the mip pyramid the ray caster is allowed to sample
+  *
+  *  @param level The level of detail, 0 being full resolution and each further level halving the resolution in each direction
+  */
+  vtkSetClampMacro(LevelOfDetail, int, 0, CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS-1);
+  vtkGetMacro(LevelOfDetail, int);
+
+  /** @brief Sets whether the level of detail is picked per frame from the screen-space footprint of a voxel and from interaction
+  *
+  *  @note The chosen level is never finer than the one given by SetLevelOfDetail
+  *  @note Off by default, so the volume is rendered at the level given by SetLevelOfDetail
+  */
+  vtkSetMacro(AutoAdjustLevelOfDetail, int);
+  vtkGetMacro(AutoAdjustLevelOfDetail, int);
+  vtkBooleanMacro(AutoAdjustLevelOfDetail, int);
+
+  /** @brief Sets the number of additional coarser levels used while the render window is interactive
+  *
+  *  @note A render is considered interactive when the render window's desired update rate is at least the interactive update rate
+  *  @note 0 by default, so interaction does not coarsen the render
+  */
+  vtkSetClampMacro(InteractiveLevelOfDetailBias, int, 0, CUDA_VTKCUDAVOLUMEMAPPER_MAX_LEVELS-1);
+  vtkGetMacro(InteractiveLevelOfDetailBias, int);
+  vtkSetMacro(InteractiveUpdateRate, double);
+  vtkGetMacro(InteractiveUpdateRate, double);
+
+  /** @brief Gets the level of the mip pyramid used for the last render
+  *
+  */
+  int GetCurrentLevelOfDetail();
+
+  /** @brief Sets how the ray step is sized, which is passed to the volume information handler
+  *
+  *  @param voxelSpace True to take one step per voxel along the ray direction (with the opacity corrected for the step length), false to step by the minimum spacing of the volume
+  *
+  *  @note Stepping in voxels avoids sampling thick-slice volumes several times per slice along the slice direction
+  */
+  void SetVoxelSpaceSampling(bool voxelSpace);
+  bool GetVoxelSpaceSampling();
+
+  /** @brief Sets the length of a ray step relative to the step picked by the voxel space sampling, which is passed to the volume information handler
+  *
+  *  @param scale The scale of a step (1.0 by default), the opacity being corrected for the step length
+  *
+  *  @note Larger steps take proportionally fewer samples, which pre-integrated transfer functions keep free of slab artefacts
+  */
+  void SetSampleDistanceScale(float scale);
+  float GetSampleDistanceScale();
+
+  /** @brief Sets the extent of the input that is uploaded to the GPU and rendered, in the index coordinates of the input extent
+  *
+  *  @note An empty extent (a minimum above its maximum, the default) means the whole input. When cropping is enabled with the VTK_CROP_SUBVOLUME region flags, the cropping region planes shrink this extent further, while other region flags are ignored
+  *  @note Memory, upload time and ray length scale with the cropped extent, at the price of a new upload whenever it changes
+  */
+  vtkSetVector6Macro(CroppingExtent, int);
+  vtkGetVector6Macro(CroppingExtent, int);
+
+  /** @brief Gets the scalar range of the uploaded part of the input, gathered once while uploading it
+  *
+  *  @note A live stream reports the range of its scalar type
+  */
+  const double* GetInputScalarRange() { return this->InputScalarRange; }
+
+  /** @brief Gets the histogram of the uploaded part of the input, whose VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS bins evenly span its scalar range
+  *
+  */
+  const vtkIdType* GetInputHistogram() { return this->InputHistogram; }
+
+  /** @brief Gets the value below which a fraction of the uploaded voxels lie, interpolated within the bins of the histogram
+  *
+  *  @param fraction The fraction of the voxels, between 0.0 and 1.0
+  */
+  double GetInputPercentile(double fraction);
+
+  /** @brief Gets the value below which a fraction of the voxels counted by a histogram lie, interpolated within its bins
+  *
+  *  @param histogram The VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS bins of the histogram
+  *  @param range The range of values the bins evenly span
+  *  @param fraction The fraction of the voxels, clamped between 0.0 and 1.0
+  *
+  *  @return The lower end of the range for an empty histogram
+  */
+  static double ComputePercentile(const vtkIdType histogram[VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS], const double range[2], double fraction);
+
+  /** @brief Converts a float to the bits of a half, rounding to nearest even, as the device half type is not available on the host
+  *
+  *  @note Values beyond the range of a half, infinities included, saturate to the largest finite half rather than becoming infinite
+  */
+  static unsigned short FloatToHalf(float value);
+
+  /** @brief Gets the range of the gradient magnitudes of the uploaded part of the input, in intensity per unit of distance as the ray caster computes them, gathered once after uploading it
+  *
+  *  @note Both ends are 0.0 while the gradients are unknown, as for a live stream
+  */
+  const double* GetInputGradientRange() { return this->InputGradientRange; }
+
+  /** @brief Gets the histogram of the gradient magnitudes of the uploaded part of the input, whose VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS bins evenly span their range
+  *
+  */
+  const vtkIdType* GetInputGradientHistogram() { return this->InputGradientHistogram; }
+
+  /** @brief Sets the device memory in bytes that the uploaded volume and its mip pyramid may take
+  *
+  *  @note When the input does not fit, it is uploaded in half precision, then halved in resolution as many times as needed, reporting the choice through UploadDegradedEvent and a warning
+  *  @note 0 (the default) uses the free memory of the device at upload time, less some room left for rendering
+  *  @note What the subclass keeps over the volume, such as its bricks, counts against the budget, and optional copies such as a pre-classified volume are only made while they fit in what is left
+  */
+  vtkSetMacro(DeviceMemoryBudget, vtkTypeUInt64);
+  vtkGetMacro(DeviceMemoryBudget, vtkTypeUInt64);
+
+  /** @brief Gets the number of times the last uploaded input was halved in resolution to fit the budget, 0 meaning full resolution
+  *
+  */
+  int GetUploadDownsampling();
+
+  /** @brief Gets whether the last uploaded input is held in half precision to fit the budget
+  *
+  *  @note Half precision keeps 11 significant bits, and values beyond 65504 in magnitude saturate
+  */
+  bool GetUploadHalfPrecision() { return this->UploadHalfPrecision; }
+
+  /** @brief Sets the directory where the preprocessed inputs are cached, so an input seen before (in this or an earlier session) is loaded without being preprocessed again
+  *
+  *  @note Caching is disabled while no directory is set (the default), and the cache files are never removed by the mapper
+  */
+  void SetCacheDirectory(const char* directory);
+  const char* GetCacheDirectory();
+
+  /** @brief Sets whether new cache files are compressed, which requires the library to be built with zstd support
+  *
+  */
+  void SetCacheCompression(bool compression);
+  bool GetCacheCompression();
+
   /** @brief Set the strength of the photorealistic shading model which is given to the renderer information handler
   *
   *  @param darkness Floating point between 0.0f and 1.0f inclusive, where 0.0f means no shading, and 1.0f means maximal shading
@@ -116,6 +338,127 @@ protected:
   void ChangeFrame(unsigned int frame);
   virtual void ChangeFrameInternal(unsigned int frame) = 0;
 
+  /** @brief Changes the level of the mip pyramid sampled by the subclass
+  *
+  *  @param level The level of detail to sample, 0 being full resolution
+  *
+  *  @pre level is less than the number of levels of detail reported to the volume information handler
+  */
+  virtual void ChangeLevelInternal(unsigned int level);
+
+  /** @brief Picks the level of detail for the coming render from the voxel footprint on screen and the interaction state
+  *
+  *  @return true if the level changed, in which case the matrices have to be recomputed
+  */
+  bool UpdateLevelOfDetail(vtkRenderer* renderer);
+
+  /** @brief Combines the cropping extent with the cropping region planes of the mapper into the extent of the image to upload
+  *
+  *  @param image The image the extent is computed for
+  *  @param extent The extent to upload, in the index coordinates of the image extent
+  */
+  void ComputeCroppingExtent(vtkImageData* image, int extent[6]);
+
+  /** @brief Passes the current cropping to the volume information handler, uploading every frame again if the sub-extent changed
+  *
+  *  @return true if the sub-extent changed, in which case the matrices have to be recomputed
+  */
+  bool UpdateCroppingExtent();
+
+  /** @brief Picks the precision and downsampling of the volume uploaded for an image so that it fits the device memory budget, passing the downsampling to the volume information handler
+  *
+  *  @note Live inputs are always uploaded at full resolution in float, as their slices are written in place
+  */
+  void ChooseUploadFormat(vtkImageData* image);
+
+  /** @brief Gets the device memory taken by a volume of the given size along with whatever the subclass keeps over it, such as the mip pyramid and the bricks
+  *
+  *  @param dims The size of the uploaded volume in voxels
+  *  @param voxelSize The size in bytes of a voxel of the uploaded volume
+  *  @param live Whether the volume is a live one, which has no mip pyramid
+  */
+  virtual vtkTypeUInt64 GetDeviceBytesInternal(const int dims[3], int voxelSize, bool live);
+
+  /** @brief Gets the most levels of detail the subclass builds over the uploaded volume, 1 being the volume alone without a mip pyramid
+  *
+  */
+  virtual int GetMaximumNumberOfLevels();
+
+  /** @brief Gets the device memory the mapper may still allocate beyond the uploaded volume, from the budget or else the free memory of the device
+  *
+  */
+  vtkTypeUInt64 GetDeviceBytesAvailable();
+
+  /** @brief Converts the uploaded sub-extent of an image to float a slab of slices at a time, handing each slab to UploadSlabInternal
+  *
+  *  @param image The image to convert, which may be backed by a memory mapped file
+  *  @param channel The channel the slabs are uploaded into, 0 being the input and the others the co-registered images of a subclass sampling several,
+  *                 which are staged as floats without gathering the statistics of the input
+  *  @param range If given for a channel past the first, receives the scalar range of its uploaded sub-extent, gathered while converting it
+  *
+  *  @note The slices of a slab are converted in parallel into pinned staging buffers, so the conversion of a slab overlaps the upload of the previous one and the input is read page by page without a full size host copy
+  *
+  *  @return true if every slab was converted and uploaded
+  */
+  bool StreamInput(vtkImageData* image, int channel = 0, double range[2] = NULL);
+
+  /** @brief Gets the first voxel of the uploaded sub-extent of an input and the increments between its voxels
+  *
+  *  @param image The input, which may describe a buffer given to SetInputBuffer
+  *  @param increments Set to the increments in scalars between consecutive voxels, rows and slices
+  */
+  const void* GetUploadedVoxels(vtkImageData* image, vtkIdType increments[3]);
+
+  /** @brief Merges the statistics gathered by the threads converting the input, binning them in another pass if needed
+  *
+  */
+  void GatherStatistics(vtkCUDAVolumeMapperSlab* slab, int numThreads);
+
+  /** @brief Reads the statistics of an input from the open cache file
+  *
+  *  @return false if the file holds no statistics
+  *
+  *  @note The gradient statistics stay invalid if the file predates them
+  */
+  bool LoadStatisticsFromCache(vtkImageData* image);
+
+  /** @brief Appends the statistics of the input to the cache file being written, followed by the gradient statistics if they were gathered
+  *
+  */
+  bool StoreStatisticsInCache();
+
+  /** @brief Checks whether an input is the volume of a live stream, which only lives on the device
+  *
+  */
+  bool IsLiveInput(vtkImageData* image);
+
+  /** @brief Converts and uploads the slices queued by PushLiveSlice, called before ray casting
+  *
+  */
+  void UploadLiveSlices();
+
+  /** @brief Computes the key of the uploaded sub-extent of an input in the volume cache
+  *
+  */
+  vtkTypeUInt64 ComputeCacheKey(vtkImageData* image);
+
+  /** @brief Calls the release callback of the buffer given to SetInputBuffer, if any, and forgets the buffer
+  *
+  */
+  void ReleaseInputBuffer();
+
+  /** @brief Uploads a slab of converted slices into the frame being loaded by the subclass
+  *
+  *  @param slab Pinned host buffer holding numSlices slices of the uploaded volume as floats, or as halves when GetUploadHalfPrecision is set
+  *  @param firstSlice The index of the first slice of the slab within the sub-extent
+  *  @param numSlices The number of slices in the slab
+  *  @param channel The channel of the slab, as given to StreamInput
+  *
+  *  @note The upload may be asynchronous on the stream of the mapper, the slab being left untouched until the stream has passed it
+  *  @note The subclass may rewrite the slab in place before uploading it, such as to narrow its voxels, the staging being refilled for the next slab
+  */
+  virtual bool UploadSlabInternal(void* slab, int firstSlice, int numSlices, int channel);
+
   /** @brief Clears all the frames in the 4D sequence
   *
   */
@@ -146,6 +489,37 @@ protected:
   vtkTransform  *VoxelsToViewTransform;       /**< Temporary storage of the voxels to view transformation used to speed the process of switching/recalculating matrices*/
   vtkTransform  *NextVoxelsToViewTransform;   /**< Temporary storage of the next voxels to view transformation used to speed the process of switching/recalculating matrices */
 
+  int CroppingExtent[6];                      /**< The extent of the input to upload, empty for the whole input */
+
+  int LevelOfDetail;                          /**< The finest level of the mip pyramid that may be sampled */
+  int AutoAdjustLevelOfDetail;                /**< Whether the level of detail follows the voxel footprint and interaction */
+  int InteractiveLevelOfDetailBias;           /**< Number of coarser levels used while interacting */
+  double InteractiveUpdateRate;               /**< Desired update rate at or above which a render is considered interactive */
+
+  vtkMultiThreader* Threader;                 /**< The threads converting the slabs of the input */
+  vtkCUDAVolumeCache* Cache;                  /**< The on-disk cache of the preprocessed inputs */
+
+  vtkImageData* InputBufferImage;             /**< The image describing the buffer given to SetInputBuffer, if any */
+  const void* InputBuffer;                    /**< The buffer given to SetInputBuffer */
+  vtkIdType InputBufferStrides[3];            /**< The increments in scalars between the voxels, rows and slices of the buffer */
+  InputBufferReleaseCallback InputBufferRelease; /**< The callback releasing the buffer */
+  void* InputBufferClientData;                /**< The client data of the release callback */
+  vtkCUDACompressedVolumeReader* StreamingReader; /**< The reader still decompressing the input being streamed, if any */
+  vtkCUDAVolumeMapperLiveStream* LiveStream;  /**< The live stream being uploaded, if any */
+  double InputScalarRange[2];                  /**< The scalar range of the uploaded part of the input */
+  vtkIdType InputHistogram[VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS]; /**< The histogram of the uploaded part of the input over its scalar range */
+  double InputGradientRange[2];               /**< The range of the gradient magnitudes of the uploaded part of the input */
+  vtkIdType InputGradientHistogram[VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS]; /**< The histogram of the gradient magnitudes over their range */
+  bool InputGradientStatisticsValid;          /**< Whether the gradient statistics were gathered from the uploaded input, which the subclass holding the volume on the device does */
+  unsigned long InputStatisticsTime;          /**< The modified time of the input the statistics were gathered from */
+  int InputStatisticsExtent[6];               /**< The sub-extent the statistics were gathered from */
+
+  vtkTypeUInt64 DeviceMemoryBudget;           /**< The device memory the uploaded volume may take, 0 for the free memory */
+  vtkTypeUInt64 UploadedBytes;                /**< The device memory taken by the last uploaded volume and what the subclass keeps over it */
+  bool UploadHalfPrecision;                   /**< Whether the last uploaded volume is held in half precision */
+
+  vtkImageData* LiveImage;                    /**< The image describing the volume of the live stream, which stays the input once stopped */
+
   bool erroredOut;                            /**< Boolean to describe whether it is safe to render */
   std::map<int, vtkImageData*> inputImages;
 
@@ -0,0 +1,166 @@
+// CUDA Volume Rendering includes
+#include "vtkCUDA1DTransferFunctionInformationHandler.h"
+
+// VTK includes
+#include <vtkColorTransferFunction.h>
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtkPiecewiseFunction.h>
+
+// STD includes
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+// Exposes the choice of table made when the transfer function is updated
+class vtkCUDAExactTableTestHandler : public vtkCUDA1DTransferFunctionInformationHandler
+{
+public:
+  static vtkCUDAExactTableTestHandler* New() { return new vtkCUDAExactTableTestHandler; }
+  bool Fit(double minIntensity, double maxIntensity, double& firstValue, int& values)
+    { return this->FitExactTable(minIntensity, maxIntensity, firstValue, values); }
+};
+
+//----------------------------------------------------------------------------
+// A range of an input and the exact table it should get, 0 expected values meaning the default interpolated table
+struct SizeCase
+{
+  const char* Name;
+  int ScalarType;
+  double MinIntensity;
+  double MaxIntensity;
+  double ExpectedFirst;
+  int ExpectedValues;
+};
+
+const SizeCase SizeCases[] =
+{
+  //8 bit data
+  { "8 bit", VTK_UNSIGNED_CHAR, 0.0, 255.0, 0.0, 256 },
+  { "8 bit", VTK_SIGNED_CHAR, -128.0, 127.0, -128.0, 256 },
+  { "8 bit", VTK_CHAR, 10.0, 20.0, 10.0, 11 },
+
+  //12 bit data, as stored in 16 bits by most scanners
+  { "12 bit", VTK_UNSIGNED_SHORT, 0.0, 4095.0, 0.0, 4096 },
+  { "12 bit", VTK_SHORT, -1024.0, 3071.0, -1024.0, 4096 },
+
+  //16 bit data, up to the full range of the type
+  { "16 bit", VTK_UNSIGNED_SHORT, 0.0, 65535.0, 0.0, 65536 },
+  { "16 bit", VTK_SHORT, -32768.0, 32767.0, -32768.0, 65536 },
+
+  //fractional ends only cover the integer values within them
+  { "Fractional", VTK_SHORT, -10.5, 20.25, -10.0, 31 },
+  { "Fractional", VTK_UNSIGNED_CHAR, 0.1, 1.9, 0.0, 0 },
+  { "Fractional", VTK_UNSIGNED_CHAR, 0.9, 2.1, 1.0, 2 },
+
+  //ranges of fewer than two or more than 65536 values
+  { "Single value", VTK_UNSIGNED_CHAR, 7.0, 7.0, 0.0, 0 },
+  { "No value", VTK_UNSIGNED_CHAR, 7.2, 7.8, 0.0, 0 },
+  { "Too wide", VTK_SHORT, -32768.0, 32768.0, 0.0, 0 },
+
+  //types with no exact tables
+  { "Float", VTK_FLOAT, 0.0, 255.0, 0.0, 0 },
+  { "Double", VTK_DOUBLE, 0.0, 255.0, 0.0, 0 },
+  { "Int", VTK_INT, 0.0, 255.0, 0.0, 0 },
+  { "Unsigned int", VTK_UNSIGNED_INT, 0.0, 255.0, 0.0, 0 }
+};
+
+//----------------------------------------------------------------------------
+// A transfer function over an input, given by an opacity ramp from 0 to 1 between two nodes (with the sharpness of the first),
+// and the table the handler should fit to it
+struct FitCase
+{
+  const char* Name;
+  int ScalarType;
+  bool ExactTables;
+  double MinIntensity;
+  double MaxIntensity;
+  double RampStart;
+  double RampEnd;
+  double RampSharpness;
+  double ExpectedFirst;
+  int ExpectedValues;
+};
+
+//the 512 entries of the default table are 8 values apart over 4096 values, so a feature narrower than 32 values gets an exact table
+const FitCase FitCases[] =
+{
+  { "Narrow feature", VTK_UNSIGNED_SHORT, true, 0.0, 4095.0, 2000.0, 2010.0, 0.0, 0.0, 4096 },
+  { "Wide feature", VTK_UNSIGNED_SHORT, true, 0.0, 4095.0, 1000.0, 3000.0, 0.0, 0.0, 0 },
+  { "Sharp feature", VTK_UNSIGNED_SHORT, true, 0.0, 4095.0, 1000.0, 3000.0, 0.999, 0.0, 4096 },
+  { "Feature outside the range", VTK_SHORT, true, -1024.0, 3071.0, 3500.0, 3510.0, 0.0, 0.0, 0 },
+  { "Narrow range", VTK_UNSIGNED_SHORT, true, 100.0, 200.0, 0.0, 4095.0, 0.0, 100.0, 101 },
+  { "Exact tables off", VTK_UNSIGNED_SHORT, false, 0.0, 4095.0, 2000.0, 2010.0, 0.0, 0.0, 0 },
+  { "Float", VTK_FLOAT, true, 0.0, 4095.0, 2000.0, 2010.0, 0.0, 0.0, 0 }
+};
+
+//----------------------------------------------------------------------------
+bool CheckTable(const char* name, double minIntensity, double maxIntensity, bool exact, double firstValue, int values,
+                double expectedFirst, int expectedValues)
+{
+  if( !exact && expectedValues > 0 )
+    {
+    std::cerr << name << ": the range " << minIntensity << ".." << maxIntensity << " has no exact table." << std::endl;
+    return false;
+    }
+  if( exact && expectedValues == 0 )
+    {
+    std::cerr << name << ": the range " << minIntensity << ".." << maxIntensity << " gets an exact table of " << values << " entries." << std::endl;
+    return false;
+    }
+  if( exact && (firstValue != expectedFirst || values != expectedValues) )
+    {
+    std::cerr << name << ": the range " << minIntensity << ".." << maxIntensity << " gets " << values << " entries from "
+              << firstValue << " instead of " << expectedValues << " from " << expectedFirst << std::endl;
+    return false;
+    }
+  return true;
+}
+
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAExactTableTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  bool succeeded = true;
+
+  for( size_t i = 0; i < sizeof(SizeCases) / sizeof(SizeCases[0]); i++ )
+    {
+    const SizeCase& c = SizeCases[i];
+    double firstValue = 0.0;
+    int values = 0;
+    bool exact = vtkCUDA1DTransferFunctionInformationHandler::ComputeExactTableSize(c.ScalarType, c.MinIntensity, c.MaxIntensity, firstValue, values);
+    succeeded &= CheckTable(c.Name, c.MinIntensity, c.MaxIntensity, exact, firstValue, values, c.ExpectedFirst, c.ExpectedValues);
+    }
+
+  vtkNew<vtkCUDAExactTableTestHandler> handler;
+  vtkNew<vtkColorTransferFunction> colour;
+  colour->AddRGBPoint(-32768.0, 0.0, 0.0, 0.0);
+  colour->AddRGBPoint(65535.0, 1.0, 1.0, 1.0);
+  handler->SetColourTransferFunction(colour.GetPointer());
+  for( size_t i = 0; i < sizeof(FitCases) / sizeof(FitCases[0]); i++ )
+    {
+    const FitCase& c = FitCases[i];
+    vtkNew<vtkImageData> image;
+    image->SetScalarType(c.ScalarType);
+    vtkNew<vtkPiecewiseFunction> opacity;
+    opacity->AddPoint(c.RampStart, 0.0, 0.5, c.RampSharpness);
+    opacity->AddPoint(c.RampEnd, 1.0);
+    handler->SetInputData(image.GetPointer(), 0);
+    handler->SetOpacityTransferFunction(opacity.GetPointer());
+    handler->SetExactTables(c.ExactTables);
+
+    double firstValue = 0.0;
+    int values = 0;
+    bool exact = handler->Fit(c.MinIntensity, c.MaxIntensity, firstValue, values);
+    succeeded &= CheckTable(c.Name, c.MinIntensity, c.MaxIntensity, exact, firstValue, values, c.ExpectedFirst, c.ExpectedValues);
+    }
+  handler->SetInputData(NULL, 0);
+  handler->SetOpacityTransferFunction(NULL);
+  handler->SetColourTransferFunction(NULL);
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,94 @@
+// CUDA Volume Rendering includes
+#include "vtkCUDAVolumeMapper.h"
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <limits>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+bool CheckHalf(float value, unsigned short expected)
+{
+  unsigned short half = vtkCUDAVolumeMapper::FloatToHalf(value);
+  if( half != expected )
+    {
+    std::cerr << "Converting " << value << " gives 0x" << std::hex << half << " instead of 0x" << expected << std::dec << std::endl;
+    return false;
+    }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+float HalfToFloat(unsigned short half)
+{
+  int exponent = (half >> 10) & 0x1f;
+  int mantissa = half & 0x3ff;
+  float magnitude = (exponent == 0) ? (float) ldexp( (double) mantissa, -24 ) :
+                                      (float) ldexp( (double) (mantissa | 0x400), exponent - 25 );
+  return (half & 0x8000) ? -magnitude : magnitude;
+}
+
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAFloatToHalfTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  bool succeeded = true;
+
+  //exact values and signs
+  succeeded &= CheckHalf(0.0f, 0x0000);
+  succeeded &= CheckHalf(-0.0f, 0x8000);
+  succeeded &= CheckHalf(1.0f, 0x3c00);
+  succeeded &= CheckHalf(0.5f, 0x3800);
+  succeeded &= CheckHalf(-2.0f, 0xc000);
+  succeeded &= CheckHalf(1000.0f, 0x63d0);
+
+  //rounding to nearest, ties to even
+  succeeded &= CheckHalf( (float) (1.0 + ldexp(1.0, -11)), 0x3c00 );
+  succeeded &= CheckHalf( (float) (1.0 + ldexp(1.0, -11) + ldexp(1.0, -20)), 0x3c01 );
+  succeeded &= CheckHalf( (float) (1.0 + 3.0 * ldexp(1.0, -11)), 0x3c02 );
+  succeeded &= CheckHalf( (float) (2.0 - ldexp(1.0, -12)), 0x4000 );
+
+  //the largest half, and saturation beyond it
+  succeeded &= CheckHalf(65504.0f, 0x7bff);
+  succeeded &= CheckHalf(65519.0f, 0x7bff);
+  succeeded &= CheckHalf(65520.0f, 0x7bff);
+  succeeded &= CheckHalf(1.0e6f, 0x7bff);
+  succeeded &= CheckHalf(-1.0e6f, 0xfbff);
+  succeeded &= CheckHalf(std::numeric_limits<float>::infinity(), 0x7bff);
+  succeeded &= CheckHalf(-std::numeric_limits<float>::infinity(), 0xfbff);
+  succeeded &= CheckHalf(std::numeric_limits<float>::quiet_NaN(), 0x7e00);
+
+  //normals and subnormals around the smallest normal
+  succeeded &= CheckHalf( (float) ldexp(1.0, -14), 0x0400 );
+  succeeded &= CheckHalf( (float) (ldexp(1.0, -14) - ldexp(1.0, -24)), 0x03ff );
+  succeeded &= CheckHalf( (float) (ldexp(1.0, -14) - ldexp(1.0, -25)), 0x0400 );
+
+  //the smallest subnormals, with ties to even, and underflow to a signed zero
+  succeeded &= CheckHalf( (float) ldexp(1.0, -24), 0x0001 );
+  succeeded &= CheckHalf( (float) -ldexp(1.0, -24), 0x8001 );
+  succeeded &= CheckHalf( (float) ldexp(1.0, -25), 0x0000 );
+  succeeded &= CheckHalf( (float) ldexp(1.5, -25), 0x0001 );
+  succeeded &= CheckHalf( (float) ldexp(3.0, -25), 0x0002 );
+  succeeded &= CheckHalf( (float) ldexp(1.0, -26), 0x0000 );
+  succeeded &= CheckHalf( (float) -ldexp(1.0, -30), 0x8000 );
+  succeeded &= CheckHalf( std::numeric_limits<float>::denorm_min(), 0x0000 );
+
+  //every finite half converts back to itself
+  for( unsigned int half = 0; half < 0x10000; half++ )
+    {
+    if( (half & 0x7c00) == 0x7c00 ) continue;
+    if( vtkCUDAVolumeMapper::FloatToHalf( HalfToFloat( (unsigned short) half ) ) != half )
+      {
+      std::cerr << "The half 0x" << std::hex << half << std::dec << " does not convert back to itself." << std::endl;
+      succeeded = false;
+      break;
+      }
+    }
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,205 @@
+// CUDA Volume Rendering includes
+#include "vtkCUDAVolumeCache.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkNew.h>
+
+// STD includes
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+std::string CacheFileName(const char* directory, vtkTypeUInt64 key)
+{
+  std::ostringstream name;
+  name << directory << "/";
+  name.fill('0');
+  name.width(16);
+  name << std::hex << key << ".vtkcudacache";
+  return name.str();
+}
+
+//----------------------------------------------------------------------------
+bool CopyFile(const std::string& from, const std::string& to, std::streamoff length = -1)
+{
+  std::ifstream in(from.c_str(), std::ios::binary);
+  std::vector<char> content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  if( !in.good() && !in.eof() ) return false;
+  if( length >= 0 && length < (std::streamoff) content.size() ) content.resize( (size_t) length );
+  std::ofstream out(to.c_str(), std::ios::binary | std::ios::trunc);
+  out.write(content.empty() ? "" : &content[0], content.size());
+  return out.good();
+}
+
+//----------------------------------------------------------------------------
+bool CheckSection(vtkCUDAVolumeCache* cache, unsigned int tag, const std::vector<unsigned short>& expected)
+{
+  vtkTypeUInt64 size = 0;
+  const void* section = cache->GetSection(tag, &size);
+  if( !section || size != expected.size() * sizeof(unsigned short) )
+    {
+    std::cerr << "Section " << tag << " is missing or has " << size << " bytes." << std::endl;
+    return false;
+    }
+  if( memcmp(section, &expected[0], (size_t) size) != 0 )
+    {
+    std::cerr << "Section " << tag << " does not read back as written." << std::endl;
+    return false;
+    }
+  return true;
+}
+
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumeCacheTest1(int argc, char* argv[])
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const char* directory = argv[1];
+
+  //a small volume, with a section written in one go and one written a slab at a time
+  const int size[3] = { 16, 8, 4 };
+  const vtkIdType increments[3] = { 1, 16, 128 };
+  std::vector<unsigned short> voxels(16 * 8 * 4);
+  for( size_t i = 0; i < voxels.size(); i++ ) voxels[i] = (unsigned short) (i * 37 % 4096);
+  std::vector<unsigned short> levels(voxels.begin(), voxels.begin() + 100);
+
+  vtkNew<vtkMultiThreader> threader;
+  const vtkTypeUInt64 key = vtkCUDAVolumeCache::ComputeKey( &voxels[0], VTK_UNSIGNED_SHORT, 2, increments, size, threader.GetPointer() );
+  const double spacing[3] = { 1.0, 1.0, 2.5 };
+  const vtkTypeUInt64 spacedKey = vtkCUDAVolumeCache::CombineKey( key, spacing, sizeof(spacing) );
+  if( spacedKey == key )
+    {
+    std::cerr << "Folding the spacing into the key left it unchanged." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //the key follows the voxels
+  std::vector<unsigned short> changed(voxels);
+  changed[42]++;
+  if( vtkCUDAVolumeCache::ComputeKey( &changed[0], VTK_UNSIGNED_SHORT, 2, increments, size, threader.GetPointer() ) == key )
+    {
+    std::cerr << "Changing a voxel left the key unchanged." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  const unsigned int voxelTag = VTKCUDAVOLUMECACHE_TAG('V','O','X','L');
+  const unsigned int levelTag = VTKCUDAVOLUMECACHE_TAG('L','E','V','L');
+
+  //round trip, with sections stored as is and (when built with zstd) compressed
+  vtkNew<vtkCUDAVolumeCache> cache;
+  cache->SetDirectory(directory);
+  for( int compression = 0; compression < 2; compression++ )
+    {
+    cache->SetCompression(compression);
+    if( !cache->BeginWrite(spacedKey) ||
+        !cache->BeginSection(voxelTag) ||
+        !cache->AppendToSection( &voxels[0], voxels.size() * sizeof(unsigned short) / 2 ) ||
+        !cache->AppendToSection( &voxels[voxels.size() / 2], voxels.size() * sizeof(unsigned short) / 2 ) ||
+        !cache->BeginSection(levelTag) ||
+        !cache->AppendToSection( &levels[0], levels.size() * sizeof(unsigned short) ) ||
+        !cache->EndWrite() )
+      {
+      std::cerr << "Writing the cache file failed." << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( !cache->Open(spacedKey) )
+      {
+      std::cerr << "The cache file just written does not open." << std::endl;
+      return EXIT_FAILURE;
+      }
+    if( !CheckSection(cache.GetPointer(), voxelTag, voxels) || !CheckSection(cache.GetPointer(), levelTag, levels) )
+      {
+      return EXIT_FAILURE;
+      }
+    vtkTypeUInt64 missingSize = 0;
+    if( cache->GetSection( VTKCUDAVOLUMECACHE_TAG('N','O','N','E'), &missingSize ) )
+      {
+      std::cerr << "A section that was never written was found." << std::endl;
+      return EXIT_FAILURE;
+      }
+    cache->Close();
+    }
+  cache->CompressionOff();
+
+  //a volume with another spacing has no file
+  if( cache->Open(key) )
+    {
+    std::cerr << "The cache file was opened under the key without the spacing." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //a stale file left under another key's name is rejected by the key in its header
+  const std::string fileName = CacheFileName(directory, spacedKey);
+  const std::string staleFileName = CacheFileName(directory, key);
+  if( !CopyFile(fileName, staleFileName) )
+    {
+    std::cerr << "Cannot copy " << fileName << "." << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( cache->Open(key) )
+    {
+    std::cerr << "A cache file holding another key was accepted." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  //so is a truncated file
+  if( !CopyFile(fileName, staleFileName + ".full") || !CopyFile(staleFileName + ".full", fileName, 64) )
+    {
+    std::cerr << "Cannot truncate " << fileName << "." << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( cache->Open(spacedKey) )
+    {
+    std::cerr << "A truncated cache file was accepted." << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::remove( staleFileName.c_str() );
+  std::remove( (staleFileName + ".full").c_str() );
+  std::remove( fileName.c_str() );
+
+  //a file read volume is keyed by its size, so rewriting it changes the key
+  const std::string volumeFileName = std::string(directory) + "/vtkCUDAVolumeCacheTest1.raw";
+  std::ofstream volumeFile(volumeFileName.c_str(), std::ios::binary | std::ios::trunc);
+  volumeFile.write( reinterpret_cast<const char*>(&voxels[0]), voxels.size() * sizeof(unsigned short) );
+  volumeFile.close();
+  vtkTypeUInt64 fileKey = 0;
+  if( !vtkCUDAVolumeCache::ComputeFileKey(volumeFileName.c_str(), &fileKey) )
+    {
+    std::cerr << "Cannot key " << volumeFileName << "." << std::endl;
+    return EXIT_FAILURE;
+    }
+  volumeFile.open(volumeFileName.c_str(), std::ios::binary | std::ios::app);
+  volumeFile.write( reinterpret_cast<const char*>(&levels[0]), levels.size() * sizeof(unsigned short) );
+  volumeFile.close();
+  vtkTypeUInt64 rewrittenKey = 0;
+  if( !vtkCUDAVolumeCache::ComputeFileKey(volumeFileName.c_str(), &rewrittenKey) || rewrittenKey == fileKey )
+    {
+    std::cerr << "Rewriting " << volumeFileName << " left its key unchanged." << std::endl;
+    return EXIT_FAILURE;
+    }
+  std::remove( volumeFileName.c_str() );
+  vtkTypeUInt64 noKey = 0;
+  if( vtkCUDAVolumeCache::ComputeFileKey(volumeFileName.c_str(), &noKey) )
+    {
+    std::cerr << "A missing file was keyed." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  return EXIT_SUCCESS;
+}
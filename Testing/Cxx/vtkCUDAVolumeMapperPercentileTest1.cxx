@@ -0,0 +1,71 @@
+// CUDA Volume Rendering includes
+#include "vtkCUDAVolumeMapper.h"
+
+// STD includes
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+bool CheckPercentile(const char* name, const vtkIdType histogram[VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS], const double range[2],
+                     double fraction, double expected)
+{
+  double percentile = vtkCUDAVolumeMapper::ComputePercentile(histogram, range, fraction);
+  if( fabs(percentile - expected) > 1e-9 * (1.0 + fabs(expected)) )
+    {
+    std::cerr << name << ": the " << fraction << " percentile is " << percentile << " instead of " << expected << std::endl;
+    return false;
+    }
+  return true;
+}
+
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumeMapperPercentileTest1(int vtkNotUsed(argc), char* vtkNotUsed(argv)[])
+{
+  vtkIdType histogram[VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS];
+  bool succeeded = true;
+
+  //an empty histogram has all its percentiles at the lower end of the range
+  for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ ) histogram[bin] = 0;
+  const double shiftedRange[2] = { -100.0, 300.0 };
+  succeeded &= CheckPercentile("Empty", histogram, shiftedRange, 0.0, -100.0);
+  succeeded &= CheckPercentile("Empty", histogram, shiftedRange, 0.5, -100.0);
+  succeeded &= CheckPercentile("Empty", histogram, shiftedRange, 1.0, -100.0);
+
+  //a flat histogram has its percentiles evenly spread over the range
+  for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ ) histogram[bin] = 10;
+  const double unitRange[2] = { 0.0, (double) VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS };
+  succeeded &= CheckPercentile("Flat", histogram, unitRange, 0.0, 0.0);
+  succeeded &= CheckPercentile("Flat", histogram, unitRange, 0.25, 0.25 * VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS);
+  succeeded &= CheckPercentile("Flat", histogram, unitRange, 0.5, 0.5 * VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS);
+  succeeded &= CheckPercentile("Flat", histogram, unitRange, 0.99, 0.99 * VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS);
+  succeeded &= CheckPercentile("Flat", histogram, unitRange, 1.0, VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS);
+  succeeded &= CheckPercentile("Flat", histogram, shiftedRange, 0.5, 100.0);
+
+  //fractions outside [0,1] are clamped
+  succeeded &= CheckPercentile("Clamped", histogram, unitRange, -0.5, 0.0);
+  succeeded &= CheckPercentile("Clamped", histogram, unitRange, 2.0, VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS);
+
+  //a single occupied bin is interpolated across its width
+  for( int bin = 0; bin < VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS; bin++ ) histogram[bin] = 0;
+  histogram[100] = 4;
+  const double binWidth = (shiftedRange[1] - shiftedRange[0]) / VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS;
+  const double binStart = shiftedRange[0] + 100 * binWidth;
+  succeeded &= CheckPercentile("Single bin", histogram, shiftedRange, 0.0, binStart);
+  succeeded &= CheckPercentile("Single bin", histogram, shiftedRange, 0.25, binStart + 0.25 * binWidth);
+  succeeded &= CheckPercentile("Single bin", histogram, shiftedRange, 1.0, binStart + binWidth);
+
+  //empty bins between occupied ones are skipped over
+  histogram[100] = 0;
+  histogram[0] = 1;
+  histogram[VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS - 1] = 3;
+  succeeded &= CheckPercentile("Two bins", histogram, unitRange, 0.25, 1.0);
+  succeeded &= CheckPercentile("Two bins", histogram, unitRange, 0.5, VTKCUDAVOLUMEMAPPER_HISTOGRAM_BINS - 1 + 1.0 / 3.0);
+
+  return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
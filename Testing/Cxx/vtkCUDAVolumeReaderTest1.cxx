@@ -0,0 +1,289 @@
+// CUDA Volume Rendering includes
+#include "vtkCUDACompressedVolumeReader.h"
+#include "vtkCUDAMappedVolumeReader.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkNew.h>
+#include <vtk_zlib.h>
+
+// STD includes
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+//----------------------------------------------------------------------------
+bool WriteFile(const std::string& fileName, const std::string& header, const void* data, size_t size)
+{
+  std::ofstream file(fileName.c_str(), std::ios::binary | std::ios::trunc);
+  file.write(header.data(), header.size());
+  if( size ) file.write(static_cast<const char*>(data), size);
+  return file.good();
+}
+
+//----------------------------------------------------------------------------
+std::vector<unsigned short> MakeVoxels(const int size[3])
+{
+  //both bytes of each voxel vary, so a missing or extra byte swap shows
+  std::vector<unsigned short> voxels(size[0] * size[1] * size[2]);
+  for( size_t i = 0; i < voxels.size(); i++ ) voxels[i] = (unsigned short) (i * 257 + i / 3);
+  return voxels;
+}
+
+//----------------------------------------------------------------------------
+std::vector<unsigned short> SwapVoxels(const std::vector<unsigned short>& voxels)
+{
+  std::vector<unsigned short> swapped(voxels.size());
+  for( size_t i = 0; i < voxels.size(); i++ ) swapped[i] = (unsigned short) ((voxels[i] >> 8) | (voxels[i] << 8));
+  return swapped;
+}
+
+//----------------------------------------------------------------------------
+std::vector<unsigned char> Compress(const std::vector<unsigned short>& voxels, bool gzip)
+{
+  //gzip for NRRD, zlib for MetaImage
+  z_stream stream;
+  memset(&stream, 0, sizeof(stream));
+  std::vector<unsigned char> compressed;
+  if( deflateInit2(&stream, Z_BEST_SPEED, Z_DEFLATED, gzip ? 15 + 16 : 15, 8, Z_DEFAULT_STRATEGY) != Z_OK ) return compressed;
+  compressed.resize( deflateBound(&stream, (uLong) (voxels.size() * sizeof(unsigned short))) + 32 );
+  stream.next_in = (Bytef*) &voxels[0];
+  stream.avail_in = (uInt) (voxels.size() * sizeof(unsigned short));
+  stream.next_out = &compressed[0];
+  stream.avail_out = (uInt) compressed.size();
+  int result = deflate(&stream, Z_FINISH);
+  compressed.resize( (result == Z_STREAM_END) ? stream.total_out : 0 );
+  deflateEnd(&stream);
+  return compressed;
+}
+
+//----------------------------------------------------------------------------
+bool CheckImage(const char* name, vtkImageData* image, const int size[3], const double spacing[3], const double origin[3],
+                int scalarType, const std::vector<unsigned short>& voxels)
+{
+  int extent[6];
+  image->GetExtent(extent);
+  for( int i = 0; i < 3; i++ )
+    {
+    if( extent[2*i] != 0 || extent[2*i+1] != size[i] - 1 )
+      {
+      std::cerr << name << ": axis " << i << " spans " << extent[2*i] << ".." << extent[2*i+1] << " instead of 0.." << size[i] - 1 << std::endl;
+      return false;
+      }
+    if( fabs(image->GetSpacing()[i] - spacing[i]) > 1e-9 || fabs(image->GetOrigin()[i] - origin[i]) > 1e-9 )
+      {
+      std::cerr << name << ": axis " << i << " has spacing " << image->GetSpacing()[i] << " and origin " << image->GetOrigin()[i]
+                << " instead of " << spacing[i] << " and " << origin[i] << std::endl;
+      return false;
+      }
+    }
+  if( image->GetScalarType() != scalarType || image->GetNumberOfScalarComponents() != 1 )
+    {
+    std::cerr << name << ": read scalar type " << image->GetScalarType() << " with " << image->GetNumberOfScalarComponents()
+              << " components instead of " << scalarType << " with 1." << std::endl;
+    return false;
+    }
+  const unsigned short* read = static_cast<const unsigned short*>(image->GetScalarPointer());
+  for( size_t i = 0; read && i < voxels.size(); i++ )
+    {
+    if( read[i] != voxels[i] )
+      {
+      std::cerr << name << ": voxel " << i << " reads " << read[i] << " instead of " << voxels[i] << std::endl;
+      return false;
+      }
+    }
+  if( !read )
+    {
+    std::cerr << name << ": no voxels were read." << std::endl;
+    return false;
+    }
+  return true;
+}
+
+}
+
+//----------------------------------------------------------------------------
+int vtkCUDAVolumeReaderTest1(int argc, char* argv[])
+{
+  if( argc < 2 )
+    {
+    std::cerr << "Usage: " << argv[0] << " <temporary directory>" << std::endl;
+    return EXIT_FAILURE;
+    }
+  const std::string directory = argv[1];
+  const bool bigEndianHost = (SwapVoxels(std::vector<unsigned short>(1, 1))[0] == 1);
+
+  const int size[3] = { 24, 16, 6 };
+  const std::vector<unsigned short> voxels = MakeVoxels(size);
+  const std::vector<unsigned short> littleEndianVoxels = bigEndianHost ? SwapVoxels(voxels) : voxels;
+  const std::vector<unsigned short> bigEndianVoxels = bigEndianHost ? voxels : SwapVoxels(voxels);
+  const size_t bytes = voxels.size() * sizeof(unsigned short);
+
+  //NRRD with attached data, the spacing given by the length of the space directions
+  const std::string nrrdName = directory + "/vtkCUDAVolumeReaderTest1.nrrd";
+  const std::string nrrdHeader =
+    "NRRD0004\n"
+    "# a comment: which is skipped\n"
+    "type: unsigned short\n"
+    "dimension: 3\n"
+    "space: left-posterior-superior\n"
+    "sizes: 24 16 6\n"
+    "space directions: (0.5,0,0) (0,0,0.75) (0,-2,0)\n"
+    "endian: little\n"
+    "encoding: raw\n"
+    "space origin: (1.5,-2,30)\n"
+    "\n";
+  const double nrrdSpacing[3] = { 0.5, 0.75, 2.0 };
+  const double nrrdOrigin[3] = { 1.5, -2.0, 30.0 };
+  vtkNew<vtkCUDAMappedVolumeReader> mappedReader;
+  if( !WriteFile(nrrdName, nrrdHeader, &littleEndianVoxels[0], bytes) ) return EXIT_FAILURE;
+  if( !mappedReader->CanReadFile(nrrdName.c_str()) )
+    {
+    std::cerr << "The NRRD file is not recognised." << std::endl;
+    return EXIT_FAILURE;
+    }
+  mappedReader->SetFileName(nrrdName.c_str());
+  mappedReader->Update();
+  if( !CheckImage("Attached NRRD", mappedReader->GetOutput(), size, nrrdSpacing, nrrdOrigin, VTK_UNSIGNED_SHORT, voxels) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //NRRD with a detached big endian data file past a byte skip
+  const std::string detachedName = directory + "/vtkCUDAVolumeReaderTest1.nhdr";
+  const std::string detachedDataName = directory + "/vtkCUDAVolumeReaderTest1.raw";
+  const std::string detachedHeader =
+    "NRRD0004\n"
+    "type: uint16\n"
+    "dimension: 3\n"
+    "sizes: 24 16 6\n"
+    "spacings: 1.25 1.25 3\n"
+    "endian: big\n"
+    "encoding: raw\n"
+    "byte skip: 7\n"
+    "data file: vtkCUDAVolumeReaderTest1.raw\n";
+  const double detachedSpacing[3] = { 1.25, 1.25, 3.0 };
+  const double noOrigin[3] = { 0.0, 0.0, 0.0 };
+  if( !WriteFile(detachedName, detachedHeader, NULL, 0) ||
+      !WriteFile(detachedDataName, "skipped", &bigEndianVoxels[0], bytes) ) return EXIT_FAILURE;
+  mappedReader->SetFileName(detachedName.c_str());
+  mappedReader->Update();
+  if( !CheckImage("Detached NRRD", mappedReader->GetOutput(), size, detachedSpacing, noOrigin, VTK_UNSIGNED_SHORT, voxels) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //MetaImage with local data
+  const std::string mhaName = directory + "/vtkCUDAVolumeReaderTest1.mha";
+  const std::string mhaHeader =
+    "ObjectType = Image\n"
+    "NDims = 3\n"
+    "BinaryData = True\n"
+    "BinaryDataByteOrderMSB = False\n"
+    "Offset = -10 20.5 0\n"
+    "ElementSpacing = 0.8 0.9 1.1\n"
+    "DimSize = 24 16 6\n"
+    "ElementType = MET_SHORT\n"
+    "ElementDataFile = LOCAL\n";
+  const double mhaSpacing[3] = { 0.8, 0.9, 1.1 };
+  const double mhaOrigin[3] = { -10.0, 20.5, 0.0 };
+  if( !WriteFile(mhaName, mhaHeader, &littleEndianVoxels[0], bytes) ) return EXIT_FAILURE;
+  if( !mappedReader->CanReadFile(mhaName.c_str()) )
+    {
+    std::cerr << "The MetaImage file is not recognised." << std::endl;
+    return EXIT_FAILURE;
+    }
+  mappedReader->SetFileName(mhaName.c_str());
+  mappedReader->Update();
+  if( !CheckImage("MetaImage", mappedReader->GetOutput(), size, mhaSpacing, mhaOrigin, VTK_SHORT, voxels) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //a gzip NRRD large enough to be decompressed over several publications of the slices, read pipelined
+  const int largeSize[3] = { 256, 256, 40 };
+  const std::vector<unsigned short> largeVoxels = MakeVoxels(largeSize);
+  const std::vector<unsigned short> largeBigEndianVoxels = bigEndianHost ? largeVoxels : SwapVoxels(largeVoxels);
+  const std::vector<unsigned char> gzipped = Compress(largeBigEndianVoxels, true);
+  if( gzipped.empty() ) return EXIT_FAILURE;
+  const std::string gzipName = directory + "/vtkCUDAVolumeReaderTest1Gzip.nrrd";
+  const std::string gzipHeader =
+    "NRRD0004\n"
+    "type: ushort\n"
+    "dimension: 3\n"
+    "sizes: 256 256 40\n"
+    "endian: big\n"
+    "encoding: gzip\n"
+    "\n";
+  const double unitSpacing[3] = { 1.0, 1.0, 1.0 };
+  if( !WriteFile(gzipName, gzipHeader, &gzipped[0], gzipped.size()) ) return EXIT_FAILURE;
+  vtkNew<vtkCUDACompressedVolumeReader> compressedReader;
+  compressedReader->SetPipelined(true);
+  compressedReader->SetFileName(gzipName.c_str());
+  compressedReader->Update();
+  int slices = compressedReader->WaitForSlices(1);
+  if( slices < 1 || slices > largeSize[2] )
+    {
+    std::cerr << "Waiting for the first slice returned " << slices << " slices." << std::endl;
+    return EXIT_FAILURE;
+    }
+  slices = compressedReader->WaitForSlices(largeSize[2]);
+  if( slices != largeSize[2] || compressedReader->GetDecompressionFailed() )
+    {
+    std::cerr << "Only " << slices << " of " << largeSize[2] << " gzip slices were decompressed." << std::endl;
+    return EXIT_FAILURE;
+    }
+  if( !CheckImage("Gzip NRRD", compressedReader->GetOutput(), largeSize, unitSpacing, noOrigin, VTK_UNSIGNED_SHORT, largeVoxels) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //a zlib MetaImage read in one go
+  const std::vector<unsigned char> zlibbed = Compress(littleEndianVoxels, false);
+  if( zlibbed.empty() ) return EXIT_FAILURE;
+  const std::string zlibName = directory + "/vtkCUDAVolumeReaderTest1Zlib.mha";
+  const std::string zlibHeader =
+    "NDims = 3\n"
+    "DimSize = 24 16 6\n"
+    "ElementSpacing = 0.8 0.9 1.1\n"
+    "Offset = -10 20.5 0\n"
+    "ElementType = MET_USHORT\n"
+    "CompressedData = True\n"
+    "ElementDataFile = LOCAL\n";
+  if( !WriteFile(zlibName, zlibHeader, &zlibbed[0], zlibbed.size()) ) return EXIT_FAILURE;
+  compressedReader->SetPipelined(false);
+  compressedReader->SetFileName(zlibName.c_str());
+  compressedReader->Update();
+  if( compressedReader->GetDecompressionFailed() ||
+      !CheckImage("Zlib MetaImage", compressedReader->GetOutput(), size, mhaSpacing, mhaOrigin, VTK_UNSIGNED_SHORT, voxels) )
+    {
+    return EXIT_FAILURE;
+    }
+
+  //a truncated stream decompresses the slices it holds, then fails
+  if( !WriteFile(gzipName, gzipHeader, &gzipped[0], gzipped.size() / 2) ) return EXIT_FAILURE;
+  compressedReader->SetFileName(gzipName.c_str());
+  compressedReader->Modified();
+  compressedReader->Update();
+  if( !compressedReader->GetDecompressionFailed() || compressedReader->WaitForSlices(largeSize[2]) >= largeSize[2] )
+    {
+    std::cerr << "A truncated gzip stream was not reported as failed." << std::endl;
+    return EXIT_FAILURE;
+    }
+
+  std::remove( nrrdName.c_str() );
+  std::remove( detachedName.c_str() );
+  std::remove( detachedDataName.c_str() );
+  std::remove( mhaName.c_str() );
+  std::remove( gzipName.c_str() );
+  std::remove( zlibName.c_str() );
+  return EXIT_SUCCESS;
+}